@@ -0,0 +1,497 @@
+// Throughput benchmarks for the CPU engines and the Apple II system.
+//
+// Every workload runs a fixed, deterministic amount of emulated work and reports emulated MHz and
+// nanoseconds per instruction for each engine. The best of --repeat runs is reported, so the
+// numbers are comparable between builds and releases. Use --json to write the results to a file
+// for regression tracking.
+//
+// Workloads that need files that are not part of the repository (Apple II ROM, Disk II ROM and a
+// disk image) are skipped unless their paths are given on the command line.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "apple2/apple2system.h"
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "cpu6502/block_cache.h"
+#include "cpu6502/mos6502.h"
+
+using namespace Common;
+using cpu6502::Generic6502Definition;
+using cpu6502::mos6502;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using Engine = apple2::Apple2System::Engine;
+
+constexpr std::array<Engine, 3> c_engines{Engine::Microcode, Engine::Instruction, Engine::Block};
+
+// Klaus Dormann's functional test starts at $0400 and ends in a JMP to itself at $3469.
+constexpr Address c_klausStart{0x0400};
+constexpr Address c_klausSuccess{0x3469};
+constexpr uint64_t c_klausMaxCycles = 200'000'000;
+
+// Autostart ROM boot ends at the Applesoft prompt, which is well within 5 seconds.
+constexpr uint64_t c_bootMaxCycles = 5'000'000;
+constexpr uint64_t c_bootSlice = 10'000;
+
+constexpr Address c_loopStart{0x0400};
+
+// LDX #0; LDA #0; loop: CLC; ADC #$37; EOR #$A5; AND #$7F; ORA #$01; ASL A; LSR A; CMP #$40; INX;
+// BNE loop; JMP loop
+constexpr std::array<Byte, 23> c_aluLoop{0xA2, 0x00, 0xA9, 0x00, 0x18, 0x69, 0x37, 0x49, 0xA5, 0x29, 0x7F, 0x09,
+    0x01, 0x0A, 0x4A, 0xC9, 0x40, 0xE8, 0xD0, 0xF0, 0x4C, 0x04, 0x04};
+
+// LDX #0; loop: LDA $10,X; ADC $20,X; STA $30,X; INC $40; LDA $40; STA $41; ASL $42; LSR $43; INX;
+// BNE loop; JMP loop
+constexpr std::array<Byte, 24> c_zeroPageLoop{0xA2, 0x00, 0xB5, 0x10, 0x75, 0x20, 0x95, 0x30, 0xE6, 0x40, 0xA5,
+    0x40, 0x85, 0x41, 0x06, 0x42, 0x46, 0x43, 0xE8, 0xD0, 0xED, 0x4C, 0x02, 0x04};
+
+struct Options
+{
+  uint64_t cycles = 20'000'000;  // Budget for the fixed-length workloads
+  int repeat = 3;
+  std::string klausImage = EMULATE_BENCH_KLAUS_BIN;
+  std::string appleRom;
+  std::string diskRom;
+  std::string disk;
+  std::string json;
+};
+
+//! What one run of a workload did and how long it took.
+struct Sample
+{
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  Clock::duration elapsed{};
+  bool ok = true;
+  std::string note;
+};
+
+struct Result
+{
+  std::string workload;
+  Engine engine;
+  std::optional<Sample> sample;  // Empty if the workload was skipped
+  std::string note;
+
+  [[nodiscard]] double seconds() const
+  {
+    return std::chrono::duration<double>(sample->elapsed).count();
+  }
+
+  [[nodiscard]] double mhz() const
+  {
+    return static_cast<double>(sample->cycles) / seconds() / 1e6;
+  }
+
+  [[nodiscard]] double nsPerInstruction() const
+  {
+    return seconds() * 1e9 / static_cast<double>(std::max<uint64_t>(sample->instructions, 1));
+  }
+};
+
+struct Workload
+{
+  std::string name;
+  std::string skipReason;  // Non-empty if the workload cannot run
+  std::function<Sample(Engine)> run;
+};
+
+const char* engineName(Engine engine)
+{
+  switch (engine)
+  {
+  case Engine::Microcode:
+    return "microcode";
+  case Engine::Instruction:
+    return "instruction";
+  case Engine::Block:
+    return "block";
+  }
+  return "?";
+}
+
+//! Runs a bare 6502 over 64K of RAM until `done` returns true at an instruction boundary or the
+//! cycle budget is used up. Only the execution loop is timed.
+template<typename Done>
+Sample runCpu(Engine engine, std::span<const Byte> image, Address start, uint64_t budget, Done done)
+{
+  std::vector<Byte> memory(0x10000);
+  std::copy_n(image.begin(), std::min(image.size(), memory.size()), memory.begin());
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+
+  Generic6502Definition cpu;
+  cpu.registers.pc = start;
+
+  Sample sample;
+  auto begin = Clock::now();
+  if (engine == Engine::Microcode)
+  {
+    MicrocodePump<mos6502> pump;
+    auto count = [&](const Generic6502Definition& state)
+    {
+      if (done(state))
+      {
+        return true;
+      }
+      ++sample.instructions;
+      return false;
+    };
+    auto result = pump.runFor(cpu, Generic6502Definition::BusToken{&bus}, budget, count);
+    sample.cycles = result.cycles;
+    if (result.status == RunStatus::Trapped)
+    {
+      sample.ok = false;
+      sample.note = "trapped at $" + std::to_string(static_cast<uint16_t>(result.trapAddress));
+    }
+  }
+  else if (engine == Engine::Instruction)
+  {
+    while (sample.cycles < budget && !done(std::as_const(cpu)))
+    {
+      sample.cycles += mos6502::executeInstruction(cpu, bus);
+      ++sample.instructions;
+      if (cpu.trapped)
+      {
+        sample.ok = false;
+        sample.note = "trapped at $" + std::to_string(static_cast<uint16_t>(cpu.trapAddress));
+        break;
+      }
+    }
+  }
+  else
+  {
+    // `done` is only asked between blocks, which is enough for the addresses the workloads stop at:
+    // they are jump targets.
+    cpu6502::BlockCache blocks{&mos6502::instruction};
+    while (sample.cycles < budget && !done(std::as_const(cpu)))
+    {
+      auto executed = blocks.execute<mos6502>(cpu, bus);
+      sample.cycles += executed.cycles;
+      sample.instructions += executed.instructions;
+      if (cpu.trapped)
+      {
+        sample.ok = false;
+        sample.note = "trapped at $" + std::to_string(static_cast<uint16_t>(cpu.trapAddress));
+        break;
+      }
+    }
+  }
+  sample.elapsed = Clock::now() - begin;
+  return sample;
+}
+
+//! ROM images and RAM banks for an Apple2System. The system keeps pointers into them, so they have
+//! to outlive it.
+struct AppleMemory
+{
+  std::array<Byte, 0xC000> ram{};
+  std::array<Byte, 0x3000> rom{};
+  std::array<Byte, 0x1000> langBank0{};
+  std::array<Byte, 0x1000> langBank1{};
+};
+
+std::unique_ptr<apple2::Apple2System> makeApple(AppleMemory& memory, Engine engine)
+{
+  return std::make_unique<apple2::Apple2System>(std::span(memory.ram),
+      std::span<const Byte, 0x3000>(memory.rom), std::span(memory.langBank0), std::span(memory.langBank1), engine);
+}
+
+bool showsPrompt(const apple2::Apple2System& system)
+{
+  const auto& screen = system.getScreen();
+  return std::ranges::any_of(screen,
+      [](const auto& line)
+      { return std::ranges::any_of(line, [](char c) { return static_cast<Byte>(c) == 0xDD; }); });  // ']'
+}
+
+//! Runs an Apple2System in slices until `done` returns true between slices or the budget is used up.
+template<typename Done>
+Sample runApple(apple2::Apple2System& system, uint64_t budget, uint64_t slice, Done done)
+{
+  Sample sample;
+  auto count = [&](const apple2::Apple2System::Processor::State& /*cpu*/)
+  {
+    ++sample.instructions;
+    return false;
+  };
+
+  system.reset();
+  auto begin = Clock::now();
+  while (sample.cycles < budget && !done())
+  {
+    auto result = system.runFor(std::min(slice, budget - sample.cycles), count);
+    sample.cycles += result.cycles;
+    if (result.status == RunStatus::Trapped)
+    {
+      sample.ok = false;
+      sample.note = "trapped at $" + std::to_string(static_cast<uint16_t>(result.trapAddress));
+      break;
+    }
+  }
+  sample.elapsed = Clock::now() - begin;
+  return sample;
+}
+
+std::vector<Workload> makeWorkloads(const Options& options)
+{
+  std::vector<Workload> workloads;
+
+  auto klaus = std::make_shared<std::vector<Byte>>(LoadFile(options.klausImage));
+  workloads.push_back({"klaus-functional", klaus->empty() ? "image not found: " + options.klausImage : "",
+      [klaus](Engine engine)
+      {
+        auto sample = runCpu(engine, *klaus, c_klausStart, c_klausMaxCycles,
+            [](const Generic6502Definition& cpu) { return cpu.registers.pc == c_klausSuccess; });
+        if (sample.ok && sample.cycles >= c_klausMaxCycles)
+        {
+          sample.ok = false;
+          sample.note = "did not reach the success address";
+        }
+        return sample;
+      }});
+
+  auto loop = [&options](std::span<const Byte> program)
+  {
+    std::vector<Byte> image(static_cast<size_t>(c_loopStart) + program.size());
+    std::ranges::copy(program, image.begin() + static_cast<std::ptrdiff_t>(c_loopStart));
+    return [image, budget = options.cycles](Engine engine)
+    { return runCpu(engine, image, c_loopStart, budget, [](const Generic6502Definition& /*cpu*/) { return false; }); };
+  };
+  workloads.push_back({"alu-loop", "", loop(c_aluLoop)});
+  workloads.push_back({"zero-page-loop", "", loop(c_zeroPageLoop)});
+
+  // The ALU loop on an Apple II, once with nothing armed and once with a breakpoint and a watchpoint
+  // away from it. Without them the system has to run as fast as it did before it had any.
+  auto appleLoop = [budget = options.cycles](bool armed)
+  {
+    return [budget, armed](Engine engine)
+    {
+      auto memory = std::make_unique<AppleMemory>();
+      std::ranges::copy(c_aluLoop, memory->ram.begin() + 0x0800);
+      memory->ram[0x0800 + c_aluLoop.size() - 1] = 0x08;  // JMP $0804
+      memory->rom[0x2FFC] = 0x00;  // Reset vector
+      memory->rom[0x2FFD] = 0x08;
+      auto system = makeApple(*memory, engine);
+      if (armed)
+      {
+        system->addBreakpoint(Address{0x9000});
+        system->addWatchpoint(Address{0x9100}, Address{0x91FF});
+      }
+      return runApple(*system, budget, c_bootSlice, [] { return false; });
+    };
+  };
+  workloads.push_back({"apple2-loop", "", appleLoop(false)});
+  workloads.push_back({"apple2-loop-armed", "", appleLoop(true)});
+
+  auto memory = std::make_shared<AppleMemory>();
+  bool haveRom = !options.appleRom.empty();
+  if (haveRom)
+  {
+    Load(std::span(memory->rom), options.appleRom);
+  }
+
+  workloads.push_back({"apple2-rom-boot", haveRom ? "" : "needs --apple-rom",
+      [memory](Engine engine)
+      {
+        memory->ram.fill(0);
+        auto system = makeApple(*memory, engine);
+        auto sample = runApple(*system, c_bootMaxCycles, c_bootSlice, [&] { return showsPrompt(*system); });
+        if (sample.ok && !showsPrompt(*system))
+        {
+          sample.ok = false;
+          sample.note = "no BASIC prompt";
+        }
+        return sample;
+      }});
+
+  std::string diskSkip;
+  if (!haveRom || options.diskRom.empty() || options.disk.empty())
+  {
+    diskSkip = "needs --apple-rom, --disk-rom and --disk";
+  }
+  workloads.push_back({"apple2-disk-boot", diskSkip,
+      [memory, options](Engine engine)
+      {
+        std::array<Byte, 0x100> diskRom{};
+        Load(std::span(diskRom), options.diskRom);
+
+        memory->ram.fill(0);
+        auto system = makeApple(*memory, engine);
+        system->loadPeripheralRom(6, std::span<const Byte, 0x100>(diskRom));
+        if (!system->loadDisk(options.disk))
+        {
+          Sample sample;
+          sample.ok = false;
+          sample.note = "cannot load " + options.disk;
+          return sample;
+        }
+        return runApple(*system, options.cycles, c_bootSlice, [] { return false; });
+      }});
+
+  return workloads;
+}
+
+void writeJson(std::ostream& out, const Options& options, const std::vector<Result>& results)
+{
+  out << std::defaultfloat << std::setprecision(6);
+  out << "{\n  \"version\": 1,\n  \"repeat\": " << options.repeat << ",\n  \"results\": [";
+  const char* separator = "\n";
+  for (const auto& result : results)
+  {
+    out << separator << "    {\"workload\": \"" << result.workload << "\", \"engine\": \"" << engineName(result.engine)
+        << "\"";
+    if (!result.sample)
+    {
+      out << ", \"status\": \"skipped\", \"reason\": \"" << result.note << "\"}";
+    }
+    else
+    {
+      out << ", \"status\": \"" << (result.sample->ok ? "ok" : "failed") << "\", \"cycles\": " << result.sample->cycles
+          << ", \"instructions\": " << result.sample->instructions << ", \"seconds\": " << result.seconds()
+          << ", \"mhz\": " << result.mhz() << ", \"ns_per_instruction\": " << result.nsPerInstruction() << "}";
+    }
+    separator = ",\n";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void printUsage()
+{
+  std::cout << "usage: emulateBench [options]\n"
+               "  --cycles N        cycle budget for the loop and disk workloads (default 20000000)\n"
+               "  --repeat N        runs per workload, the fastest is reported (default 3)\n"
+               "  --klaus FILE      Klaus Dormann 6502_functional_test.bin\n"
+               "  --apple-rom FILE  12K Apple II ROM ($D000-$FFFF)\n"
+               "  --disk-rom FILE   256 byte Disk II controller ROM\n"
+               "  --disk FILE       .dsk image for the disk boot workload\n"
+               "  --json FILE       write the results as JSON, '-' for stdout\n";
+}
+
+std::optional<Options> parseOptions(std::span<char*> args)
+{
+  Options options;
+  for (size_t i = 1; i < args.size(); ++i)
+  {
+    std::string_view arg = args[i];
+    if (arg == "--help" || i + 1 >= args.size())
+    {
+      return std::nullopt;
+    }
+
+    std::string value = args[++i];
+    if (arg == "--cycles")
+      options.cycles = std::stoull(value);
+    else if (arg == "--repeat")
+      options.repeat = std::max(1, std::stoi(value));
+    else if (arg == "--klaus")
+      options.klausImage = value;
+    else if (arg == "--apple-rom")
+      options.appleRom = value;
+    else if (arg == "--disk-rom")
+      options.diskRom = value;
+    else if (arg == "--disk")
+      options.disk = value;
+    else if (arg == "--json")
+      options.json = value;
+    else
+      return std::nullopt;
+  }
+  return options;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  auto options = parseOptions(std::span(argv, static_cast<size_t>(argc)));
+  if (!options)
+  {
+    printUsage();
+    return 2;
+  }
+
+  try
+  {
+    std::vector<Result> results;
+    bool failed = false;
+
+    std::cout << std::left << std::setw(18) << "workload" << std::setw(13) << "engine" << std::right << std::setw(12)
+              << "MHz" << std::setw(12) << "ns/instr" << std::setw(14) << "cycles" << "\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (const auto& workload : makeWorkloads(*options))
+    {
+      for (auto engine : c_engines)
+      {
+        Result result{workload.name, engine, std::nullopt, workload.skipReason};
+        if (workload.skipReason.empty())
+        {
+          for (int run = 0; run < options->repeat; ++run)
+          {
+            Sample sample = workload.run(engine);
+            if (!result.sample || !sample.ok || sample.elapsed < result.sample->elapsed)
+            {
+              result.sample = std::move(sample);
+            }
+            if (!result.sample->ok)
+            {
+              result.note = result.sample->note;
+              failed = true;
+              break;
+            }
+          }
+        }
+
+        std::cout << std::left << std::setw(18) << result.workload << std::setw(13) << engineName(engine);
+        if (result.sample && result.sample->ok)
+        {
+          std::cout << std::right << std::setw(12) << result.mhz() << std::setw(12) << result.nsPerInstruction()
+                    << std::setw(14) << result.sample->cycles << "\n";
+        }
+        else
+        {
+          std::cout << (result.sample ? "FAILED: " : "skipped: ") << result.note << "\n";
+        }
+        results.push_back(std::move(result));
+      }
+    }
+
+    if (options->json == "-")
+    {
+      writeJson(std::cout, *options, results);
+    }
+    else if (!options->json.empty())
+    {
+      std::ofstream file(options->json);
+      writeJson(file, *options, results);
+    }
+    return failed ? 1 : 0;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+}
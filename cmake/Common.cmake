@@ -44,6 +44,9 @@ elseif(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
 endif()
 
 option(EMULATE_ENABLE_LOGGING "Enable runtime logging" OFF)
+option(EMULATE_ENABLE_PROFILING "Count executions and cycles per opcode in Apple2System" OFF)
+option(EMULATE_ENABLE_AVX2 "Build the page hash kernels for AVX2, see common/page_hash.h" OFF)
+option(EMULATE_ENHANCED_IIE "Run Apple2System on the 65C02 of an enhanced Apple IIe" OFF)
 
 # ###############################################################################
 # add dependencies
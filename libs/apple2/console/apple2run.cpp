@@ -0,0 +1,527 @@
+// Headless Apple II runner for scripted batch jobs.
+//
+// Boots the machine from the given ROMs and disk, types an input script and runs as fast as the host
+// allows until a stop condition is met or the cycle budget is used up. The final text screen, the
+// cycles run, the wall time and the emulated MHz are written as JSON. Nothing is read from the
+// terminal and nothing waits in real time, so any number of runs can go side by side.
+//
+// The input script is typed line by line, each line followed by Return. Lines starting with '@' are
+// directives instead:
+//   @wait TEXT    type nothing more until TEXT is on the screen
+//   @delay N      type nothing more for N cycles
+//   @@TEXT        types the line "@TEXT"
+// Lines starting with '#' are comments. Stop conditions only count once the whole script has been
+// typed and read by the guest, so a script can type at the same prompt a run stops at.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "apple2/apple2system.h"
+#include "common/address.h"
+#include "common/logger.h"
+#include "common/memory.h"
+
+using namespace Common;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+using Engine = apple2::Apple2System::Engine;
+using apple2::TextVideoDevice;
+
+// Work is done a video frame at a time; the script and the screen are looked at in between.
+constexpr uint64_t c_frameCycles = 17'030;
+
+struct Options
+{
+  std::string appleRom;
+  std::string diskRom;
+  std::string disk;
+  std::string input;
+  std::string type;  // Typed after the input script, same format
+  uint64_t cycles = 100'000'000;
+  Engine engine = Engine::Block;
+  bool fastDisk = false;
+  bool fastPaste = false;
+  std::vector<Address> stopPcs;
+  std::vector<std::string> stopTexts;
+  std::string json = "-";
+};
+
+struct Step
+{
+  enum class Kind
+  {
+    Type,
+    Wait,
+    Delay,
+  };
+
+  Kind kind = Kind::Type;
+  std::string text;
+  uint64_t cycles = 0;
+};
+
+//! Why a run ended.
+enum class Outcome
+{
+  Budget,
+  StopPc,
+  StopText,
+  Trapped,
+};
+
+const char* outcomeName(Outcome outcome)
+{
+  switch (outcome)
+  {
+  case Outcome::Budget:
+    return "budget";
+  case Outcome::StopPc:
+    return "pc";
+  case Outcome::StopText:
+    return "text";
+  case Outcome::Trapped:
+    return "trapped";
+  }
+  return "?";
+}
+
+const char* engineName(Engine engine)
+{
+  switch (engine)
+  {
+  case Engine::Microcode:
+    return "microcode";
+  case Engine::Instruction:
+    return "instruction";
+  case Engine::Block:
+    return "block";
+  }
+  return "?";
+}
+
+std::vector<Step> parseScript(std::istream& in)
+{
+  std::vector<Step> steps;
+  std::string line;
+  while (std::getline(in, line))
+  {
+    if (!line.empty() && line.back() == '\r')
+    {
+      line.pop_back();
+    }
+
+    std::string_view text = line;
+    if (text.starts_with('#'))
+    {
+      continue;
+    }
+    if (text.starts_with("@wait "))
+    {
+      steps.push_back({Step::Kind::Wait, std::string(text.substr(6)), 0});
+    }
+    else if (text.starts_with("@delay "))
+    {
+      steps.push_back({Step::Kind::Delay, {}, std::stoull(std::string(text.substr(7)))});
+    }
+    else if (text.starts_with("@@") || !text.starts_with('@'))
+    {
+      steps.push_back({Step::Kind::Type, std::string(text.substr(text.starts_with('@') ? 1 : 0)) + '\n', 0});
+    }
+    else
+    {
+      throw std::runtime_error("Unknown script directive: " + line);
+    }
+  }
+  return steps;
+}
+
+//! The text screen as ASCII rows without trailing blanks.
+std::vector<std::string> screenRows(const apple2::Apple2System& system)
+{
+  std::array<char, TextVideoDevice::c_rows * TextVideoDevice::c_columns> text{};
+  system.exportScreen(text);
+
+  std::vector<std::string> rows;
+  for (size_t row = 0; row < TextVideoDevice::c_rows; ++row)
+  {
+    std::string_view line(text.data() + row * TextVideoDevice::c_columns, TextVideoDevice::c_columns);
+    rows.emplace_back(line.substr(0, line.find_last_not_of(' ') + 1));
+  }
+  return rows;
+}
+
+//! True if `text` is on the screen. Rows are joined with newlines, so text can span rows.
+bool showsText(const std::vector<std::string>& rows, std::string_view text)
+{
+  std::string screen;
+  for (const auto& row : rows)
+  {
+    screen += row;
+    screen += '\n';
+  }
+  return screen.find(text) != std::string::npos;
+}
+
+//! Types the script as fast as the guest reads it.
+class ScriptPlayer
+{
+public:
+  explicit ScriptPlayer(std::vector<Step> steps) noexcept
+    : m_steps(std::move(steps))
+  {
+  }
+
+  //! Moves on through the script as far as it can at `cycle`.
+  void advance(apple2::Apple2System& system, uint64_t cycle)
+  {
+    while (m_next < m_steps.size())
+    {
+      const Step& step = m_steps[m_next];
+      switch (step.kind)
+      {
+      case Step::Kind::Type:
+        m_typed += system.typeText(std::string_view(step.text).substr(m_typed));
+        if (m_typed < step.text.size())
+        {
+          return;
+        }
+        m_typed = 0;
+        break;
+      case Step::Kind::Wait:
+        if (!showsText(screenRows(system), step.text))
+        {
+          return;
+        }
+        break;
+      case Step::Kind::Delay:
+        if (!m_resumeCycle)
+        {
+          m_resumeCycle = cycle + step.cycles;
+        }
+        if (cycle < *m_resumeCycle)
+        {
+          return;
+        }
+        m_resumeCycle.reset();
+        break;
+      }
+      ++m_next;
+    }
+  }
+
+  //! True once every step is done and the guest has read every key.
+  bool finished(const apple2::Apple2System& system) const noexcept
+  {
+    return m_next == m_steps.size() && system.pendingKeys() == 0;
+  }
+
+private:
+  std::vector<Step> m_steps;
+  size_t m_next = 0;
+  size_t m_typed = 0;  // Characters of the current Type step that fit into the key buffer
+  std::optional<uint64_t> m_resumeCycle;  // When the current Delay step is over
+};
+
+struct Report
+{
+  Outcome outcome = Outcome::Budget;
+  uint64_t cycles = 0;
+  Clock::duration elapsed{};
+  Address pc{0};
+  Address trapAddress{0};
+  std::vector<std::string> screen;
+};
+
+Report run(apple2::Apple2System& system, ScriptPlayer& script, const Options& options)
+{
+  Report report;
+  auto atStopPc = [&options](const apple2::Apple2System::Processor::State& cpu)
+  { return std::ranges::find(options.stopPcs, cpu.registers.pc) != options.stopPcs.end(); };
+
+  auto begin = Clock::now();
+  while (report.cycles < options.cycles)
+  {
+    script.advance(system, report.cycles);
+    bool armed = script.finished(system);
+
+    // A stop predicate turns off idle and disk fast-forwarding, so it is only passed when it can stop.
+    uint64_t slice = std::min(c_frameCycles, options.cycles - report.cycles);
+    auto result = armed && !options.stopPcs.empty() ? system.runFor(slice, atStopPc) : system.runFor(slice);
+    report.cycles += result.cycles;
+
+    if (result.status == RunStatus::Trapped)
+    {
+      report.outcome = Outcome::Trapped;
+      report.trapAddress = result.trapAddress;
+      break;
+    }
+    if (result.status == RunStatus::Stopped)
+    {
+      report.outcome = Outcome::StopPc;
+      break;
+    }
+    if (armed && std::ranges::any_of(options.stopTexts,
+                     [rows = screenRows(system)](const std::string& text) { return showsText(rows, text); }))
+    {
+      report.outcome = Outcome::StopText;
+      break;
+    }
+  }
+  report.elapsed = Clock::now() - begin;
+  report.pc = system.cpu().registers.pc;
+  report.screen = screenRows(system);
+  return report;
+}
+
+void writeString(std::ostream& out, std::string_view text)
+{
+  out << '"';
+  for (char c : text)
+  {
+    if (c == '"' || c == '\\')
+    {
+      out << '\\' << c;
+    }
+    else if (static_cast<Byte>(c) < 0x20 || static_cast<Byte>(c) >= 0x7F)
+    {
+      out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned{static_cast<Byte>(c)} << std::dec
+          << std::setfill(' ');
+    }
+    else
+    {
+      out << c;
+    }
+  }
+  out << '"';
+}
+
+std::string hexAddress(Address address)
+{
+  std::ostringstream text;
+  text << '$' << std::hex << std::uppercase << std::setw(4) << std::setfill('0') << static_cast<uint16_t>(address);
+  return text.str();
+}
+
+void writeJson(std::ostream& out, const Options& options, const Report& report)
+{
+  double seconds = std::chrono::duration<double>(report.elapsed).count();
+  out << std::defaultfloat << std::setprecision(6);
+  out << "{\n  \"version\": 1,\n  \"engine\": \"" << engineName(options.engine) << "\",\n  \"status\": \""
+      << outcomeName(report.outcome) << "\",\n  \"cycles\": " << report.cycles << ",\n  \"seconds\": " << seconds
+      << ",\n  \"mhz\": " << (seconds > 0 ? static_cast<double>(report.cycles) / seconds / 1e6 : 0.0)
+      << ",\n  \"pc\": \"" << hexAddress(report.pc) << "\"";
+  if (report.outcome == Outcome::Trapped)
+  {
+    out << ",\n  \"trap_address\": \"" << hexAddress(report.trapAddress) << "\"";
+  }
+  out << ",\n  \"screen\": [";
+  const char* separator = "\n    ";
+  for (const auto& row : report.screen)
+  {
+    out << separator;
+    writeString(out, row);
+    separator = ",\n    ";
+  }
+  out << "\n  ]\n}\n";
+}
+
+void printUsage()
+{
+  std::cout << "usage: apple2run --rom FILE [options]\n"
+               "  --rom FILE         12K Apple II ROM ($D000-$FFFF)\n"
+               "  --disk-rom FILE    256 byte Disk II controller ROM, mapped to slot 6\n"
+               "  --disk FILE        .dsk image for drive 1, needs --disk-rom\n"
+               "  --input FILE       input script to type, '-' for stdin\n"
+               "  --type TEXT        more script, typed after --input\n"
+               "  --cycles N         cycle budget (default 100000000)\n"
+               "  --stop-pc ADDR     stop when the CPU reaches ADDR (hex), can be repeated\n"
+               "  --stop-text TEXT   stop when TEXT is on the screen, can be repeated\n"
+               "  --engine NAME      microcode, instruction or block (default block)\n"
+               "  --fast-disk on     fast-forward the DOS sector reads\n"
+               "  --fast-paste on    latch typed keys as soon as the guest reads them\n"
+               "  --json FILE        where to write the results (default '-', stdout)\n"
+               "Exits with 0 if a stop condition was met, or the budget was used up and none were given.\n";
+}
+
+std::optional<Engine> parseEngine(std::string_view name)
+{
+  for (auto engine : {Engine::Microcode, Engine::Instruction, Engine::Block})
+  {
+    if (name == engineName(engine))
+    {
+      return engine;
+    }
+  }
+  return std::nullopt;
+}
+
+std::optional<Options> parseOptions(std::span<char*> args)
+{
+  Options options;
+  for (size_t i = 1; i < args.size(); ++i)
+  {
+    std::string_view arg = args[i];
+    if (arg == "--help" || i + 1 >= args.size())
+    {
+      return std::nullopt;
+    }
+
+    std::string value = args[++i];
+    if (arg == "--rom")
+      options.appleRom = value;
+    else if (arg == "--disk-rom")
+      options.diskRom = value;
+    else if (arg == "--disk")
+      options.disk = value;
+    else if (arg == "--input")
+      options.input = value;
+    else if (arg == "--type")
+      options.type = value;
+    else if (arg == "--cycles")
+      options.cycles = std::stoull(value);
+    else if (arg == "--stop-pc")
+    {
+      auto digits = value.substr(value.starts_with('$') ? 1 : 0);
+      options.stopPcs.push_back(Address{static_cast<uint16_t>(std::stoul(digits, nullptr, 16))});
+    }
+    else if (arg == "--stop-text")
+      options.stopTexts.push_back(value);
+    else if (arg == "--engine")
+    {
+      auto engine = parseEngine(value);
+      if (!engine)
+      {
+        return std::nullopt;
+      }
+      options.engine = *engine;
+    }
+    else if (arg == "--fast-disk")
+      options.fastDisk = value == "on";
+    else if (arg == "--fast-paste")
+      options.fastPaste = value == "on";
+    else if (arg == "--json")
+      options.json = value;
+    else
+      return std::nullopt;
+  }
+
+  if (options.appleRom.empty() || (!options.disk.empty() && options.diskRom.empty()))
+  {
+    return std::nullopt;
+  }
+  return options;
+}
+
+std::vector<Step> loadScript(const Options& options)
+{
+  std::vector<Step> steps;
+  if (options.input == "-")
+  {
+    steps = parseScript(std::cin);
+  }
+  else if (!options.input.empty())
+  {
+    std::ifstream file(options.input);
+    if (!file)
+    {
+      throw std::runtime_error("Cannot open file: " + options.input);
+    }
+    steps = parseScript(file);
+  }
+
+  std::istringstream typed(options.type);
+  std::ranges::move(parseScript(typed), std::back_inserter(steps));
+  return steps;
+}
+
+void logToStderr(std::string_view output)
+{
+  std::cerr << output << '\n';
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  auto options = parseOptions(std::span(argv, static_cast<size_t>(argc)));
+  if (!options)
+  {
+    printUsage();
+    return 2;
+  }
+
+  // stdout may carry the JSON.
+  common::Logger::setOutputFunc(logToStderr);
+
+  try
+  {
+    ScriptPlayer script{loadScript(*options)};
+
+    // The system keeps pointers into these, and they are too big for the stack.
+    struct Memory
+    {
+      std::array<Byte, 0xC000> ram{};
+      std::array<Byte, 0x3000> rom{};
+      std::array<Byte, 0x1000> langBank0{};
+      std::array<Byte, 0x1000> langBank1{};
+      std::array<Byte, 0x100> diskRom{};
+    };
+    auto memory = std::make_unique<Memory>();
+    Load(std::span(memory->rom), options->appleRom);
+
+    apple2::Apple2System system{std::span(memory->ram), std::span<const Byte, 0x3000>(memory->rom),
+        std::span(memory->langBank0), std::span(memory->langBank1), options->engine};
+    system.setFastDisk(options->fastDisk);
+    system.setFastPaste(options->fastPaste);
+    if (!options->diskRom.empty())
+    {
+      Load(std::span(memory->diskRom), options->diskRom);
+      system.loadPeripheralRom(6, std::span<const Byte, 0x100>(memory->diskRom));
+    }
+    if (!options->disk.empty() && !system.loadDisk(options->disk))
+    {
+      throw std::runtime_error("Cannot load disk: " + options->disk);
+    }
+    system.reset();
+
+    Report report = run(system, script, *options);
+    if (options->json == "-")
+    {
+      writeJson(std::cout, *options, report);
+    }
+    else
+    {
+      std::ofstream file(options->json);
+      writeJson(file, *options, report);
+    }
+
+    bool stopConditions = !options->stopPcs.empty() || !options->stopTexts.empty();
+    bool met = report.outcome == Outcome::StopPc || report.outcome == Outcome::StopText ||
+               (report.outcome == Outcome::Budget && !stopConditions);
+    return met ? 0 : 1;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Error: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -1,42 +1,24 @@
 // main.cpp or test_apple2.cpp
-#include <chrono>
+#include <array>
 #include <fcntl.h>
+#include <fstream>
 #include <iostream>
+#include <span>
+#include <string>
+#include <string_view>
 #include <termios.h>
-#include <thread>
 #include <unistd.h>
 
 #include "apple2/apple2system.h"
+#include "apple2/pacer.h"
 #include "common/logger.h"
+#include "cpu6502/profile_report.h"
+#include "cpu6502/trace_sink.h"
 
 using namespace Common;
 
 namespace
 {
-char appleToAscii(Byte data)
-{
-  // Apple II character set conversion
-  Byte c = data & 0x7F;  // Strip high bit
-
-  // Normal ASCII range
-  if (c >= 0x20 && c <= 0x5F)
-    return static_cast<char>(c);
-
-  // Apple II "flashing" characters (high bit set, bits 6-5 = 00)
-  if ((data & 0xC0) == 0x80)
-    return static_cast<char>(c);
-
-  // Apple II inverse characters (bits 7-6 = 00)
-  if ((data & 0xC0) == 0x00)
-    return static_cast<char>(c + 0x40);
-
-  // Control characters
-  if (c < 0x20)
-    return ' ';  // Convert controls to space for now
-
-  return static_cast<char>(c);
-}
-
 class KeyboardHandler
 {
 public:
@@ -59,14 +41,11 @@ public:
     tcsetattr(STDIN_FILENO, TCSANOW, &m_originalTermios);
   }
 
-  std::optional<char> getKey()
+  //! Reads whatever has been typed or pasted, up to `keys.size()` bytes, without waiting.
+  std::string_view getKeys(std::span<char> keys)
   {
-    char c;
-    if (read(STDIN_FILENO, &c, 1) == 1)
-    {
-      return c;
-    }
-    return std::nullopt;
+    ssize_t count = read(STDIN_FILENO, keys.data(), keys.size());
+    return count > 0 ? std::string_view(keys.data(), static_cast<size_t>(count)) : std::string_view{};
   }
 
 private:
@@ -76,8 +55,7 @@ private:
 void logOutput(std::string_view str)
 {
   static std::ofstream logFile("debug.log", std::ios::app);
-  logFile << str;
-  logFile.flush();
+  logFile << str << '\n';
 }
 
 }  // namespace
@@ -85,6 +63,7 @@ void logOutput(std::string_view str)
 int main()
 {
   common::Logger::setOutputFunc(logOutput);
+  common::Logger::setLevel(common::LogLevel::Verbose);
 
   try
   {
@@ -106,69 +85,65 @@ int main()
     apple2::Apple2System system{std::span(ram), std::span(rom), std::span(langBank0), std::span(langBank1)};
 
     system.loadPeripheralRom(6, std::span(diskRom));  // Slot 6: Disk controller ROM
-    system.loadDisk("/home/jason/Downloads/Master.dsk");
+    system.loadDisk("/home/jason/Downloads/Master.dsk", apple2::DiskImage::Writes::WriteBack);
 
     std::cout << "System created successfully!\n";
 
+#ifdef EMULATE_ENABLE_LOGGING
+    // Instructions are traced on a thread of their own, the emulation only queues them.
+    std::ofstream traceFile("trace.log");
+    cpu6502::TraceSink trace{traceFile, &apple2::Apple2System::Processor::disassemble};
+    system.startTracing(trace);
+#endif
+
     system.reset();
 
     Address resetVector = Common::MakeAddress(rom[0x2ffc], rom[0x2ffd]);
     std::cout << "Reset vector: $" << std::hex << static_cast<uint16_t>(resetVector) << std::dec << "\n";
 
-    // Set up a loop that runs roughly at 1MHz (1 microsecond per cycle)
+    std::cout << "\033[2J";  // Clear the terminal, rows are drawn in place from here on
 
+    // Run a video frame at a time at the Apple II's speed.
+    constexpr uint64_t frameCycles = 17'030;
+    apple2::Pacer pacer;
+    uint64_t overshoot = 0;
     while (true)
     {
-      auto start = std::chrono::high_resolution_clock::now();
-      for (int i = 0; i != 16667; ++i)  // Roughly 1MHz
-      {
-        if (!system.clock())
-        {
-          // Instruction complete
-          auto pc = system.cpu().registers.pc;
-          if ((pc >= Address{0x3F0} && pc <= Address{0x3F4}) || (pc >= Address(0xC000) && pc <= Address(0xCFFF)))
-          {
-            // std::stringstream stream;
-            // stream << "[EXECUTE] Running code at $" << std::hex << static_cast<int>(pc) << std::dec << "\n";
-            // LOG(stream.str());
-          }
-        }
-      }
-      auto elapsed = std::chrono::high_resolution_clock::now() - start;
-      if (elapsed < std::chrono::microseconds(16'667))
-      {
-        std::this_thread::sleep_for(std::chrono::microseconds(16'667) - (elapsed));
-      }
-      if (auto key = keyboard.getKey(); key.has_value())
-      {
-        auto c = key.value();
-        if (c == 27)
-          break;  // ESC to quit
+      pacer.pace(system.runSliceRepaying(frameCycles, overshoot));
 
-        // Convert Enter to carriage return for Apple II
-        if (c == '\n' || c == '\r')
-        {
-          c = '\r';  // Apple II expects CR (0x0D)
-        }
-        system.pressKey(c);
+      // A paste arrives all at once and is typed from the system's buffer, which turns newlines into
+      // carriage returns. Only read as much as the buffer can take, the rest waits in the terminal.
+      std::array<char, apple2::KeyBuffer::c_capacity> keyData{};
+      std::string_view keys = keyboard.getKeys(std::span(keyData).first(keyData.size() - system.pendingKeys()));
+      if (keys.find('\x1b') != std::string_view::npos)
+      {
+        break;  // ESC to quit
       }
+      system.typeText(keys);
 
-      if (system.isScreenDirty())
+      // Redraw only the rows that changed, each with one write.
+      if (auto rows = system.takeDirtyRows(); rows != 0)
       {
-        auto screen = system.getScreen();
-        //        std::cout << "\033[2J\033[H";  // Clear screen, move cursor to top
-        std::cout << "\n--- Screen Update ---\n";
-        for (const auto& line : screen)
+        constexpr size_t columns = apple2::TextVideoDevice::c_columns;
+        std::array<char, apple2::TextVideoDevice::c_rows * columns> text{};
+        system.exportScreen(text);
+        std::string output;
+        for (size_t row = 0; row < apple2::TextVideoDevice::c_rows; ++row)
         {
-          for (char c : line)
+          if ((rows & (1u << row)) != 0)
           {
-            std::cout << appleToAscii(static_cast<Byte>(c));
+            output += "\033[" + std::to_string(row + 1) + ";1H";
+            output.append(text.data() + row * columns, columns);
           }
-          std::cout << "\n";
         }
+        std::cout << output << std::flush;
       }
     }
 
+#ifdef EMULATE_ENABLE_PROFILING
+    cpu6502::writeProfileReport(std::cout, system.profiler());
+#endif
+
     //    std::cout << "Test completed successfully!\n";
     return 0;
   }
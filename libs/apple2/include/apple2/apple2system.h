@@ -1,19 +1,42 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <concepts>
 #include <cstdint>
+#include <iosfwd>
 #include <memory>
+#include <optional>
 #include <span>
+#include <string_view>
+#include <type_traits>
 #include <utility>
 
 #include "apple2/disk_controller.h"
+#include "apple2/disk_image.h"
+#include "apple2/fast_disk.h"
+#include "apple2/framebuffer.h"
+#include "apple2/hires_video_device.h"
+#include "apple2/idle_loop.h"
 #include "apple2/iodevice.h"
+#include "apple2/key_buffer.h"
+#include "apple2/speaker.h"
 #include "apple2/text_video_device.h"
 #include "common/address.h"
 #include "common/bank_switcher.h"
+#include "common/copy_on_write_memory.h"
+#include "common/event_queue.h"
+#include "common/hot_spot_profile.h"
 #include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "common/page_hash.h"
+#include "common/profiler.h"
+#include "common/tracing_device.h"
+#include "cpu6502/block_cache.h"
 #include "cpu6502/cpu6502_types.h"
 #include "cpu6502/mos6502.h"
+#include "cpu6502/trace_sink.h"
+#include "cpu6502/wdc65c02.h"
 
 namespace apple2
 {
@@ -21,7 +44,12 @@ namespace apple2
 class Apple2System
 {
 public:
+  // An enhanced IIe has a 65C02, see EMULATE_ENHANCED_IIE in cmake/Common.cmake.
+#ifdef EMULATE_ENHANCED_IIE
+  using Processor = cpu6502::wdc65c02;
+#else
   using Processor = cpu6502::mos6502;
+#endif
   using Address = Common::Address;
   using Byte = Common::Byte;
 
@@ -30,20 +58,158 @@ public:
   template<size_t Size>
   using RomSpan = std::span<const Byte, Size>;
 
-  Apple2System(RamSpan<0xc000> memory, RomSpan<0x3000> rom, RamSpan<0x1000> langBank0, RamSpan<0x1000> langBank1);
+  //! How the CPU is driven.
+  enum class Engine
+  {
+    Microcode,  // One microcode step per clock(), every bus cycle is observable
+    Instruction,  // Whole instructions per clock(), timing is kept at instruction granularity
+    Block,  // Like Instruction, but runFor() runs cached basic blocks, see cpu6502::BlockCache
+  };
+
+  //! Accuracy profiles, each an engine and a way of driving the bus. Every profile runs programs to the
+  //! same results with the same instruction timing, and their snapshots can be restored in any other,
+  //! so an instance can be switched to an accurate profile to debug it and back, see setAccuracy().
+  enum class Accuracy
+  {
+    Traced,  // Like Cycle, and the CPU's bus cycles go through a TracingDevice, see busTrace()
+    Cycle,  // The microcode engine: every bus cycle happens at its own cycle, dummy accesses included
+    Fast,  // The block engine: the same accesses, but devices see them at the instruction's start
+  };
+
+  //! Per-opcode counters when built with EMULATE_ENABLE_PROFILING, otherwise an empty policy.
+  using Profiler = Common::DefaultProfiler;
+  using Pump = MicrocodePump<Processor, Profiler>;
+  using RunResult = Pump::RunResult;
+
+  //! Why the last runFor() returned RunStatus::Breakpoint.
+  struct Break
+  {
+    Address pc;  // Where the CPU stopped
+    std::optional<Common::Bus::WatchHit> watch;  // The access that hit a watchpoint, empty for a breakpoint
+  };
+
+  //! The language card soft switches at $C080-$C08F.
+  struct LanguageCard
+  {
+    bool readRam = false;  // $D000-$FFFF read RAM rather than ROM
+    bool writeRam = true;  // Writes to $D000-$FFFF go to RAM
+    bool bank1 = false;  // $D000-$DFFF is bank 1 (langBank0) rather than bank 2 (langBank1)
+    bool preWrite = false;  // The last switch access was a read of an odd switch
+
+    bool operator==(const LanguageCard&) const = default;
+  };
+
+  //! Everything that changes while the machine runs, as one trivially copyable block that can be
+  //! copied or written out as it is. The ROMs, the disk image and keys still waiting behind the
+  //! keyboard latch are not included. A snapshot holds no addresses, so other builds whose Snapshot
+  //! has the same layout can restore it.
+  struct Snapshot
+  {
+    uint32_t magic = c_snapshotMagic;
+    uint32_t size = sizeof(Snapshot);
+    Processor cpu;
+    Pump::Snapshot pump;
+    uint64_t cycles = 0;
+    uint64_t idleCycles = 0;
+    bool stopped = false;
+    Byte keyboardData = 0;
+    LanguageCard languageCard;
+    VideoMode video;
+    DiskController::Snapshot disk;
+    std::array<Byte, 0xc000> ram;
+    std::array<Byte, 0x1000> langBank0;
+    std::array<Byte, 0x1000> langBank1;
+    std::array<Byte, 0x2000> langHighRam;
+  };
+
+  Apple2System(RamSpan<0xc000> memory, RomSpan<0x3000> rom, RamSpan<0x1000> langBank0, RamSpan<0x1000> langBank1,
+      Engine engine = Engine::Microcode);
+
+  //! An instance in the given accuracy profile, see setAccuracy().
+  Apple2System(RamSpan<0xc000> memory, RomSpan<0x3000> rom, RamSpan<0x1000> langBank0, RamSpan<0x1000> langBank1,
+      Accuracy accuracy);
+
+  //! Creates an instance in the state saved in `snapshot` whose main RAM shares the snapshot's pages
+  //! until it writes them, so many instances forked from one snapshot cost little more memory than
+  //! one. The ROM is shared as well. The text page and the language card banks are copied. Card ROMs
+  //! are not part of a snapshot, map them with loadPeripheralRom().
+  static std::unique_ptr<Apple2System> fork(
+      std::shared_ptr<const Snapshot> snapshot, RomSpan<0x3000> rom, Engine engine = Engine::Microcode);
+
+  static std::unique_ptr<Apple2System> fork(
+      std::shared_ptr<const Snapshot> snapshot, RomSpan<0x3000> rom, Accuracy accuracy);
 
   ~Apple2System() = default;
 
   void reset();
 
-  // Returns true if instruction is still executing, false if instruction completed
+  // Returns true if instruction is still executing, false if instruction completed. With the
+  // instruction and block engines every call runs a whole instruction and returns false.
   bool clock();
 
-  // Execute one instruction
-  void step();
+  // Execute one instruction, returns the number of cycles it took
+  uint32_t step();
+
+  //! Runs for at least `cycles` cycles, then finishes the instruction in progress so the CPU is left
+  //! on an instruction boundary. Returns how many cycles it ran past the budget; subtract that from
+  //! the next budget to keep the long-term rate exact. A trap is thrown as TrapException.
+  uint64_t run(uint64_t cycles = 1'000'000);
+
+  //! run() for one of a series of slices of `cycles` each. `overshoot` is what the earlier slices ran
+  //! past their budgets and comes off this one's, up to all but one cycle of it, so more than a slice
+  //! of overshoot, such as from a fast disk read, is paid back over several. Updates `overshoot` and
+  //! returns the cycles this slice ran. A slice of 0 cycles runs nothing. A trap is thrown as
+  //! TrapException.
+  uint64_t runSliceRepaying(uint64_t cycles, uint64_t& overshoot);
+
+  //! Runs a batch of up to `cycles` cycles without going back through clock() for every cycle.
+  //! `stop` is called with the CPU state at instruction boundaries, see MicrocodePump::runFor().
+  //! The microcode engine stops exactly at the budget, possibly in the middle of an instruction. The
+  //! instruction and block engines finish the instruction that crosses the budget, so they can run a
+  //! few cycles over. The block engine runs the same instructions with the same timing as the
+  //! instruction engine; hot guest loops just run faster.
+  //!
+  //! Without a stop predicate and while hot spots are not recorded, idle loops are fast-forwarded,
+  //! see setIdleSkipping(), and so are disk reads, see setFastDisk().
+  //!
+  //! The batch is split at the deadlines of the device events, see events(), which are run in between.
+  //!
+  //! While a breakpoint or watchpoint is set, the batch also stops at the instruction boundary where the
+  //! PC is on a breakpoint or after an instruction that hit a watchpoint, with RunStatus::Breakpoint,
+  //! and fast-forwarding is off. Resuming runs the instruction at the breakpoint. Without any set the
+  //! batch runs exactly as fast as it always does.
+  template<StopCondition<Processor::State> StopPredicate = NeverStop>
+  RunResult runFor(uint64_t cycles, StopPredicate stop = {});
+
+  //! See Common::Bus::addBreakpoint(). Only runFor() stops at breakpoints.
+  void addBreakpoint(Address address)
+  {
+    m_bus.addBreakpoint(address);
+  }
+
+  void removeBreakpoint(Address address) noexcept
+  {
+    m_bus.removeBreakpoint(address);
+  }
+
+  //! See Common::Bus::addWatchpoint(). Only runFor() stops at watchpoints, but the host's accesses
+  //! through the bus, such as reset() reading the reset vector, are seen as well.
+  void addWatchpoint(Address first, Address last, Common::Bus::Access access = Common::Bus::Access::ReadWrite)
+  {
+    m_bus.addWatchpoint({first, last, access});
+  }
 
-  // Execute until some condition (useful for debugging)
-  void run(size_t maxCycles = 1000000);
+  void removeWatchpoint(
+      Address first, Address last, Common::Bus::Access access = Common::Bus::Access::ReadWrite) noexcept
+  {
+    m_bus.removeWatchpoint({first, last, access});
+  }
+
+  //! Where and why the last runFor() that returned RunStatus::Breakpoint stopped.
+  const std::optional<Break>& lastBreak() const noexcept
+  {
+    return m_break;
+  }
 
   // CPU state access
   const auto& cpu() const
@@ -51,24 +217,289 @@ public:
     return m_cpu;
   }
 
-  void pressKey(char c);
+  Engine engine() const noexcept
+  {
+    return m_engine;
+  }
+
+  //! Switches to `engine` in place. Leaving the microcode engine in the middle of an instruction
+  //! finishes that instruction first.
+  void setEngine(Engine engine);
+
+  //! Switches to the engine and bus of `accuracy` in place, see setEngine().
+  void setAccuracy(Accuracy accuracy);
+
+  //! The profile the instance runs in. Both instruction-level engines count as Fast.
+  Accuracy accuracy() const noexcept
+  {
+    if (m_traced)
+    {
+      return Accuracy::Traced;
+    }
+    return m_engine == Engine::Microcode ? Accuracy::Cycle : Accuracy::Fast;
+  }
+
+  //! With Accuracy::Traced, the device that records the CPU's bus cycles. nullptr in the other
+  //! profiles. It only keeps the last TracingDevice::c_maxCycles, so drain it with cycles() at every
+  //! instruction boundary, for instance with a cpu6502::BinaryTraceRecorder as the runFor() stop
+  //! predicate; a longer run() or runFor() without one leaves a wrapped, partial trace.
+  const Common::TracingDevice* busTrace() const noexcept
+  {
+    return m_traced ? &m_traced->tracer : nullptr;
+  }
+
+  // Total number of CPU cycles executed since reset
+  uint64_t cycles() const noexcept
+  {
+    return m_cycles;
+  }
+
+  //! Deadlines on cycles() for the devices, such as the disk turning while its motor is on. runFor()
+  //! and run() run the CPU uninterrupted from one deadline to the next and the events in between;
+  //! clock() and step() check for them before every cycle or instruction. An event a device schedules
+  //! from a bus access, say when the disk motor comes on, runs once the batch it was scheduled in ends.
+  Common::EventQueue& events() noexcept
+  {
+    return m_events;
+  }
+
+  //! Lets runFor() and run() skip whole iterations of idle loops, such as polling the keyboard while
+  //! no key is pending or counting down in WAIT, crediting the cycles they would have taken. The
+  //! resulting CPU and memory state is exact, but the skipped bus accesses are not made. Nothing is
+  //! skipped while a disk motor is on or an interrupt line is asserted. On by default.
+  void setIdleSkipping(bool enabled) noexcept
+  {
+    m_idleSkipping = enabled;
+  }
+
+  // Number of cycles skipped in idle loops since reset
+  uint64_t idleCycles() const noexcept
+  {
+    return m_idleCycles;
+  }
+
+  //! A data field takes this long to pass under the head: 343 nibbles, the prologue and the epilogue
+  //! at 32 cycles each.
+  static constexpr uint32_t c_fastDiskSectorCycles = 349 * 32;
+
+  //! Lets runFor() and run() read a sector in one go when the guest calls the DOS 3.3 routine that
+  //! reads a data field, see DiskReadRoutine. Memory, registers and the disk are left as the routine
+  //! would leave them, and `sectorCycles` are credited for the call. Reads the routine would fail are
+  //! left to the guest. Off by default.
+  void setFastDisk(bool enabled, uint32_t sectorCycles = c_fastDiskSectorCycles) noexcept
+  {
+    m_fastDisk = enabled;
+    m_fastDiskCycles = sectorCycles;
+  }
+
+  // Number of sectors read in fast disk mode since reset
+  uint64_t fastDiskSectors() const noexcept
+  {
+    return m_fastDiskSectors;
+  }
+
+  //! Opcode counters for both engines since reset(). The instruction in progress is not
+  //! counted until the next opcode is fetched.
+  const Profiler& profiler() const noexcept
+  {
+    return m_pump.profiler();
+  }
+
+  //! Starts recording a cycle histogram keyed by instruction address. Recording is done by runFor()
+  //! and run(); it is selected once per batch, so it costs nothing while it is off.
+  void startHotSpotRecording();
+
+  //! Stops recording and hands over the histogram, or nullptr if nothing was being recorded.
+  std::unique_ptr<Common::HotSpotProfile> stopHotSpotRecording();
+
+  bool isRecordingHotSpots() const noexcept
+  {
+    return m_hotSpots != nullptr;
+  }
+
+  //! Writes one line per instruction address that used any cycles, in address order, as the
+  //! disassembled instruction followed by its cycle count. This is the folded format flamegraph.pl and
+  //! difffolded.pl read, and it diffs cleanly between runs. Instructions that cannot be read without
+  //! side effects, such as code in I/O space, are shown as ??.
+  void writeHotSpots(std::ostream& out, const Common::HotSpotProfile& profile) const;
+
+  //! Starts queueing a record of every instruction runFor() and run() execute into `sink`, which must
+  //! use Processor::disassemble and outlive the tracing. Like hot spot recording, tracing runs every
+  //! instruction, so idle loops and disk reads are not skipped while it is on.
+  void startTracing(cpu6502::TraceSink& sink) noexcept
+  {
+    m_trace = &sink;
+  }
+
+  void stopTracing() noexcept
+  {
+    m_trace = nullptr;
+  }
+
+  bool isTracing() const noexcept
+  {
+    return m_trace != nullptr;
+  }
+
+  //! With the block engine, drops the decoded code after the host changed RAM without going through
+  //! the bus. Writes the guest makes are noticed without it.
+  void invalidateCode() noexcept
+  {
+    m_blocks.clear();
+  }
+
+  //! Copies the machine's state into `snapshot`. A Snapshot holds all of RAM, so keep it off the stack.
+  void saveSnapshot(Snapshot& snapshot) const;
+
+  //! Puts the machine into the state saved in `snapshot`, which can come from another instance with
+  //! the same ROMs and any engine. Keys waiting behind the keyboard latch are dropped. If the snapshot
+  //! was taken in the middle of an instruction and this instance does not use the microcode engine,
+  //! the instruction is finished, so cycles() can be a few past the snapshot's. Throws
+  //! std::invalid_argument if the snapshot has another layout or stopped in microcode this CPU does
+  //! not have.
+  void restoreSnapshot(const Snapshot& snapshot);
+
+  //! Starts or stops recording which pages of the address space are written through the bus, by the
+  //! CPU or the disk's fast read. Writes the host makes to RAM directly are not seen.
+  void trackWrites(bool enable) noexcept
+  {
+    m_bus.trackWrites(Address{0x0000}, Address{0xFFFF}, enable);
+  }
+
+  //! The pages written since the last call while tracking, see Common::Bus::takeWrittenPages(). A
+  //! page at $D000-$FFFF was written in whichever bank was mapped at the time.
+  Common::PageBitmap takeWrittenPages() noexcept
+  {
+    return m_bus.takeWrittenPages();
+  }
+
+  //! The RAM of a snapshot as the 256 pages the page functions below number: main RAM is pages
+  //! 0-191, the language card's bank 1 and bank 2 at $D000 are 192-207 and 208-223, and its RAM at
+  //! $E000-$FFFF is 224-255.
+  static std::array<std::span<const Byte>, 4> snapshotMemory(const Snapshot& snapshot) noexcept;
+
+  //! The pages of RAM that differ between two snapshots, all an incremental checkpoint has to store.
+  static Common::PageBitmap changedPages(const Snapshot& snapshot, const Snapshot& previous) noexcept;
+
+  //! Common::hashPage() of every page of RAM in `snapshot`. Instances whose hashes agree hold the same
+  //! memory, page for page, and can share it.
+  static std::array<uint64_t, Common::Bus::c_pageCount> pageHashes(const Snapshot& snapshot) noexcept;
+
+  //! Number of 256-byte pages of main RAM this instance does not share with others. For an instance
+  //! made by fork() these are the pages it has written to.
+  size_t privateRamPages() const noexcept
+  {
+    return m_sharedRam ? m_sharedRam->privatePages() : m_memory.size() / Common::Bus::c_pageSize;
+  }
+
+  //! Without fast paste, keys are latched no faster than this, 30 a second, which programs that
+  //! only look at the keyboard now and then can keep up with.
+  static constexpr uint64_t c_keyIntervalCycles{34'016};
+
+  //! Queues a key, see typeText().
+  void pressKey(char c)
+  {
+    typeText(std::string_view(&c, 1));
+  }
+
+  //! Queues `text` to be typed and returns how much of it fit, at most KeyBuffer::c_capacity keys
+  //! can wait; the rest has to be typed once the guest has read some. Letters are typed in upper case
+  //! and a newline as a carriage return. A key is latched when the guest reads the keyboard with the
+  //! strobe clear, and no sooner than c_keyIntervalCycles after the one before it unless fast paste is
+  //! on.
+  size_t typeText(std::string_view text) noexcept
+  {
+    return m_keyBuffer.push(text);
+  }
+
+  //! Hands the guest the next key as soon as it clears the strobe, however fast it reads them. Meant
+  //! for feeding scripts to programs that read every key, such as the BASIC prompt. Off by default.
+  void setFastPaste(bool enabled) noexcept
+  {
+    m_fastPaste = enabled;
+  }
+
+  //! Keys typed but not latched yet.
+  size_t pendingKeys() const noexcept
+  {
+    return m_keyBuffer.size();
+  }
+
+  //! True if the guest is polling the keyboard with no key pending, on an instruction boundary, and
+  //! nothing but a key press can get it out of the loop: no disk motor on and no interrupt line
+  //! asserted. A host can stop running it until pressKey().
+  bool isWaitingForKey() const;
+
+  //! Drives the CPU's IRQ line. It is level triggered: the CPU takes the interrupt at every instruction
+  //! boundary at which I is clear, so a card holds the line until the guest acknowledges it. Cards
+  //! share the one line, so the caller combines their requests.
+  void setIrq(bool asserted) noexcept
+  {
+    m_cpu.irq = asserted;
+  }
+
+  //! Signals an NMI. It is edge triggered: the CPU takes it once, at the next instruction boundary.
+  void triggerNmi() noexcept
+  {
+    m_cpu.triggerNmi();
+  }
+
+  //! The speaker toggles since the last call to Speaker::synthesize(), timed to the start of the
+  //! instruction that made them. Synthesize up to cycles() after every run() to hear them.
+  Speaker& speaker() noexcept
+  {
+    return m_speaker;
+  }
 
   bool isScreenDirty() const noexcept
   {
     return m_textVideo.isDirty();
   }
 
+  //! The text rows changed since the last call or getScreen(), see TextVideoDevice::takeDirtyRows().
+  TextVideoDevice::RowMask takeDirtyRows() noexcept
+  {
+    return m_textVideo.takeDirtyRows();
+  }
+
   TextVideoDevice::Screen getScreen() const noexcept
   {
     return m_textVideo.screen();
   }
 
-  // Load a disk image:
-  bool loadDisk(const std::string& filename)
+  //! The text screen as ASCII, see TextVideoDevice::exportScreen().
+  size_t exportScreen(std::span<char> out) const noexcept
   {
-    return m_disk.loadDisk(filename);
+    return m_textVideo.exportScreen(out);
   }
 
+  //! The display mode the soft switches at $C050-$C057 selected.
+  const VideoMode& videoMode() const noexcept
+  {
+    return m_videoMode;
+  }
+
+  //! Converts the graphics blocks that changed since the last call into `framebuffer`, see
+  //! Framebuffer::update(), and returns them. The dirty rows of the text page taken here are not
+  //! reported by takeDirtyRows() again, only the rows that show text stay for it.
+  Framebuffer::RowMask renderGraphics(Framebuffer& framebuffer);
+
+  //! Inserts a disk image into drive 1, see DiskController::loadDisk(). The guest's writes stay private
+  //! to this system unless `writes` is Writes::WriteBack.
+  bool loadDisk(const std::string& filename, DiskImage::Writes writes = DiskImage::Writes::Private)
+  {
+    return m_disk.loadDisk(filename, writes);
+  }
+
+  //! Writes the sectors the guest changed back to the disk image if it was loaded with
+  //! Writes::WriteBack, see DiskController::flush(). Also done when the disk is replaced and when the
+  //! system is destroyed.
+  bool flushDisk()
+  {
+    return m_disk.flush();
+  }
+
+  //! Maps a card ROM into `slot`. Like the system ROM it is not copied, so it must outlive the system.
   void loadPeripheralRom(int slot, RomSpan<0x100> romData)
   {
     if (slot < 0 || slot >= 8)
@@ -78,37 +509,349 @@ public:
   }
 
 private:
+  //! Memory a forked instance owns itself.
+  struct OwnedMemory
+  {
+    std::array<Byte, 0x400> textPage{};
+    std::array<Byte, 0x400> textPage2{};
+    std::array<Byte, 0x2000> hiResPage1{};
+    std::array<Byte, 0x2000> hiResPage2{};
+    std::array<Byte, 0x1000> langBank0{};
+    std::array<Byte, 0x1000> langBank1{};
+  };
+
+  //! The parts of main RAM the video devices watch.
+  struct VideoMemory
+  {
+    RamSpan<0x400> textPage1;  // $0400-$07FF
+    RamSpan<0x400> textPage2;  // $0800-$0BFF
+    RamSpan<0x2000> hiResPage1;  // $2000-$3FFF
+    RamSpan<0x2000> hiResPage2;  // $4000-$5FFF
+  };
+
+  // Main RAM is either `memory` or `sharedRam`, the other one is empty.
+  Apple2System(std::span<Byte> memory, std::unique_ptr<Common::CopyOnWriteMemory> sharedRam, VideoMemory video,
+      RomSpan<0x3000> rom, RamSpan<0x1000> langBank0, RamSpan<0x1000> langBank1, std::unique_ptr<OwnedMemory> owned,
+      Engine engine);
+
   using RamDevice = Common::MemoryDevice<Common::Byte>;
-  using RomDevice = Common::MemoryDevice<const Common::Byte>;
-  using LanguageCardDevice = Common::BankSwitcher<2, 0x1000>;
+  // ROM, bank 1 and bank 2 at $D000-$DFFF, ROM and RAM at $E000-$FFFF
+  using LanguageCardLowDevice = Common::BankSwitcher<3, 0x1000>;
+  using LanguageCardHighDevice = Common::BankSwitcher<2, 0x2000>;
 
   void updateKeyboard();
-  char appleToAscii(Byte data) const noexcept;
+
+  // Puts the whole bus behind one TracingDevice, for Accuracy::Traced. The CPU runs on `bus`, which
+  // passes every access on to the system's bus.
+  class BusPort : public Common::Bus::Device
+  {
+  public:
+    explicit BusPort(Common::Bus& bus) noexcept
+      : m_bus(bus)
+    {
+    }
+
+    Byte read(Address address, Address /*normalizedAddress*/) const override
+    {
+      return m_bus.read(address);
+    }
+
+    void write(Address address, Address /*normalizedAddress*/, Byte value) override
+    {
+      m_bus.write(address, value);
+    }
+
+  private:
+    Common::Bus& m_bus;
+  };
+
+  struct TracedBus
+  {
+    explicit TracedBus(Common::Bus& systemBus) noexcept
+      : port(systemBus)
+    {
+    }
+
+    BusPort port;
+    Common::TracingDevice tracer{port};
+    Common::Bus bus{{Common::Bus::Entry{Address{0x0000}, Address{0xFFFF}, &tracer}}, Common::Bus::MemoryAccess::Device};
+  };
+
+  // The bus the microcode engine runs the CPU on.
+  Common::Bus& cpuBus() noexcept
+  {
+    return m_traced ? m_traced->bus : m_bus;
+  }
+
+  // Runs the microcode engine up to the end of the instruction in progress.
+  void finishInstruction();
+
+  // Runs one instruction with the instruction engine, `cycle` is the cycle count before it starts.
+  uint32_t executeInstruction(uint64_t cycle);
+
+  // The cycle count at the start of the instruction in progress, also in the middle of a batch.
+  uint64_t instructionCycle() const noexcept
+  {
+    return m_engine == Engine::Microcode ? m_pump.instructionStart() : m_instructionCycle;
+  }
+
+  // Hands the instruction about to run at `cpu.pc` to m_trace.
+  void traceInstruction(const cpu6502::Registers& cpu, uint64_t cycle) noexcept;
+
+  // runFor() without the breakpoint checks, one device event deadline at a time.
+  template<typename StopPredicate>
+  RunResult runSlices(uint64_t cycles, StopPredicate& stop);
+
+  // runFor() up to the next event deadline at most.
+  template<typename StopPredicate>
+  RunResult runToDeadline(uint64_t cycles, StopPredicate& stop);
+
+  template<typename StopPredicate>
+  RunResult runBatch(uint64_t cycles, StopPredicate& stop);
+
+  // Runs the cached block at the PC, or the instruction there if it cannot be cached, for the block
+  // engine. Adds its cycles to `result` and leaves the block early where the batch has to end;
+  // `boundary` is runBatch()'s check before every instruction after the first.
+  template<typename Boundary>
+  void runBlock(uint64_t cycles, RunResult& result, Boundary& boundary);
+
+  // runFor() without a stop predicate, checking for idle loops and the disk read routine every
+  // c_idleCheckCycles and whenever the CPU gets to the start of one.
+  RunResult runAccelerated(uint64_t cycles);
+
+  // The idle loop the CPU is in, if it is on an instruction boundary and the loop can be skipped.
+  std::optional<IdleLoop> idleLoop() const;
+
+  // Fast-forwards `loop`, which starts at the PC, by up to `budget` cycles. Returns the number of
+  // cycles skipped.
+  uint64_t skipIdleLoop(const IdleLoop& loop, uint64_t budget);
+
+  // The disk read routine while fast disk is on and the motor is running. A routine found once is
+  // checked again where it was, memory is only searched every c_diskScanCycles.
+  std::optional<DiskReadRoutine> diskReadRoutine();
+
+  // Reads a sector for the routine at the PC. Returns the number of cycles credited, 0 if the guest
+  // has to run the routine itself.
+  uint64_t readSector(const DiskReadRoutine& routine);
+
+  static constexpr uint64_t c_idleCheckCycles = 1024;
+  static constexpr uint64_t c_diskScanCycles = 0x10000;
+  static constexpr uint32_t c_snapshotMagic = 0x55324141;  // "AA2U", the pump's microcode by walk index
 
   void setupIoHandlers();
   Byte handleKeyboardRead(Address address);
   Byte handleKeyboardStrobeRead(Address address);
   Byte handleLanguageCardRead(Address address);
   void handleLanguageCardWrite(Address address, Byte data);
+  void switchLanguageCard(Address address, bool read);
+  // Selects the banks m_languageCardState asks for and maps them into the bus.
+  void mapLanguageCard();
   Byte handleSpeakerRead(Address address);
   void handleSpeakerWrite(Address address, Byte data);
+  Byte handleVideoSwitchRead(Address address);
+  void handleVideoSwitchWrite(Address address, Byte data);
 
   Processor m_cpu;
-  MicrocodePump<Processor> m_pump;
+  Pump m_pump;
+  Engine m_engine;
+  uint64_t m_cycles = 0;
+  uint64_t m_instructionCycle = 0;  // Start of the current instruction with the instruction engine
+  cpu6502::BlockCache m_blocks{&Processor::instruction};  // Only filled by the block engine
+  bool m_stopped = false;  // The last runFor() with the instruction engine stopped at this instruction
+  std::optional<Break> m_break;  // See lastBreak()
+  std::unique_ptr<Common::HotSpotProfile> m_hotSpots;  // Only while recording
+  cpu6502::TraceSink* m_trace = nullptr;  // Only while tracing
+  bool m_idleSkipping = true;
+  uint64_t m_idleCycles = 0;
+  bool m_fastDisk = false;
+  uint32_t m_fastDiskCycles = c_fastDiskSectorCycles;
+  uint64_t m_fastDiskSectors = 0;
+  std::optional<DiskReadRoutine> m_diskReadRoutine;
+  uint64_t m_nextDiskScan = 0;  // Cycle count at which memory may be searched for the routine again
 
   // Memory and devices
+  Common::EventQueue m_events;  // Before the devices that schedule on it
+  std::unique_ptr<OwnedMemory> m_owned;  // Only for forked instances
+  std::span<Byte> m_memory;  // Empty for forked instances
+  std::unique_ptr<Common::CopyOnWriteMemory> m_sharedRam;  // Only for forked instances
+  VideoMemory m_video;
+  RamSpan<0x1000> m_langBank0;
+  RamSpan<0x1000> m_langBank1;
   TextVideoDevice m_textVideo;
+  TextVideoDevice m_textVideo2;
+  HiResVideoDevice m_hiRes1;
+  HiResVideoDevice m_hiRes2;
+  VideoMode m_videoMode;
   RamDevice m_ram;
-  RomDevice m_rom;
+  std::array<Byte, 0x2000> m_langHighRam{};  // The language card's RAM at $E000-$FFFF
   IoDevice m_io;
-  LanguageCardDevice m_languageCard;
+  LanguageCardLowDevice m_languageCardLow;
+  LanguageCardHighDevice m_languageCardHigh;
+  LanguageCard m_languageCardState;
   DiskController m_disk;
+  Speaker m_speaker;
 
   Common::Bus m_bus;
+  std::unique_ptr<TracedBus> m_traced;  // Only with Accuracy::Traced
 
   // I/O state
-  std::queue<char> m_keyBuffer;
+  KeyBuffer m_keyBuffer;
   Common::Byte m_keyboardData = 0x00;
+  bool m_fastPaste = false;
+  uint64_t m_nextKeyCycle = 0;  // The next key is not latched before this, unless pasting fast
 };
 
+template<StopCondition<Apple2System::Processor::State> StopPredicate>
+Apple2System::RunResult Apple2System::runFor(uint64_t cycles, StopPredicate stop)
+{
+  if (!m_bus.hasDebugPoints())
+  {
+    return runSlices(cycles, stop);
+  }
+
+  m_break.reset();
+  auto check = [this, &stop](const Processor::State& cpu, uint64_t cycle)
+  {
+    auto watch = m_bus.takeWatchHit();
+    if (watch || m_bus.isBreakpoint(cpu.registers.pc))
+    {
+      m_break = Break{cpu.registers.pc, watch};
+      return true;
+    }
+    return shouldStop(stop, cpu, cycle);
+  };
+  RunResult result = runSlices(cycles, check);
+  if (result.status == RunStatus::Stopped && m_break)
+  {
+    result.status = RunStatus::Breakpoint;
+  }
+  return result;
+}
+
+template<typename StopPredicate>
+Apple2System::RunResult Apple2System::runSlices(uint64_t cycles, StopPredicate& stop)
+{
+  RunResult result;
+  while (result.cycles < cycles)
+  {
+    m_events.runDue(m_cycles);
+    RunResult slice = runToDeadline(std::min(cycles - result.cycles, m_events.nextDeadline() - m_cycles), stop);
+    result.cycles += slice.cycles;
+    if (slice.status != RunStatus::Completed)
+    {
+      result.status = slice.status;
+      result.trapAddress = slice.trapAddress;
+      break;
+    }
+  }
+  return result;
+}
+
+template<typename StopPredicate>
+Apple2System::RunResult Apple2System::runToDeadline(uint64_t cycles, StopPredicate& stop)
+{
+  if (m_hotSpots || m_trace)
+  {
+    auto record = [this, &stop](const Processor::State& cpu, uint64_t cycle)
+    {
+      if (m_hotSpots)
+      {
+        m_hotSpots->instructionStart(cpu.registers.pc, cycle);
+      }
+      if (m_trace)
+      {
+        traceInstruction(cpu.registers, cycle);
+      }
+      return shouldStop(stop, cpu, cycle);
+    };
+    return runBatch(cycles, record);
+  }
+  if constexpr (std::is_same_v<StopPredicate, NeverStop>)
+  {
+    // Fast-forwarding skips guest code, which a bus trace would miss.
+    if ((m_idleSkipping || m_fastDisk) && !m_traced)
+    {
+      return runAccelerated(cycles);
+    }
+  }
+  return runBatch(cycles, stop);
+}
+
+template<typename StopPredicate>
+Apple2System::RunResult Apple2System::runBatch(uint64_t cycles, StopPredicate& stop)
+{
+  RunResult result;
+  if (m_engine == Engine::Microcode)
+  {
+    result = m_pump.runFor(m_cpu, Processor::BusToken{&cpuBus()}, cycles, stop);
+  }
+  else
+  {
+    // Reports a trap at the next boundary, like MicrocodePump::runFor(), and asks `stop`. False if the
+    // batch ends here.
+    bool resuming = std::exchange(m_stopped, false);
+    auto boundary = [this, &stop, &result, &resuming]()
+    {
+      if (m_cpu.trapped)
+      {
+        m_cpu.trapped = false;
+        result.status = RunStatus::Trapped;
+        result.trapAddress = m_cpu.trapAddress;
+        return false;
+      }
+      if (!resuming && shouldStop(stop, std::as_const(m_cpu), m_cycles + result.cycles))
+      {
+        result.status = RunStatus::Stopped;
+        m_stopped = true;
+        return false;
+      }
+      resuming = false;
+      return true;
+    };
+
+    while (result.cycles < cycles && result.status == RunStatus::Completed && boundary())
+    {
+      if (m_engine == Engine::Block)
+      {
+        runBlock(cycles, result, boundary);
+      }
+      else
+      {
+        result.cycles += executeInstruction(m_cycles + result.cycles);
+      }
+    }
+  }
+
+  m_cycles += result.cycles;
+  return result;
+}
+
+template<typename Boundary>
+void Apple2System::runBlock(uint64_t cycles, RunResult& result, Boundary& boundary)
+{
+  cpu6502::BlockCache::Block block = m_blocks.find(m_bus, m_cpu.registers.pc);
+  if (block.instructions.empty())
+  {
+    result.cycles += executeInstruction(m_cycles + result.cycles);
+    return;
+  }
+
+  for (size_t index = 0; index < block.instructions.size(); ++index)
+  {
+    const auto& instruction = block.instructions[index];
+    if (index != 0 && !boundary())
+    {
+      return;
+    }
+    m_instructionCycle = m_cycles + result.cycles;
+    result.cycles += Processor::executeDecoded(m_cpu, m_bus, instruction);
+    m_pump.profiler().fetched(m_cpu.opcode, m_instructionCycle);
+    if (result.cycles >= cycles || m_cpu.registers.pc != instruction.next ||
+        !cpu6502::BlockCache::isCurrent(m_bus, block))
+    {
+      return;
+    }
+  }
+}
+
 }  // namespace apple2
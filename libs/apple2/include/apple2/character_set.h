@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+#include "common/address.h"
+
+namespace apple2
+{
+
+//! ASCII for every screen code of the text page. Inverse ($00-$3F), flashing ($40-$7F) and normal
+//! ($80-$FF) characters all map to the character they show. $E0-$FF are lowercase on an enhanced IIe
+//! and repeat the punctuation and digits of $A0-$BF on earlier models.
+inline constexpr std::array<char, 256> c_screenToAscii = []()
+{
+  std::array<char, 256> table{};
+  for (size_t code = 0; code < table.size(); ++code)
+  {
+    // Bits 5 and 6 pick the glyph row: @A-Z[\]^_ for 0, space to ? for 1.
+    size_t glyph = code & 0x3F;
+    char ascii = static_cast<char>(glyph < 0x20 ? glyph + 0x40 : glyph);
+#ifdef EMULATE_ENHANCED_IIE
+    if (code >= 0xE0)
+    {
+      ascii = static_cast<char>(code - 0x80);
+    }
+#endif
+    table[code] = ascii;
+  }
+  return table;
+}();
+
+constexpr char screenToAscii(Common::Byte code) noexcept
+{
+  return c_screenToAscii[code];
+}
+
+}  // namespace apple2
@@ -1,14 +1,16 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
 #include <cstdint>
-#include <fstream>
+#include <memory>
 #include <span>
 #include <string>
-#include <vector>
 
+#include "apple2/disk_image.h"
 #include "common/address.h"
 #include "common/bus.h"
+#include "common/event_queue.h"
 
 namespace apple2
 {
@@ -23,9 +25,70 @@ public:
 
   static constexpr int8_t c_maxTracks{35};
 
-  static bool loadRom(std::span<const Byte, 256> romData);
+  //! Nibbles on one track of a 5.25" disk spinning at 300 rpm.
+  static constexpr size_t c_trackSize{6656};
 
-  bool loadDisk(const std::string& filename);
+  //! The disk turns by one nibble every 32 CPU cycles.
+  static constexpr uint32_t c_nibbleCycles{32};
+
+  //! While the motor is on, the disk is turned on by the time that passed this often.
+  static constexpr uint32_t c_rotationEventCycles{16 * c_nibbleCycles};
+
+  //! Head, motor and read position, trivially copyable. The disk image and the ROM are not included.
+  struct Snapshot
+  {
+    Byte status = 0;
+    Byte lastPhase = 0;
+    int8_t halfTrack = 0;
+    uint16_t nibblePos = 0;  // Index of the next nibble under the head, below c_trackSize
+    uint16_t lead = 0;  // Nibbles the guest has read ahead of the rotation
+    uint64_t rotationCycle = 0;  // Cycle count up to which the rotation has been applied
+  };
+
+  //! Maps `romData` as the card ROM at $Cn00. The controller only keeps a view of it, so the data must
+  //! outlive the controller; any number of controllers can share one copy. Until a ROM is mapped the
+  //! card reads as zeros.
+  bool loadRom(std::span<const Byte, 256> romData);
+
+  //! A controller without an event queue only moves the disk when the guest reads or writes it.
+  DiskController() = default;
+
+  //! Turns the disk with time as well: while the motor is on, an event on `events` moves it on by the
+  //! nibbles that passed under the head since the last one, less those the guest read in the meantime.
+  //! The guest can read ahead, as reads do not wait for the next nibble, but it cannot fall behind the
+  //! spinning disk. The cycle count the motor starts at is taken from EventQueue::now(), so it is only
+  //! as exact as the owner's last call to runDue().
+  explicit DiskController(Common::EventQueue& events);
+
+  DiskController(const DiskController&) = delete;
+  DiskController& operator=(const DiskController&) = delete;
+
+  //! Writes back any sectors the guest changed if the disk was loaded with Writes::WriteBack, see
+  //! flush().
+  ~DiskController() override;
+
+  //! Inserts the disk image in `filename`, see DiskImage::open() for the formats. The guest's writes
+  //! stay private to this controller unless `writes` is Writes::WriteBack. Tracks changed on the
+  //! previous disk are flushed first.
+  bool loadDisk(const std::string& filename, DiskImage::Writes writes = DiskImage::Writes::Private);
+
+  //! Writes the tracks the guest has changed back to the image file, if the disk was loaded with
+  //! Writes::WriteBack. Writes only change the track cache; the track goes to the image when the head
+  //! moves to another track or on flush(), and the file is only touched here, so the guest never waits
+  //! for file I/O. Returns false if the file could not be written; the changes are kept and the next
+  //! flush() tries again.
+  bool flush();
+
+  bool isWriteProtected() const noexcept
+  {
+    return m_image != nullptr && m_image->isWriteProtected();
+  }
+
+  //! The inserted disk, nullptr if there is none.
+  const DiskImage* image() const noexcept
+  {
+    return m_image.get();
+  }
 
   Byte read(Address address, Address normalizedAddress) const override;
   void write(Address address, Address normalizedAddress, Byte data) override;
@@ -46,6 +109,22 @@ public:
     return (m_status & MotorMask) != 0;
   }
 
+  //! Copies the nibbles the next reads of the data register would return into `nibbles`, without
+  //! moving the disk. Returns false if reads would not return disk data: no disk, the motor is off or
+  //! the controller is not in read mode.
+  bool peekNibbles(std::span<Byte> nibbles) const;
+
+  //! Moves the disk on by `count` nibbles, as if they had been read. Only valid if peekNibbles()
+  //! succeeds.
+  void skipNibbles(size_t count) const noexcept
+  {
+    m_nibblePos = static_cast<uint16_t>((m_nibblePos + count) % c_trackSize);
+    m_lead = static_cast<uint16_t>(std::min<size_t>(m_lead + count, c_trackSize));
+  }
+
+  Snapshot snapshot() const noexcept;
+  void restore(const Snapshot& snapshot);
+
 private:
   // All controller cards use ROM memory in the range of $C0n0-$C0nF where n is the slot number.
   // The disk controller is typically in slot 6, so its ROM is at $C600-$C6FF.
@@ -81,56 +160,59 @@ private:
   static constexpr Byte Q6Mask{0x40};
   static constexpr Byte Q7Mask{0x80};
 
-  // Size of encoded address fields: 4 fields × 2 nibbles
-  static constexpr size_t c_addressFieldSize = 4 * 2;
-
-  using State = Byte (DiskController::*)() const;
-
-  struct TrackPosition
-  {
-    int16_t step = 0;  // Step within current state
-    int16_t nibblePos = 0;  // Overall position in 6656-byte track
-    Byte sectorIndex = 0;  // Which sector (0-15)
-    State state = &DiskController::AddressPrologue;
-  };
+  static const std::array<Byte, 256> c_emptyRom;
 
-  static Byte c_rom[256];
+  std::span<const Byte, 256> m_rom{c_emptyRom};
 
-  std::vector<Byte> m_diskData;
-  bool m_diskLoaded = false;
+  // Changed tracks are written back to it from read(), hence mutable.
+  mutable std::unique_ptr<DiskImage> m_image;
+  // The cached track has been written to since it was read from the image
+  mutable bool m_trackDirty = false;
   mutable Byte m_status = 0x00;
   mutable Byte m_lastPhase = 0x00;
   mutable int8_t m_halfTrack = 34 * 2;
-  // Track currently being read
-  mutable Byte m_currentTrack = 0xff;
-  mutable TrackPosition m_trackPos;
-  mutable Byte m_lastGeneratedTrack = 0xff;
-  mutable Byte m_lastGeneratedSector = 0xff;
-  mutable std::array<Byte, c_addressFieldSize> m_addressBuffer{};
+  // Position of the head along the track. The disk keeps spinning while the head steps, so a seek
+  // does not reset it.
+  mutable uint16_t m_nibblePos = 0;
+  // Nibbles read since the rotation last caught up, at most one turn.
+  mutable uint16_t m_lead = 0;
+  mutable uint64_t m_rotationCycle = 0;
+  Common::EventQueue* m_events = nullptr;
+  Common::EventQueue::Id m_rotationEvent = 0;
+  // The nibbles of one whole track, encoded when the head first reads it so that a read is just an
+  // index into it. m_cachedTrack is 0xff when nothing is cached.
+  mutable std::array<Byte, c_trackSize> m_track{};
+  mutable Byte m_cachedTrack = 0xff;
 
   Byte updateMotor() const;
+  void startRotation() const;
+  void stopRotation() const;
+  // Moves the disk on by the nibbles that passed under the head by `cycle`, the rotation event.
+  void rotate(uint64_t cycle);
+  // Moves the head to the next nibble after a read or write.
+  void advanceHead() const noexcept
+  {
+    m_nibblePos = m_nibblePos + 1 == c_trackSize ? 0 : static_cast<uint16_t>(m_nibblePos + 1);
+    m_lead = std::min<uint16_t>(static_cast<uint16_t>(m_lead + 1), c_trackSize);
+  }
   Byte handleControlLines() const;
   Byte readDiskData() const;
-  Byte getEncodedSectorByte(int track, int sector, int byteIndex) const;
+  void writeDiskData(Byte nibble);
+
+  // Makes `track` the cached track, decoding the old one into the image first if it was written to.
+  void cacheTrack(int track) const;
 
-  // State functions
-  void Transition(State newState) const
+  // Fills m_track with the nibbles of `track`.
+  void encodeTrack(int track) const;
+
+  // Gives the cached track back to the image.
+  void decodeTrack() const;
+
+  // Drops the cached track, it is encoded again from the image on the next read.
+  void invalidateTrack() const noexcept
   {
-    m_trackPos.state = newState;
+    m_cachedTrack = 0xff;
   }
-
-  // Sync Bytes (FF) D5 AA 96
-  Byte AddressPrologue() const;
-  // Volume, track, sector, checksum (4-and-4 encoded)
-  Byte AddressData() const;
-  // DE AA EB + sync bytes + D5 AA AD
-  Byte DataPrologue() const;
-  // 256 bytes of sector data (encoded)
-  Byte DataPayload() const;
-  // DE AA EB
-  Byte DataEpilogue() const;
-  // Fill to end of track
-  Byte TrackGap() const;
 };
 
 }  // namespace apple2
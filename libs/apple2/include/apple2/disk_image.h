@@ -0,0 +1,146 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common/address.h"
+
+namespace apple2
+{
+
+//! A read-only view of a whole file. Opening the same file again while it is mapped returns the same
+//! mapping, so any number of disks can share one copy of a master image.
+class MappedFile
+{
+public:
+  using Byte = Common::Byte;
+
+  //! Returns nullptr if the file cannot be opened.
+  static std::shared_ptr<const MappedFile> open(const std::string& filename);
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  ~MappedFile();
+
+  std::span<const Byte> bytes() const noexcept
+  {
+    return {m_data, m_size};
+  }
+
+  const std::string& filename() const noexcept
+  {
+    return m_filename;
+  }
+
+private:
+  MappedFile() = default;
+
+  std::string m_filename;
+  const Byte* m_data = nullptr;
+  size_t m_size = 0;
+  bool m_mapped = false;  // m_data is a mapping rather than m_copy
+  std::vector<Byte> m_copy;  // Fallback when the file cannot be mapped
+};
+
+//! A 5.25" disk as a stack of nibble tracks. The file is mapped and shared, the disk only owns the
+//! tracks it has written to. Those stay private to the disk unless it was opened with
+//! Writes::WriteBack, so any number of machines can run from one master image without seeing each
+//! other's writes.
+class DiskImage
+{
+public:
+  using Byte = Common::Byte;
+
+  static constexpr int c_maxTracks{35};
+
+  //! Nibbles on one track of a disk spinning at 300 rpm.
+  static constexpr size_t c_trackSize{6656};
+
+  using Track = std::span<Byte, c_trackSize>;
+
+  enum class Format : uint8_t
+  {
+    Dos,  // .dsk or .do, 256 byte sectors in DOS 3.3 order
+    ProDos,  // .po, 256 byte sectors in ProDOS block order
+    Nibble,  // .nib, 6656 nibbles per track
+    Woz,  // .woz 1 or 2, a bit stream per track
+  };
+
+  //! What becomes of the tracks the guest writes.
+  enum class Writes : uint8_t
+  {
+    Private,  // Only this disk sees them, the file is never written
+    WriteBack,  // flush() also writes them to the file
+  };
+
+  //! Opens `filename` and detects its format from the contents, the size and the extension. Returns
+  //! nullptr if the file cannot be opened or is not a disk image.
+  static std::unique_ptr<DiskImage> open(const std::string& filename, Writes writes = Writes::Private);
+
+  //! The format of an image with contents `bytes`, named `filename`. A .dsk holding a ProDOS volume is
+  //! ProDOS-ordered, any other one DOS-ordered.
+  static std::optional<Format> detectFormat(std::span<const Byte> bytes, std::string_view filename) noexcept;
+
+  Format format() const noexcept
+  {
+    return m_format;
+  }
+
+  Writes writes() const noexcept
+  {
+    return m_writes;
+  }
+
+  //! WOZ images are not written, and with Writes::WriteBack neither are files that cannot be opened
+  //! for writing.
+  bool isWriteProtected() const noexcept
+  {
+    return m_writeProtected;
+  }
+
+  //! Fills `nibbles` with `track` as the head would read it, encoding sector images 6-and-2 and
+  //! padding short tracks with sync bytes.
+  void readTrack(int track, Track nibbles) const;
+
+  //! Keeps the nibbles of a track the guest has written. Sector images keep the sectors that decode;
+  //! the others stay as they were.
+  void writeTrack(int track, std::span<const Byte, c_trackSize> nibbles);
+
+  //! Number of tracks this disk has its own copy of.
+  size_t privateTracks() const noexcept;
+
+  //! With Writes::WriteBack, writes the tracks changed since the last flush() to the file, where other
+  //! disks open on it see them. Returns false if the file could not be written; the changes are kept.
+  //! A private disk is left as it is.
+  bool flush();
+
+private:
+  DiskImage(std::shared_ptr<const MappedFile> file, Format format, Writes writes, bool writeProtected);
+
+  //! The bytes of `track` in the file's own layout: 16 sectors for sector images, the nibbles for
+  //! .nib. Not used for WOZ.
+  std::span<const Byte> storedTrack(int track) const noexcept;
+  size_t storedTrackSize() const noexcept;
+
+  void readWozTrack(int track, Track nibbles) const;
+
+  struct PrivateTrack
+  {
+    std::vector<Byte> bytes;  // In the layout of storedTrack()
+    bool dirty = false;  // Not in the file yet
+  };
+
+  std::shared_ptr<const MappedFile> m_file;
+  Format m_format;
+  Writes m_writes;
+  bool m_writeProtected;
+  std::array<std::unique_ptr<PrivateTrack>, c_maxTracks> m_tracks;
+};
+
+}  // namespace apple2
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "apple2/disk_controller.h"
+#include "common/address.h"
+#include "common/bus.h"
+#include "cpu6502/registers.h"
+
+namespace apple2
+{
+
+//! The DOS 3.3 RWTS routine that reads a data field (READ16, $B8DC in a 48K DOS). It searches for the
+//! D5 AA AD prologue, reads the 86 auxiliary values into a buffer of its own and the 256 main values
+//! into the caller's buffer, checks the checksum and epilogue, and returns with carry clear. The
+//! routine is found by its code, so relocated copies are recognized too; the operands below are taken
+//! from the code that matched.
+struct DiskReadRoutine
+{
+  Common::Address start{0};
+  Common::Byte index = 0;  // Zero page byte the routine keeps the buffer index in (IDX)
+  Common::Byte buffer = 0;  // Zero page pointer to the caller's buffer (BUF)
+  Common::Address auxBuffer{0};  // The 86 byte buffer for the low bits (NBUF2)
+  Common::Address translate{0};  // The table disk bytes are looked up in, indexed by the disk byte
+};
+
+//! Recognizes the routine if it starts at `pc`. Code is only read with Bus::peek().
+std::optional<DiskReadRoutine> findDiskReadRoutine(Common::Address pc, const Common::Bus& bus) noexcept;
+
+//! Looks for the routine between `begin` and `end`.
+std::optional<DiskReadRoutine> scanForDiskReadRoutine(
+    const Common::Bus& bus, Common::Address begin, Common::Address end) noexcept;
+
+//! Does what calling `routine` with the registers in `cpu` would do, reading the disk in one go: the
+//! values are stored in guest memory, the disk moves past the field, the registers and flags are left
+//! as the successful return leaves them and the return address is popped. Returns false, changing
+//! nothing, if the routine would fail or read anything but slot 6, so the guest can run it itself.
+bool readSectorFast(
+    const DiskReadRoutine& routine, cpu6502::Registers& cpu, const DiskController& disk, Common::Bus& bus) noexcept;
+
+}  // namespace apple2
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "apple2/apple2system.h"
+#include "common/address.h"
+
+namespace apple2
+{
+
+//! Runs many independent machines on a pool of threads. Every call to runSlices() advances each
+//! runnable machine by whole time slices with Apple2System::run(), carrying the overshoot into the
+//! next slice. Machines are dealt out to the workers' queues, and a worker that runs out steals from
+//! the others, so a few slow machines do not hold up a thread while the rest sit idle.
+//!
+//! A machine is parked, and not run, while it waits for a key (see Apple2System::isWaitingForKey()),
+//! while its owner has flagged it idle, or once it has trapped. Parked machines do not advance; one
+//! waiting for a key is run again once pressKey() gives it one.
+//!
+//! The machines are only run inside runSlices(), so between calls they can be used directly through
+//! system(). pressKey() can be called from any thread at any time.
+class Apple2Fleet
+{
+public:
+  using Id = size_t;
+
+  //! One NTSC video frame.
+  static constexpr uint64_t c_defaultSliceCycles{17'030};
+
+  struct InstanceStats
+  {
+    uint64_t cycles = 0;  // Cycles run by the fleet, including skipped idle loops
+    std::chrono::nanoseconds busy{0};  // Time spent running them
+    bool parked = false;
+    std::optional<Common::Address> trap;  // Where the machine trapped, it is parked for good
+
+    //! Emulated speed while it was running.
+    double mhz() const noexcept
+    {
+      return busy.count() > 0 ? static_cast<double>(cycles) * 1e3 / static_cast<double>(busy.count()) : 0.0;
+    }
+  };
+
+  //! Throws std::invalid_argument if `sliceCycles` is 0.
+  explicit Apple2Fleet(size_t threads = std::thread::hardware_concurrency(),
+      uint64_t sliceCycles = c_defaultSliceCycles);
+
+  Apple2Fleet(const Apple2Fleet&) = delete;
+  Apple2Fleet& operator=(const Apple2Fleet&) = delete;
+  ~Apple2Fleet();
+
+  //! Takes over `system`. Must not be called during runSlices().
+  Id add(std::unique_ptr<Apple2System> system);
+
+  size_t size() const noexcept
+  {
+    return m_instances.size();
+  }
+
+  size_t threads() const noexcept
+  {
+    return m_workers.size();
+  }
+
+  //! Only valid between calls to runSlices().
+  Apple2System& system(Id id)
+  {
+    return *m_instances[id]->system;
+  }
+
+  //! Parks or unparks a machine the owner knows has nothing to do. Must not be called during
+  //! runSlices().
+  void setIdle(Id id, bool idle) noexcept
+  {
+    m_instances[id]->idle = idle;
+  }
+
+  //! Queues a key for the machine. It is handed over before the machine's next slice.
+  void pressKey(Id id, char c);
+
+  //! Runs `slices` time slices of every machine that is not parked, and returns when all are done.
+  //! A machine that parks during a slice sits out the rest.
+  void runSlices(size_t slices = 1);
+
+  InstanceStats stats(Id id) const;
+
+  //! Number of machines that were parked after the last slice.
+  size_t parked() const;
+
+private:
+  struct alignas(64) Instance
+  {
+    std::unique_ptr<Apple2System> system;
+    uint64_t overshoot = 0;  // Cycles the last slice ran past its budget
+    uint64_t cycles = 0;
+    std::chrono::nanoseconds busy{0};
+    bool idle = false;
+    bool waitingForKey = false;
+    std::optional<Common::Address> trap;
+
+    std::mutex keysMutex;
+    std::string keys;  // Pressed since the last slice
+    std::atomic<bool> hasKeys{false};
+  };
+
+  // A worker's share of the machines for one slice. The owner takes from the back, thieves from the
+  // front.
+  struct WorkQueue
+  {
+    std::mutex mutex;
+    std::deque<Id> ids;
+  };
+
+  bool isRunnable(const Instance& instance) const noexcept;
+  void runSlice(Instance& instance);
+  std::optional<Id> takeWork(size_t worker);
+  void work(std::stop_token stop, size_t worker);
+
+  uint64_t m_sliceCycles;
+  std::vector<std::unique_ptr<Instance>> m_instances;
+  std::vector<std::unique_ptr<WorkQueue>> m_queues;
+
+  std::mutex m_mutex;
+  std::condition_variable_any m_started;  // A new slice is in the queues
+  std::condition_variable m_finished;  // m_remaining reached zero
+  uint64_t m_generation = 0;  // Slices started, guarded by m_mutex
+  size_t m_remaining = 0;  // Machines of the current slice not run yet, guarded by m_mutex
+
+  std::vector<std::jthread> m_workers;  // Last, so they stop before everything they use goes
+};
+
+}  // namespace apple2
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+
+#include "apple2/hires_video_device.h"
+#include "apple2/text_video_device.h"
+#include "common/address.h"
+
+namespace apple2
+{
+
+//! The display soft switches at $C050-$C057.
+struct VideoMode
+{
+  bool text = true;  // $C050 graphics, $C051 text
+  bool mixed = false;  // $C052 full screen, $C053 four lines of text at the bottom
+  bool page2 = false;  // $C054 page 1, $C055 page 2
+  bool hiRes = false;  // $C056 lo-res, $C057 hi-res
+
+  bool operator==(const VideoMode&) const = default;
+
+  //! The blocks, 8 scanlines each, that show graphics in this mode.
+  TextVideoDevice::RowMask graphicsBlocks() const noexcept
+  {
+    if (text)
+    {
+      return 0;
+    }
+    return mixed ? TextVideoDevice::c_allRows >> 4 : TextVideoDevice::c_allRows;
+  }
+};
+
+//! The graphics screen as 280x192 palette indices, converted a block of 8 scanlines at a time so a
+//! frame costs in proportion to what changed. Blocks that show text are black; the text itself comes
+//! from TextVideoDevice::exportScreen().
+class Framebuffer
+{
+public:
+  using Byte = Common::Byte;
+  using RowMask = TextVideoDevice::RowMask;
+
+  //! An index into c_palette, the 16 lo-res colors. Hi-res uses black, white and the four colors
+  //! among them it can show.
+  using Pixel = uint8_t;
+
+  static constexpr size_t c_width{280};
+  static constexpr size_t c_height{192};
+  static constexpr size_t c_blockHeight{8};
+  static constexpr size_t c_blocks{c_height / c_blockHeight};
+
+  //! 0xRRGGBBAA for each Pixel value.
+  static constexpr std::array<uint32_t, 16> c_palette{0x000000FF, 0x722640FF, 0x40337FFF, 0xE434FEFF, 0x0E5940FF,
+      0x808080FF, 0x1B9AFEFF, 0xBFB3FFFF, 0x404C00FF, 0xE46501FF, 0x808080FF, 0xF1A6BFFF, 0x1BCB01FF, 0xBFCC80FF,
+      0x8DD9BFFF, 0xFFFFFFFF};
+
+  std::span<const Pixel, c_width * c_height> pixels() const noexcept
+  {
+    return m_pixels;
+  }
+
+  //! The pixels of one block, c_blockHeight rows of c_width.
+  std::span<const Pixel, c_width * c_blockHeight> block(size_t index) const noexcept
+  {
+    return std::span(m_pixels).subspan(index * c_width * c_blockHeight).first<c_width * c_blockHeight>();
+  }
+
+  //! Brings the framebuffer up to `mode`, converting the blocks in `dirty` from the page that mode
+  //! shows. Everything is converted if the mode differs from the last update. Returns the blocks that
+  //! were converted.
+  RowMask update(const VideoMode& mode, RowMask dirty, std::span<const Byte, TextVideoDevice::c_size> textPage,
+      std::span<const Byte, HiResVideoDevice::c_size> hiResPage);
+
+private:
+  void convertLoRes(size_t block, std::span<const Byte, TextVideoDevice::c_size> page) noexcept;
+  void convertHiRes(size_t block, std::span<const Byte, HiResVideoDevice::c_size> page) noexcept;
+  void clear(size_t block) noexcept;
+
+  std::array<Pixel, c_width * c_height> m_pixels{};
+  VideoMode m_mode;
+  bool m_valid = false;  // m_pixels show m_mode
+};
+
+}  // namespace apple2
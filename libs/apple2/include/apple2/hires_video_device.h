@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "apple2/text_video_device.h"
+#include "common/bus.h"
+
+namespace apple2
+{
+
+//! One page of hi-res graphics memory, $2000-$3FFF or $4000-$5FFF. Like TextVideoDevice it keeps a
+//! mask of the blocks that changed, where a block is the 8 scanlines behind one text row.
+class HiResVideoDevice : public Common::Bus::Device
+{
+public:
+  using Address = Common::Address;
+  using Byte = Common::Byte;
+  using RowMask = TextVideoDevice::RowMask;
+
+  static constexpr size_t c_size{0x2000};
+  static constexpr Address c_page1Address{0x2000};
+  static constexpr Address c_page2Address{0x4000};
+
+  explicit HiResVideoDevice(std::span<Byte, c_size> videoMemory) noexcept
+    : m_videoMemory(videoMemory)
+  {
+  }
+
+  //! The block shown from `offset` into the page. Each scanline of a block is $400 bytes further on,
+  //! otherwise the layout is that of the text page, holes included.
+  static constexpr std::optional<size_t> blockAt(size_t offset) noexcept
+  {
+    return TextVideoDevice::rowAt(offset % TextVideoDevice::c_size);
+  }
+
+  // Bus interface methods
+  Byte read(Address address, Address normalizedAddress) const override;
+  void write(Address address, Address normalizedAddress, Byte value) override;
+
+  // Reads can bypass the device; writes still come through write() so their blocks are marked dirty.
+  Common::Bus::DirectMemory directMemory() noexcept override
+  {
+    return {m_videoMemory.data(), nullptr, m_videoMemory.size(), false};
+  }
+
+  std::span<const Byte, c_size> memory() const noexcept
+  {
+    return m_videoMemory;
+  }
+
+  //! The blocks whose bytes changed since they were last taken. Writes to the holes and writes that
+  //! store the byte already there do not count.
+  RowMask dirtyBlocks() const noexcept
+  {
+    return m_dirtyBlocks;
+  }
+
+  //! Returns the dirty blocks among `blocks` and marks them clean.
+  RowMask takeDirtyBlocks(RowMask blocks = TextVideoDevice::c_allRows) noexcept
+  {
+    RowMask taken = m_dirtyBlocks & blocks;
+    m_dirtyBlocks &= ~blocks;
+    return taken;
+  }
+
+  // For changes to video memory that did not go through write(), such as restoring a snapshot.
+  void markDirty() noexcept
+  {
+    m_dirtyBlocks = TextVideoDevice::c_allRows;
+  }
+
+private:
+  std::span<Byte, c_size> m_videoMemory;
+  RowMask m_dirtyBlocks = TextVideoDevice::c_allRows;
+};
+
+}  // namespace apple2
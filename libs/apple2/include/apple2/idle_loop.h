@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace apple2
+{
+
+//! A short loop at the program counter that Apple2System can fast-forward by whole iterations. Every
+//! iteration of these loops leaves the machine in a state that can be computed from the iteration
+//! count alone, so skipping them is exact.
+struct IdleLoop
+{
+  enum class Kind
+  {
+    KeyboardPoll,  // LDA/LDX/LDY/BIT $C000; BPL loop
+    KeyboardPollCounting,  // INC zp; BNE +2; INC zp+1; BIT $C000; BPL loop (monitor KEYIN)
+    CountdownX,  // DEX; BNE loop
+    CountdownY,  // DEY; BNE loop
+    CountdownA,  // SBC #$01; BNE loop (monitor WAIT)
+  };
+
+  Kind kind;
+  Common::Address start{0};  // First instruction of the loop
+  Common::Byte opcode = 0;  // Polling instruction of a KeyboardPoll
+  Common::Byte counter = 0;  // Zero page address of the KeyboardPollCounting counter
+  uint32_t iterationCycles = 0;  // One iteration that branches back to the top
+  uint32_t wrapCycles = 0;  // A KeyboardPollCounting iteration in which the counter's low byte wraps
+};
+
+//! Recognizes an idle loop that `pc` is in, where `pc` is the address of any of its instructions.
+//! Code is only read with Bus::peek(), so a loop in I/O space or on a split page is never recognized.
+std::optional<IdleLoop> findIdleLoop(Common::Address pc, const Common::Bus& bus) noexcept;
+
+}  // namespace apple2
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <string_view>
+
+namespace apple2
+{
+
+//! Keys waiting for the keyboard latch, in a ring of fixed capacity so that typing never allocates.
+class KeyBuffer
+{
+public:
+  static constexpr size_t c_capacity{4096};
+
+  //! Appends as much of `keys` as fits and returns how many that was.
+  size_t push(std::string_view keys) noexcept
+  {
+    size_t count = std::min(keys.size(), c_capacity - m_count);
+    size_t tail = (m_head + m_count) % c_capacity;
+    size_t first = std::min(count, c_capacity - tail);
+    std::copy_n(keys.begin(), first, m_keys.begin() + static_cast<std::ptrdiff_t>(tail));
+    std::copy_n(keys.begin() + static_cast<std::ptrdiff_t>(first), count - first, m_keys.begin());
+    m_count += count;
+    return count;
+  }
+
+  std::optional<char> pop() noexcept
+  {
+    if (m_count == 0)
+    {
+      return std::nullopt;
+    }
+    char key = m_keys[m_head];
+    m_head = (m_head + 1) % c_capacity;
+    --m_count;
+    return key;
+  }
+
+  bool empty() const noexcept
+  {
+    return m_count == 0;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_count;
+  }
+
+  void clear() noexcept
+  {
+    m_head = 0;
+    m_count = 0;
+  }
+
+private:
+  std::array<char, c_capacity> m_keys{};
+  size_t m_head = 0;  // Index of the oldest key
+  size_t m_count = 0;
+};
+
+}  // namespace apple2
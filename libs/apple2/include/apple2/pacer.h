@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+namespace apple2
+{
+
+//! Keeps emulated time in step with the host's monotonic clock. The owner runs the machine for a
+//! while and tells pace() how many cycles actually ran, overshoot included; pace() waits until the
+//! host has caught up with them. Every wait is for an absolute time computed from the total number of
+//! cycles since the last reset, so the rounding of one frame and the lateness of a wake-up are made
+//! up in the next frame instead of adding up.
+//!
+//! If the host falls more than c_maxLag behind, say because the process was stopped, the lost time is
+//! dropped rather than run flat out to catch up.
+class Pacer
+{
+public:
+  using Clock = std::chrono::steady_clock;
+
+  enum class Mode
+  {
+    RealTime,  // Run at the Apple II's speed
+    Multiple,  // Run at `speed` times the Apple II's speed
+    Unthrottled,  // Never wait, pace() only counts
+  };
+
+  //! The NTSC Apple II's average CPU clock: 14.31818 MHz / 14, with one cycle in 65 stretched by two
+  //! 14 MHz ticks.
+  static constexpr double c_cpuHz{1'020'484.45};
+
+  static constexpr std::chrono::milliseconds c_maxLag{100};
+
+  //! `speed` is only used in Mode::Multiple.
+  explicit Pacer(Mode mode = Mode::RealTime, double speed = 1.0) noexcept;
+
+  //! Changes the mode and starts timing from now.
+  void setMode(Mode mode, double speed = 1.0) noexcept;
+
+  Mode mode() const noexcept
+  {
+    return m_mode;
+  }
+
+  //! Counts `cycles` that have run and, unless unthrottled, waits until they are due. Unthrottled
+  //! mode does not even read the clock.
+  void pace(uint64_t cycles)
+  {
+    m_cycles += cycles;
+    if (m_mode != Mode::Unthrottled)
+    {
+      waitForCycles();
+    }
+  }
+
+  //! Starts timing from now, forgetting how far ahead or behind the emulation was.
+  void reset() noexcept;
+
+  //! Cycles counted since the last reset.
+  uint64_t cycles() const noexcept
+  {
+    return m_cycles;
+  }
+
+  //! Number of times the host fell more than c_maxLag behind and the lost time was dropped.
+  uint64_t resyncs() const noexcept
+  {
+    return m_resyncs;
+  }
+
+private:
+  void waitForCycles();
+
+  Mode m_mode = Mode::RealTime;
+  double m_cyclesPerSecond = c_cpuHz;
+  Clock::time_point m_start;  // Host time at which cycle 0 was due
+  uint64_t m_cycles = 0;  // Since m_start
+  uint64_t m_resyncs = 0;
+};
+
+}  // namespace apple2
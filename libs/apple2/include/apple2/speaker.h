@@ -0,0 +1,97 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "apple2/pacer.h"
+
+namespace apple2
+{
+
+//! The speaker behind $C030, which flips its cone from one position to the other on every access.
+//! While the machine runs, a toggle only stores its cycle count in a preallocated buffer; turning the
+//! toggles into sound waits for synthesize(), which the host calls once a frame or so.
+//!
+//! Every toggle is a step in the speaker level. The steps are drawn into the sample stream through a
+//! band-limited step table, so toggles that fall between two samples are neither lost nor aliased,
+//! and the level is then run through a high-pass filter, as the real speaker cannot hold a level
+//! either. Samples come out a fixed c_width / 2 samples late.
+class Speaker
+{
+public:
+  using Sample = int16_t;
+
+  //! Gets the samples of each synthesize(), mono, at sampleRate().
+  using Output = std::function<void(std::span<const Sample> samples)>;
+
+  //! Toggles buffered before they are synthesized without being asked, a little over two frames of
+  //! the fastest toggling loop.
+  static constexpr size_t c_capacity{1 << 13};
+
+  //! Samples each step is spread over.
+  static constexpr size_t c_width{16};
+
+  explicit Speaker(double sampleRate = 44'100.0, double cpuHz = Pacer::c_cpuHz);
+
+  //! Samples go nowhere until an output is set.
+  void setOutput(Output output)
+  {
+    m_output = std::move(output);
+  }
+
+  double sampleRate() const noexcept
+  {
+    return m_sampleRate;
+  }
+
+  //! The speaker was accessed at `cycle`, which is no earlier than the last toggle.
+  void toggle(uint64_t cycle)
+  {
+    if (m_count == c_capacity) [[unlikely]]
+    {
+      synthesize(cycle);
+    }
+    m_toggles[m_count++] = cycle;
+  }
+
+  //! Toggles recorded since the last synthesize().
+  std::span<const uint64_t> pendingToggles() const noexcept
+  {
+    return std::span(m_toggles).first(m_count);
+  }
+
+  //! Turns the toggles so far into the samples up to `cycle` and hands them to the output.
+  void synthesize(uint64_t cycle);
+
+  //! Drops the pending toggles and starts the samples over at `cycle`, for when the machine's cycle
+  //! count jumps.
+  void restart(uint64_t cycle) noexcept;
+
+private:
+  // Samples from the start for `cycle`, minus those already handed out.
+  double samplePosition(uint64_t cycle) const noexcept
+  {
+    return static_cast<double>(cycle) * m_samplesPerCycle - m_emitted;
+  }
+
+  double m_sampleRate;
+  double m_samplesPerCycle;
+  Output m_output;
+
+  std::vector<uint64_t> m_toggles;
+  size_t m_count = 0;
+
+  double m_emitted = 0;  // Samples handed out since cycle 0, a whole number
+  std::vector<float> m_deltas;  // Level changes from the next sample on, c_width longer than needed
+  bool m_high = false;  // The level after the last toggle that was synthesized
+  float m_level = 0;  // The level at the last sample handed out
+  float m_filtered = 0;  // The high-passed level at the last sample handed out
+  std::vector<Sample> m_samples;
+};
+
+}  // namespace apple2
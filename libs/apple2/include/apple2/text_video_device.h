@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <optional>
 #include <span>
 
 #include "common/bus.h"
@@ -15,8 +17,27 @@ public:
   using Line = std::span<char, 40>;
   using Screen = std::array<Line, 24>;
 
+  //! One bit per screen row, bit 0 is the top row.
+  using RowMask = uint32_t;
+
   static constexpr size_t c_size{0x0400};  // 1KB
   static constexpr Address c_baseAddress{0x0400};
+  static constexpr Address c_page2Address{0x0800};
+  static constexpr size_t c_rows{24};
+  static constexpr size_t c_columns{40};
+  static constexpr RowMask c_allRows{(RowMask{1} << c_rows) - 1};
+
+  //! The row shown from `offset` into the text page, or nothing for the screen holes: the last 8 bytes
+  //! of every 128, which are not displayed.
+  static constexpr std::optional<size_t> rowAt(size_t offset) noexcept
+  {
+    size_t column = offset % 0x80;
+    if (column >= 3 * 0x28)
+    {
+      return std::nullopt;
+    }
+    return (column / 0x28) * 8 + (offset / 0x80) % 8;
+  }
 
   explicit TextVideoDevice(std::span<Byte, c_size> videoMemory) noexcept;
 
@@ -24,17 +45,59 @@ public:
   Byte read(Address address, Address normalizedAddress) const override;
   void write(Address address, Address normalizedAddress, Byte value) override;
 
+  // Reads can bypass the device; writes still come through write() so their rows are marked dirty.
+  Common::Bus::DirectMemory directMemory() noexcept override
+  {
+    return {m_videoMemory.data(), nullptr, m_videoMemory.size(), false};
+  }
+
   bool isDirty() const noexcept
   {
-    return m_dirty;
+    return m_dirtyRows != 0;
   }
 
+  //! The rows whose characters changed since the last call to takeDirtyRows() or screen(). Writes to
+  //! the screen holes and writes that store the byte already there do not count.
+  RowMask dirtyRows() const noexcept
+  {
+    return m_dirtyRows;
+  }
+
+  //! Returns the dirty rows among `rows` and marks them clean, for consumers that only redraw the rows
+  //! that changed.
+  RowMask takeDirtyRows(RowMask rows = c_allRows) noexcept
+  {
+    RowMask taken = m_dirtyRows & rows;
+    m_dirtyRows &= ~rows;
+    return taken;
+  }
+
+  // For changes to video memory that did not go through write(), such as restoring a snapshot.
+  void markDirty() noexcept
+  {
+    m_dirtyRows = c_allRows;
+  }
+
+  //! The whole screen. Marks all rows clean.
   const Screen& screen() const noexcept;
 
+  //! The page as lo-res graphics read it.
+  std::span<const Byte, c_size> memory() const noexcept
+  {
+    return m_videoMemory;
+  }
+
+  //! Writes `row` as ASCII, see c_screenToAscii.
+  void exportRow(size_t row, std::span<char, c_columns> out) const noexcept;
+
+  //! Writes the screen as ASCII into `out`, c_columns characters per row and no line breaks, as many
+  //! rows as fit. Returns the number of rows written. Does not change dirtyRows().
+  size_t exportScreen(std::span<char> out) const noexcept;
+
 private:
   std::span<Byte, c_size> m_videoMemory;
   Screen m_screen;
-  mutable bool m_dirty = true;
+  mutable RowMask m_dirtyRows = c_allRows;
 };
 
 }  // namespace apple2
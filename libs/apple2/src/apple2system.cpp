@@ -1,42 +1,168 @@
 #include "apple2/apple2system.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <memory>
+#include <ostream>
 #include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
 
 #include "common/bus.h"
+#include "common/copy_on_write_memory.h"
+#include "common/fixed_formatter.h"
+#include "common/hot_spot_profile.h"
 #include "common/logger.h"
 #include "common/memory.h"
+#include "common/page_hash.h"
 #include "cpu6502/mos6502.h"
+#include "cpu6502/trace_sink.h"
 
 namespace apple2
 {
 
 using Common::Bus;
 
+namespace
+{
+
+constexpr Apple2System::Engine engineFor(Apple2System::Accuracy accuracy) noexcept
+{
+  return accuracy == Apple2System::Accuracy::Fast ? Apple2System::Engine::Block : Apple2System::Engine::Microcode;
+}
+
+}  // namespace
+
 Apple2System::Apple2System(  //
     RamSpan<0xc000> memory,  // Main memory
     RomSpan<0x3000> rom,  // upper ROM
     RamSpan<0x1000> langBank0,  // language card bank 0
-    RamSpan<0x1000> langBank1  // language card bank 1
-    )
-  : m_textVideo(RamSpan<0x400>(memory.data() + 0x400, 0x400))  // $0400-$07FF
+    RamSpan<0x1000> langBank1,  // language card bank 1
+    Engine engine)
+  : Apple2System(memory, nullptr,
+        {RamSpan<0x400>(memory.data() + 0x400, 0x400), RamSpan<0x400>(memory.data() + 0x800, 0x400),
+            RamSpan<0x2000>(memory.data() + 0x2000, 0x2000), RamSpan<0x2000>(memory.data() + 0x4000, 0x2000)},
+        rom, langBank0, langBank1, nullptr, engine)
+{
+}
+
+Apple2System::Apple2System(RamSpan<0xc000> memory, RomSpan<0x3000> rom, RamSpan<0x1000> langBank0,
+    RamSpan<0x1000> langBank1, Accuracy accuracy)
+  : Apple2System(memory, rom, langBank0, langBank1, engineFor(accuracy))
+{
+  setAccuracy(accuracy);
+}
+
+Apple2System::Apple2System(std::span<Byte> memory, std::unique_ptr<Common::CopyOnWriteMemory> sharedRam,
+    VideoMemory video, RomSpan<0x3000> rom, RamSpan<0x1000> langBank0, RamSpan<0x1000> langBank1,
+    std::unique_ptr<OwnedMemory> owned, Engine engine)
+  : m_engine(engine)
+  , m_owned(std::move(owned))
+  , m_memory(memory)
+  , m_sharedRam(std::move(sharedRam))
+  , m_video(video)
+  , m_langBank0(langBank0)
+  , m_langBank1(langBank1)
+  , m_textVideo(video.textPage1)
+  , m_textVideo2(video.textPage2)
+  , m_hiRes1(video.hiResPage1)
+  , m_hiRes2(video.hiResPage2)
   , m_ram(memory)
-  , m_rom(rom)
   , m_io(this)
-  , m_languageCard(std::span(langBank0), std::span(langBank1))
+  , m_languageCardLow(rom.first<0x1000>(), langBank0, langBank1)
+  , m_languageCardHigh(rom.last<0x2000>(), RamSpan<0x2000>(m_langHighRam))
+  , m_disk(m_events)
   , m_bus{{
         Bus::Entry{Address{0x0400}, Address{0x07FF}, &m_textVideo},
+        Bus::Entry{Address{0x0800}, Address{0x0BFF}, &m_textVideo2},
+        Bus::Entry{Address{0x2000}, Address{0x3FFF}, &m_hiRes1},
+        Bus::Entry{Address{0x4000}, Address{0x5FFF}, &m_hiRes2},
         Bus::Entry{Address{0xC0E0}, Address{0xC0EF}, &m_disk},  // Disk (slot 6, control switches)
         Bus::Entry{Address{0xC600}, Address{0xC6FF}, &m_disk},  // Disk (slot 6, ROM)
         Bus::Entry{Address{0xC000}, Address{0xC0FF}, &m_io},  // I/O and soft switches
-        Bus::Entry{Address{0x0000}, Address{0x0000}, &m_languageCard},
-        Bus::Entry{Address{0x0000}, Address{0xBFFF}, &m_ram},
-        Bus::Entry{Address{0xD000}, Address{0xFFFF}, &m_rom},
+        Bus::Entry{Address{0x0000}, Address{0xBFFF}, m_sharedRam ? static_cast<Bus::Device*>(m_sharedRam.get()) : &m_ram},
+        Bus::Entry{Address{0xD000}, Address{0xDFFF}, &m_languageCardLow},
+        Bus::Entry{Address{0xE000}, Address{0xFFFF}, &m_languageCardHigh},
     }}
 {
   setupIoHandlers();
+  mapLanguageCard();
+}
+
+std::unique_ptr<Apple2System> Apple2System::fork(
+    std::shared_ptr<const Snapshot> snapshot, RomSpan<0x3000> rom, Engine engine)
+{
+  auto owned = std::make_unique<OwnedMemory>();
+  VideoMemory video{owned->textPage, owned->textPage2, owned->hiResPage1, owned->hiResPage2};
+  RamSpan<0x1000> langBank0(owned->langBank0);
+  RamSpan<0x1000> langBank1(owned->langBank1);
+  auto ram = std::make_unique<Common::CopyOnWriteMemory>(
+      std::shared_ptr<const Byte>(snapshot, snapshot->ram.data()), snapshot->ram.size());
+
+  // The constructor is private, so std::make_unique cannot call it.
+  std::unique_ptr<Apple2System> system(
+      new Apple2System({}, std::move(ram), video, rom, langBank0, langBank1, std::move(owned), engine));
+  system->restoreSnapshot(*snapshot);
+  return system;
+}
+
+std::unique_ptr<Apple2System> Apple2System::fork(
+    std::shared_ptr<const Snapshot> snapshot, RomSpan<0x3000> rom, Accuracy accuracy)
+{
+  auto system = fork(std::move(snapshot), rom, engineFor(accuracy));
+  system->setAccuracy(accuracy);
+  return system;
+}
+
+void Apple2System::setEngine(Engine engine)
+{
+  if (engine == m_engine)
+  {
+    return;
+  }
+
+  // Whether the last run stopped at this instruction is kept by the pump for the microcode engine and
+  // by the system for the others; the flag of the engine not in use stays clear. The pump's cycle
+  // count is only kept up to date by the microcode engine.
+  if (m_engine == Engine::Microcode)
+  {
+    finishInstruction();
+    m_stopped = m_pump.snapshot().stopped;
+    m_pump.restore({0, m_cycles, false, false});
+  }
+  else
+  {
+    m_pump.restore({0, m_cycles, false, m_stopped});
+    m_stopped = false;
+  }
+  m_engine = engine;
+  m_blocks.clear();
+}
+
+void Apple2System::setAccuracy(Accuracy accuracy)
+{
+  setEngine(engineFor(accuracy));
+  if (accuracy != Accuracy::Traced)
+  {
+    m_traced.reset();
+  }
+  else if (!m_traced)
+  {
+    m_traced = std::make_unique<TracedBus>(m_bus);
+  }
+}
+
+void Apple2System::finishInstruction()
+{
+  while (!m_pump.atInstructionBoundary())
+  {
+    m_events.runDue(m_cycles);
+    ++m_cycles;
+    m_pump.tick(m_cpu, Processor::BusToken{&cpuBus()});
+  }
 }
 
 void Apple2System::reset()
@@ -51,67 +177,536 @@ void Apple2System::reset()
   m_cpu.set(Processor::Flag::Interrupt, true);  // Disable interrupts
   m_cpu.registers.sp = 0xFF;  // Initialize stack pointer
 
-  // Reset the microcode pump
-  m_pump = MicrocodePump<Processor>();
+  // Reset the microcode pump, pending events stay as far away as they were
+  m_pump = Pump();
+  m_events.rewind(m_cycles);
+  m_cycles = 0;
+  m_idleCycles = 0;
+  m_fastDiskSectors = 0;
+  m_nextDiskScan = 0;
+  m_stopped = false;
+  m_nextKeyCycle = 0;
+  m_speaker.restart(0);
 }
 
 bool Apple2System::clock()
 {
-  return m_pump.tick(m_cpu, Processor::BusToken{&m_bus});
+  m_events.runDue(m_cycles);
+  if (m_engine != Engine::Microcode)
+  {
+    m_stopped = false;
+    m_cycles += executeInstruction(m_cycles);
+    return false;
+  }
+
+  ++m_cycles;
+  return m_pump.tick(m_cpu, Processor::BusToken{&cpuBus()});
 }
 
-void Apple2System::step()
+uint32_t Apple2System::step()
 {
+  if (m_engine != Engine::Microcode)
+  {
+    m_events.runDue(m_cycles);
+    uint32_t cycles = executeInstruction(m_cycles);
+    m_cycles += cycles;
+    return cycles;
+  }
+
   // Execute one instruction (multiple clocks)
+  uint32_t cycles = 0;
   do
   {
     // Keep clocking until instruction completes
+    ++cycles;
   } while (clock());
+  return cycles;
 }
 
-void Apple2System::run(size_t maxCycles)
+uint64_t Apple2System::run(uint64_t cycles)
 {
-  size_t cycles = 0;
-  while (cycles < maxCycles)
+  // Breakpoints are left to runFor(), this has to run the whole budget.
+  NeverStop never;
+  RunResult result = runSlices(cycles, never);
+  if (result.status == RunStatus::Trapped)
   {
-    if (!clock())
+    throw Processor::TrapException(result.trapAddress);
+  }
+
+  // The microcode engine stops exactly at the budget, finish the instruction it stopped in.
+  uint64_t executed = result.cycles;
+  if (m_engine == Engine::Microcode)
+  {
+    while (!m_pump.atInstructionBoundary())
     {
-      break;  // Instruction completed
+      clock();
+      ++executed;
     }
-    ++cycles;
+  }
+  return executed - cycles;
+}
+
+uint64_t Apple2System::runSliceRepaying(uint64_t cycles, uint64_t& overshoot)
+{
+  if (cycles == 0)
+  {
+    return 0;
+  }
+  uint64_t owed = std::min(overshoot, cycles - 1);
+  uint64_t budget = cycles - owed;
+  uint64_t over = run(budget);
+  overshoot = overshoot - owed + over;
+  return budget + over;
+}
+
+Apple2System::RunResult Apple2System::runAccelerated(uint64_t cycles)
+{
+  RunResult result;
+  while (result.cycles < cycles)
+  {
+    // If the CPU is in an idle loop but not at its top, the next slice stops at the top so the loop
+    // can be skipped from there. The same goes for the disk read routine.
+    std::optional<Address> top;
+    if (auto loop = idleLoop())
+    {
+      if (loop->start == m_cpu.registers.pc)
+      {
+        result.cycles += skipIdleLoop(*loop, cycles - result.cycles);
+        if (result.cycles >= cycles)
+        {
+          break;
+        }
+      }
+      else
+      {
+        top = loop->start;
+      }
+    }
+
+    std::optional<Address> diskRead;
+    if (auto routine = diskReadRoutine())
+    {
+      if (routine->start != m_cpu.registers.pc)
+      {
+        diskRead = routine->start;
+      }
+      else if (uint64_t credited = readSector(*routine); credited != 0)
+      {
+        result.cycles += credited;
+        continue;
+      }
+    }
+
+    auto atTop = [top, diskRead](const Processor::State& cpu)
+    { return top == cpu.registers.pc || diskRead == cpu.registers.pc; };
+    RunResult slice = runBatch(std::min(cycles - result.cycles, c_idleCheckCycles), atTop);
+    result.cycles += slice.cycles;
+    if (slice.status != RunStatus::Trapped && !m_pump.atInstructionBoundary() && result.cycles < cycles)
+    {
+      // Idle loops can only be recognized on an instruction boundary, finish the instruction.
+      auto boundary = [](const Processor::State& /*cpu*/) { return true; };
+      slice = runBatch(cycles - result.cycles, boundary);
+      result.cycles += slice.cycles;
+    }
+    if (slice.status == RunStatus::Trapped)
+    {
+      result.status = slice.status;
+      result.trapAddress = slice.trapAddress;
+      break;
+    }
+  }
+  return result;
+}
+
+std::optional<IdleLoop> Apple2System::idleLoop() const
+{
+  if (!m_idleSkipping || (m_engine == Engine::Microcode && !m_pump.atInstructionBoundary()) || m_disk.isMotorOn())
+  {
+    return std::nullopt;
+  }
+
+  // An interrupt can end the loop at any boundary.
+  if (m_cpu.irq || m_cpu.nmi)
+  {
+    return std::nullopt;
+  }
+
+  auto loop = findIdleLoop(m_cpu.registers.pc, m_bus);
+  bool polling = loop && (loop->kind == IdleLoop::Kind::KeyboardPoll || loop->kind == IdleLoop::Kind::KeyboardPollCounting);
+
+  // The keyboard only changes if there are keys waiting or one has not been read yet.
+  if (polling && (!m_keyBuffer.empty() || (m_keyboardData & 0x80) != 0))
+  {
+    return std::nullopt;
+  }
+  return loop;
+}
+
+uint64_t Apple2System::skipIdleLoop(const IdleLoop& idle, uint64_t budget)
+{
+  using Flag = Processor::Flag;
+  using Kind = IdleLoop::Kind;
+
+  const IdleLoop* loop = &idle;
+  auto& regs = m_cpu.registers;
+  uint64_t iterations = 0;
+  uint64_t skipped = 0;
+  switch (loop->kind)
+  {
+    case Kind::KeyboardPoll:
+    case Kind::KeyboardPollCounting:
+    {
+      // Every iteration has to leave the registers as they are, which is the case once the loop has
+      // run at least once.
+      Byte key = m_keyboardData;
+      bool settled = loop->opcode == 0x2C || loop->kind == Kind::KeyboardPollCounting
+                         ? (m_cpu.has(Flag::Overflow) == ((key & 0x40) != 0) &&
+                               m_cpu.has(Flag::Zero) == ((regs.a & key) == 0))
+                         : ((loop->opcode == 0xAD   ? regs.a
+                                : loop->opcode == 0xAE ? regs.x
+                                                       : regs.y) == key &&
+                               m_cpu.has(Flag::Zero) == (key == 0));
+      if (!settled || m_cpu.has(Flag::Negative))
+      {
+        return 0;
+      }
+
+      if (loop->kind == Kind::KeyboardPoll)
+      {
+        iterations = budget / loop->iterationCycles;
+        skipped = iterations * loop->iterationCycles;
+        break;
+      }
+
+      // The counter's low byte wraps once every 256 iterations, and that iteration takes longer.
+      Address counter{loop->counter};
+      uint16_t value = static_cast<uint16_t>(m_bus.read(counter) | (m_bus.read(counter + 1) << 8));
+      uint64_t chunk = 0x100 - LoByte(Address{value});  // Iterations up to and including the next wrap
+      while (true)
+      {
+        uint64_t chunkCycles = (chunk - 1) * loop->iterationCycles + loop->wrapCycles;
+        if (skipped + chunkCycles > budget)
+        {
+          uint64_t rest = std::min((budget - skipped) / loop->iterationCycles, chunk - 1);
+          iterations += rest;
+          skipped += rest * loop->iterationCycles;
+          break;
+        }
+        iterations += chunk;
+        skipped += chunkCycles;
+        chunk = 0x100;
+      }
+
+      value = static_cast<uint16_t>(value + iterations);
+      m_bus.write(counter, static_cast<Byte>(value));
+      m_bus.write(counter + 1, static_cast<Byte>(value >> 8));
+      break;
+    }
+
+    case Kind::CountdownX:
+    case Kind::CountdownY:
+    case Kind::CountdownA:
+    {
+      // Skip all but the last iteration, which then runs normally and falls out of the loop.
+      Byte& reg = loop->kind == Kind::CountdownX ? regs.x : loop->kind == Kind::CountdownY ? regs.y : regs.a;
+      if (loop->kind == Kind::CountdownA && (!m_cpu.has(Flag::Carry) || m_cpu.has(Flag::Decimal) || reg == 0))
+      {
+        return 0;  // Only a plain binary subtract without borrow counts down by one
+      }
+
+      uint64_t remaining = reg == 0 ? 0xFF : reg - 1u;
+      iterations = std::min(remaining, budget / loop->iterationCycles);
+      if (iterations == 0)
+      {
+        return 0;
+      }
+      skipped = iterations * loop->iterationCycles;
+
+      reg = static_cast<Byte>(reg - iterations);
+      m_cpu.setZN(reg);
+      if (loop->kind == Kind::CountdownA)
+      {
+        m_cpu.set(Flag::Overflow, reg == 0x7F);  // $80 - 1
+      }
+      break;
+    }
+  }
+
+  m_cycles += skipped;
+  m_idleCycles += skipped;
+  if (m_engine == Engine::Microcode)
+  {
+    m_pump.skip(skipped);
+  }
+  return skipped;
+}
+
+std::optional<DiskReadRoutine> Apple2System::diskReadRoutine()
+{
+  if (!m_fastDisk || !m_disk.isMotorOn())
+  {
+    return std::nullopt;
+  }
+
+  if (m_diskReadRoutine)
+  {
+    // The guest may have loaded something else over it.
+    m_diskReadRoutine = findDiskReadRoutine(m_diskReadRoutine->start, m_bus);
+    if (m_diskReadRoutine)
+    {
+      return m_diskReadRoutine;
+    }
+  }
+
+  if (m_cycles < m_nextDiskScan)
+  {
+    return std::nullopt;
+  }
+  m_nextDiskScan = m_cycles + c_diskScanCycles;
+  m_diskReadRoutine = scanForDiskReadRoutine(m_bus, Address{0x0200}, Address{0xC000});
+  return m_diskReadRoutine;
+}
+
+uint64_t Apple2System::readSector(const DiskReadRoutine& routine)
+{
+  // An interrupt is taken before the routine's first instruction.
+  if ((m_engine == Engine::Microcode && !m_pump.atInstructionBoundary()) || m_cpu.irq || m_cpu.nmi ||
+      !readSectorFast(routine, m_cpu.registers, m_disk, m_bus))
+  {
+    return 0;
+  }
+
+  ++m_fastDiskSectors;
+  m_cycles += m_fastDiskCycles;
+  if (m_engine == Engine::Microcode)
+  {
+    m_pump.skip(m_fastDiskCycles);
+  }
+  return m_fastDiskCycles;
+}
+
+uint32_t Apple2System::executeInstruction(uint64_t cycle)
+{
+  m_instructionCycle = cycle;
+  uint32_t cycles = Processor::executeInstruction(m_cpu, m_bus);
+  m_pump.profiler().fetched(m_cpu.opcode, cycle);
+  return cycles;
+}
+
+void Apple2System::traceInstruction(const cpu6502::Registers& cpu, uint64_t cycle) noexcept
+{
+  cpu6502::TraceRecord record{cycle, cpu};
+  if (auto opcode = m_bus.peek(cpu.pc))
+  {
+    record.bytes = {*opcode, m_bus.peek(cpu.pc + 1).value_or(0), m_bus.peek(cpu.pc + 2).value_or(0)};
+    record.bytesKnown = true;
+  }
+  m_trace->record(record);
+}
+
+void Apple2System::startHotSpotRecording()
+{
+  m_hotSpots = std::make_unique<Common::HotSpotProfile>();
+}
+
+std::unique_ptr<Common::HotSpotProfile> Apple2System::stopHotSpotRecording()
+{
+  if (m_hotSpots)
+  {
+    m_hotSpots->flush(m_cycles);
+  }
+  return std::move(m_hotSpots);
+}
+
+void Apple2System::writeHotSpots(std::ostream& out, const Common::HotSpotProfile& profile) const
+{
+  const auto& histogram = profile.histogram();
+  for (size_t pc = 0; pc < histogram.size(); ++pc)
+  {
+    if (histogram[pc] == 0)
+    {
+      continue;
+    }
+
+    Address address{static_cast<uint16_t>(pc)};
+    std::array<std::optional<Byte>, 3> peeked{
+        m_bus.peek(address), m_bus.peek(address + 1), m_bus.peek(address + 2)};
+
+    std::array<char, 64> buffer{};
+    Common::FixedFormatter formatter{buffer};
+    if (peeked[0].has_value())
+    {
+      std::array<Byte, 3> bytes{peeked[0].value(), peeked[1].value_or(0), peeked[2].value_or(0)};
+      Processor::disassemble(address, bytes, formatter);
+    }
+    else
+    {
+      formatter << address << " : ??";
+    }
+
+    std::string_view text = formatter.finalize();
+    text = text.substr(0, text.find_last_not_of(' ') + 1);
+    out << text << ' ' << histogram[pc] << '\n';
   }
 }
 
 void Apple2System::updateKeyboard()
 {
-  if (!m_keyBuffer.empty() && (m_keyboardData & 0x80) == 0)
+  if (m_keyBuffer.empty() || (m_keyboardData & 0x80) != 0 || (!m_fastPaste && instructionCycle() < m_nextKeyCycle))
+  {
+    return;
+  }
+
+  // Latch the next key and set the ready flag
+  char key = *m_keyBuffer.pop();
+  if (key >= 'a' && key <= 'z')
+  {
+    key = static_cast<char>(key - 'a' + 'A');
+  }
+  else if (key == '\n')
+  {
+    key = '\r';
+  }
+  m_keyboardData = static_cast<Common::Byte>(key & 0x7F) | 0x80;
+  m_nextKeyCycle = instructionCycle() + c_keyIntervalCycles;
+}
+
+void Apple2System::saveSnapshot(Snapshot& snapshot) const
+{
+  static_assert(std::is_trivially_copyable_v<Snapshot>);
+
+  snapshot.magic = c_snapshotMagic;
+  snapshot.size = sizeof(Snapshot);
+  snapshot.cpu = m_cpu;
+  snapshot.pump = m_pump.snapshot();
+  snapshot.cycles = m_cycles;
+  snapshot.idleCycles = m_idleCycles;
+  snapshot.stopped = m_stopped;
+  snapshot.keyboardData = m_keyboardData;
+  snapshot.languageCard = m_languageCardState;
+  snapshot.video = m_videoMode;
+  snapshot.disk = m_disk.snapshot();
+  if (m_sharedRam)
+  {
+    m_sharedRam->copyTo(snapshot.ram);
+  }
+  else
+  {
+    std::ranges::copy(m_memory, snapshot.ram.begin());
+  }
+  std::ranges::copy(m_video.textPage1, snapshot.ram.begin() + 0x400);
+  std::ranges::copy(m_video.textPage2, snapshot.ram.begin() + 0x800);
+  std::ranges::copy(m_video.hiResPage1, snapshot.ram.begin() + 0x2000);
+  std::ranges::copy(m_video.hiResPage2, snapshot.ram.begin() + 0x4000);
+  std::ranges::copy(m_langBank0, snapshot.langBank0.begin());
+  std::ranges::copy(m_langBank1, snapshot.langBank1.begin());
+  snapshot.langHighRam = m_langHighRam;
+}
+
+std::array<std::span<const Common::Byte>, 4> Apple2System::snapshotMemory(const Snapshot& snapshot) noexcept
+{
+  static_assert(sizeof(Snapshot::ram) + sizeof(Snapshot::langBank0) + sizeof(Snapshot::langBank1) +
+                    sizeof(Snapshot::langHighRam) ==
+                Common::Bus::c_pageCount * Common::Bus::c_pageSize);
+  return {snapshot.ram, snapshot.langBank0, snapshot.langBank1, snapshot.langHighRam};
+}
+
+Common::PageBitmap Apple2System::changedPages(const Snapshot& snapshot, const Snapshot& previous) noexcept
+{
+  Common::PageBitmap changed;
+  auto regions = snapshotMemory(snapshot);
+  auto previousRegions = snapshotMemory(previous);
+  size_t page = 0;
+  for (size_t region = 0; region < regions.size(); ++region)
   {
-    // Get next key and set ready flag
-    char key = m_keyBuffer.front();
-    m_keyBuffer.pop();
-    m_keyboardData = static_cast<Common::Byte>(key & 0x7F) | 0x80;
+    Common::changedPages(regions[region], previousRegions[region], changed, page);
+    page += regions[region].size() / Common::Bus::c_pageSize;
   }
+  return changed;
 }
 
-void Apple2System::pressKey(char c)
+std::array<uint64_t, Common::Bus::c_pageCount> Apple2System::pageHashes(const Snapshot& snapshot) noexcept
 {
-  // Convert to uppercase and store in buffer
-  if (c >= 'a' && c <= 'z')
+  std::array<uint64_t, Common::Bus::c_pageCount> hashes{};
+  std::span<uint64_t> remaining(hashes);
+  for (std::span<const Byte> region : snapshotMemory(snapshot))
   {
-    c = c - 'a' + 'A';
+    size_t pages = region.size() / Common::Bus::c_pageSize;
+    Common::hashPages(region, remaining.first(pages));
+    remaining = remaining.subspan(pages);
   }
-  m_keyBuffer.push(c);
+  return hashes;
 }
 
-char Apple2System::appleToAscii(Byte data) const noexcept
+void Apple2System::restoreSnapshot(const Snapshot& snapshot)
 {
-  // Apple II has some encoding quirks
-  Byte c = data & 0x7F;  // Strip high bit
-  if (c >= 0x20 && c <= 0x5F)
-    return static_cast<char>(c);
-  if (c >= 0x60 && c <= 0x7F)
-    return static_cast<char>(c - 0x40);  // Lowercase
-  return ' ';  // Default for control chars
+  if (snapshot.magic != c_snapshotMagic || snapshot.size != sizeof(Snapshot))
+  {
+    throw std::invalid_argument("Not a snapshot with this layout");
+  }
+  if (snapshot.pump.inInstruction && Processor::microcode(snapshot.pump.microcode) == nullptr)
+  {
+    throw std::invalid_argument("The snapshot stopped in microcode this CPU does not have");
+  }
+
+  // The snapshot can come from any engine, see setEngine().
+  bool stopped = snapshot.stopped || snapshot.pump.stopped;
+  Pump::Snapshot pump = snapshot.pump;
+  pump.cycles = snapshot.cycles;
+  pump.stopped = stopped && m_engine == Engine::Microcode;
+
+  m_disk.restore(snapshot.disk);
+  m_blocks.clear();
+  m_cpu = snapshot.cpu;
+  m_pump.restore(pump);
+  m_cycles = snapshot.cycles;
+  m_idleCycles = snapshot.idleCycles;
+  m_stopped = stopped && m_engine != Engine::Microcode;
+  m_keyboardData = snapshot.keyboardData;
+  m_keyBuffer.clear();
+  m_nextKeyCycle = 0;
+  m_speaker.restart(m_cycles);
+  if (m_sharedRam)
+  {
+    // Only the pages that differ from what is mapped now stop being shared.
+    m_sharedRam->assign(snapshot.ram);
+    m_bus.remap(Address{0x0000}, Address{0xBFFF});
+  }
+  else
+  {
+    std::ranges::copy(snapshot.ram, m_memory.begin());
+  }
+  std::ranges::copy(std::span(snapshot.ram).subspan<0x400, 0x400>(), m_video.textPage1.begin());
+  std::ranges::copy(std::span(snapshot.ram).subspan<0x800, 0x400>(), m_video.textPage2.begin());
+  std::ranges::copy(std::span(snapshot.ram).subspan<0x2000, 0x2000>(), m_video.hiResPage1.begin());
+  std::ranges::copy(std::span(snapshot.ram).subspan<0x4000, 0x2000>(), m_video.hiResPage2.begin());
+  std::ranges::copy(snapshot.langBank0, m_langBank0.begin());
+  std::ranges::copy(snapshot.langBank1, m_langBank1.begin());
+  m_langHighRam = snapshot.langHighRam;
+  m_languageCardState = snapshot.languageCard;
+  mapLanguageCard();
+  m_videoMode = snapshot.video;
+  m_textVideo.markDirty();
+  m_textVideo2.markDirty();
+  m_hiRes1.markDirty();
+  m_hiRes2.markDirty();
+
+  if (m_engine != Engine::Microcode)
+  {
+    finishInstruction();
+  }
+}
+
+bool Apple2System::isWaitingForKey() const
+{
+  if ((m_engine == Engine::Microcode && !m_pump.atInstructionBoundary()) || m_disk.isMotorOn() || m_cpu.irq ||
+      m_cpu.nmi || !m_keyBuffer.empty() || (m_keyboardData & 0x80) != 0)
+  {
+    return false;
+  }
+
+  auto loop = findIdleLoop(m_cpu.registers.pc, m_bus);
+  return loop && (loop->kind == IdleLoop::Kind::KeyboardPoll || loop->kind == IdleLoop::Kind::KeyboardPollCounting);
 }
 
 void Apple2System::setupIoHandlers()
@@ -133,9 +728,9 @@ void Apple2System::setupIoHandlers()
   // m_io.registerReadRange(Address{0xC020}, Address{0xC02F}, &Apple2System::handleCassetteRead);
   // m_io.registerWriteRange(Address{0xC020}, Address{0xC02F}, &Apple2System::handleCassetteWrite);
 
-  // Graphics soft switches
-  // m_io.registerReadRange(Address{0xC050}, Address{0xC05F}, &Apple2System::handleGraphicsRead);
-  // m_io.registerWriteRange(Address{0xC050}, Address{0xC05F}, &Apple2System::handleGraphicsWrite);
+  // Display soft switches, reads and writes alike
+  m_io.registerReadRange(Address{0xC050}, Address{0xC057}, &Apple2System::handleVideoSwitchRead);
+  m_io.registerWriteRange(Address{0xC050}, Address{0xC057}, &Apple2System::handleVideoSwitchWrite);
 }
 
 Common::Byte Apple2System::handleKeyboardRead(Address /*address*/)
@@ -148,47 +743,65 @@ Common::Byte Apple2System::handleKeyboardStrobeRead(Address /*address*/)
 {
   // Reading the strobe clears the key ready flag (bit 7)
   m_keyboardData &= 0x7F;
-  return m_keyboardData;
+  Byte data = m_keyboardData;
+  if (m_fastPaste)
+  {
+    updateKeyboard();
+  }
+  return data;
 }
 
-// The handler functions examine the specific address to determine behavior
-Common::Byte Apple2System::handleLanguageCardRead(Common::Address address)
+Common::Byte Apple2System::handleLanguageCardRead(Address address)
 {
-  uint16_t addr = static_cast<uint16_t>(address);
-  uint16_t offset = addr - static_cast<uint16_t>(0xC080);  // 0-15 for $C080-$C08F
-
-  // All 16 addresses in the range call this same function
-  // The function examines the specific address to determine what to do
+  switchLanguageCard(address, true);
+  return 0xFF;  // Open bus
+}
 
-  bool selectBank1 = (offset & 0x01) != 0;  // Odd addresses = bank 1
-  bool readFromLC = (offset & 0x08) != 0;  // $C088-$C08F = LC mode
+void Apple2System::handleLanguageCardWrite(Address address, Byte /*data*/)
+{
+  switchLanguageCard(address, false);
+}
 
-  if (selectBank1)
+void Apple2System::switchLanguageCard(Address address, bool read)
+{
+  // Bit 3 picks the bank at $D000, bits 0 and 1 the source for reads: RAM for 0 and 3, ROM for 1 and 2.
+  // Odd switches enable writing to RAM, but only on the second read in a row; even ones disable it.
+  auto offset = static_cast<uint16_t>(address) & 0x0F;
+  LanguageCard state = m_languageCardState;
+  state.bank1 = (offset & 0x08) != 0;
+  state.readRam = (offset & 0x03) == 0 || (offset & 0x03) == 3;
+  if ((offset & 0x01) != 0)
   {
-    m_languageCard.selectBank(0);
+    state.writeRam = state.writeRam || (read && state.preWrite);
+    state.preWrite = read;
   }
   else
   {
-    m_languageCard.selectBank(1);
+    state.writeRam = false;
+    state.preWrite = false;
   }
 
-  std::cout << "[DEBUG] Language card: " << (readFromLC ? "LC mode" : "ROM mode") << " bank "
-            << (selectBank1 ? "1" : "2") << " at $" << std::hex << addr << std::dec << "\n";
-
-  return 0xFF;  // Open bus
+  bool remap = state.readRam != m_languageCardState.readRam || state.writeRam != m_languageCardState.writeRam ||
+               state.bank1 != m_languageCardState.bank1;
+  m_languageCardState = state;
+  if (remap)
+  {
+    mapLanguageCard();
+  }
 }
 
-void Apple2System::handleLanguageCardWrite(Address address, Byte data)
+void Apple2System::mapLanguageCard()
 {
-  static_cast<void>(data);  // Unused parameter
-
-  // Same logic as read - writes to language card switches trigger bank changes
-  handleLanguageCardRead(address);  // Reuse the read logic
+  const LanguageCard& state = m_languageCardState;
+  size_t bank = state.bank1 ? 1 : 2;
+  m_languageCardLow.selectBanks(state.readRam ? bank : 0, state.writeRam ? std::optional(bank) : std::nullopt);
+  m_languageCardHigh.selectBanks(state.readRam ? 1 : 0, state.writeRam ? std::optional<size_t>(1) : std::nullopt);
+  m_bus.remap(Address{0xD000}, Address{0xFFFF});
 }
 
 Common::Byte Apple2System::handleSpeakerRead(Address /*address*/)
 {
-  //  std::cout << "tick\n";
+  m_speaker.toggle(instructionCycle());
   return 0x00;  // Open bus
 }
 
@@ -197,4 +810,33 @@ void Apple2System::handleSpeakerWrite(Address /*address*/, Byte /*data*/)
   handleSpeakerRead(Address{0});  // use the same logic as the read.
 }
 
+Common::Byte Apple2System::handleVideoSwitchRead(Address address)
+{
+  // Even addresses turn a switch off, odd ones on.
+  uint16_t offset = static_cast<uint16_t>(address) - 0xC050;
+  bool on = (offset & 1) != 0;
+  switch (offset >> 1)
+  {
+    case 0: m_videoMode.text = on; break;
+    case 1: m_videoMode.mixed = on; break;
+    case 2: m_videoMode.page2 = on; break;
+    default: m_videoMode.hiRes = on; break;
+  }
+  return 0x00;  // Open bus
+}
+
+void Apple2System::handleVideoSwitchWrite(Address address, Byte /*data*/)
+{
+  handleVideoSwitchRead(address);
+}
+
+Framebuffer::RowMask Apple2System::renderGraphics(Framebuffer& framebuffer)
+{
+  TextVideoDevice& text = m_videoMode.page2 ? m_textVideo2 : m_textVideo;
+  HiResVideoDevice& hiRes = m_videoMode.page2 ? m_hiRes2 : m_hiRes1;
+  TextVideoDevice::RowMask graphics = m_videoMode.graphicsBlocks();
+  TextVideoDevice::RowMask dirty = m_videoMode.hiRes ? hiRes.takeDirtyBlocks(graphics) : text.takeDirtyRows(graphics);
+  return framebuffer.update(m_videoMode, dirty, text.memory(), hiRes.memory());
+}
+
 }  // namespace apple2
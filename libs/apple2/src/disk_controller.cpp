@@ -1,8 +1,10 @@
 #include "apple2/disk_controller.h"
 
+#include <algorithm>
 #include <bit>
+#include <cassert>
 #include <iostream>
-#include <sstream>
+#include <stdexcept>
 
 #include "common/logger.h"
 
@@ -14,10 +16,7 @@ using Common::Byte;
 namespace
 {
 
-// DOS 3.3 sector interleaving
-static constexpr int c_dosOrder[] = {0, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 15};
-
-std::array<int8_t, 256> c_stepTable = []()
+const std::array<int8_t, 256> c_stepTable = []()
 {
   std::array<int8_t, 256> table{};
   table.fill(0);
@@ -26,70 +25,49 @@ std::array<int8_t, 256> c_stepTable = []()
   return table;
 }();
 
-Byte encodeNibble(Byte value) noexcept
-{
-  // Simplified disk-safe encoding (high bit set)
-  return 0x80 | (value & 0x7F);
-}
+}  // namespace
+
+const std::array<Byte, 256> DiskController::c_emptyRom{};
 
-uint16_t encode4x4(Byte value) noexcept
+bool DiskController::loadRom(std::span<const Byte, 256> romData)
 {
-  Byte even = value | 0b1010'1010;
-  Byte odd = ((value >> 1) | 0b1010'1010);
-  return static_cast<uint16_t>((static_cast<uint16_t>(even) << 8) | odd);
+  m_rom = romData;
+  return true;
 }
 
-size_t calculateDiskOffset(int track, int sector, int byteIndex) noexcept
+DiskController::DiskController(Common::EventQueue& events)
+  : m_events(&events)
+  , m_rotationEvent(events.add([this](uint64_t cycle) { rotate(cycle); }))
 {
-  // DOS 3.3 sector interleaving
-  int physicalSector = c_dosOrder[sector];
-
-  return (static_cast<size_t>(track) * 16 + static_cast<size_t>(physicalSector)) * 256 + static_cast<size_t>(byteIndex);
 }
 
-std::array<Byte, 8> generateAddressField(int track, int sector)
+DiskController::~DiskController()
 {
-  // Simplified 4-and-4 encoding for now
-  Byte volume = 254;
-  Byte checksum = static_cast<Byte>(volume ^ track ^ sector);
-
-  std::array<Byte, 8> buffer{};
-
-  // Each value becomes 2 nibbles (simplified encoding)
-  auto word = encode4x4(volume);
-  memcpy(&buffer[0], &word, 2);
-  word = encode4x4(static_cast<Byte>(track));
-  memcpy(&buffer[2], &word, 2);
-  word = encode4x4(static_cast<Byte>(sector));
-  memcpy(&buffer[4], &word, 2);
-  word = encode4x4(checksum);
-  memcpy(&buffer[6], &word, 2);
-  return buffer;
+  flush();
 }
 
-}  // namespace
+bool DiskController::loadDisk(const std::string& filename, DiskImage::Writes writes)
+{
+  LOG(common::LogLevel::Minimal, "DiskController::loadDisk(\"" << filename << "\")");
+  flush();
 
-Byte DiskController::c_rom[256] = {};
+  auto image = DiskImage::open(filename, writes);
+  if (image == nullptr)
+    return false;
 
-bool DiskController::loadRom(std::span<const Byte, 256> romData)
-{
-  std::copy(romData.begin(), romData.end(), std::begin(c_rom));
+  m_image = std::move(image);
+  m_trackDirty = false;
+  invalidateTrack();
   return true;
 }
 
-bool DiskController::loadDisk(const std::string& filename)
+bool DiskController::flush()
 {
-  std::stringstream stream;
-  stream << "DiskController::loadDisk(\"" << filename << "\")\n";
-  LOG(stream.str());
-  std::ifstream file(filename, std::ios::binary);
-  if (!file)
-    return false;
-
-  m_diskData.resize(143360);  // Standard .dsk size
-  file.read(reinterpret_cast<char*>(m_diskData.data()), 143360);
-  m_diskLoaded = true;
-  return true;
+  if (m_trackDirty)
+  {
+    decodeTrack();
+  }
+  return m_image == nullptr || m_image->flush();
 }
 
 Byte DiskController::read(Address address, Address normalizedAddress) const
@@ -99,10 +77,8 @@ Byte DiskController::read(Address address, Address normalizedAddress) const
 
   if (address < c_slot1Rom)
   {
-    std::stringstream stream;
-    stream << "DiskController::read(address=" << std::hex << static_cast<int>(address)
-           << ", normalizedAddress=" << static_cast<int>(normalizedAddress) << ")\n";
-    LOG(stream.str());
+    LOG(common::LogLevel::Verbose,
+        "DiskController::read(address=" << address << ", normalizedAddress=" << normalizedAddress << ")");
 
     // Control/status registers
     Control control{static_cast<Byte>(normalizedAddress)};
@@ -116,8 +92,8 @@ Byte DiskController::read(Address address, Address normalizedAddress) const
       case Control::Phase2_On: m_status |= Phase2Mask; return updateMotor();
       case Control::Phase3_Off: m_status &= ~Phase3Mask; return updateMotor();
       case Control::Phase3_On: m_status |= Phase3Mask; return updateMotor();
-      case Control::Motor_Off: m_status &= ~MotorMask; return updateMotor();
-      case Control::Motor_On: m_status |= MotorMask; return updateMotor();
+      case Control::Motor_Off: stopRotation(); m_status &= ~MotorMask; return updateMotor();
+      case Control::Motor_On: startRotation(); m_status |= MotorMask; return updateMotor();
       case Control::SelectDrive0: m_status &= ~DriveSelectMask; return updateMotor();
       case Control::SelectDrive1: m_status |= DriveSelectMask; return updateMotor();
       case Control::Q6Low: m_status &= ~Q6Mask; return handleControlLines();
@@ -130,21 +106,27 @@ Byte DiskController::read(Address address, Address normalizedAddress) const
   else
   {
     size_t index = static_cast<size_t>(normalizedAddress);
-    assert(index < std::size(c_rom));
-    return c_rom[index];
+    assert(index < m_rom.size());
+    return m_rom[index];
   }
 }
 
 void DiskController::write(Address address, Address normalizedAddress, Byte data)
 {
-  std::stringstream stream;
-  stream << "DiskController::write(address=" << std::hex << static_cast<int>(address)
-         << ", normalizedAddress=" << static_cast<int>(normalizedAddress) << ", data=" << static_cast<int>(data) << ")\n";
-  LOG(stream.str());
+  LOG(common::LogLevel::Verbose,
+      "DiskController::write(address=" << address << ", normalizedAddress=" << normalizedAddress << ", data=" << data
+                                        << ")");
 
   if (address < c_slot1Rom)
   {
     read(address, normalizedAddress);  // Trigger the same actions
+
+    // In write mode a store to an odd switch loads the data latch; the nibble goes to the disk as the
+    // latch is shifted out, which is modelled as one nibble per store.
+    if ((m_status & Q7Mask) != 0 && (static_cast<Byte>(normalizedAddress) & 1) != 0)
+    {
+      writeDiskData(data);
+    }
   }
   else
   {
@@ -152,6 +134,37 @@ void DiskController::write(Address address, Address normalizedAddress, Byte data
   }
 }
 
+DiskController::Snapshot DiskController::snapshot() const noexcept
+{
+  return Snapshot{m_status, m_lastPhase, m_halfTrack, m_nibblePos, m_lead, m_rotationCycle};
+}
+
+void DiskController::restore(const Snapshot& snapshot)
+{
+  if (snapshot.nibblePos >= c_trackSize)
+  {
+    throw std::invalid_argument("Invalid disk controller position in snapshot");
+  }
+
+  m_status = snapshot.status;
+  m_lastPhase = snapshot.lastPhase;
+  m_halfTrack = snapshot.halfTrack;
+  m_nibblePos = snapshot.nibblePos;
+  m_lead = std::min<uint16_t>(snapshot.lead, c_trackSize);
+  m_rotationCycle = snapshot.rotationCycle;
+  if (m_events != nullptr)
+  {
+    if (isMotorOn())
+    {
+      m_events->schedule(m_rotationEvent, m_rotationCycle + c_rotationEventCycles);
+    }
+    else
+    {
+      m_events->cancel(m_rotationEvent);
+    }
+  }
+}
+
 Byte DiskController::updateMotor() const
 {
   if (m_status & MotorMask)
@@ -168,18 +181,57 @@ Byte DiskController::updateMotor() const
   return m_status;
 }
 
+void DiskController::startRotation() const
+{
+  if (m_events != nullptr && !isMotorOn())
+  {
+    m_rotationCycle = m_events->now();
+    m_lead = 0;
+    m_events->schedule(m_rotationEvent, m_rotationCycle + c_rotationEventCycles);
+  }
+}
+
+void DiskController::stopRotation() const
+{
+  if (m_events != nullptr)
+  {
+    m_events->cancel(m_rotationEvent);
+  }
+}
+
+void DiskController::rotate(uint64_t cycle)
+{
+  // The owner's cycle count started over, start timing from there.
+  if (cycle < m_rotationCycle)
+  {
+    m_rotationCycle = cycle;
+  }
+
+  uint64_t passed = (cycle - m_rotationCycle) / c_nibbleCycles;
+  m_rotationCycle += passed * c_nibbleCycles;
+  if (passed > m_lead)
+  {
+    m_nibblePos = static_cast<uint16_t>((m_nibblePos + passed - m_lead) % c_trackSize);
+    m_lead = 0;
+  }
+  else
+  {
+    m_lead = static_cast<uint16_t>(m_lead - passed);
+  }
+  m_events->schedule(m_rotationEvent, cycle + c_rotationEventCycles);
+}
+
 Byte DiskController::handleControlLines() const
 {
   switch (m_status & 0xC0)
   {
     case 0x00:  // Read data
       return readDiskData();
-    case 0x40:  // Write prep
-      return 0;
-    case 0x80:  // Check write protect status
-      return 0x80;  // bit 7 means write protected
+    case 0x40:  // Check write protect status, bit 7 means write protected
+      return isWriteProtected() ? 0x80 : 0x00;
+    case 0x80:  // Shift the data latch out to the disk
     default:
-    case 0xC0:  // Write data
+    case 0xC0:  // Load the data latch, see write()
       return 0;
   }
 }
@@ -187,166 +239,85 @@ Byte DiskController::handleControlLines() const
 Byte DiskController::readDiskData() const
 {
   // Return actual disk data when in read mode
-  if (!m_diskLoaded || (m_status & MotorMask) == 0)
+  if (m_image == nullptr || (m_status & MotorMask) == 0)
   {
     return 0x00;  // No data if no disk or motor off
   }
 
   int track = getCurrentTrack();
-
-  // Reset position if we switched tracks
-  if (m_currentTrack != track)
+  if (m_cachedTrack != track) [[unlikely]]
   {
-    m_currentTrack = static_cast<Byte>(track);
-    m_trackPos = TrackPosition();
+    cacheTrack(track);
   }
 
-  auto lastState = m_trackPos.state;
-  auto nibble = ((*this).*(m_trackPos.state))();
-  ++m_trackPos.nibblePos;
-  if (m_trackPos.state != lastState)
-    m_trackPos.step = 0;
-  else
-    ++m_trackPos.step;
+  auto nibble = m_track[m_nibblePos];
+  advanceHead();
   return nibble;
 }
 
-Byte DiskController::getEncodedSectorByte(int track, int sector, int byteIndex) const
+bool DiskController::peekNibbles(std::span<Byte> nibbles) const
 {
-  // Calculate offset into .dsk file
-  size_t diskOffset = calculateDiskOffset(track, sector, byteIndex);
-
-  if (diskOffset < m_diskData.size())
+  if (m_image == nullptr || (m_status & (MotorMask | Q6Mask | Q7Mask)) != MotorMask)
   {
-    return encodeNibble(m_diskData[diskOffset]);
+    return false;
   }
 
-  return 0x00;
-}
-
-Byte DiskController::AddressPrologue() const
-{
-  static constexpr Byte prologue[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xD5, 0xAA, 0x96};
-  assert(static_cast<size_t>(m_trackPos.step) < std::size(prologue));
-
-  if (static_cast<size_t>(m_trackPos.step) >= std::size(prologue) - 1)
-    Transition(&DiskController::AddressData);
-
-  std::stringstream stream;
-  stream << "DiskController::AddressPrologue() step=" << static_cast<int>(m_trackPos.step) << " returning " << std::hex
-         << static_cast<int>(prologue[m_trackPos.step]) << std::dec << "\n";
-  LOG(stream.str());
-  return prologue[m_trackPos.step];
-}
-
-Byte DiskController::AddressData() const
-{
-  // Generate 4-and-4 encoded address field on demand
-  // Only regenerate if sector or track changed
-  if (m_lastGeneratedSector != m_trackPos.sectorIndex || m_lastGeneratedTrack != m_currentTrack)
+  int track = getCurrentTrack();
+  if (m_cachedTrack != track)
   {
-    std::stringstream stream;
-    stream << "DiskController::AddressData() generating address field for track=" << static_cast<int>(m_currentTrack)
-           << " sector=" << static_cast<int>(c_dosOrder[m_trackPos.sectorIndex]) << "\n";
-    LOG(stream.str());
-    m_addressBuffer = generateAddressField(m_currentTrack, c_dosOrder[m_trackPos.sectorIndex]);
-    m_lastGeneratedSector = m_trackPos.sectorIndex;
-    m_lastGeneratedTrack = m_currentTrack;
+    cacheTrack(track);
   }
 
-  auto ret = m_addressBuffer[static_cast<size_t>(m_trackPos.step)];
-  if (static_cast<size_t>(m_trackPos.step) >= c_addressFieldSize - 1)
-    Transition(&DiskController::DataPrologue);
-
-  std::stringstream stream;
-  stream << "DiskController::AddressData() track=" << static_cast<int>(m_currentTrack)
-         << " sector=" << static_cast<int>(c_dosOrder[m_trackPos.sectorIndex])
-         << " step=" << static_cast<int>(m_trackPos.step) << " returning " << std::hex << static_cast<int>(ret)
-         << std::dec << "\n";
-  LOG(stream.str());
-  return ret;
+  size_t position = m_nibblePos;
+  for (Byte& nibble : nibbles)
+  {
+    nibble = m_track[position];
+    position = position + 1 == c_trackSize ? 0 : position + 1;
+  }
+  return true;
 }
 
-Byte DiskController::DataPrologue() const
+void DiskController::writeDiskData(Byte nibble)
 {
-  static constexpr Byte prologue[] = {
-      0xDE, 0xAA, 0xEB,  // Data epliogue
-      0xFF, 0xFF, 0xFF, 0xFF, 0xFF,  // Sync bytes
-      0xD5, 0xAA, 0xAD  // Start of data field
-  };
-
-  std::stringstream stream;
-  stream << "DiskController::DataPrologue() step=" << static_cast<int>(m_trackPos.step) << " returning " << std::hex
-         << static_cast<int>(prologue[m_trackPos.step]) << std::dec << "\n";
-  LOG(stream.str());
+  if (m_image == nullptr || m_image->isWriteProtected() || (m_status & MotorMask) == 0)
+  {
+    return;
+  }
 
-  if (static_cast<size_t>(m_trackPos.step) >= std::size(prologue) - 1)
-    Transition(&DiskController::DataPayload);
+  int track = getCurrentTrack();
+  if (m_cachedTrack != track) [[unlikely]]
+  {
+    cacheTrack(track);
+  }
 
-  return prologue[m_trackPos.step];
+  m_track[m_nibblePos] = nibble;
+  m_trackDirty = true;
+  advanceHead();
 }
 
-Byte DiskController::DataPayload() const
+void DiskController::cacheTrack(int track) const
 {
-  // Return checksum (simplified for now)
-  Byte ret = 0xDE;
-
-  if (m_trackPos.step < 256)
+  if (m_trackDirty)
   {
-    std::stringstream stream;
-    stream << "DiskController::DataPayload() track=" << static_cast<int>(m_currentTrack)
-           << " sector=" << static_cast<int>(c_dosOrder[m_trackPos.sectorIndex])
-           << " step=" << static_cast<int>(m_trackPos.step) << " returning data byte\n";
-    LOG(stream.str());
-
-    // Return encoded sector data byte
-    ret = getEncodedSectorByte(m_currentTrack, c_dosOrder[m_trackPos.sectorIndex], m_trackPos.step);
+    decodeTrack();
   }
-
-  if (m_trackPos.step >= 259)  // 256 data + checksum
-    Transition(&DiskController::DataEpilogue);
-
-  return ret;
+  encodeTrack(track);
 }
 
-Byte DiskController::DataEpilogue() const
+void DiskController::encodeTrack(int track) const
 {
-  static constexpr Byte epilogue[] = {0xDE, 0xAA, 0xEB};
+  LOG(common::LogLevel::Minimal, "DiskController::encodeTrack(" << track << ")");
 
-  std::stringstream stream;
-  stream << "DiskController::DataEpilogue() step=" << static_cast<int>(m_trackPos.step) << " returning " << std::hex
-         << static_cast<int>(epilogue[m_trackPos.step]) << std::dec << "\n";
-  LOG(stream.str());
-
-  if (static_cast<size_t>(m_trackPos.step) >= std::size(epilogue) - 1)
-  {
-    // Move to next sector or end of track
-    m_trackPos.sectorIndex++;
-    if (m_trackPos.sectorIndex < 16)
-    {
-      Transition(&DiskController::AddressPrologue);
-    }
-    else
-    {
-      Transition(&DiskController::TrackGap);
-    }
-  }
-
-  return epilogue[m_trackPos.step];
+  m_image->readTrack(track, m_track);
+  m_cachedTrack = static_cast<Byte>(track);
 }
 
-Byte DiskController::TrackGap() const
+void DiskController::decodeTrack() const
 {
-  std::stringstream stream;
-  stream << "DiskController::TrackGap() step=" << static_cast<int>(m_trackPos.step) << " returning 0xFF\n";
-  LOG(stream.str());
+  LOG(common::LogLevel::Minimal, "DiskController::decodeTrack(" << static_cast<int>(m_cachedTrack) << ")");
 
-  if (m_trackPos.nibblePos >= 6656)  // Standard track size
-  {
-    m_trackPos = TrackPosition();  // Wrap to beginning of track
-    Transition(&DiskController::AddressPrologue);
-  }
-  return 0xFF;  // Fill rest of track
+  m_image->writeTrack(m_cachedTrack, m_track);
+  m_trackDirty = false;
 }
 
 }  // namespace apple2
@@ -0,0 +1,582 @@
+#include "apple2/disk_image.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define EMULATE_HAVE_MMAP 1
+#endif
+
+#include "common/logger.h"
+
+namespace apple2
+{
+using Common::Byte;
+
+namespace
+{
+
+// Sector sizes of a 16 sector disk: 256 bytes per sector, 342 six bit values per sector
+constexpr size_t c_sectorsPerTrack = 16;
+constexpr size_t c_sectorSize = 256;
+constexpr size_t c_auxSize = 86;
+constexpr size_t c_sectorTrackSize = c_sectorsPerTrack * c_sectorSize;
+constexpr size_t c_sectorImageSize = c_sectorTrackSize * DiskImage::c_maxTracks;
+constexpr size_t c_nibbleImageSize = DiskImage::c_trackSize * DiskImage::c_maxTracks;
+
+// The logical sector each physical sector holds, for DOS 3.3 and for ProDOS ordered images
+constexpr int c_dosOrder[] = {0, 7, 14, 6, 13, 5, 12, 4, 11, 3, 10, 2, 9, 1, 8, 15};
+constexpr int c_proDosOrder[] = {0, 8, 1, 9, 2, 10, 3, 11, 4, 12, 5, 13, 6, 14, 7, 15};
+
+// Sync bytes before the first sector, between the address and data fields, and after each sector.
+constexpr size_t c_gap1 = 48;
+constexpr size_t c_gap2 = 6;
+constexpr size_t c_gap3 = 27;
+
+constexpr Byte c_addressPrologue[] = {0xD5, 0xAA, 0x96};
+constexpr Byte c_dataPrologue[] = {0xD5, 0xAA, 0xAD};
+constexpr Byte c_epilogue[] = {0xDE, 0xAA, 0xEB};
+
+// The 64 disk bytes with the high bit set, no two adjacent zero bits and at least two adjacent one
+// bits, indexed by the six bit value they carry.
+constexpr std::array<Byte, 64> c_writeTranslate{0x96, 0x97, 0x9A, 0x9B, 0x9D, 0x9E, 0x9F, 0xA6, 0xA7, 0xAB, 0xAC,
+    0xAD, 0xAE, 0xAF, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF, 0xCB, 0xCD, 0xCE,
+    0xCF, 0xD3, 0xD6, 0xD7, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF, 0xE5, 0xE6, 0xE7, 0xE9, 0xEA, 0xEB, 0xEC, 0xED,
+    0xEE, 0xEF, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+
+// The inverse of c_writeTranslate, 0xFF for bytes that cannot appear in a data field.
+constexpr Byte c_invalidNibble = 0xFF;
+constexpr std::array<Byte, 256> c_readTranslate = []()
+{
+  std::array<Byte, 256> table{};
+  table.fill(c_invalidNibble);
+  for (size_t index = 0; index < c_writeTranslate.size(); ++index)
+  {
+    table[c_writeTranslate[index]] = static_cast<Byte>(index);
+  }
+  return table;
+}();
+
+// The two low bits of each byte go into the auxiliary buffer swapped.
+constexpr Byte c_swapBits[] = {0b00, 0b10, 0b01, 0b11};
+
+uint16_t encode4x4(Byte value) noexcept
+{
+  Byte even = value | 0b1010'1010;
+  Byte odd = ((value >> 1) | 0b1010'1010);
+  return static_cast<uint16_t>((static_cast<uint16_t>(even) << 8) | odd);
+}
+
+Byte decode4x4(Byte odd, Byte even) noexcept
+{
+  return static_cast<Byte>(((odd << 1) | 1) & even);
+}
+
+const int* sectorOrder(DiskImage::Format format) noexcept
+{
+  return format == DiskImage::Format::ProDos ? c_proDosOrder : c_dosOrder;
+}
+
+// Appends the 4-and-4 encoded address field of `sector` to `out`.
+Byte* encodeAddressField(Byte* out, int track, int sector) noexcept
+{
+  Byte volume = 254;
+  Byte checksum = static_cast<Byte>(volume ^ track ^ sector);
+
+  for (Byte value : {volume, static_cast<Byte>(track), static_cast<Byte>(sector), checksum})
+  {
+    auto word = encode4x4(value);
+    *out++ = static_cast<Byte>(word);
+    *out++ = static_cast<Byte>(word >> 8);
+  }
+  return out;
+}
+
+template<size_t N>
+Byte* append(Byte* out, const Byte (&bytes)[N]) noexcept
+{
+  return std::ranges::copy(bytes, out).out;
+}
+
+Byte* appendSync(Byte* out, size_t count) noexcept
+{
+  return std::fill_n(out, count, Byte{0xFF});
+}
+
+// Appends the 6-and-2 encoded data field body of `data`: 86 values holding the low two bits of each
+// byte, then the high six bits of each byte, each one XORed with the one before, and a checksum.
+Byte* encodeSector(Byte* out, std::span<const Byte, c_sectorSize> data) noexcept
+{
+  Byte last = 0;
+  auto put = [&out, &last](Byte value)
+  {
+    *out++ = c_writeTranslate[value ^ last];
+    last = value;
+  };
+
+  for (size_t index = 0; index < c_auxSize; ++index)
+  {
+    // The last two values only have two bytes to carry; the third pair of bits is unused.
+    put(static_cast<Byte>(c_swapBits[data[index] & 3] | (c_swapBits[data[index + c_auxSize] & 3] << 2) |
+                          (c_swapBits[data[(index + 2 * c_auxSize) % c_sectorSize] & 3] << 4)));
+  }
+  for (Byte value : data)
+  {
+    put(static_cast<Byte>(value >> 2));
+  }
+  *out++ = c_writeTranslate[last];
+  return out;
+}
+
+// Decodes the 343 nibbles at `in` into `data`. Returns false if a nibble is invalid or the checksum
+// does not match.
+bool decodeSector(const Byte* in, std::span<Byte, c_sectorSize> data) noexcept
+{
+  std::array<Byte, c_auxSize + c_sectorSize + 1> values{};
+  Byte last = 0;
+  for (Byte& value : values)
+  {
+    Byte decoded = c_readTranslate[*in++];
+    if (decoded == c_invalidNibble)
+    {
+      return false;
+    }
+    last ^= decoded;
+    value = last;
+  }
+  if (values.back() != 0)
+  {
+    return false;
+  }
+
+  for (size_t index = 0; index < c_sectorSize; ++index)
+  {
+    Byte aux = static_cast<Byte>(values[index % c_auxSize] >> (index / c_auxSize * 2));
+    data[index] = static_cast<Byte>((values[c_auxSize + index] << 2) | c_swapBits[aux & 3]);
+  }
+  return true;
+}
+
+// Fills `nibbles` with the 16 sectors of `sectors`, in physical order with the standard gaps.
+void encodeTrack(int track, std::span<const Byte> sectors, const int* order, DiskImage::Track nibbles) noexcept
+{
+  assert(sectors.size() == c_sectorTrackSize);
+  Byte* out = appendSync(nibbles.data(), c_gap1);
+  for (int sector = 0; sector < static_cast<int>(c_sectorsPerTrack); ++sector)
+  {
+    out = append(out, c_addressPrologue);
+    out = encodeAddressField(out, track, sector);
+    out = append(out, c_epilogue);
+    out = appendSync(out, c_gap2);
+
+    out = append(out, c_dataPrologue);
+    out = encodeSector(out, sectors.subspan(static_cast<size_t>(order[sector]) * c_sectorSize).first<c_sectorSize>());
+    out = append(out, c_epilogue);
+    out = appendSync(out, c_gap3);
+  }
+
+  // Fill to end of track
+  assert(out <= nibbles.data() + nibbles.size());
+  appendSync(out, static_cast<size_t>(nibbles.data() + nibbles.size() - out));
+}
+
+// Decodes every readable sector of `nibbles` into `sectors`.
+void decodeTrack(int track, std::span<const Byte, DiskImage::c_trackSize> nibbles, const int* order,
+    std::span<Byte> sectors) noexcept
+{
+  // Fields can wrap around the end of the track, so scan two turns of it.
+  std::vector<Byte> turns(2 * nibbles.size());
+  std::ranges::copy(nibbles, std::ranges::copy(nibbles, turns.begin()).out);
+
+  // Room for an address field, a data field and the sync bytes in between
+  constexpr size_t c_maxFieldGap = 64;
+  constexpr size_t c_dataFieldSize = std::size(c_dataPrologue) + c_auxSize + c_sectorSize + 1;
+
+  auto begin = turns.begin();
+  auto end = turns.end() - static_cast<ptrdiff_t>(c_dataFieldSize + c_maxFieldGap);
+  for (auto it = begin; it < begin + static_cast<ptrdiff_t>(nibbles.size()); ++it)
+  {
+    it = std::search(it, end, std::begin(c_addressPrologue), std::end(c_addressPrologue));
+    if (it >= begin + static_cast<ptrdiff_t>(nibbles.size()))
+    {
+      break;
+    }
+
+    auto field = it + std::size(c_addressPrologue);
+    Byte volume = decode4x4(field[0], field[1]);
+    Byte fieldTrack = decode4x4(field[2], field[3]);
+    Byte sector = decode4x4(field[4], field[5]);
+    Byte checksum = decode4x4(field[6], field[7]);
+    if ((volume ^ fieldTrack ^ sector) != checksum || fieldTrack != track || sector >= c_sectorsPerTrack)
+    {
+      continue;
+    }
+
+    auto data = std::search(field, field + c_maxFieldGap, std::begin(c_dataPrologue), std::end(c_dataPrologue));
+    if (data == field + c_maxFieldGap)
+    {
+      continue;
+    }
+
+    // Sectors that do not decode are left as they were.
+    std::array<Byte, c_sectorSize> decoded{};
+    if (decodeSector(&*(data + std::size(c_dataPrologue)), decoded))
+    {
+      std::ranges::copy(decoded, sectors.begin() + order[sector] * static_cast<ptrdiff_t>(c_sectorSize));
+    }
+  }
+}
+
+uint32_t readLe32(std::span<const Byte> bytes, size_t offset) noexcept
+{
+  return static_cast<uint32_t>(bytes[offset] | (bytes[offset + 1] << 8) | (bytes[offset + 2] << 16)) |
+         (static_cast<uint32_t>(bytes[offset + 3]) << 24);
+}
+
+uint16_t readLe16(std::span<const Byte> bytes, size_t offset) noexcept
+{
+  return static_cast<uint16_t>(bytes[offset] | (bytes[offset + 1] << 8));
+}
+
+constexpr Byte c_woz1Signature[] = {'W', 'O', 'Z', '1', 0xFF, 0x0A, 0x0D, 0x0A};
+constexpr Byte c_woz2Signature[] = {'W', 'O', 'Z', '2', 0xFF, 0x0A, 0x0D, 0x0A};
+constexpr size_t c_wozHeaderSize = 12;  // Signature and CRC
+constexpr size_t c_woz1TrackSize = 6656;  // Bit stream, then the byte and bit counts
+constexpr size_t c_woz1BitCountOffset = 6648;
+constexpr size_t c_woz2TrackEntrySize = 8;
+constexpr size_t c_wozBlockSize = 512;
+
+bool startsWith(std::span<const Byte> bytes, std::span<const Byte> prefix) noexcept
+{
+  return bytes.size() >= prefix.size() && std::equal(prefix.begin(), prefix.end(), bytes.begin());
+}
+
+// Offset of the data of chunk `id` in a WOZ image, or 0.
+size_t findWozChunk(std::span<const Byte> bytes, const char (&id)[5]) noexcept
+{
+  size_t offset = c_wozHeaderSize;
+  while (offset + 8 <= bytes.size())
+  {
+    uint32_t size = readLe32(bytes, offset + 4);
+    if (std::memcmp(bytes.data() + offset, id, 4) == 0)
+    {
+      return offset + 8 + size <= bytes.size() ? offset + 8 : 0;
+    }
+    offset += 8 + size;
+  }
+  return 0;
+}
+
+std::string lowerExtension(std::string_view filename)
+{
+  std::string extension = std::filesystem::path(filename).extension().string();
+  std::ranges::transform(extension, extension.begin(), [](char c) { return static_cast<char>(std::tolower(c)); });
+  return extension;
+}
+
+// A ProDOS volume directory key block: no previous block, the next one is block 3, and the storage
+// type of the first entry is $F.
+bool hasProDosVolume(std::span<const Byte> bytes) noexcept
+{
+  constexpr size_t c_volumeDirectory = 2 * 512;
+  return readLe16(bytes, c_volumeDirectory) == 0 && readLe16(bytes, c_volumeDirectory + 2) == 3 &&
+         (bytes[c_volumeDirectory + 4] & 0xF0) == 0xF0;
+}
+
+}  // namespace
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filename)
+{
+  static std::mutex mutex;
+  static std::map<std::string, std::weak_ptr<const MappedFile>> files;
+
+  std::error_code error;
+  auto path = std::filesystem::weakly_canonical(filename, error);
+  std::string key = error ? filename : path.string();
+
+  std::lock_guard lock{mutex};
+  if (auto found = files.find(key); found != files.end())
+  {
+    if (auto file = found->second.lock())
+    {
+      return file;
+    }
+  }
+  std::erase_if(files, [](const auto& entry) { return entry.second.expired(); });
+
+  std::shared_ptr<MappedFile> file{new MappedFile()};
+  file->m_filename = filename;
+
+#ifdef EMULATE_HAVE_MMAP
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  struct stat status{};
+  if (::fstat(fd, &status) == 0 && status.st_size > 0)
+  {
+    void* data = ::mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (data != MAP_FAILED)
+    {
+      file->m_data = static_cast<const Byte*>(data);
+      file->m_size = static_cast<size_t>(status.st_size);
+      file->m_mapped = true;
+    }
+  }
+  ::close(fd);
+#endif
+
+  if (!file->m_mapped)
+  {
+    std::ifstream stream(filename, std::ios::binary | std::ios::ate);
+    if (!stream)
+    {
+      return nullptr;
+    }
+    file->m_copy.resize(static_cast<size_t>(stream.tellg()));
+    stream.seekg(0);
+    stream.read(reinterpret_cast<char*>(file->m_copy.data()), static_cast<std::streamsize>(file->m_copy.size()));
+    file->m_data = file->m_copy.data();
+    file->m_size = file->m_copy.size();
+  }
+
+  files[key] = file;
+  return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef EMULATE_HAVE_MMAP
+  if (m_mapped)
+  {
+    ::munmap(const_cast<Byte*>(m_data), m_size);
+  }
+#endif
+}
+
+std::optional<DiskImage::Format> DiskImage::detectFormat(
+    std::span<const Byte> bytes, std::string_view filename) noexcept
+{
+  if (startsWith(bytes, c_woz1Signature) || startsWith(bytes, c_woz2Signature))
+  {
+    return Format::Woz;
+  }
+  if (bytes.size() == c_nibbleImageSize)
+  {
+    return Format::Nibble;
+  }
+  if (bytes.size() != c_sectorImageSize)
+  {
+    return std::nullopt;
+  }
+
+  std::string extension = lowerExtension(filename);
+  if (extension == ".po")
+  {
+    return Format::ProDos;
+  }
+  if (extension == ".do")
+  {
+    return Format::Dos;
+  }
+  return hasProDosVolume(bytes) ? Format::ProDos : Format::Dos;
+}
+
+std::unique_ptr<DiskImage> DiskImage::open(const std::string& filename, Writes writes)
+{
+  auto file = MappedFile::open(filename);
+  if (file == nullptr)
+  {
+    return nullptr;
+  }
+
+  auto format = detectFormat(file->bytes(), filename);
+  if (!format)
+  {
+    return nullptr;
+  }
+
+  LOG(common::LogLevel::Minimal, "DiskImage::open(\"" << filename << "\") format=" << static_cast<int>(*format));
+
+  bool writeProtected = *format == Format::Woz ||
+                        (writes == Writes::WriteBack &&
+                            !std::fstream(filename, std::ios::binary | std::ios::in | std::ios::out));
+  return std::unique_ptr<DiskImage>(new DiskImage(std::move(file), *format, writes, writeProtected));
+}
+
+DiskImage::DiskImage(std::shared_ptr<const MappedFile> file, Format format, Writes writes, bool writeProtected)
+  : m_file(std::move(file))
+  , m_format(format)
+  , m_writes(writes)
+  , m_writeProtected(writeProtected)
+{
+}
+
+size_t DiskImage::privateTracks() const noexcept
+{
+  return static_cast<size_t>(std::ranges::count_if(m_tracks, [](const auto& track) { return track != nullptr; }));
+}
+
+size_t DiskImage::storedTrackSize() const noexcept
+{
+  return m_format == Format::Dos || m_format == Format::ProDos ? c_sectorTrackSize : c_trackSize;
+}
+
+std::span<const Byte> DiskImage::storedTrack(int track) const noexcept
+{
+  assert(track >= 0 && track < c_maxTracks);
+  if (const auto& owned = m_tracks[static_cast<size_t>(track)])
+  {
+    return owned->bytes;
+  }
+  assert(m_format != Format::Woz);
+  return m_file->bytes().subspan(static_cast<size_t>(track) * storedTrackSize(), storedTrackSize());
+}
+
+void DiskImage::readTrack(int track, Track nibbles) const
+{
+  switch (m_format)
+  {
+    case Format::Dos:
+    case Format::ProDos: encodeTrack(track, storedTrack(track), sectorOrder(m_format), nibbles); return;
+    case Format::Woz:
+      if (m_tracks[static_cast<size_t>(track)] == nullptr)
+      {
+        readWozTrack(track, nibbles);
+        return;
+      }
+      [[fallthrough]];
+    case Format::Nibble: std::ranges::copy(storedTrack(track), nibbles.begin()); return;
+  }
+}
+
+void DiskImage::writeTrack(int track, std::span<const Byte, c_trackSize> nibbles)
+{
+  auto& owned = m_tracks[static_cast<size_t>(track)];
+  if (owned == nullptr)
+  {
+    owned = std::make_unique<PrivateTrack>();
+    if (m_format == Format::Woz)
+    {
+      owned->bytes.resize(c_trackSize);
+    }
+    else
+    {
+      auto stored = m_file->bytes().subspan(static_cast<size_t>(track) * storedTrackSize(), storedTrackSize());
+      owned->bytes.assign(stored.begin(), stored.end());
+    }
+  }
+
+  if (m_format == Format::Dos || m_format == Format::ProDos)
+  {
+    decodeTrack(track, nibbles, sectorOrder(m_format), owned->bytes);
+  }
+  else
+  {
+    std::ranges::copy(nibbles, owned->bytes.begin());
+  }
+  owned->dirty = m_format != Format::Woz;
+}
+
+bool DiskImage::flush()
+{
+  if (m_writes == Writes::Private ||
+      std::ranges::none_of(m_tracks, [](const auto& track) { return track != nullptr && track->dirty; }))
+  {
+    return true;
+  }
+
+  // Open for update so the rest of the file is kept.
+  std::fstream file(m_file->filename(), std::ios::binary | std::ios::in | std::ios::out);
+  if (!file)
+  {
+    return false;
+  }
+  for (size_t track = 0; track < m_tracks.size(); ++track)
+  {
+    auto& owned = m_tracks[track];
+    if (owned != nullptr && owned->dirty)
+    {
+      file.seekp(static_cast<std::streamoff>(track * storedTrackSize()));
+      auto size = static_cast<std::streamsize>(owned->bytes.size());
+      if (!file.write(reinterpret_cast<const char*>(owned->bytes.data()), size))
+      {
+        return false;
+      }
+      owned->dirty = false;
+    }
+  }
+  return file.flush().good();
+}
+
+void DiskImage::readWozTrack(int track, Track nibbles) const
+{
+  std::ranges::fill(nibbles, Byte{0xFF});
+
+  auto bytes = m_file->bytes();
+  size_t tmap = findWozChunk(bytes, "TMAP");
+  size_t trks = findWozChunk(bytes, "TRKS");
+  if (tmap == 0 || trks == 0)
+  {
+    return;
+  }
+
+  // The map has an entry per quarter track, 0xFF where there is no data.
+  Byte index = bytes[tmap + static_cast<size_t>(track) * 4];
+  if (index == 0xFF)
+  {
+    return;
+  }
+
+  std::span<const Byte> bits;
+  size_t bitCount = 0;
+  if (startsWith(bytes, c_woz1Signature))
+  {
+    size_t start = trks + index * c_woz1TrackSize;
+    if (start + c_woz1TrackSize > bytes.size())
+    {
+      return;
+    }
+    bits = bytes.subspan(start, c_woz1BitCountOffset);
+    bitCount = readLe16(bytes, start + c_woz1BitCountOffset);
+  }
+  else
+  {
+    size_t entry = trks + index * c_woz2TrackEntrySize;
+    size_t start = readLe16(bytes, entry) * c_wozBlockSize;
+    size_t size = readLe16(bytes, entry + 2) * c_wozBlockSize;
+    if (start + size > bytes.size())
+    {
+      return;
+    }
+    bits = bytes.subspan(start, size);
+    bitCount = readLe32(bytes, entry + 4);
+  }
+  bitCount = std::min(bitCount, bits.size() * 8);
+
+  // Shift bits in until the top bit is set, the way the disk controller's sequencer does.
+  size_t out = 0;
+  Byte latch = 0;
+  for (size_t bit = 0; bit < bitCount && out < nibbles.size(); ++bit)
+  {
+    latch = static_cast<Byte>((latch << 1) | ((bits[bit / 8] >> (7 - bit % 8)) & 1));
+    if (latch & 0x80)
+    {
+      nibbles[out++] = latch;
+      latch = 0;
+    }
+  }
+}
+
+}  // namespace apple2
@@ -0,0 +1,260 @@
+#include "apple2/fast_disk.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace apple2
+{
+
+namespace
+{
+
+using Common::Address;
+using Common::Byte;
+
+using Flag = cpu6502::Registers::Flag;
+
+constexpr int16_t c_any = -1;
+
+// READ16 with its operands left open. The Q6L reads ($C08C,X) and the loops are fixed, the buffers,
+// the table and the error and exit branches are wherever the DOS was assembled to.
+constexpr std::array<int16_t, 0x67> c_read16{
+    0xA0, 0x20,  // 00 LDY #$20
+    0x88,  // 02 RSYNC DEY
+    0xF0, c_any,  // 03 BEQ RDERR
+    0xBD, 0x8C, 0xC0, 0x10, 0xFB,  // 05 LDA Q6L,X; BPL *-3
+    0x49, 0xD5,  // 0A RSYNC1 EOR #$D5
+    0xD0, 0xF4,  // 0C BNE RSYNC
+    0xEA,  // 0E NOP
+    0xBD, 0x8C, 0xC0, 0x10, 0xFB,  // 0F LDA Q6L,X; BPL *-3
+    0xC9, 0xAA,  // 14 CMP #$AA
+    0xD0, 0xF2,  // 16 BNE RSYNC1
+    0xA0, 0x56,  // 18 LDY #$56
+    0xBD, 0x8C, 0xC0, 0x10, 0xFB,  // 1A LDA Q6L,X; BPL *-3
+    0xC9, 0xAD,  // 1F CMP #$AD
+    0xD0, 0xE7,  // 21 BNE RSYNC1
+    0xA9, 0x00,  // 23 LDA #0
+    0x88,  // 25 RD16.1 DEY
+    0x84, c_any,  // 26 STY IDX
+    0xBC, 0x8C, 0xC0, 0x10, 0xFB,  // 28 LDY Q6L,X; BPL *-3
+    0x59, c_any, c_any,  // 2D EOR DNIBL,Y
+    0xA4, c_any,  // 30 LDY IDX
+    0x99, c_any, c_any,  // 32 STA NBUF2,Y
+    0xD0, 0xEE,  // 35 BNE RD16.1
+    0x84, c_any,  // 37 RD16.3 STY IDX
+    0xBC, 0x8C, 0xC0, 0x10, 0xFB,  // 39 LDY Q6L,X; BPL *-3
+    0x59, c_any, c_any,  // 3E EOR DNIBL,Y
+    0xA4, c_any,  // 41 LDY IDX
+    0x91, c_any,  // 43 STA (BUF),Y
+    0xC8,  // 45 INY
+    0xD0, 0xEF,  // 46 BNE RD16.3
+    0xBC, 0x8C, 0xC0, 0x10, 0xFB,  // 48 LDY Q6L,X; BPL *-3
+    0xD9, c_any, c_any,  // 4D CMP DNIBL,Y
+    0xD0, c_any,  // 50 BNE RDERR
+    0xBD, 0x8C, 0xC0, 0x10, 0xFB,  // 52 LDA Q6L,X; BPL *-3
+    0xC9, 0xDE,  // 57 CMP #$DE
+    0xD0, c_any,  // 59 BNE RDERR
+    0xEA,  // 5B NOP
+    0xBD, 0x8C, 0xC0, 0x10, 0xFB,  // 5C LDA Q6L,X; BPL *-3
+    0xC9, 0xAA,  // 61 CMP #$AA
+    0xF0, c_any,  // 63 BEQ RDEXIT
+    0x38,  // 65 RDERR SEC
+    0x60,  // 66 RTS
+};
+
+constexpr size_t c_error = 0x65;
+
+// The slot 6 data register, which the routine reads as Q6L,X.
+constexpr uint16_t c_q6l = 0xC08C;
+constexpr uint16_t c_slot6DataRegister = 0xC0EC;
+
+constexpr size_t c_searchLimit = 0x20;
+constexpr size_t c_searchAfterSync = 0x56;
+constexpr size_t c_auxValues = 86;
+constexpr size_t c_mainValues = 256;
+
+// Nibbles looked at: a generous search, the prologue, the data field, the checksum and the epilogue.
+constexpr size_t c_window = 1024;
+
+Address branchTarget(Address branch, Byte offset) noexcept
+{
+  return Address{static_cast<uint16_t>(static_cast<int32_t>(branch) + 2 + static_cast<int8_t>(offset))};
+}
+
+Address operandAt(const std::array<Byte, c_read16.size()>& code, size_t offset) noexcept
+{
+  return Common::MakeAddress(code[offset], code[offset + 1]);
+}
+
+}  // namespace
+
+std::optional<DiskReadRoutine> findDiskReadRoutine(Address pc, const Common::Bus& bus) noexcept
+{
+  std::array<Byte, c_read16.size()> code{};
+  for (size_t i = 0; i < code.size(); ++i)
+  {
+    auto byte = bus.peek(pc + static_cast<uint16_t>(i));
+    if (!byte || (c_read16[i] != c_any && c_read16[i] != *byte))
+    {
+      return std::nullopt;
+    }
+    code[i] = *byte;
+  }
+
+  // The same index, table and error exit everywhere.
+  Address translate = operandAt(code, 0x2E);
+  Address error = pc + static_cast<uint16_t>(c_error);
+  if (code[0x31] != code[0x27] || code[0x38] != code[0x27] || code[0x42] != code[0x27] ||
+      operandAt(code, 0x3F) != translate || operandAt(code, 0x4E) != translate ||
+      branchTarget(pc + 0x03, code[0x04]) != error || branchTarget(pc + 0x50, code[0x51]) != error ||
+      branchTarget(pc + 0x59, code[0x5A]) != error)
+  {
+    return std::nullopt;
+  }
+
+  // The success exit has to be CLC; RTS for the registers to be known.
+  Address exit = branchTarget(pc + 0x63, code[0x64]);
+  if (bus.peek(exit) != Byte{0x18} || bus.peek(exit + 1) != Byte{0x60})
+  {
+    return std::nullopt;
+  }
+
+  return DiskReadRoutine{pc, code[0x27], code[0x44], operandAt(code, 0x33), translate};
+}
+
+std::optional<DiskReadRoutine> scanForDiskReadRoutine(const Common::Bus& bus, Address begin, Address end) noexcept
+{
+  for (Address pc = begin; pc < end; ++pc)
+  {
+    // Most addresses fail on the first byte, check it before reading the rest.
+    if (bus.peek(pc) == Byte{0xA0})
+    {
+      if (auto routine = findDiskReadRoutine(pc, bus))
+      {
+        return routine;
+      }
+    }
+  }
+  return std::nullopt;
+}
+
+bool readSectorFast(
+    const DiskReadRoutine& routine, cpu6502::Registers& cpu, const DiskController& disk, Common::Bus& bus) noexcept
+{
+  if (c_q6l + cpu.x != c_slot6DataRegister)
+  {
+    return false;
+  }
+
+  std::array<Byte, c_window> nibbles{};
+  if (!disk.peekNibbles(nibbles))
+  {
+    return false;
+  }
+
+  std::array<Byte, 256> translate{};
+  for (size_t i = 0; i < translate.size(); ++i)
+  {
+    auto value = bus.peek(routine.translate + static_cast<uint16_t>(i));
+    if (!value)
+    {
+      return false;
+    }
+    translate[i] = *value;
+  }
+
+  size_t position = 0;
+  auto next = [&nibbles, &position]() -> std::optional<Byte>
+  {
+    if (position == nibbles.size())
+    {
+      return std::nullopt;
+    }
+    return nibbles[position++];
+  };
+
+  // The prologue search: Y counts the bytes that are not $D5, a $D5 followed by the wrong byte starts
+  // over with that byte. Y is loaded with $56 once D5 AA is seen, so an address field prologue gives
+  // the search more time.
+  std::optional<Byte> nibble;
+  size_t tries = c_searchLimit;
+  bool found = false;
+  while (!found)
+  {
+    if (--tries == 0 || !(nibble = next()))
+    {
+      return false;
+    }
+    while (!found && *nibble == 0xD5)
+    {
+      if (!(nibble = next()))
+      {
+        return false;
+      }
+      if (*nibble != 0xAA)
+      {
+        continue;
+      }
+      tries = c_searchAfterSync;
+      if (!(nibble = next()))
+      {
+        return false;
+      }
+      found = *nibble == 0xAD;
+    }
+  }
+
+  // The auxiliary values go into the buffer from the top down, then the main values bottom up.
+  std::array<Byte, c_auxValues + c_mainValues> values{};
+  Byte a = 0;
+  for (size_t i = 0; i < values.size(); ++i)
+  {
+    if (!(nibble = next()))
+    {
+      return false;
+    }
+    a ^= translate[*nibble];
+    values[i] = a;
+  }
+
+  auto checksum = next();
+  auto epilogue0 = next();
+  auto epilogue1 = next();
+  if (!checksum || translate[*checksum] != a || epilogue0 != Byte{0xDE} || epilogue1 != Byte{0xAA})
+  {
+    return false;
+  }
+
+  // Zero page and the stack are plain RAM, reading them has no side effects.
+  Byte returnLow = bus.read(Address{static_cast<uint16_t>(0x100 + static_cast<Byte>(cpu.sp + 1))});
+  Byte returnHigh = bus.read(Address{static_cast<uint16_t>(0x100 + static_cast<Byte>(cpu.sp + 2))});
+  Address buffer =
+      Common::MakeAddress(bus.read(Address{routine.buffer}), bus.read(Address{static_cast<Byte>(routine.buffer + 1)}));
+
+  disk.skipNibbles(position);
+  for (size_t i = 0; i < c_auxValues; ++i)
+  {
+    bus.write(routine.auxBuffer + static_cast<uint16_t>(c_auxValues - 1 - i), values[i]);
+  }
+  for (size_t i = 0; i < c_mainValues; ++i)
+  {
+    bus.write(buffer + static_cast<uint16_t>(i), values[c_auxValues + i]);
+  }
+  bus.write(Address{routine.index}, 0xFF);
+
+  // CMP #$AA matched, then CLC; RTS.
+  cpu.a = 0xAA;
+  cpu.y = *checksum;
+  cpu.p = static_cast<Byte>((cpu.p & ~(static_cast<Byte>(Flag::Negative) | static_cast<Byte>(Flag::Carry))) |
+                            static_cast<Byte>(Flag::Zero));
+  cpu.sp = static_cast<Byte>(cpu.sp + 2);
+  cpu.pc = Common::MakeAddress(returnLow, returnHigh) + 1;
+  return true;
+}
+
+}  // namespace apple2
@@ -0,0 +1,189 @@
+#include "apple2/fleet.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+namespace apple2
+{
+
+Apple2Fleet::Apple2Fleet(size_t threads, uint64_t sliceCycles)
+  : m_sliceCycles(sliceCycles)
+{
+  if (sliceCycles == 0)
+  {
+    throw std::invalid_argument("A fleet slice has to be at least one cycle");
+  }
+  threads = std::max<size_t>(threads, 1);
+  for (size_t worker = 0; worker < threads; ++worker)
+  {
+    m_queues.push_back(std::make_unique<WorkQueue>());
+  }
+  for (size_t worker = 0; worker < threads; ++worker)
+  {
+    m_workers.emplace_back([this, worker](std::stop_token stop) { work(stop, worker); });
+  }
+}
+
+Apple2Fleet::~Apple2Fleet()
+{
+  for (auto& worker : m_workers)
+  {
+    worker.request_stop();
+  }
+  m_started.notify_all();
+  m_workers.clear();
+}
+
+Apple2Fleet::Id Apple2Fleet::add(std::unique_ptr<Apple2System> system)
+{
+  auto instance = std::make_unique<Instance>();
+  instance->system = std::move(system);
+  m_instances.push_back(std::move(instance));
+  return m_instances.size() - 1;
+}
+
+void Apple2Fleet::pressKey(Id id, char c)
+{
+  Instance& instance = *m_instances[id];
+  std::lock_guard lock{instance.keysMutex};
+  instance.keys += c;
+  instance.hasKeys.store(true, std::memory_order_release);
+}
+
+void Apple2Fleet::runSlices(size_t slices)
+{
+  for (size_t slice = 0; slice < slices; ++slice)
+  {
+    // Deal the runnable machines out round robin, neighbours go to different workers. A worker still
+    // taking work from the last slice can run a machine as soon as it is queued, so the dealing holds
+    // m_mutex: its completion has to wait until m_remaining counts it.
+    std::unique_lock lock{m_mutex};
+    size_t dealt = 0;
+    for (Id id = 0; id < m_instances.size(); ++id)
+    {
+      if (isRunnable(*m_instances[id]))
+      {
+        WorkQueue& queue = *m_queues[dealt++ % m_queues.size()];
+        std::lock_guard queueLock{queue.mutex};
+        queue.ids.push_back(id);
+      }
+    }
+    if (dealt == 0)
+    {
+      return;
+    }
+
+    m_remaining = dealt;
+    ++m_generation;
+    m_started.notify_all();
+    m_finished.wait(lock, [this] { return m_remaining == 0; });
+  }
+}
+
+Apple2Fleet::InstanceStats Apple2Fleet::stats(Id id) const
+{
+  const Instance& instance = *m_instances[id];
+  return InstanceStats{instance.cycles, instance.busy, !isRunnable(instance), instance.trap};
+}
+
+size_t Apple2Fleet::parked() const
+{
+  return static_cast<size_t>(
+      std::ranges::count_if(m_instances, [this](const auto& instance) { return !isRunnable(*instance); }));
+}
+
+bool Apple2Fleet::isRunnable(const Instance& instance) const noexcept
+{
+  return !instance.idle && !instance.trap &&
+         (!instance.waitingForKey || instance.hasKeys.load(std::memory_order_acquire));
+}
+
+void Apple2Fleet::runSlice(Instance& instance)
+{
+  Apple2System& system = *instance.system;
+  if (instance.hasKeys.exchange(false, std::memory_order_acquire))
+  {
+    std::lock_guard lock{instance.keysMutex};
+    size_t typed = system.typeText(instance.keys);
+    instance.keys.erase(0, typed);
+    if (!instance.keys.empty())
+    {
+      // The machine's buffer is full, the rest waits for the next slice.
+      instance.hasKeys.store(true, std::memory_order_release);
+    }
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t before = system.cycles();
+  try
+  {
+    static_cast<void>(system.runSliceRepaying(m_sliceCycles, instance.overshoot));
+  }
+  catch (const Apple2System::Processor::TrapException& e)
+  {
+    instance.trap = e.address();
+  }
+  instance.busy += std::chrono::steady_clock::now() - start;
+  instance.cycles += system.cycles() - before;
+  instance.waitingForKey = system.isWaitingForKey();
+}
+
+std::optional<Apple2Fleet::Id> Apple2Fleet::takeWork(size_t worker)
+{
+  {
+    WorkQueue& own = *m_queues[worker];
+    std::lock_guard lock{own.mutex};
+    if (!own.ids.empty())
+    {
+      Id id = own.ids.back();
+      own.ids.pop_back();
+      return id;
+    }
+  }
+
+  for (size_t offset = 1; offset < m_queues.size(); ++offset)
+  {
+    WorkQueue& victim = *m_queues[(worker + offset) % m_queues.size()];
+    std::lock_guard lock{victim.mutex};
+    if (!victim.ids.empty())
+    {
+      Id id = victim.ids.front();
+      victim.ids.pop_front();
+      return id;
+    }
+  }
+  return std::nullopt;
+}
+
+void Apple2Fleet::work(std::stop_token stop, size_t worker)
+{
+  uint64_t generation = 0;
+  while (true)
+  {
+    {
+      std::unique_lock lock{m_mutex};
+      if (!m_started.wait(lock, stop, [this, generation] { return m_generation != generation; }))
+      {
+        return;
+      }
+      generation = m_generation;
+    }
+
+    while (auto id = takeWork(worker))
+    {
+      runSlice(*m_instances[*id]);
+
+      std::lock_guard lock{m_mutex};
+      if (--m_remaining == 0)
+      {
+        m_finished.notify_one();
+      }
+    }
+  }
+}
+
+}  // namespace apple2
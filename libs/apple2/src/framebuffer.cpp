@@ -0,0 +1,144 @@
+#include "apple2/framebuffer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+namespace apple2
+{
+
+namespace
+{
+
+using Common::Byte;
+using Pixel = Framebuffer::Pixel;
+using Pixels = std::array<Pixel, 7>;
+
+constexpr Pixel c_black = 0;
+constexpr Pixel c_white = 15;
+
+// Lone dots show a color that depends on the column and on the byte's high bit.
+constexpr Pixel c_purple = 3;
+constexpr Pixel c_green = 12;
+constexpr Pixel c_blue = 6;
+constexpr Pixel c_orange = 9;
+
+// The offset of the first byte of a text row, and of the first scanline of a graphics block.
+constexpr size_t rowOffset(size_t row) noexcept
+{
+  return (row % 8) * 0x80 + (row / 8) * 0x28;
+}
+
+// The 7 pixels of a hi-res byte, by the byte, the last dot before it, the first dot after it and
+// whether it starts in an odd column. Two dots next to each other are white.
+constexpr size_t hiResIndex(Byte byte, bool previous, bool next, bool odd) noexcept
+{
+  return (((static_cast<size_t>(byte) << 1 | previous) << 1 | next) << 1) | odd;
+}
+
+constexpr std::array<Pixels, 256 * 8> c_hiResPixels = []()
+{
+  std::array<Pixels, 256 * 8> table{};
+  for (size_t index = 0; index < table.size(); ++index)
+  {
+    bool odd = (index & 1) != 0;
+    bool next = (index & 2) != 0;
+    bool previous = (index & 4) != 0;
+    size_t byte = index >> 3;
+    bool shifted = (byte & 0x80) != 0;
+
+    auto dot = [byte, previous, next](int bit)
+    { return bit < 0 ? previous : bit > 6 ? next : ((byte >> bit) & 1) != 0; };
+    for (int bit = 0; bit < 7; ++bit)
+    {
+      Pixel pixel = c_black;
+      if (dot(bit))
+      {
+        bool oddColumn = odd != ((bit & 1) != 0);
+        pixel = dot(bit - 1) || dot(bit + 1) ? c_white
+                : oddColumn                 ? (shifted ? c_orange : c_green)
+                                            : (shifted ? c_blue : c_purple);
+      }
+      table[index][static_cast<size_t>(bit)] = pixel;
+    }
+  }
+  return table;
+}();
+
+}  // namespace
+
+Framebuffer::RowMask Framebuffer::update(const VideoMode& mode, RowMask dirty,
+    std::span<const Byte, TextVideoDevice::c_size> textPage, std::span<const Byte, HiResVideoDevice::c_size> hiResPage)
+{
+  RowMask graphics = mode.graphicsBlocks();
+  RowMask converted = dirty & graphics;
+  if (!m_valid || mode != m_mode)
+  {
+    converted = TextVideoDevice::c_allRows;
+    m_mode = mode;
+    m_valid = true;
+  }
+
+  for (size_t block = 0; block < c_blocks; ++block)
+  {
+    if ((converted & (RowMask{1} << block)) == 0)
+    {
+      continue;
+    }
+    if ((graphics & (RowMask{1} << block)) == 0)
+    {
+      clear(block);
+    }
+    else if (mode.hiRes)
+    {
+      convertHiRes(block, hiResPage);
+    }
+    else
+    {
+      convertLoRes(block, textPage);
+    }
+  }
+  return converted;
+}
+
+void Framebuffer::convertLoRes(size_t block, std::span<const Byte, TextVideoDevice::c_size> page) noexcept
+{
+  // Each byte is two blocks of 7x4 pixels, the low nibble on top.
+  const Byte* row = page.data() + rowOffset(block);
+  Pixel* out = m_pixels.data() + block * c_blockHeight * c_width;
+  for (size_t line = 0; line < c_blockHeight; ++line)
+  {
+    int shift = line < c_blockHeight / 2 ? 0 : 4;
+    for (size_t column = 0; column < 40; ++column)
+    {
+      std::fill_n(out + column * 7, 7, static_cast<Pixel>((row[column] >> shift) & 0x0F));
+    }
+    out += c_width;
+  }
+}
+
+void Framebuffer::convertHiRes(size_t block, std::span<const Byte, HiResVideoDevice::c_size> page) noexcept
+{
+  Pixel* out = m_pixels.data() + block * c_blockHeight * c_width;
+  for (size_t line = 0; line < c_blockHeight; ++line)
+  {
+    const Byte* scanline = page.data() + line * 0x400 + rowOffset(block);
+    bool previous = false;
+    for (size_t column = 0; column < 40; ++column)
+    {
+      bool next = column + 1 < 40 && (scanline[column + 1] & 1) != 0;
+      const Pixels& pixels = c_hiResPixels[hiResIndex(scanline[column], previous, next, (column & 1) != 0)];
+      std::ranges::copy(pixels, out + column * 7);
+      previous = (scanline[column] & 0x40) != 0;
+    }
+    out += c_width;
+  }
+}
+
+void Framebuffer::clear(size_t block) noexcept
+{
+  std::fill_n(m_pixels.begin() + static_cast<std::ptrdiff_t>(block * c_blockHeight * c_width),
+      c_blockHeight * c_width, c_black);
+}
+
+}  // namespace apple2
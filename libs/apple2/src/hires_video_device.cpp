@@ -0,0 +1,29 @@
+#include "apple2/hires_video_device.h"
+
+namespace apple2
+{
+
+Common::Byte HiResVideoDevice::read(Address /*address*/, Address normalizedAddress) const
+{
+  size_t index = static_cast<size_t>(normalizedAddress);
+  if (index < m_videoMemory.size())
+  {
+    return m_videoMemory[index];
+  }
+  return 0;
+}
+
+void HiResVideoDevice::write(Address /*address*/, Address normalizedAddress, Byte value)
+{
+  size_t index = static_cast<size_t>(normalizedAddress);
+  if (index < m_videoMemory.size() && m_videoMemory[index] != value)
+  {
+    m_videoMemory[index] = value;
+    if (auto block = blockAt(index))
+    {
+      m_dirtyBlocks |= RowMask{1} << *block;
+    }
+  }
+}
+
+}  // namespace apple2
@@ -0,0 +1,150 @@
+#include "apple2/idle_loop.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace apple2
+{
+
+namespace
+{
+
+using Common::Address;
+using Common::Byte;
+
+constexpr Byte c_lda{0xAD};
+constexpr Byte c_ldx{0xAE};
+constexpr Byte c_ldy{0xAC};
+constexpr Byte c_bit{0x2C};
+constexpr Byte c_incZeroPage{0xE6};
+constexpr Byte c_dex{0xCA};
+constexpr Byte c_dey{0x88};
+constexpr Byte c_sbcImmediate{0xE9};
+constexpr Byte c_bpl{0x10};
+constexpr Byte c_bne{0xD0};
+
+constexpr Address c_keyboard{0xC000};
+
+//! Reads `Size` bytes of code starting at `pc`, or nothing if any of them cannot be peeked.
+template<size_t Size>
+std::optional<std::array<Byte, Size>> peekCode(Address pc, const Common::Bus& bus) noexcept
+{
+  std::array<Byte, Size> code{};
+  for (size_t i = 0; i < Size; ++i)
+  {
+    auto byte = bus.peek(pc + static_cast<uint16_t>(i));
+    if (!byte)
+    {
+      return std::nullopt;
+    }
+    code[i] = *byte;
+  }
+  return code;
+}
+
+//! Cycles for a taken branch at `branch`, one more if the target is on another page.
+uint32_t branchTakenCycles(Address branch, Address target) noexcept
+{
+  Address next = branch + 2;
+  return HiByte(next) == HiByte(target) ? 3 : 4;
+}
+
+//! True if the relative branch at `branch` jumps to `target`.
+bool branchesTo(Address branch, Byte offset, Address target) noexcept
+{
+  auto destination = static_cast<uint16_t>(static_cast<int32_t>(branch) + 2 + static_cast<int8_t>(offset));
+  return Address{destination} == target;
+}
+
+//! Recognizes an idle loop that starts at `pc`.
+std::optional<IdleLoop> matchIdleLoop(Address pc, const Common::Bus& bus) noexcept
+{
+  auto code = peekCode<9>(pc, bus);
+  if (!code)
+  {
+    return std::nullopt;
+  }
+  const auto& c = *code;
+
+  // LDA/LDX/LDY/BIT $C000; BPL pc
+  if ((c[0] == c_lda || c[0] == c_ldx || c[0] == c_ldy || c[0] == c_bit) &&
+      Common::MakeAddress(c[1], c[2]) == c_keyboard && c[3] == c_bpl && branchesTo(pc + 3, c[4], pc))
+  {
+    return IdleLoop{IdleLoop::Kind::KeyboardPoll, pc, c[0], 0, 4 + branchTakenCycles(pc + 3, pc), 0};
+  }
+
+  // INC zp; BNE +2; INC zp+1; BIT $C000; BPL pc
+  if (c[0] == c_incZeroPage && c[2] == c_bne && c[3] == 0x02 && c[4] == c_incZeroPage &&
+      c[5] == static_cast<Byte>(c[1] + 1) && c[6] == c_bit && Common::MakeAddress(c[7], c[8]) == c_keyboard)
+  {
+    auto tail = peekCode<2>(pc + 9, bus);
+    if (tail && (*tail)[0] == c_bpl && branchesTo(pc + 9, (*tail)[1], pc))
+    {
+      uint32_t loop = 4 + branchTakenCycles(pc + 9, pc);  // BIT and BPL
+      return IdleLoop{IdleLoop::Kind::KeyboardPollCounting, pc, 0, c[1],
+          5 + branchTakenCycles(pc + 2, pc + 6) + loop, 5 + 2 + 5 + loop};
+    }
+  }
+
+  // DEX/DEY; BNE pc
+  if ((c[0] == c_dex || c[0] == c_dey) && c[1] == c_bne && branchesTo(pc + 1, c[2], pc))
+  {
+    auto kind = c[0] == c_dex ? IdleLoop::Kind::CountdownX : IdleLoop::Kind::CountdownY;
+    return IdleLoop{kind, pc, c[0], 0, 2 + branchTakenCycles(pc + 1, pc), 0};
+  }
+
+  // SBC #$01; BNE pc
+  if (c[0] == c_sbcImmediate && c[1] == 0x01 && c[2] == c_bne && branchesTo(pc + 2, c[3], pc))
+  {
+    return IdleLoop{IdleLoop::Kind::CountdownA, pc, c[0], 0, 2 + branchTakenCycles(pc + 2, pc), 0};
+  }
+
+  return std::nullopt;
+}
+
+//! Offsets of the instructions of each kind of loop from its start.
+std::span<const uint16_t> instructionOffsets(IdleLoop::Kind kind) noexcept
+{
+  static constexpr std::array<uint16_t, 2> c_poll{0, 3};
+  static constexpr std::array<uint16_t, 5> c_pollCounting{0, 2, 4, 6, 9};
+  static constexpr std::array<uint16_t, 2> c_countdown{0, 1};
+  static constexpr std::array<uint16_t, 2> c_countdownA{0, 2};
+
+  switch (kind)
+  {
+    case IdleLoop::Kind::KeyboardPoll:
+      return c_poll;
+    case IdleLoop::Kind::KeyboardPollCounting:
+      return c_pollCounting;
+    case IdleLoop::Kind::CountdownX:
+    case IdleLoop::Kind::CountdownY:
+      return c_countdown;
+    case IdleLoop::Kind::CountdownA:
+      return c_countdownA;
+  }
+  return {};
+}
+
+}  // namespace
+
+std::optional<IdleLoop> findIdleLoop(Address pc, const Common::Bus& bus) noexcept
+{
+  for (uint16_t offset : std::array<uint16_t, 7>{0, 1, 2, 3, 4, 6, 9})
+  {
+    auto loop = matchIdleLoop(pc - offset, bus);
+    if (loop && std::ranges::find(instructionOffsets(loop->kind), offset) != instructionOffsets(loop->kind).end())
+    {
+      return loop;
+    }
+  }
+  return std::nullopt;
+}
+
+}  // namespace apple2
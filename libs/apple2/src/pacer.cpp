@@ -0,0 +1,58 @@
+#include "apple2/pacer.h"
+
+#include <chrono>
+#include <thread>
+
+namespace apple2
+{
+
+namespace
+{
+
+// Sleeping can overshoot by the scheduler's granularity, so the last stretch is waited out by
+// yielding instead.
+constexpr std::chrono::microseconds c_spinTime{500};
+
+}  // namespace
+
+Pacer::Pacer(Mode mode, double speed) noexcept
+{
+  setMode(mode, speed);
+}
+
+void Pacer::setMode(Mode mode, double speed) noexcept
+{
+  m_mode = mode;
+  m_cyclesPerSecond = c_cpuHz * (mode == Mode::Multiple ? speed : 1.0);
+  reset();
+}
+
+void Pacer::reset() noexcept
+{
+  m_start = Clock::now();
+  m_cycles = 0;
+}
+
+void Pacer::waitForCycles()
+{
+  auto due = m_start + std::chrono::duration_cast<Clock::duration>(
+                           std::chrono::duration<double>(static_cast<double>(m_cycles) / m_cyclesPerSecond));
+  auto now = Clock::now();
+  if (now > due + c_maxLag)
+  {
+    ++m_resyncs;
+    reset();
+    return;
+  }
+
+  if (due - now > c_spinTime)
+  {
+    std::this_thread::sleep_until(due - c_spinTime);
+  }
+  while (Clock::now() < due)
+  {
+    std::this_thread::yield();
+  }
+}
+
+}  // namespace apple2
@@ -0,0 +1,116 @@
+#include "apple2/speaker.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <numbers>
+
+namespace apple2
+{
+
+namespace
+{
+
+// Steps start between two samples at one of this many positions.
+constexpr size_t c_phases = 32;
+
+// Share of the sample rate the steps are band-limited to, a little below Nyquist.
+constexpr double c_cutoff = 0.45;
+
+// The high-pass pole, which takes the level back to zero with a time constant of 1000 samples.
+constexpr float c_highPass = 0.999f;
+
+constexpr float c_volume = 0.3f * 32767.0f;
+
+using Kernel = std::array<std::array<float, Speaker::c_width>, c_phases>;
+
+// A windowed sinc pulse per phase, each adding up to one, so a step drawn with it ends up exactly one
+// higher once it has been integrated.
+const Kernel c_kernel = []()
+{
+  constexpr double c_half = Speaker::c_width / 2.0;
+  Kernel kernel{};
+  for (size_t phase = 0; phase < c_phases; ++phase)
+  {
+    double sum = 0;
+    for (size_t tap = 0; tap < Speaker::c_width; ++tap)
+    {
+      double x = static_cast<double>(tap) + 1.0 - c_half - static_cast<double>(phase) / c_phases;
+      double angle = 2 * std::numbers::pi * c_cutoff * x;
+      double sinc = x == 0 ? 1.0 : std::sin(angle) / angle;
+      double window = 0.42 + 0.5 * std::cos(std::numbers::pi * x / c_half) +
+                      0.08 * std::cos(2 * std::numbers::pi * x / c_half);  // Blackman
+      kernel[phase][tap] = static_cast<float>(sinc * window);
+      sum += sinc * window;
+    }
+    for (float& tap : kernel[phase])
+    {
+      tap = static_cast<float>(static_cast<double>(tap) / sum);
+    }
+  }
+  return kernel;
+}();
+
+}  // namespace
+
+Speaker::Speaker(double sampleRate, double cpuHz)
+  : m_sampleRate(sampleRate)
+  , m_samplesPerCycle(sampleRate / cpuHz)
+  , m_toggles(c_capacity)
+  , m_deltas(c_width)
+{
+}
+
+void Speaker::synthesize(uint64_t cycle)
+{
+  size_t count = static_cast<size_t>(std::max(samplePosition(cycle), 0.0));
+  m_deltas.resize(std::max(m_deltas.size(), count + c_width), 0.0f);
+
+  for (uint64_t toggle : pendingToggles())
+  {
+    double position = std::max(samplePosition(toggle), 0.0);
+    auto index = static_cast<size_t>(position);
+    auto phase = std::min(static_cast<size_t>((position - static_cast<double>(index)) * c_phases), c_phases - 1);
+    if (index + c_width > m_deltas.size())
+    {
+      m_deltas.resize(index + c_width, 0.0f);
+    }
+
+    float step = m_high ? -1.0f : 1.0f;
+    m_high = !m_high;
+    const auto& taps = c_kernel[phase];
+    for (size_t tap = 0; tap < c_width; ++tap)
+    {
+      m_deltas[index + tap] += step * taps[tap];
+    }
+  }
+  m_count = 0;
+
+  m_samples.resize(count);
+  for (size_t index = 0; index < count; ++index)
+  {
+    float level = m_level + m_deltas[index];
+    m_filtered = level - m_level + c_highPass * m_filtered;
+    m_level = level;
+    m_samples[index] = static_cast<Sample>(std::clamp(m_filtered * c_volume, -32768.0f, 32767.0f));
+  }
+
+  // Keep the tails of the last steps for the next call.
+  m_deltas.erase(m_deltas.begin(), m_deltas.begin() + static_cast<std::ptrdiff_t>(count));
+  m_emitted += static_cast<double>(count);
+
+  if (m_output && count != 0)
+  {
+    m_output(m_samples);
+  }
+}
+
+void Speaker::restart(uint64_t cycle) noexcept
+{
+  m_count = 0;
+  m_emitted = std::floor(static_cast<double>(cycle) * m_samplesPerCycle);
+  std::ranges::fill(m_deltas, 0.0f);
+}
+
+}  // namespace apple2
@@ -1,5 +1,9 @@
 #include "apple2/text_video_device.h"
 
+#include <algorithm>
+
+#include "apple2/character_set.h"
+
 namespace apple2
 {
 
@@ -41,11 +45,10 @@ TextVideoDevice::TextVideoDevice(std::span<Byte, c_size> videoMemory) noexcept
 {
 }
 
-Common::Byte TextVideoDevice::read(Address address, Address /*normalizedAddress*/) const
+Common::Byte TextVideoDevice::read(Address /*address*/, Address normalizedAddress) const
 {
-  assert(address >= c_baseAddress);
-
-  size_t index = static_cast<size_t>(address) - c_size;
+  // Page 1 or page 2, whichever this device is mapped at.
+  size_t index = static_cast<size_t>(normalizedAddress);
   if (index < m_videoMemory.size())
   {
     return m_videoMemory[index];
@@ -53,23 +56,43 @@ Common::Byte TextVideoDevice::read(Address address, Address /*normalizedAddress*
   return 0;  // Out of range reads return 0
 }
 
-void TextVideoDevice::write(Address address, Address /*normalizedAddress*/, Byte value)
+void TextVideoDevice::write(Address /*address*/, Address normalizedAddress, Byte value)
 {
-  assert(address >= c_baseAddress);
-
-  m_dirty = true;
-
-  size_t index = static_cast<size_t>(address) - c_size;
-  if (index < m_videoMemory.size())
+  size_t index = static_cast<size_t>(normalizedAddress);
+  if (index < m_videoMemory.size() && m_videoMemory[index] != value)
   {
     m_videoMemory[index] = value;
+    if (auto row = rowAt(index))
+    {
+      m_dirtyRows |= RowMask{1} << *row;
+    }
   }
 }
 
 const TextVideoDevice::Screen& TextVideoDevice::screen() const noexcept
 {
-  m_dirty = false;
+  m_dirtyRows = 0;
   return m_screen;
 }
 
+void TextVideoDevice::exportRow(size_t row, std::span<char, c_columns> out) const noexcept
+{
+  // A table lookup per character, no branches, so the loop over a row can be unrolled and vectorized.
+  const char* line = m_screen[row].data();
+  for (size_t column = 0; column < c_columns; ++column)
+  {
+    out[column] = c_screenToAscii[static_cast<Byte>(line[column])];
+  }
+}
+
+size_t TextVideoDevice::exportScreen(std::span<char> out) const noexcept
+{
+  size_t rows = std::min(c_rows, out.size() / c_columns);
+  for (size_t row = 0; row < rows; ++row)
+  {
+    exportRow(row, out.subspan(row * c_columns).first<c_columns>());
+  }
+  return rows;
+}
+
 }  // namespace apple2
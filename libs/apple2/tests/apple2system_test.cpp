@@ -0,0 +1,891 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "apple2/apple2system.h"
+#include "common/address.h"
+#include "common/tracing_device.h"
+#include "cpu6502/trace_sink.h"
+#include "test_machine.h"
+
+using apple2::Apple2System;
+using apple2::Framebuffer;
+using apple2::TestMachine;
+using apple2::TextVideoDevice;
+using Common::Address;
+using Common::Byte;
+
+namespace
+{
+
+//! DOS 3.3's READ16 assembled to $3000, with IDX at $26, BUF at $3E, NBUF2 at $3C00 and the DNIBL
+//! table at $2F00, and a caller at $0800 that reads into $4000 and retries until carry is clear.
+void installRead16(TestMachine& machine)
+{
+  constexpr std::array<Byte, 0x69> read16{
+      0xA0, 0x20, 0x88, 0xF0, 0x60, 0xBD, 0x8C, 0xC0, 0x10, 0xFB, 0x49, 0xD5, 0xD0, 0xF4, 0xEA, 0xBD,  //
+      0x8C, 0xC0, 0x10, 0xFB, 0xC9, 0xAA, 0xD0, 0xF2, 0xA0, 0x56, 0xBD, 0x8C, 0xC0, 0x10, 0xFB, 0xC9,  //
+      0xAD, 0xD0, 0xE7, 0xA9, 0x00, 0x88, 0x84, 0x26, 0xBC, 0x8C, 0xC0, 0x10, 0xFB, 0x59, 0x00, 0x2F,  //
+      0xA4, 0x26, 0x99, 0x00, 0x3C, 0xD0, 0xEE, 0x84, 0x26, 0xBC, 0x8C, 0xC0, 0x10, 0xFB, 0x59, 0x00,  //
+      0x2F, 0xA4, 0x26, 0x91, 0x3E, 0xC8, 0xD0, 0xEF, 0xBC, 0x8C, 0xC0, 0x10, 0xFB, 0xD9, 0x00, 0x2F,  //
+      0xD0, 0x13, 0xBD, 0x8C, 0xC0, 0x10, 0xFB, 0xC9, 0xDE, 0xD0, 0x0A, 0xEA, 0xBD, 0x8C, 0xC0, 0x10,  //
+      0xFB, 0xC9, 0xAA, 0xF0, 0x02, 0x38, 0x60, 0x18, 0x60};
+  std::ranges::copy(read16, machine.ram.begin() + 0x3000);
+
+  constexpr std::array<Byte, 64> writeTranslate{0x96, 0x97, 0x9A, 0x9B, 0x9D, 0x9E, 0x9F, 0xA6, 0xA7, 0xAB, 0xAC,
+      0xAD, 0xAE, 0xAF, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF, 0xCB, 0xCD, 0xCE,
+      0xCF, 0xD3, 0xD6, 0xD7, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF, 0xE5, 0xE6, 0xE7, 0xE9, 0xEA, 0xEB, 0xEC, 0xED,
+      0xEE, 0xEF, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF};
+  for (size_t value = 0; value < writeTranslate.size(); ++value)
+  {
+    machine.ram[0x2F00 + writeTranslate[value]] = static_cast<Byte>(value);
+  }
+
+  constexpr std::array<Byte, 21> caller{
+      0xA9, 0x00,  // 0800 LDA #$00
+      0x85, 0x3E,  // 0802 STA $3E
+      0xA9, 0x40,  // 0804 LDA #$40
+      0x85, 0x3F,  // 0806 STA $3F
+      0xA2, 0x60,  // 0808 LDX #$60
+      0xBD, 0x89, 0xC0,  // 080A LDA $C089,X (motor on)
+      0x20, 0x00, 0x30,  // 080D JSR $3000
+      0xB0, 0xFB,  // 0810 BCS $080D
+      0x4C, 0x12, 0x08,  // 0812 JMP $0812
+  };
+  std::ranges::copy(caller, machine.ram.begin() + 0x0800);
+}
+
+}  // namespace
+
+TEST_CASE("Apple2System::run finishes the instruction that crosses the budget", "[apple2]")
+{
+  TestMachine machine;
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    auto system = machine.create(engine);
+
+    // 12 loops take 96 cycles, the budget ends 4 cycles into the next INC.
+    uint64_t overshoot = system->run(100);
+    CHECK(overshoot == 1);
+    CHECK(system->cycles() == 101);
+    CHECK(system->cpu().registers.pc == Address{0x0802});
+    CHECK(machine.ram[0x10] == 13);
+
+    // Carrying the overshoot keeps the total on budget: 200 cycles is exactly 25 loops.
+    overshoot = system->run(100 - overshoot);
+    CHECK(overshoot == 0);
+    CHECK(system->cycles() == 25 * TestMachine::c_loopCycles);
+    CHECK(system->cpu().registers.pc == Address{0x0800});
+
+    machine.ram[0x10] = 0;
+  }
+}
+
+TEST_CASE("Apple2System::runSliceRepaying pays back overshoot over several slices", "[apple2]")
+{
+  TestMachine machine;
+  auto system = machine.create(Apple2System::Engine::Instruction);
+
+  // 20 cycles owed, say from a fast disk read, with slices of 16: the first slice only gets one cycle
+  // of budget and the rest is paid back by the next ones.
+  uint64_t overshoot = 20;
+  for (uint64_t slice = 1; slice <= 10; ++slice)
+  {
+    uint64_t before = system->cycles();
+    uint64_t ran = system->runSliceRepaying(16, overshoot);
+    CHECK(ran == system->cycles() - before);
+    CHECK(system->cycles() + 20 == slice * 16 + overshoot);
+    if (slice == 1)
+    {
+      CHECK(ran == 5);  // The INC that started in the single cycle of budget
+    }
+  }
+  CHECK(overshoot < TestMachine::c_loopCycles);
+
+  // An empty slice runs nothing and pays nothing back.
+  uint64_t before = system->cycles();
+  uint64_t owed = overshoot;
+  CHECK(system->runSliceRepaying(0, overshoot) == 0);
+  CHECK(system->cycles() == before);
+  CHECK(overshoot == owed);
+}
+
+TEST_CASE("Apple2System records a hot spot histogram by instruction address", "[apple2]")
+{
+  TestMachine machine;
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    auto system = machine.create(engine);
+    CHECK(system->stopHotSpotRecording() == nullptr);
+
+    system->startHotSpotRecording();
+    CHECK(system->isRecordingHotSpots());
+    system->run(100);
+    auto profile = system->stopHotSpotRecording();
+    REQUIRE(profile != nullptr);
+    CHECK_FALSE(system->isRecordingHotSpots());
+
+    // 13 INCs and 12 JMPs, every cycle is charged to one of them.
+    CHECK(profile->cycles(Address{0x0800}) == 13 * 5);
+    CHECK(profile->cycles(Address{0x0802}) == 12 * 3);
+    CHECK(profile->cycles(Address{0x0801}) == 0);
+
+    std::ostringstream out;
+    system->writeHotSpots(out, *profile);
+    std::string text = out.str();
+    CHECK(text.find("INC $10 65\n") != std::string::npos);
+    CHECK(text.find("JMP $0800 36\n") != std::string::npos);
+    CHECK(text.find("0800 :") < text.find("0802 :"));
+
+    machine.ram[0x10] = 0;
+  }
+}
+
+TEST_CASE("Apple2System traces every instruction to a sink", "[apple2]")
+{
+  TestMachine machine;
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    auto system = machine.create(engine);
+    std::ostringstream out;
+    {
+      cpu6502::TraceSink sink{out, &Apple2System::Processor::disassemble};
+      system->startTracing(sink);
+      CHECK(system->isTracing());
+      system->run(100);
+      system->stopTracing();
+      CHECK(sink.dropped() == 0);
+    }
+    CHECK_FALSE(system->isTracing());
+
+    // The sink writes out everything before it goes, one line per instruction in the order they ran.
+    std::istringstream lines{out.str()};
+    std::vector<std::string> trace;
+    for (std::string line; std::getline(lines, line);)
+    {
+      trace.push_back(line);
+    }
+    REQUIRE(trace.size() == 25);
+    CHECK(trace[0].starts_with("0800 : E6 10"));
+    CHECK(trace[0].find("INC $10") != std::string::npos);
+    CHECK(trace[1].starts_with("0802 : 4C 00 08"));
+    CHECK(trace[2].find(" A:00 X:00 Y:00 ") != std::string::npos);
+    CHECK(trace[2].ends_with(" @" + std::to_string(system->cycles() - 101 + 8)));
+
+    machine.ram[0x10] = 0;
+  }
+}
+
+TEST_CASE("Apple2System idle skipping matches running every cycle", "[apple2]")
+{
+  // Countdown loops on X, Y and A, then KEYIN-style polling with a counter, then a plain poll.
+  constexpr std::array<Byte, 41> program{
+      0xA2, 0x00,  // 0800 LDX #$00
+      0xCA,  // 0802 DEX
+      0xD0, 0xFD,  // 0803 BNE $0802
+      0xA0, 0x40,  // 0805 LDY #$40
+      0x88,  // 0807 DEY
+      0xD0, 0xFD,  // 0808 BNE $0807
+      0x38,  // 080A SEC
+      0xA9, 0x90,  // 080B LDA #$90
+      0xE9, 0x01,  // 080D SBC #$01
+      0xD0, 0xFC,  // 080F BNE $080D
+      0xE6, 0x4E,  // 0811 INC $4E
+      0xD0, 0x02,  // 0813 BNE $0817
+      0xE6, 0x4F,  // 0815 INC $4F
+      0x2C, 0x00, 0xC0,  // 0817 BIT $C000
+      0x10, 0xF5,  // 081A BPL $0811
+      0xAD, 0x10, 0xC0,  // 081C LDA $C010
+      0xAD, 0x00, 0xC0,  // 081F LDA $C000
+      0x10, 0xFB,  // 0822 BPL $081F
+      0x85, 0x10,  // 0824 STA $10
+      0x4C, 0x26, 0x08,  // 0826 JMP $0826
+  };
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine skipping;
+    TestMachine exact;
+    std::ranges::copy(program, skipping.ram.begin() + 0x0800);
+    std::ranges::copy(program, exact.ram.begin() + 0x0800);
+    skipping.ram[0x4E] = 0xF0;
+    exact.ram[0x4E] = 0xF0;
+
+    auto fast = skipping.create(engine);
+    auto slow = exact.create(engine);
+    slow->setIdleSkipping(false);
+
+    auto compare = [&]()
+    {
+      CHECK(fast->cycles() == slow->cycles());
+      CHECK(fast->cpu().registers.pc == slow->cpu().registers.pc);
+      CHECK(fast->cpu().registers.a == slow->cpu().registers.a);
+      CHECK(fast->cpu().registers.x == slow->cpu().registers.x);
+      CHECK(fast->cpu().registers.y == slow->cpu().registers.y);
+      CHECK(fast->cpu().registers.p == slow->cpu().registers.p);
+      CHECK(skipping.ram == exact.ram);
+    };
+
+    for (uint64_t budget : std::array<uint64_t, 7>{300, 700, 1'500, 2'500, 10'000, 100'000, 17'030})
+    {
+      CHECK(fast->run(budget) == slow->run(budget));
+      compare();
+    }
+
+    fast->pressKey('A');
+    slow->pressKey('A');
+    CHECK(fast->run(50'000) == slow->run(50'000));
+    compare();
+    CHECK(fast->cpu().registers.pc == Address{0x081F});
+
+    fast->pressKey('B');
+    slow->pressKey('B');
+    CHECK(fast->run(1'000) == slow->run(1'000));
+    compare();
+    CHECK(skipping.ram[0x10] == 0xC2);
+
+    CHECK(slow->idleCycles() == 0);
+    CHECK(fast->idleCycles() > 100'000);
+  }
+}
+
+TEST_CASE("Apple2System block engine sees code that modifies itself", "[apple2]")
+{
+  // Each pass patches the ADC operand ahead of it in the same block, then the LDA operand behind it,
+  // so $10 takes 2 * $11 + $0801 and $0801 counts up.
+  constexpr std::array<Byte, 20> program{
+      0xA9, 0x00,  // 0800 LDA #$00
+      0x85, 0x12,  // 0802 STA $12
+      0xA5, 0x11,  // 0804 LDA $11
+      0x8D, 0x0B, 0x08,  // 0806 STA $080B
+      0x18,  // 0809 CLC
+      0x69, 0x00,  // 080A ADC #$00
+      0x85, 0x10,  // 080C STA $10
+      0xEE, 0x01, 0x08,  // 080E INC $0801
+      0x4C, 0x00, 0x08,  // 0811 JMP $0800
+  };
+
+  TestMachine blocks;
+  TestMachine instructions;
+  std::ranges::copy(program, blocks.ram.begin() + 0x0800);
+  std::ranges::copy(program, instructions.ram.begin() + 0x0800);
+  blocks.ram[0x11] = 0x21;
+  instructions.ram[0x11] = 0x21;
+
+  auto fast = blocks.create(Apple2System::Engine::Block);
+  auto reference = instructions.create(Apple2System::Engine::Instruction);
+  for (uint64_t budget : std::array<uint64_t, 4>{7, 100, 1'000, 17'030})
+  {
+    CHECK(fast->run(budget) == reference->run(budget));
+    CHECK(fast->cycles() == reference->cycles());
+    CHECK(fast->cpu().registers == reference->cpu().registers);
+    CHECK(blocks.ram == instructions.ram);
+  }
+  CHECK(blocks.ram[0x10] == 0x42);
+  CHECK(blocks.ram[0x12] == static_cast<Byte>(blocks.ram[0x0801] - 1));
+
+  // The host changing code behind the bus needs invalidateCode(): the loop now stores 0 to $12.
+  blocks.ram[0x0801] = 0x00;
+  blocks.ram[0x080E] = 0xEA;  // NOP
+  blocks.ram[0x080F] = 0xEA;  // NOP
+  blocks.ram[0x0810] = 0xEA;  // NOP
+  fast->invalidateCode();
+  fast->run(100);
+  CHECK(blocks.ram[0x12] == 0x00);
+}
+
+TEST_CASE("Apple2System snapshots clone a running machine", "[apple2]")
+{
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine original;
+    auto system = original.create(engine);
+
+    // The microcode engine stops 4 cycles into an INC, the instruction engine finishes it.
+    system->runFor(100);
+    auto snapshot = std::make_unique<Apple2System::Snapshot>();
+    system->saveSnapshot(*snapshot);
+    system->runFor(1'000);
+
+    TestMachine copy;
+    auto clone = copy.create(engine);
+    clone->restoreSnapshot(*snapshot);
+    CHECK(clone->cycles() == snapshot->cycles);
+    CHECK(copy.ram[0x10] == snapshot->ram[0x10]);
+
+    clone->runFor(1'000);
+    CHECK(clone->cycles() == system->cycles());
+    CHECK(clone->cpu().registers == system->cpu().registers);
+    CHECK(copy.ram == original.ram);
+
+    // Restoring the same snapshot again rewinds the original.
+    system->restoreSnapshot(*snapshot);
+    CHECK(system->cycles() == snapshot->cycles);
+    CHECK(original.ram[0x10] == snapshot->ram[0x10]);
+  }
+}
+
+TEST_CASE("Apple2System restores snapshots taken in the middle of an instruction", "[apple2]")
+{
+  TestMachine machine;
+  auto microcode = machine.create(Apple2System::Engine::Microcode);
+  microcode->runFor(3);
+
+  auto snapshot = std::make_unique<Apple2System::Snapshot>();
+  microcode->saveSnapshot(*snapshot);
+  REQUIRE(snapshot->pump.inInstruction);
+
+  // The instruction engine finishes the INC with the microcode.
+  TestMachine other;
+  auto instruction = other.create(Apple2System::Engine::Instruction);
+  instruction->restoreSnapshot(*snapshot);
+  CHECK(instruction->cycles() == 5);
+  CHECK(instruction->cpu().registers.pc == Address{0x0802});
+  CHECK(other.ram[0x10] == 1);
+
+  snapshot->magic = 0;
+  CHECK_THROWS_AS(microcode->restoreSnapshot(*snapshot), std::invalid_argument);
+}
+
+TEST_CASE("Apple2System accuracy profiles trade snapshots and run alike", "[apple2]")
+{
+  using Accuracy = Apple2System::Accuracy;
+  auto fromCycle = [](uint64_t first)
+  { return [first](const Apple2System::Processor::State& /*cpu*/, uint64_t cycle) { return cycle >= first; }; };
+
+  for (auto from : {Accuracy::Traced, Accuracy::Cycle, Accuracy::Fast})
+  {
+    for (auto to : {Accuracy::Traced, Accuracy::Cycle, Accuracy::Fast})
+    {
+      TestMachine original;
+      auto system = original.create(from);
+      CHECK(system->accuracy() == from);
+      CHECK((system->busTrace() != nullptr) == (from == Accuracy::Traced));
+
+      // The microcode engine stops in the middle of an INC.
+      system->runFor(103);
+      auto snapshot = std::make_unique<Apple2System::Snapshot>();
+      system->saveSnapshot(*snapshot);
+
+      TestMachine copy;
+      auto clone = copy.create(to);
+      clone->restoreSnapshot(*snapshot);
+
+      // Both stop at the first instruction boundary from cycle 1000 on.
+      system->runFor(10'000, fromCycle(1000));
+      clone->runFor(10'000, fromCycle(1000));
+      CHECK(clone->cycles() == system->cycles());
+      CHECK(clone->cpu().registers == system->cpu().registers);
+      CHECK(copy.ram == original.ram);
+    }
+  }
+}
+
+TEST_CASE("Apple2System switches accuracy in place and traces the bus", "[apple2]")
+{
+  using Accuracy = Apple2System::Accuracy;
+  TestMachine machine;
+  auto system = machine.create(Accuracy::Fast);
+  CHECK(system->engine() == Apple2System::Engine::Block);
+  system->runFor(100);
+
+  system->setAccuracy(Accuracy::Traced);
+  CHECK(system->engine() == Apple2System::Engine::Microcode);
+  REQUIRE(system->busTrace() != nullptr);
+  system->runFor(1'000, [](const Apple2System::Processor::State& cpu) { return cpu.registers.pc == Address{0x0800}; });
+  system->busTrace()->cycles();
+
+  // INC $10; JMP $0800, including the INC's extra access to $10.
+  system->runFor(TestMachine::c_loopCycles);
+  auto cycles = system->busTrace()->cycles();
+  constexpr std::array<uint16_t, TestMachine::c_loopCycles> addresses{
+      0x0800, 0x0801, 0x0010, 0x0010, 0x0010, 0x0802, 0x0803, 0x0804};
+  REQUIRE(cycles.size() == addresses.size());
+  for (size_t i = 0; i < addresses.size(); ++i)
+  {
+    CHECK(cycles[i].address == Address{addresses[i]});
+  }
+
+  // Drained at every instruction boundary, the trace keeps runs longer than the device's buffer.
+  std::vector<Common::Bus::Cycle> trace;
+  auto drain = [&trace, device = system->busTrace()](const Apple2System::Processor::State& /*cpu*/)
+  {
+    std::ranges::copy(device->cycles(), std::back_inserter(trace));
+    return false;
+  };
+  constexpr size_t c_loops = 10;
+  static_assert(c_loops * TestMachine::c_loopCycles > Common::TracingDevice::c_maxCycles);
+  system->runFor(c_loops * TestMachine::c_loopCycles, drain);
+  drain(system->cpu());
+  REQUIRE(trace.size() == c_loops * TestMachine::c_loopCycles);
+  for (size_t i = 0; i < trace.size(); ++i)
+  {
+    CHECK(trace[i].address == Address{addresses[i % addresses.size()]});
+  }
+
+  // Leaving the microcode engine in the middle of the INC finishes it.
+  system->setAccuracy(Accuracy::Cycle);
+  CHECK(system->busTrace() == nullptr);
+  system->runFor(3);
+  system->setAccuracy(Accuracy::Fast);
+  CHECK(system->cycles() % TestMachine::c_loopCycles == 5);
+  CHECK(system->cpu().registers.pc == Address{0x0802});
+}
+
+TEST_CASE("Apple2System::fork shares RAM pages with the snapshot until they are written", "[apple2]")
+{
+  TestMachine original;
+  auto system = original.create(Apple2System::Engine::Microcode);
+  system->runFor(100);
+
+  auto snapshot = std::make_shared<Apple2System::Snapshot>();
+  system->saveSnapshot(*snapshot);
+  system->runFor(1'000);
+
+  std::array<std::unique_ptr<Apple2System>, 4> forks;
+  for (auto& fork : forks)
+  {
+    fork = Apple2System::fork(snapshot, std::span<const Byte, 0x3000>(original.rom));
+    CHECK(fork->privateRamPages() == 0);
+    CHECK(fork->cycles() == snapshot->cycles);
+
+    // The program only writes to the zero page.
+    fork->runFor(1'000);
+    CHECK(fork->cycles() == system->cycles());
+    CHECK(fork->cpu().registers == system->cpu().registers);
+    CHECK(fork->privateRamPages() == 1);
+  }
+
+  auto forked = std::make_unique<Apple2System::Snapshot>();
+  forks[0]->saveSnapshot(*forked);
+  CHECK(forked->ram == original.ram);
+  CHECK(snapshot->ram[0x10] != original.ram[0x10]);
+
+  // Restoring a snapshot only copies pages that differ, the zero page is already private.
+  forks[0]->restoreSnapshot(*snapshot);
+  CHECK(forks[0]->privateRamPages() == 1);
+  forks[0]->runFor(1'000);
+  CHECK(forks[0]->cpu().registers == system->cpu().registers);
+}
+
+TEST_CASE("Apple2System takes IRQs while I is clear and NMIs once", "[apple2]")
+{
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine machine;
+
+    // $0800: CLI; INC $10; JMP $0801. The IRQ handler at $0900 and the NMI handler at $0A00 each
+    // count in zero page and return.
+    constexpr std::array<Byte, 6> program{0x58, 0xE6, 0x10, 0x4C, 0x01, 0x08};
+    std::ranges::copy(program, machine.ram.begin() + 0x0800);
+    constexpr std::array<Byte, 3> irqHandler{0xE6, 0x11, 0x40};
+    std::ranges::copy(irqHandler, machine.ram.begin() + 0x0900);
+    constexpr std::array<Byte, 3> nmiHandler{0xE6, 0x12, 0x40};
+    std::ranges::copy(nmiHandler, machine.ram.begin() + 0x0A00);
+    machine.rom[0x2FFA] = 0x00;
+    machine.rom[0x2FFB] = 0x0A;
+    machine.rom[0x2FFE] = 0x00;
+    machine.rom[0x2FFF] = 0x09;
+
+    auto system = machine.create(engine);
+    system->setIrq(true);
+
+    // Reset leaves I set, and the poll at the end of CLI still sees it, so INC runs first.
+    CHECK(system->step() == 2);
+    CHECK(system->step() == 5);
+    CHECK(machine.ram[0x10] == 1);
+
+    CHECK(system->step() == 7);
+    CHECK(system->cpu().registers.pc == Address{0x0900});
+    CHECK(system->cpu().has(Apple2System::Processor::Flag::Interrupt));
+
+    // The return address is the interrupted JMP, and P was pushed with B clear.
+    auto sp = static_cast<size_t>(system->cpu().registers.sp);
+    CHECK((machine.ram[0x0101 + sp] & static_cast<Byte>(Apple2System::Processor::Flag::Break)) == 0);
+    CHECK(machine.ram[0x0102 + sp] == 0x03);
+    CHECK(machine.ram[0x0103 + sp] == 0x08);
+
+    // The handler acknowledges the card, RTI restores I and goes back to the JMP.
+    system->setIrq(false);
+    system->step();
+    system->step();
+    CHECK(machine.ram[0x11] == 1);
+    CHECK(system->cpu().registers.pc == Address{0x0803});
+    CHECK_FALSE(system->cpu().has(Apple2System::Processor::Flag::Interrupt));
+
+    // An NMI is taken at the next instruction boundary whatever I says.
+    system->triggerNmi();
+    CHECK(system->step() == 7);
+    CHECK(system->cpu().registers.pc == Address{0x0A00});
+    system->step();
+    system->step();
+    CHECK(machine.ram[0x12] == 1);
+
+    CHECK(system->cpu().registers.pc == Address{0x0803});
+
+    // An NMI is only taken once.
+    CHECK(system->step() == 3);
+    CHECK(system->step() == 5);
+    CHECK(machine.ram[0x10] == 2);
+  }
+}
+
+TEST_CASE("Apple2System fast disk reads a sector like READ16 does", "[apple2]")
+{
+  std::vector<Byte> bytes(143360);
+  for (size_t index = 0; index < bytes.size(); ++index)
+  {
+    bytes[index] = static_cast<Byte>(index * 7 + index / 256);
+  }
+  auto path = std::filesystem::temp_directory_path() / "apple2system_fast_disk.dsk";
+  std::ofstream{path, std::ios::binary}.write(
+      reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine accelerated;
+    TestMachine exact;
+    installRead16(accelerated);
+    installRead16(exact);
+
+    auto fast = accelerated.create(engine);
+    auto slow = exact.create(engine);
+    REQUIRE(fast->loadDisk(path.string()));
+    REQUIRE(slow->loadDisk(path.string()));
+    fast->setFastDisk(true, 100);
+
+    // Short runs, so the routine is looked for soon after the motor comes on.
+    for (auto* system : {fast.get(), slow.get()})
+    {
+      for (int run = 0; run < 2000 && system->cpu().registers.pc != Address{0x0812}; ++run)
+      {
+        system->run(50);
+      }
+      CHECK(system->cpu().registers.pc == Address{0x0812});
+    }
+
+    CHECK(fast->fastDiskSectors() == 1);
+    CHECK(slow->fastDiskSectors() == 0);
+    CHECK(fast->cycles() < slow->cycles());
+
+    CHECK(fast->cpu().registers.a == slow->cpu().registers.a);
+    CHECK(fast->cpu().registers.x == slow->cpu().registers.x);
+    CHECK(fast->cpu().registers.y == slow->cpu().registers.y);
+    CHECK(fast->cpu().registers.p == slow->cpu().registers.p);
+    CHECK(fast->cpu().registers.sp == slow->cpu().registers.sp);
+    CHECK(accelerated.ram == exact.ram);
+    CHECK(std::any_of(exact.ram.begin() + 0x4000, exact.ram.begin() + 0x4100, [](Byte value) { return value != 0; }));
+
+    auto fastSnapshot = std::make_unique<Apple2System::Snapshot>();
+    auto slowSnapshot = std::make_unique<Apple2System::Snapshot>();
+    fast->saveSnapshot(*fastSnapshot);
+    slow->saveSnapshot(*slowSnapshot);
+    CHECK(fastSnapshot->disk.nibblePos == slowSnapshot->disk.nibblePos);
+
+    // A routine that exits some other way is left to the guest.
+    TestMachine modified;
+    installRead16(modified);
+    modified.ram[0x3067] = 0xEA;
+    auto other = modified.create(engine);
+    REQUIRE(other->loadDisk(path.string()));
+    other->setFastDisk(true);
+    other->run(20'000);
+    CHECK(other->fastDiskSectors() == 0);
+  }
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Apple2System switches to graphics and renders what was drawn", "[apple2]")
+{
+  TestMachine machine;
+  constexpr std::array<Byte, 19> program{
+      0xAD, 0x50, 0xC0,  // 0800 LDA $C050 (graphics)
+      0x8D, 0x57, 0xC0,  // 0803 STA $C057 (hi-res)
+      0xA9, 0x7F,  // 0806 LDA #$7F
+      0x8D, 0x00, 0x20,  // 0808 STA $2000
+      0x8D, 0xA8, 0x24,  // 080B STA $24A8 (scanline 1 of block 9)
+      0x4C, 0x0E, 0x08,  // 080E JMP $080E
+  };
+  std::ranges::copy(program, machine.ram.begin() + 0x0800);
+  auto system = machine.create(Apple2System::Engine::Instruction);
+
+  apple2::Framebuffer framebuffer;
+  system->renderGraphics(framebuffer);
+  system->run(20);
+  CHECK(system->videoMode() == apple2::VideoMode{false, false, false, true});
+
+  // The mode changed since the last render, so everything is converted.
+  CHECK(system->renderGraphics(framebuffer) == TextVideoDevice::c_allRows);
+  CHECK(framebuffer.pixels()[0] == 15);
+  CHECK(framebuffer.block(9)[Framebuffer::c_width] == 15);
+
+  // Only the block written to is converted after that.
+  machine.ram[0x0807] = 0x00;
+  system->reset();
+  system->run(20);
+  CHECK(system->renderGraphics(framebuffer) == ((1u << 0) | (1u << 9)));
+  CHECK(framebuffer.pixels()[0] == 0);
+  CHECK(system->renderGraphics(framebuffer) == 0);
+}
+
+TEST_CASE("Apple2System language card switches banks and arms writes on two reads", "[apple2]")
+{
+  constexpr std::array<Byte, 0x53> program{
+      0xAD, 0x83, 0xC0, 0xAD, 0x83, 0xC0,  // 0800 LDA $C083 twice: read and write RAM, bank 2
+      0xA9, 0x42, 0x8D, 0x00, 0xD0,  // 0806 STA $D000 #$42
+      0xAD, 0x8B, 0xC0, 0xAD, 0x8B, 0xC0,  // 080B LDA $C08B twice: read and write RAM, bank 1
+      0xA9, 0x43, 0x8D, 0x00, 0xD0, 0x8D, 0x00, 0xE0,  // 0811 STA $D000 and $E000 #$43
+      0xAD, 0x80, 0xC0,  // 0819 LDA $C080: read RAM, bank 2, no writes
+      0xAD, 0x00, 0xD0, 0x85, 0x10,  // 081C $10 = $D000
+      0xA9, 0x44, 0x8D, 0x00, 0xD0,  // 0821 STA $D000 #$44, ignored
+      0xAD, 0x00, 0xD0, 0x85, 0x11,  // 0826 $11 = $D000
+      0xAD, 0x00, 0xE0, 0x85, 0x12,  // 082B $12 = $E000
+      0xAD, 0x82, 0xC0,  // 0830 LDA $C082: read ROM
+      0xAD, 0x00, 0xD0, 0x85, 0x13,  // 0833 $13 = $D000
+      0x8D, 0x81, 0xC0, 0xAD, 0x81, 0xC0,  // 0838 STA $C081, LDA $C081: a write does not count
+      0xA9, 0x45, 0x8D, 0x00, 0xE0,  // 083E STA $E000 #$45, ignored
+      0xAD, 0x88, 0xC0,  // 0843 LDA $C088: read RAM, bank 1
+      0xAD, 0x00, 0xE0, 0x85, 0x14,  // 0846 $14 = $E000
+      0xAD, 0x00, 0xD0, 0x85, 0x15,  // 084B $15 = $D000
+      0x4C, 0x50, 0x08,  // 0850 JMP $0850
+  };
+
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine machine;
+    std::ranges::copy(program, machine.ram.begin() + 0x0800);
+    machine.rom[0x0000] = 0x99;
+    auto system = machine.create(engine);
+    system->run(400);
+    REQUIRE(system->cpu().registers.pc == Address{0x0850});
+
+    CHECK(machine.ram[0x10] == 0x42);
+    CHECK(machine.ram[0x11] == 0x42);
+    CHECK(machine.ram[0x12] == 0x43);
+    CHECK(machine.ram[0x13] == 0x99);
+    CHECK(machine.ram[0x14] == 0x43);
+    CHECK(machine.ram[0x15] == 0x43);
+    CHECK(machine.langBank1[0] == 0x42);
+    CHECK(machine.langBank0[0] == 0x43);
+    CHECK(machine.rom[0x0000] == 0x99);
+
+    // The state and the RAM behind ROM survive a snapshot.
+    auto snapshot = std::make_unique<Apple2System::Snapshot>();
+    system->saveSnapshot(*snapshot);
+    CHECK(snapshot->languageCard == Apple2System::LanguageCard{true, false, true, false});
+    CHECK(snapshot->langHighRam[0] == 0x43);
+  }
+}
+
+TEST_CASE("Apple2System finds the pages that changed between two snapshots", "[apple2]")
+{
+  // Writes $D000 in bank 1 and bank 2, $E000 and the zero page.
+  constexpr std::array<Byte, 33> program{
+      0xAD, 0x83, 0xC0, 0xAD, 0x83, 0xC0,  // 0800 LDA $C083 twice: read and write RAM, bank 2
+      0xA9, 0x42, 0x8D, 0x00, 0xD0,  // 0806 STA $D000 #$42
+      0xAD, 0x8B, 0xC0, 0xAD, 0x8B, 0xC0,  // 080B LDA $C08B twice: read and write RAM, bank 1
+      0xA9, 0x43, 0x8D, 0x00, 0xD0, 0x8D, 0x00, 0xE0,  // 0811 STA $D000 and $E000 #$43
+      0x85, 0x10,  // 0819 STA $10
+      0x4C, 0x1B, 0x08,  // 081B JMP $081B
+  };
+
+  TestMachine machine;
+  std::ranges::copy(program, machine.ram.begin() + 0x0800);
+  machine.rom[0x0000] = 0x99;
+  auto system = machine.create(Apple2System::Engine::Instruction);
+
+  auto before = std::make_unique<Apple2System::Snapshot>();
+  auto after = std::make_unique<Apple2System::Snapshot>();
+  system->saveSnapshot(*before);
+  system->run(200);
+  REQUIRE(system->cpu().registers.pc == Address{0x081B});
+  system->saveSnapshot(*after);
+
+  Common::PageBitmap changed = Apple2System::changedPages(*after, *before);
+  CHECK(changed.count() == 4);
+  CHECK(changed.test(0x00));  // Zero page
+  CHECK(changed.test(0xC0));  // Bank 1 at $D000
+  CHECK(changed.test(0xD0));  // Bank 2 at $D000
+  CHECK(changed.test(0xE0));  // $E000
+
+  auto beforeHashes = Apple2System::pageHashes(*before);
+  auto afterHashes = Apple2System::pageHashes(*after);
+  for (size_t page = 0; page < afterHashes.size(); ++page)
+  {
+    CHECK((afterHashes[page] != beforeHashes[page]) == changed.test(page));
+  }
+  CHECK(Apple2System::changedPages(*after, *after).none());
+}
+
+TEST_CASE("Apple2System records the pages the CPU writes", "[apple2]")
+{
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine machine;
+    auto system = machine.create(engine);
+    system->runFor(100);
+    CHECK(system->takeWrittenPages().none());
+
+    // INC $10 in a loop.
+    system->trackWrites(true);
+    system->runFor(100);
+    Common::PageBitmap zeroPage;
+    zeroPage.set(0);
+    CHECK(system->takeWrittenPages() == zeroPage);
+    CHECK(system->takeWrittenPages().none());
+
+    system->trackWrites(false);
+    system->runFor(100);
+    CHECK(system->takeWrittenPages().none());
+  }
+}
+
+TEST_CASE("Apple2System stops at breakpoints and watchpoints", "[apple2]")
+{
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    TestMachine machine;
+    auto system = machine.create(engine);
+    system->runFor(100);
+
+    // Stops in front of the JMP every time round the loop, resuming runs it.
+    system->addBreakpoint(Address{0x0802});
+    system->runFor(100);
+    for (int round = 0; round < 3; ++round)
+    {
+      auto result = system->runFor(100);
+      CHECK(result.status == RunStatus::Breakpoint);
+      CHECK(result.cycles == TestMachine::c_loopCycles);
+      CHECK(system->cpu().registers.pc == Address{0x0802});
+      REQUIRE(system->lastBreak().has_value());
+      CHECK(system->lastBreak()->pc == Address{0x0802});
+      CHECK_FALSE(system->lastBreak()->watch.has_value());
+    }
+    system->removeBreakpoint(Address{0x0802});
+
+    // The INC $10 writes the zero page, the stop is after it.
+    system->addWatchpoint(Address{0x0010}, Address{0x0010}, Common::Bus::Access::Write);
+    auto result = system->runFor(100);
+    CHECK(result.status == RunStatus::Breakpoint);
+    CHECK(system->cpu().registers.pc == Address{0x0802});
+    // The 6502 writes the old value back before the new one, the 65C02 reads it again instead, so the
+    // first write seen carries either value.
+    REQUIRE(system->lastBreak().has_value());
+    REQUIRE(system->lastBreak()->watch.has_value());
+    CHECK(system->lastBreak()->watch->address == Address{0x0010});
+    CHECK_FALSE(system->lastBreak()->watch->isRead);
+
+    // Reads of $10 are not watched, so only the write of the next INC stops.
+    system->removeWatchpoint(Address{0x0010}, Address{0x0010}, Common::Bus::Access::Write);
+    system->addWatchpoint(Address{0x0011}, Address{0x00FF}, Common::Bus::Access::Read);
+    CHECK(system->runFor(100).status == RunStatus::Completed);
+    system->removeWatchpoint(Address{0x0011}, Address{0x00FF}, Common::Bus::Access::Read);
+    CHECK(system->runFor(100).status == RunStatus::Completed);
+  }
+}
+
+TEST_CASE("Apple2System turns the disk while the guest does something else", "[apple2]")
+{
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction, Apple2System::Engine::Block})
+  {
+    // LDA $C0E9 turns the motor on, then the INC loop never reads the disk.
+    TestMachine machine;
+    constexpr std::array<Byte, 8> program{0xAD, 0xE9, 0xC0, 0xE6, 0x10, 0x4C, 0x03, 0x08};
+    std::ranges::copy(program, machine.ram.begin() + 0x0800);
+    auto system = machine.create(engine);
+    CHECK(system->events().nextDeadline() == Common::EventQueue::c_never);
+
+    system->run(1000 * apple2::DiskController::c_nibbleCycles);
+
+    // The motor came on in the middle of that batch, its first event runs at the start of the next.
+    // The disk has turned by the time since the motor came on, up to the last rotation event.
+    system->run(1);
+    auto snapshot = std::make_unique<Apple2System::Snapshot>();
+    system->saveSnapshot(*snapshot);
+    CHECK(snapshot->disk.nibblePos <= 1001);
+    CHECK(snapshot->disk.nibblePos >= 1000 - apple2::DiskController::c_rotationEventCycles / 32);
+
+    // Short runs do not hold the events up.
+    for (int run = 0; run < 64; ++run)
+    {
+      system->run(apple2::DiskController::c_nibbleCycles);
+      CHECK(system->events().nextDeadline() > system->cycles());
+      CHECK(system->events().nextDeadline() <= system->cycles() + apple2::DiskController::c_rotationEventCycles);
+    }
+  }
+}
+
+TEST_CASE("Apple2System types text from its buffer, paced or pasted", "[apple2]")
+{
+  // Stores every key at $1000,X and clears the strobe.
+  constexpr std::array<Byte, 15> program{
+      0xAD, 0x00, 0xC0,  // 0800 LDA $C000
+      0x10, 0xFB,  // 0803 BPL $0800
+      0x9D, 0x00, 0x10,  // 0805 STA $1000,X
+      0xE8,  // 0808 INX
+      0x2C, 0x10, 0xC0,  // 0809 BIT $C010
+      0x4C, 0x00, 0x08,  // 080C JMP $0800
+  };
+  constexpr std::string_view c_text = "10 print\n";
+  constexpr std::array<Byte, 9> c_typed{0xB1, 0xB0, 0xA0, 0xD0, 0xD2, 0xC9, 0xCE, 0xD4, 0x8D};
+
+  for (bool fastPaste : {false, true})
+  {
+    TestMachine machine;
+    std::ranges::copy(program, machine.ram.begin() + 0x0800);
+    auto system = machine.create(Apple2System::Engine::Microcode);
+    system->setFastPaste(fastPaste);
+    CHECK(system->typeText(c_text) == c_text.size());
+    CHECK(system->pendingKeys() == c_text.size());
+
+    // Pasting hands over a key every time round the loop, otherwise they come at the typing rate.
+    system->run(1000);
+    CHECK(system->pendingKeys() == (fastPaste ? 0 : c_text.size() - 1));
+    system->run(c_text.size() * Apple2System::c_keyIntervalCycles);
+    CHECK(system->pendingKeys() == 0);
+    CHECK(std::equal(c_typed.begin(), c_typed.end(), machine.ram.begin() + 0x1000));
+  }
+
+  // The buffer takes what fits.
+  TestMachine machine;
+  auto system = machine.create(Apple2System::Engine::Instruction);
+  std::string text(apple2::KeyBuffer::c_capacity + 100, 'A');
+  CHECK(system->typeText(text) == apple2::KeyBuffer::c_capacity);
+  CHECK(system->typeText("B") == 0);
+}
+
+TEST_CASE("KeyBuffer wraps around its ring", "[apple2]")
+{
+  apple2::KeyBuffer keys;
+  CHECK_FALSE(keys.pop().has_value());
+  REQUIRE(keys.push(std::string(apple2::KeyBuffer::c_capacity - 2, 'x')) == apple2::KeyBuffer::c_capacity - 2);
+  for (size_t key = 0; key < apple2::KeyBuffer::c_capacity - 3; ++key)
+  {
+    keys.pop();
+  }
+
+  CHECK(keys.push("abcdef") == 6);
+  std::string popped;
+  while (auto key = keys.pop())
+  {
+    popped += *key;
+  }
+  CHECK(popped == "xabcdef");
+  CHECK(keys.empty());
+}
@@ -1,3 +1,11 @@
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
+#include <stdexcept>
+
 #include "apple2/disk_controller.h"
 #include "catch2/catch_test_macros.hpp"
 #include "disk_controller_helper.h"
@@ -29,3 +37,289 @@ TEST_CASE("DiskController.seek track zero", "[apple2][disk_controller]")
 
   CHECK_FALSE(dc.isMotorOn());
 }
+
+TEST_CASE("DiskController.snapshot restores head position", "[apple2][disk_controller]")
+{
+  apple2::DiskController dc;
+  DiskControllerHelper helper{dc};
+  helper.motorOn();
+  helper.seekTrack0();
+  helper.seekTrack(10);
+
+  auto snapshot = dc.snapshot();
+
+  apple2::DiskController copy;
+  CHECK(copy.getCurrentTrack() != dc.getCurrentTrack());
+  copy.restore(snapshot);
+  CHECK(copy.isMotorOn());
+  CHECK(copy.getCurrentTrack() == dc.getCurrentTrack());
+  CHECK(copy.readStatus() == dc.readStatus());
+
+  snapshot.nibblePos = DiskController::c_trackSize;
+  CHECK_THROWS_AS(copy.restore(snapshot), std::invalid_argument);
+}
+
+TEST_CASE("DiskController.ROM belongs to each controller", "[apple2][disk_controller]")
+{
+  std::array<Common::Byte, 256> first{};
+  std::array<Common::Byte, 256> second{};
+  first[0x5C] = 0xA2;
+  second[0x5C] = 0x20;
+
+  apple2::DiskController a;
+  apple2::DiskController b;
+  CHECK(a.read(Address{0xC65C}, Address{0x5C}) == 0x00);
+
+  a.loadRom(first);
+  b.loadRom(second);
+  CHECK(a.read(Address{0xC65C}, Address{0x5C}) == 0xA2);
+  CHECK(b.read(Address{0xC65C}, Address{0x5C}) == 0x20);
+
+  // The controller maps the ROM instead of copying it.
+  first[0x5C] = 0xEA;
+  CHECK(a.read(Address{0xC65C}, Address{0x5C}) == 0xEA);
+}
+
+namespace
+{
+
+constexpr size_t c_imageSize = 143360;
+
+std::filesystem::path writeImage(const char* name, const std::vector<Byte>& image)
+{
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::ofstream{path, std::ios::binary}.write(
+      reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.size()));
+  return path;
+}
+
+std::vector<Byte> readImage(const std::filesystem::path& path)
+{
+  std::vector<Byte> image(c_imageSize);
+  std::ifstream{path, std::ios::binary}.read(
+      reinterpret_cast<char*>(image.data()), static_cast<std::streamsize>(image.size()));
+  return image;
+}
+
+Byte readNibble(DiskController& dc)
+{
+  return dc.read(Address{0xC0EC}, Address{0x0C});
+}
+
+//! Reads a whole track from where the disk is, which leaves it where it was.
+std::vector<Byte> readTrack(DiskController& dc)
+{
+  std::vector<Byte> track(DiskController::c_trackSize);
+  std::ranges::generate(track, [&dc] { return readNibble(dc); });
+  return track;
+}
+
+//! Writes `track` from where the disk is: STA $C0EF enters write mode with the first nibble, then
+//! STA $C0ED loads each following one and LDA $C0EC shifts it out. Leaves the controller in read mode.
+void writeTrack(DiskController& dc, const std::vector<Byte>& track)
+{
+  dc.write(Address{0xC0EF}, Address{0x0F}, track[0]);
+  dc.read(Address{0xC0EC}, Address{0x0C});
+  for (size_t index = 1; index < track.size(); ++index)
+  {
+    dc.write(Address{0xC0ED}, Address{0x0D}, track[index]);
+    dc.read(Address{0xC0EC}, Address{0x0C});
+  }
+  dc.read(Address{0xC0EE}, Address{0x0E});  // Back in read mode, this reads the first nibble
+}
+
+}  // namespace
+
+TEST_CASE("DiskController.reads the track as a loop of nibbles", "[apple2][disk_controller]")
+{
+  // Every byte is $11 except logical sector 7 of track 0, which is physical sector 1.
+  std::vector<Byte> image(c_imageSize, 0x11);
+  std::fill_n(image.begin() + 7 * 256, 256, Byte{0x00});
+  auto path = writeImage("disk_controller_test.dsk", image);
+
+  apple2::DiskController dc;
+  REQUIRE(dc.loadDisk(path.string()));
+  std::filesystem::remove(path);
+
+  DiskControllerHelper helper{dc};
+  helper.motorOn();
+  helper.seekTrack0();
+
+  std::vector<Byte> track(DiskController::c_trackSize);
+  std::ranges::generate(track, [&dc] { return readNibble(dc); });
+
+  // Sector 0 follows the first gap: the address field with volume 254, track 0, sector 0, a short gap
+  // and the data field.
+  std::vector<Byte> expected{0xFF, 0xD5, 0xAA, 0x96, 0xFF, 0xFE, 0xAA, 0xAA, 0xAA, 0xAA, 0xFF, 0xFE, 0xDE, 0xAA, 0xEB,
+      0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xD5, 0xAA, 0xAD};
+  CHECK(std::vector<Byte>(track.begin() + 47, track.begin() + 71) == expected);
+
+  // $11 is 00 in the low bits of every byte after swapping, 000100 in the high bits: one auxiliary
+  // value, 85 repeats of it, the first data value and 255 repeats of it, then the checksum.
+  CHECK(track[71] == 0xE6);
+  CHECK(std::all_of(track.begin() + 72, track.begin() + 157, [](Byte nibble) { return nibble == 0x96; }));
+  CHECK(track[157] == 0xEB);
+  CHECK(std::all_of(track.begin() + 158, track.begin() + 413, [](Byte nibble) { return nibble == 0x96; }));
+  CHECK(track[413] == 0x9D);
+  CHECK(std::vector<Byte>(track.begin() + 414, track.begin() + 417) == std::vector<Byte>{0xDE, 0xAA, 0xEB});
+
+  // Physical sector 1 holds the zeroed logical sector 7.
+  CHECK(track[48 + 396 + 8] == 0xAB);
+  CHECK(std::all_of(track.begin() + 467, track.begin() + 810, [](Byte nibble) { return nibble == 0x96; }));
+  CHECK(track.back() == 0xFF);
+
+  // The disk keeps spinning, the next read is the start of the track again.
+  CHECK(dc.snapshot().nibblePos == 0);
+  CHECK(readNibble(dc) == track[0]);
+
+  // Stepping to another track keeps the rotational position and reads that track's address field.
+  helper.seekTrack(5);
+  auto trackNumber = static_cast<Byte>(dc.getCurrentTrack());
+  REQUIRE(trackNumber != 0);
+  std::vector<Byte> next(DiskController::c_trackSize - 1);
+  std::ranges::generate(next, [&dc] { return readNibble(dc); });
+  CHECK(next[52] == ((trackNumber >> 1) | 0xAA));
+  CHECK(next[53] == (trackNumber | 0xAA));
+}
+
+TEST_CASE("DiskController.writes changed sectors back to the image", "[apple2][disk_controller]")
+{
+  std::vector<Byte> source(c_imageSize);
+  for (size_t index = 0; index < source.size(); ++index)
+  {
+    source[index] = static_cast<Byte>(index * 7 + index / 256);
+  }
+  auto sourcePath = writeImage("disk_controller_source.dsk", source);
+  auto targetPath = writeImage("disk_controller_target.dsk", std::vector<Byte>(c_imageSize, 0));
+
+  // Read track 0 of the source disk.
+  std::vector<Byte> track;
+  {
+    apple2::DiskController dc;
+    REQUIRE(dc.loadDisk(sourcePath.string()));
+    DiskControllerHelper helper{dc};
+    helper.motorOn();
+    helper.seekTrack0();
+    track = readTrack(dc);
+  }
+
+  apple2::DiskController dc;
+  REQUIRE(dc.loadDisk(targetPath.string(), DiskImage::Writes::WriteBack));
+  CHECK_FALSE(dc.isWriteProtected());
+  DiskControllerHelper helper{dc};
+  helper.motorOn();
+  helper.seekTrack0();
+
+  // Sense write protect the way RWTS does: Q6 high, Q7 low.
+  dc.read(Address{0xC0ED}, Address{0x0D});
+  CHECK(dc.read(Address{0xC0EE}, Address{0x0E}) == 0x00);
+
+  // Write it to the target.
+  writeTrack(dc, track);
+
+  // The track reads back as written, and nothing reaches the file before flush().
+  std::vector<Byte> readBack = readTrack(dc);
+  std::ranges::rotate(track, track.begin() + 1);
+  CHECK(readBack == track);
+  CHECK(readImage(targetPath) == std::vector<Byte>(c_imageSize, 0));
+
+  CHECK(dc.flush());
+  auto target = readImage(targetPath);
+  CHECK(std::equal(target.begin(), target.begin() + 4096, source.begin()));
+  CHECK(std::all_of(target.begin() + 4096, target.end(), [](Byte value) { return value == 0; }));
+
+  std::filesystem::remove(sourcePath);
+  std::filesystem::remove(targetPath);
+}
+
+TEST_CASE("DiskController.keeps the guest's writes to a shared image private", "[apple2][disk_controller]")
+{
+  auto sourcePath = writeImage("disk_controller_shared_source.dsk", std::vector<Byte>(c_imageSize, 0x22));
+  auto sharedPath = writeImage("disk_controller_shared.dsk", std::vector<Byte>(c_imageSize, 0x11));
+
+  std::vector<Byte> track;
+  {
+    apple2::DiskController dc;
+    REQUIRE(dc.loadDisk(sourcePath.string()));
+    DiskControllerHelper helper{dc};
+    helper.motorOn();
+    helper.seekTrack0();
+    track = readTrack(dc);
+  }
+
+  // Two machines run from the same image.
+  auto first = std::make_unique<apple2::DiskController>();
+  apple2::DiskController second;
+  REQUIRE(first->loadDisk(sharedPath.string()));
+  REQUIRE(second.loadDisk(sharedPath.string()));
+  std::vector<Byte> original;
+  for (auto* dc : {first.get(), &second})
+  {
+    DiskControllerHelper helper{*dc};
+    helper.motorOn();
+    helper.seekTrack0();
+    original = readTrack(*dc);
+  }
+  REQUIRE(track != original);
+
+  // The first one writes track 0 and keeps it, flushing and ejecting it does not touch the file.
+  writeTrack(*first, track);
+  std::ranges::rotate(track, track.begin() + 1);
+  CHECK(readTrack(*first) == track);
+  CHECK(first->flush());
+  first.reset();
+  CHECK(readImage(sharedPath) == std::vector<Byte>(c_imageSize, 0x11));
+
+  // The second one still reads the image as it was, and so does a disk loaded after.
+  CHECK(readTrack(second) == original);
+  apple2::DiskController third;
+  REQUIRE(third.loadDisk(sharedPath.string()));
+  CHECK(third.image()->privateTracks() == 0);
+
+  std::filesystem::remove(sourcePath);
+  std::filesystem::remove(sharedPath);
+}
+
+TEST_CASE("DiskController.turns the disk with time while the motor is on", "[apple2][disk_controller]")
+{
+  auto path = writeImage("disk_controller_rotation.dsk", std::vector<Byte>(c_imageSize, 0x11));
+  Common::EventQueue events;
+  apple2::DiskController dc{events};
+  REQUIRE(dc.loadDisk(path.string()));
+  std::filesystem::remove(path);
+  DiskControllerHelper helper{dc};
+  CHECK(events.nextDeadline() == Common::EventQueue::c_never);
+
+  events.runDue(1000);
+  helper.motorOn();
+  CHECK(events.nextDeadline() == 1000 + DiskController::c_rotationEventCycles);
+
+  // Ten reads put the guest ten nibbles ahead, then 100 nibbles' worth of time passes.
+  for (int read = 0; read < 10; ++read)
+  {
+    readNibble(dc);
+  }
+  CHECK(dc.snapshot().lead == 10);
+  events.runDue(1000 + 100 * DiskController::c_nibbleCycles + 31);
+  CHECK(dc.snapshot().nibblePos == 100);
+  CHECK(dc.snapshot().lead == 0);
+  CHECK(dc.snapshot().rotationCycle == 1000 + 100 * DiskController::c_nibbleCycles);
+
+  // A guest that reads faster than the disk turns keeps its lead until the disk catches up.
+  for (int read = 0; read < 200; ++read)
+  {
+    readNibble(dc);
+  }
+  events.runDue(events.nextDeadline());
+  CHECK(dc.snapshot().nibblePos == 300);
+  CHECK(dc.snapshot().lead == 200 - 16);
+
+  helper.motorOff();
+  CHECK(events.nextDeadline() == Common::EventQueue::c_never);
+
+  // A restored controller with the motor on picks the rotation up where the snapshot left it.
+  auto snapshot = dc.snapshot();
+  snapshot.status |= 0x10;
+  dc.restore(snapshot);
+  CHECK(events.nextDeadline() == snapshot.rotationCycle + DiskController::c_rotationEventCycles);
+}
@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+#include "apple2/disk_image.h"
+#include "catch2/catch_test_macros.hpp"
+
+using apple2::DiskImage;
+using apple2::MappedFile;
+using Common::Byte;
+
+namespace
+{
+
+constexpr size_t c_sectorImageSize = 143360;
+constexpr size_t c_nibbleImageSize = 232960;
+
+std::filesystem::path writeFile(const char* name, const std::vector<Byte>& bytes)
+{
+  auto path = std::filesystem::temp_directory_path() / name;
+  std::ofstream{path, std::ios::binary}.write(
+      reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  return path;
+}
+
+std::vector<Byte> readFile(const std::filesystem::path& path)
+{
+  std::vector<Byte> bytes(std::filesystem::file_size(path));
+  std::ifstream{path, std::ios::binary}.read(
+      reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+  return bytes;
+}
+
+void putLe32(std::vector<Byte>& bytes, size_t offset, uint32_t value)
+{
+  for (size_t index = 0; index < 4; ++index)
+  {
+    bytes[offset + index] = static_cast<Byte>(value >> (8 * index));
+  }
+}
+
+}  // namespace
+
+TEST_CASE("DiskImage.detects the format", "[apple2][disk_image]")
+{
+  std::vector<Byte> sectors(c_sectorImageSize);
+  CHECK(DiskImage::detectFormat(sectors, "master.dsk") == DiskImage::Format::Dos);
+  CHECK(DiskImage::detectFormat(sectors, "master.DO") == DiskImage::Format::Dos);
+  CHECK(DiskImage::detectFormat(sectors, "master.po") == DiskImage::Format::ProDos);
+
+  // A .dsk with a ProDOS volume directory in block 2 is in block order.
+  sectors[0x402] = 0x03;
+  sectors[0x404] = 0xF5;
+  CHECK(DiskImage::detectFormat(sectors, "prodos.dsk") == DiskImage::Format::ProDos);
+
+  CHECK(DiskImage::detectFormat(std::vector<Byte>(c_nibbleImageSize), "game.nib") == DiskImage::Format::Nibble);
+
+  std::vector<Byte> woz{'W', 'O', 'Z', '2', 0xFF, 0x0A, 0x0D, 0x0A, 0, 0, 0, 0};
+  CHECK(DiskImage::detectFormat(woz, "game.woz") == DiskImage::Format::Woz);
+
+  CHECK_FALSE(DiskImage::detectFormat(std::vector<Byte>(1000), "short.dsk").has_value());
+}
+
+TEST_CASE("DiskImage.shares the file and keeps written tracks private", "[apple2][disk_image]")
+{
+  // Logical sector 8 of track 0 is zero, the rest $11. In ProDOS order it is physical sector 1.
+  std::vector<Byte> bytes(c_sectorImageSize, 0x11);
+  std::fill_n(bytes.begin() + 8 * 256, 256, Byte{0x00});
+  auto path = writeFile("disk_image_test.po", bytes);
+
+  auto first = DiskImage::open(path.string());
+  auto second = DiskImage::open(path.string());
+  REQUIRE(first != nullptr);
+  REQUIRE(second != nullptr);
+  CHECK(first->format() == DiskImage::Format::ProDos);
+  CHECK(MappedFile::open(path.string()) == MappedFile::open(path.string()));
+
+  std::array<Byte, DiskImage::c_trackSize> track{};
+  first->readTrack(0, track);
+  CHECK(std::all_of(track.begin() + 467, track.begin() + 810, [](Byte nibble) { return nibble == 0x96; }));
+
+  // Write a track of another disk onto the second one.
+  auto otherPath = writeFile("disk_image_other.po", std::vector<Byte>(c_sectorImageSize, 0x22));
+  auto other = DiskImage::open(otherPath.string());
+  REQUIRE(other != nullptr);
+  std::array<Byte, DiskImage::c_trackSize> otherTrack{};
+  other->readTrack(1, otherTrack);
+  other.reset();
+  std::filesystem::remove(otherPath);
+
+  second->writeTrack(1, otherTrack);
+  CHECK(second->privateTracks() == 1);
+  CHECK(first->privateTracks() == 0);
+  second->readTrack(1, track);
+  CHECK(track == otherTrack);
+  first->readTrack(1, track);
+  CHECK(track != otherTrack);
+
+  // Sectors that do not decode keep their contents.
+  std::array<Byte, DiskImage::c_trackSize> sync{};
+  std::ranges::fill(sync, Byte{0xFF});
+  second->writeTrack(2, sync);
+  second->readTrack(2, track);
+  first->readTrack(2, sync);
+  CHECK(track == sync);
+
+  // A private disk never writes the file, not even on flush().
+  CHECK(second->flush());
+  CHECK(readFile(path) == bytes);
+
+  // A disk opened for write-back writes the tracks it changed, but only on flush().
+  auto writer = DiskImage::open(path.string(), DiskImage::Writes::WriteBack);
+  REQUIRE(writer != nullptr);
+  CHECK(writer->writes() == DiskImage::Writes::WriteBack);
+  writer->writeTrack(1, otherTrack);
+  CHECK(readFile(path) == bytes);
+  CHECK(writer->flush());
+  std::fill_n(bytes.begin() + 4096, 4096, Byte{0x22});
+  CHECK(readFile(path) == bytes);
+
+  first.reset();
+  second.reset();
+  writer.reset();
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("DiskImage.reads and writes nibble images", "[apple2][disk_image]")
+{
+  std::vector<Byte> bytes(c_nibbleImageSize, 0xFF);
+  bytes[DiskImage::c_trackSize * 3] = 0xD5;
+  auto path = writeFile("disk_image_test.nib", bytes);
+
+  auto image = DiskImage::open(path.string(), DiskImage::Writes::WriteBack);
+  REQUIRE(image != nullptr);
+  CHECK(image->format() == DiskImage::Format::Nibble);
+  CHECK_FALSE(image->isWriteProtected());
+
+  std::array<Byte, DiskImage::c_trackSize> track{};
+  image->readTrack(3, track);
+  CHECK(track[0] == 0xD5);
+  CHECK(track[1] == 0xFF);
+
+  track[1] = 0xAA;
+  image->writeTrack(3, track);
+  CHECK(image->flush());
+
+  bytes[DiskImage::c_trackSize * 3 + 1] = 0xAA;
+  CHECK(readFile(path) == bytes);
+
+  image.reset();
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("DiskImage.reads WOZ bit streams", "[apple2][disk_image]")
+{
+  // Header, INFO, TMAP and TRKS with one track of 32 bits in block 3.
+  std::vector<Byte> bytes(2048);
+  std::memcpy(bytes.data(), "WOZ2\xFF\x0A\x0D\x0A", 8);
+  std::memcpy(bytes.data() + 12, "INFO", 4);
+  putLe32(bytes, 16, 60);
+  std::memcpy(bytes.data() + 80, "TMAP", 4);
+  putLe32(bytes, 84, 160);
+  std::fill_n(bytes.begin() + 88, 160, Byte{0xFF});
+  bytes[88] = 0;  // Track 0 is TRKS entry 0
+  std::memcpy(bytes.data() + 248, "TRKS", 4);
+  putLe32(bytes, 252, 2048 - 256);
+  bytes[256] = 3;  // Starting block
+  bytes[258] = 1;  // Block count
+  putLe32(bytes, 260, 32);  // Bit count
+  std::ranges::copy(std::array<Byte, 4>{0xFF, 0xD5, 0xAA, 0x96}, bytes.begin() + 3 * 512);
+  auto path = writeFile("disk_image_test.woz", bytes);
+
+  auto image = DiskImage::open(path.string());
+  REQUIRE(image != nullptr);
+  CHECK(image->format() == DiskImage::Format::Woz);
+  CHECK(image->isWriteProtected());
+
+  std::array<Byte, DiskImage::c_trackSize> track{};
+  image->readTrack(0, track);
+  CHECK(std::vector<Byte>(track.begin(), track.begin() + 5) == std::vector<Byte>{0xFF, 0xD5, 0xAA, 0x96, 0xFF});
+
+  // Tracks missing from the map read as sync bytes.
+  image->readTrack(1, track);
+  CHECK(std::ranges::all_of(track, [](Byte nibble) { return nibble == 0xFF; }));
+
+  image.reset();
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,125 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "apple2/fleet.h"
+#include "common/address.h"
+#include "test_machine.h"
+
+using apple2::Apple2Fleet;
+using apple2::TestMachine;
+using Common::Address;
+using Common::Byte;
+
+namespace
+{
+
+// Polls the keyboard, stores the key in $10 and clears the strobe, then polls again.
+constexpr std::array<Byte, 13> c_typing{
+    0xAD, 0x00, 0xC0,  // 0800 LDA $C000
+    0x10, 0xFB,  // 0803 BPL $0800
+    0x85, 0x10,  // 0805 STA $10
+    0xAD, 0x10, 0xC0,  // 0807 LDA $C010
+    0x4C, 0x00, 0x08,  // 080A JMP $0800
+};
+
+// CLC; BCC *, which traps.
+constexpr std::array<Byte, 3> c_trapping{0x18, 0x90, 0xFE};
+
+}  // namespace
+
+TEST_CASE("Apple2Fleet runs machines in slices and parks the waiting ones", "[apple2][fleet]")
+{
+  constexpr uint64_t c_slice = 1000;
+  std::vector<std::unique_ptr<TestMachine>> machines;
+  Apple2Fleet fleet{3, c_slice};
+  CHECK(fleet.threads() == 3);
+
+  std::vector<Apple2Fleet::Id> counting;
+  std::vector<Apple2Fleet::Id> typing;
+  for (int i = 0; i < 4; ++i)
+  {
+    machines.push_back(std::make_unique<TestMachine>(TestMachine::c_counting));
+    counting.push_back(fleet.add(machines.back()->create()));
+    machines.push_back(std::make_unique<TestMachine>(c_typing));
+    typing.push_back(fleet.add(machines.back()->create()));
+  }
+  machines.push_back(std::make_unique<TestMachine>(c_trapping));
+  auto trapping = fleet.add(machines.back()->create());
+  CHECK(fleet.size() == 9);
+
+  fleet.runSlices(5);
+
+  // Every slice of a busy machine runs the full budget, give or take the overshoot of the last one.
+  for (auto id : counting)
+  {
+    auto stats = fleet.stats(id);
+    CHECK_FALSE(stats.parked);
+    CHECK(stats.cycles >= 5 * c_slice);
+    CHECK(stats.cycles < 5 * c_slice + 8);
+    CHECK(stats.mhz() > 0.0);
+  }
+
+  // The others park after their first slice and do not advance.
+  for (auto id : typing)
+  {
+    CHECK(fleet.stats(id).parked);
+    CHECK(fleet.stats(id).cycles < c_slice + 8);
+  }
+  CHECK(fleet.stats(trapping).trap == Address{0x0801});
+  CHECK(fleet.parked() == 5);
+
+  // A key gets a waiting machine going until it waits again.
+  fleet.pressKey(typing[1], 'a');
+  CHECK_FALSE(fleet.stats(typing[1]).parked);
+  uint64_t before = fleet.stats(typing[1]).cycles;
+  fleet.runSlices(2);
+  CHECK(fleet.system(typing[1]).cpu().registers.a != 0);
+  CHECK(machines[3]->ram[0x10] == 0xC1);
+  CHECK(machines[1]->ram[0x10] == 0x00);
+  CHECK(fleet.stats(typing[1]).parked);
+  CHECK(fleet.stats(typing[1]).cycles > before);
+
+  // An idle machine sits out until it is unflagged.
+  fleet.setIdle(counting[0], true);
+  uint64_t idleCycles = fleet.stats(counting[0]).cycles;
+  fleet.runSlices(3);
+  CHECK(fleet.stats(counting[0]).parked);
+  CHECK(fleet.stats(counting[0]).cycles == idleCycles);
+  CHECK(fleet.stats(counting[1]).cycles > idleCycles);
+  fleet.setIdle(counting[0], false);
+  fleet.runSlices(1);
+  CHECK(fleet.stats(counting[0]).cycles > idleCycles);
+}
+
+TEST_CASE("Apple2Fleet counts every machine of back-to-back slices", "[apple2][fleet]")
+{
+  // Short slices on more threads than machines, so workers are often still taking work from one slice
+  // when the next is dealt.
+  constexpr uint64_t c_slice = 20;
+  constexpr size_t c_slices = 2000;
+  std::vector<std::unique_ptr<TestMachine>> machines;
+  Apple2Fleet fleet{4, c_slice};
+  for (int i = 0; i < 3; ++i)
+  {
+    machines.push_back(std::make_unique<TestMachine>(TestMachine::c_counting));
+    fleet.add(machines.back()->create());
+  }
+
+  fleet.runSlices(c_slices);
+
+  for (Apple2Fleet::Id id = 0; id < fleet.size(); ++id)
+  {
+    CHECK(fleet.stats(id).cycles >= c_slices * c_slice);
+    CHECK(fleet.stats(id).cycles < c_slices * c_slice + 8);
+  }
+}
+
+TEST_CASE("Apple2Fleet rejects an empty slice", "[apple2][fleet]")
+{
+  CHECK_THROWS_AS(Apple2Fleet(1, 0), std::invalid_argument);
+}
@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+
+#include "apple2/framebuffer.h"
+#include "apple2/hires_video_device.h"
+#include "catch2/catch_test_macros.hpp"
+
+using apple2::Framebuffer;
+using apple2::HiResVideoDevice;
+using apple2::TextVideoDevice;
+using apple2::VideoMode;
+using Common::Address;
+using Common::Byte;
+
+namespace
+{
+
+constexpr VideoMode c_hiRes{false, false, false, true};
+constexpr VideoMode c_loRes{false, false, false, false};
+
+struct Pages
+{
+  std::array<Byte, TextVideoDevice::c_size> text{};
+  std::array<Byte, HiResVideoDevice::c_size> hiRes{};
+};
+
+Framebuffer::Pixel pixelAt(const Framebuffer& framebuffer, size_t x, size_t y)
+{
+  return framebuffer.pixels()[y * Framebuffer::c_width + x];
+}
+
+}  // namespace
+
+TEST_CASE("HiResVideoDevice.tracks the blocks that changed", "[apple2][video]")
+{
+  std::array<Byte, HiResVideoDevice::c_size> memory{};
+  HiResVideoDevice hiRes{memory};
+  CHECK(hiRes.takeDirtyBlocks() == TextVideoDevice::c_allRows);
+
+  // Scanline 2 of block 0, scanline 7 of block 9, and a hole.
+  hiRes.write(Address{0x2800}, Address{0x0800}, 0x01);
+  hiRes.write(Address{0x3CA8}, Address{0x1CA8}, 0x01);
+  hiRes.write(Address{0x2478}, Address{0x0478}, 0x01);
+  CHECK(hiRes.dirtyBlocks() == ((1u << 0) | (1u << 9)));
+
+  // Taking some blocks leaves the others dirty.
+  CHECK(hiRes.takeDirtyBlocks(1u << 9) == (1u << 9));
+  CHECK(hiRes.takeDirtyBlocks() == 1u);
+
+  hiRes.write(Address{0x2800}, Address{0x0800}, 0x01);
+  CHECK(hiRes.dirtyBlocks() == 0);
+}
+
+TEST_CASE("Framebuffer.decodes hi-res colors", "[apple2][video]")
+{
+  Pages pages;
+  // Scanline 0: a lone dot in column 0 and one in column 1, then two dots next to each other.
+  pages.hiRes[0] = 0b0000'0011 | 0x00;
+  pages.hiRes[1] = 0b0000'0001 | 0x80;  // Column 7, odd, high bit set
+  // Scanline 1 of block 0: dots in columns 0 and 2 with the high bit set.
+  pages.hiRes[0x400] = 0b1000'0101;
+
+  Framebuffer framebuffer;
+  CHECK(framebuffer.update(c_hiRes, 0, pages.text, pages.hiRes) == TextVideoDevice::c_allRows);
+
+  CHECK(pixelAt(framebuffer, 0, 0) == 15);  // White, next to column 1
+  CHECK(pixelAt(framebuffer, 1, 0) == 15);
+  CHECK(pixelAt(framebuffer, 2, 0) == 0);
+  CHECK(pixelAt(framebuffer, 7, 0) == 9);  // Orange
+  CHECK(pixelAt(framebuffer, 0, 1) == 6);  // Blue
+  CHECK(pixelAt(framebuffer, 2, 1) == 6);
+  CHECK(pixelAt(framebuffer, 1, 1) == 0);
+
+  // A dot at the end of a byte next to one at the start of the next is white on both sides.
+  pages.hiRes[0x80 + 0] = 0x40;
+  pages.hiRes[0x80 + 1] = 0x01;
+  CHECK(framebuffer.update(c_hiRes, 1u << 1, pages.text, pages.hiRes) == (1u << 1));
+  CHECK(pixelAt(framebuffer, 6, 8) == 15);
+  CHECK(pixelAt(framebuffer, 7, 8) == 15);
+
+  // Column 8 is even, so lone dots there and in column 6 are purple. Column 9 is green.
+  pages.hiRes[0x80 + 1] = 0x02;
+  framebuffer.update(c_hiRes, 1u << 1, pages.text, pages.hiRes);
+  CHECK(pixelAt(framebuffer, 6, 8) == 3);  // Purple, column 6 is even
+  CHECK(pixelAt(framebuffer, 8, 8) == 3);
+  pages.hiRes[0x80 + 1] = 0x04;
+  framebuffer.update(c_hiRes, 1u << 1, pages.text, pages.hiRes);
+  CHECK(pixelAt(framebuffer, 9, 8) == 12);
+}
+
+TEST_CASE("Framebuffer.converts only the dirty blocks", "[apple2][video]")
+{
+  Pages pages;
+  pages.text[0x028] = 0x5A;  // Row 8: color $A on top, $5 below
+  Framebuffer framebuffer;
+  framebuffer.update(c_loRes, 0, pages.text, pages.hiRes);
+  CHECK(pixelAt(framebuffer, 0, 64) == 0x0A);
+  CHECK(pixelAt(framebuffer, 6, 67) == 0x0A);
+  CHECK(pixelAt(framebuffer, 6, 68) == 0x05);
+  CHECK(pixelAt(framebuffer, 7, 68) == 0x00);
+
+  // Changes outside the dirty blocks are not picked up until the blocks are reported.
+  pages.text[0x000] = 0x0F;
+  pages.text[0x028] = 0x00;
+  CHECK(framebuffer.update(c_loRes, 1u << 0, pages.text, pages.hiRes) == 1u);
+  CHECK(pixelAt(framebuffer, 0, 0) == 0x0F);
+  CHECK(pixelAt(framebuffer, 0, 64) == 0x0A);
+
+  // Mixed mode keeps the bottom four rows for text, which are cleared once.
+  VideoMode mixed = c_loRes;
+  mixed.mixed = true;
+  pages.text[0x3D0] = 0xFF;  // Row 23
+  CHECK(framebuffer.update(mixed, 0, pages.text, pages.hiRes) == TextVideoDevice::c_allRows);
+  CHECK(pixelAt(framebuffer, 0, 64) == 0x00);
+  CHECK(pixelAt(framebuffer, 0, 191) == 0x00);
+  CHECK(framebuffer.update(mixed, 1u << 23, pages.text, pages.hiRes) == 0);
+
+  auto block = framebuffer.block(0);
+  CHECK(std::ranges::count(block, Framebuffer::Pixel{0x0F}) == 7 * 4);
+}
@@ -0,0 +1,54 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#include "apple2/pacer.h"
+
+using apple2::Pacer;
+using namespace std::chrono_literals;
+
+TEST_CASE("Pacer never waits when unthrottled", "[apple2][pacer]")
+{
+  Pacer pacer{Pacer::Mode::Unthrottled};
+  auto start = Pacer::Clock::now();
+  pacer.pace(1'000'000'000);  // Over 16 minutes of emulated time
+  CHECK(Pacer::Clock::now() - start < 1s);
+  CHECK(pacer.cycles() == 1'000'000'000);
+  CHECK(pacer.resyncs() == 0);
+}
+
+TEST_CASE("Pacer keeps a multiple of real time across frames", "[apple2][pacer]")
+{
+  constexpr uint64_t c_frame = 17'030;
+  constexpr uint64_t c_frames = 20;
+  Pacer pacer{Pacer::Mode::Multiple, 10.0};
+  CHECK(pacer.mode() == Pacer::Mode::Multiple);
+
+  auto start = Pacer::Clock::now();
+  for (uint64_t frame = 0; frame < c_frames; ++frame)
+  {
+    pacer.pace(c_frame + frame % 3);  // Uneven frames, as with overshoot
+  }
+  auto elapsed = std::chrono::duration<double>(Pacer::Clock::now() - start).count();
+
+  double due = static_cast<double>(pacer.cycles()) / (Pacer::c_cpuHz * 10.0);
+  CHECK(elapsed >= due * 0.99);
+  CHECK(elapsed < due + 0.1);  // Generous, the host may be busy
+}
+
+TEST_CASE("Pacer drops time it has fallen too far behind on", "[apple2][pacer]")
+{
+  Pacer pacer;
+  std::this_thread::sleep_for(Pacer::c_maxLag + 50ms);
+  pacer.pace(1'000);
+  CHECK(pacer.resyncs() == 1);
+  CHECK(pacer.cycles() == 0);
+
+  // Once resynced it paces from now on instead of running flat out to catch up.
+  auto start = Pacer::Clock::now();
+  pacer.pace(10'205);  // About 10ms
+  CHECK(Pacer::Clock::now() - start >= 9ms);
+  CHECK(pacer.resyncs() == 1);
+}
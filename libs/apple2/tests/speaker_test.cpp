@@ -0,0 +1,111 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <span>
+#include <vector>
+
+#include "apple2/apple2system.h"
+#include "apple2/speaker.h"
+#include "common/address.h"
+#include "test_machine.h"
+
+using apple2::Apple2System;
+using apple2::Speaker;
+using apple2::TestMachine;
+using Common::Byte;
+
+namespace
+{
+
+// How often the samples change sign.
+size_t crossings(std::span<const Speaker::Sample> samples)
+{
+  size_t count = 0;
+  for (size_t index = 1; index < samples.size(); ++index)
+  {
+    count += (samples[index - 1] < 0) != (samples[index] < 0) ? 1u : 0u;
+  }
+  return count;
+}
+
+}  // namespace
+
+TEST_CASE("Speaker turns toggles into a band-limited square wave", "[apple2][speaker]")
+{
+  // Exactly 1 MHz, so a toggle every 500 cycles is a 1 kHz tone and a second is 44100 samples.
+  Speaker speaker{44'100.0, 1'000'000.0};
+  std::vector<Speaker::Sample> samples;
+  speaker.setOutput([&samples](std::span<const Speaker::Sample> output)
+      { samples.insert(samples.end(), output.begin(), output.end()); });
+
+  uint64_t cycle = 0;
+  for (uint64_t frame = 0; frame < 60; ++frame)
+  {
+    uint64_t end = (frame + 1) * 1'000'000ull / 60;
+    for (; cycle < end; cycle += 500)
+    {
+      speaker.toggle(cycle);
+    }
+    CHECK_FALSE(speaker.pendingToggles().empty());
+    speaker.synthesize(end);
+    CHECK(speaker.pendingToggles().empty());
+  }
+  REQUIRE(samples.size() == 44'100);
+
+  // Two sign changes per period once the high-pass has settled, and no clipping.
+  auto settled = std::span(samples).subspan(4410);
+  size_t count = crossings(settled);
+  CHECK(count >= 2 * 900 - 4);
+  CHECK(count <= 2 * 900 + 4);
+  auto [low, high] = std::ranges::minmax(settled);
+  CHECK(high > 5000);
+  CHECK(low < -5000);
+  CHECK(high < 32767);
+  CHECK(low > -32768);
+
+  // Without toggles the level dies away.
+  speaker.synthesize(2'000'000);
+  CHECK(std::abs(samples.back()) < 100);
+}
+
+TEST_CASE("Speaker synthesizes a full buffer by itself", "[apple2][speaker]")
+{
+  Speaker speaker{44'100.0, 1'000'000.0};
+  size_t delivered = 0;
+  speaker.setOutput([&delivered](std::span<const Speaker::Sample> output) { delivered += output.size(); });
+
+  for (uint64_t toggle = 0; toggle < Speaker::c_capacity + 10; ++toggle)
+  {
+    speaker.toggle(toggle * 4);
+  }
+  CHECK(speaker.pendingToggles().size() == 10);
+  CHECK(delivered == static_cast<size_t>(Speaker::c_capacity * 4 * 0.0441));
+}
+
+TEST_CASE("Apple2System times speaker toggles to the instruction", "[apple2][speaker]")
+{
+  // LDA $C030 (4 cycles); JMP $0800 (3 cycles)
+  constexpr std::array<Byte, 6> program{0xAD, 0x30, 0xC0, 0x4C, 0x00, 0x08};
+  for (auto engine : {Apple2System::Engine::Microcode, Apple2System::Engine::Instruction})
+  {
+    TestMachine machine{program};
+    auto system = machine.create(engine);
+
+    system->run(700);
+    auto toggles = system->speaker().pendingToggles();
+    REQUIRE(toggles.size() == 100);
+    for (size_t index = 0; index < toggles.size(); ++index)
+    {
+      CHECK(toggles[index] == index * 7);
+    }
+
+    size_t samples = 0;
+    system->speaker().setOutput([&samples](std::span<const Speaker::Sample> output) { samples += output.size(); });
+    system->speaker().synthesize(system->cycles());
+    CHECK(system->speaker().pendingToggles().empty());
+    CHECK(samples == static_cast<size_t>(700 * 44'100.0 / apple2::Pacer::c_cpuHz));
+  }
+}
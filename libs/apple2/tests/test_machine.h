@@ -0,0 +1,50 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+
+#include "apple2/apple2system.h"
+#include "common/address.h"
+
+namespace apple2
+{
+
+//! Memory for an Apple II with a program at $0800, which the reset vector points to. The system
+//! keeps pointers into it, so the machine has to stay where it is while a system created from it
+//! runs.
+struct TestMachine
+{
+  //! INC $10 (5 cycles) followed by JMP $0800 (3 cycles).
+  static constexpr std::array<Common::Byte, 5> c_counting{0xE6, 0x10, 0x4C, 0x00, 0x08};
+  static constexpr uint64_t c_loopCycles = 8;
+
+  std::array<Common::Byte, 0xC000> ram{};
+  std::array<Common::Byte, 0x3000> rom{};
+  std::array<Common::Byte, 0x1000> langBank0{};
+  std::array<Common::Byte, 0x1000> langBank1{};
+
+  explicit TestMachine(std::span<const Common::Byte> program = c_counting)
+  {
+    std::ranges::copy(program, ram.begin() + 0x0800);
+
+    // Reset vector at $FFFC, i.e. offset $2FFC into the ROM
+    rom[0x2FFC] = 0x00;
+    rom[0x2FFD] = 0x08;
+  }
+
+  //! A system on this memory, after reset. The system keeps pointers to its own devices, so it cannot
+  //! be returned by value. `mode` is an Apple2System::Engine or an Apple2System::Accuracy.
+  template<typename Mode = Apple2System::Engine>
+  std::unique_ptr<Apple2System> create(Mode mode = Apple2System::Engine::Microcode)
+  {
+    auto system = std::make_unique<Apple2System>(std::span(ram), std::span<const Common::Byte, 0x3000>(rom),
+        std::span(langBank0), std::span(langBank1), mode);
+    system->reset();
+    return system;
+  }
+};
+
+}  // namespace apple2
@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <string_view>
+
+#include "apple2/character_set.h"
+#include "apple2/text_video_device.h"
+#include "catch2/catch_test_macros.hpp"
+
+using apple2::TextVideoDevice;
+using Common::Address;
+using Common::Byte;
+
+TEST_CASE("TextVideoDevice.maps text page offsets to rows", "[apple2][video]")
+{
+  CHECK(TextVideoDevice::rowAt(0x000) == 0);
+  CHECK(TextVideoDevice::rowAt(0x080) == 1);
+  CHECK(TextVideoDevice::rowAt(0x028) == 8);
+  CHECK(TextVideoDevice::rowAt(0x050) == 16);
+  CHECK(TextVideoDevice::rowAt(0x3D0 + 39) == 23);
+
+  // The last 8 bytes of every 128 are not displayed.
+  CHECK_FALSE(TextVideoDevice::rowAt(0x078).has_value());
+  CHECK_FALSE(TextVideoDevice::rowAt(0x3FF).has_value());
+}
+
+TEST_CASE("TextVideoDevice.tracks the rows that changed", "[apple2][video]")
+{
+  std::array<Byte, TextVideoDevice::c_size> memory{};
+  TextVideoDevice video{memory};
+
+  // Everything is dirty until the screen is first taken.
+  CHECK(video.takeDirtyRows() == TextVideoDevice::c_allRows);
+  CHECK_FALSE(video.isDirty());
+
+  video.write(Address{0x0400}, Address{0x0000}, 0xC1);  // Row 0
+  video.write(Address{0x04A8}, Address{0x00A8}, 0xC1);  // Row 9
+  CHECK(video.dirtyRows() == ((1u << 0) | (1u << 9)));
+  CHECK(video.screen()[9][0] == static_cast<char>(0xC1));
+  CHECK(video.dirtyRows() == 0);
+
+  // Screen holes and stores of the same byte change nothing on screen.
+  video.write(Address{0x0478}, Address{0x0078}, 0x12);
+  video.write(Address{0x0400}, Address{0x0000}, 0xC1);
+  CHECK_FALSE(video.isDirty());
+  CHECK(memory[0x78] == 0x12);
+
+  video.write(Address{0x07F7}, Address{0x03F7}, 0xA0);  // Row 23, last column
+  CHECK(video.takeDirtyRows() == (1u << 23));
+
+  video.markDirty();
+  CHECK(video.dirtyRows() == TextVideoDevice::c_allRows);
+}
+
+TEST_CASE("TextVideoDevice.exports the screen as ASCII", "[apple2][video]")
+{
+  CHECK(apple2::screenToAscii(0xC1) == 'A');  // Normal
+  CHECK(apple2::screenToAscii(0x01) == 'A');  // Inverse
+  CHECK(apple2::screenToAscii(0x41) == 'A');  // Flashing
+  CHECK(apple2::screenToAscii(0xA0) == ' ');
+  CHECK(apple2::screenToAscii(0x3F) == '?');
+  CHECK(apple2::screenToAscii(0xDD) == ']');
+#ifdef EMULATE_ENHANCED_IIE
+  CHECK(apple2::screenToAscii(0xE1) == 'a');
+#else
+  CHECK(apple2::screenToAscii(0xE1) == '!');
+#endif
+
+  std::array<Byte, TextVideoDevice::c_size> memory{};
+  memory.fill(0xA0);
+  constexpr std::array<Byte, 3> prompt{0xDD, 0x01, 0x42};
+  std::ranges::copy(prompt, memory.begin() + 0x3D0);  // Row 23
+  TextVideoDevice video{memory};
+
+  std::array<char, TextVideoDevice::c_rows * TextVideoDevice::c_columns> text{};
+  CHECK(video.exportScreen(text) == TextVideoDevice::c_rows);
+  CHECK(std::string_view(text.data() + 23 * TextVideoDevice::c_columns, 4) == "]AB ");
+  CHECK(std::ranges::count(text, ' ') == static_cast<std::ptrdiff_t>(text.size() - 3));
+  CHECK(video.dirtyRows() == TextVideoDevice::c_allRows);
+
+  // Only whole rows are written.
+  std::array<char, 100> partial{};
+  CHECK(video.exportScreen(partial) == 2);
+  CHECK(partial[80] == 0);
+}
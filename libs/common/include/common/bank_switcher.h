@@ -1,8 +1,11 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
+#include <optional>
 #include <span>
-#include <variant>
+#include <stdexcept>
 
 #include "common/address.h"
 #include "common/bus.h"
@@ -10,6 +13,10 @@
 namespace Common
 {
 
+//! A window onto one of several banks of RAM or ROM. Reads and writes can come from different banks,
+//! as on the Apple II language card, which can read ROM while writing the RAM behind it. The device
+//! exposes the selected banks as direct memory, so accesses through a Bus cost nothing extra; after
+//! selecting other banks the owner calls Bus::remap() for the window.
 template<size_t BankCount, size_t BankSize>
 class BankSwitcher : public Bus::Device
 {
@@ -19,62 +26,96 @@ public:
 
   template<typename... Spans>
   constexpr BankSwitcher(Spans... banks)
-    : m_banks{banks...}
+    : m_banks{Bank{banks}...}
+    , m_size{std::min({banks.size()...})}
   {
     static_assert(sizeof...(banks) == BankCount);
+    selectBank(0);
   }
 
+  //! Reads and writes `bank`. Writes are ignored if it is ROM.
   constexpr void selectBank(size_t bank) noexcept
   {
-    if (bank < BankCount)
-      m_activeBank = bank;
+    selectBanks(bank, bank);
   }
 
-  Byte read(Address /*address*/, Address normalizedAddress) const override
+  //! Reads `readBank` and writes `writeBank`, or ignores writes if there is none or it is ROM.
+  constexpr void selectBanks(size_t readBank, std::optional<size_t> writeBank) noexcept
   {
-    // Address has already been validated & normalized by Bus
-    assert(static_cast<size_t>(normalizedAddress) < BankSize);
-
-    const auto& activeBank = m_banks[m_activeBank];
-    if (std::holds_alternative<RamBank>(activeBank))
-    {
-      return std::get<RamBank>(activeBank)[static_cast<size_t>(normalizedAddress)];
-    }
-    else if (std::holds_alternative<RomBank>(activeBank))
+    if (readBank >= BankCount || (writeBank && *writeBank >= BankCount))
     {
-      return std::get<RomBank>(activeBank)[static_cast<size_t>(normalizedAddress)];
+      return;
     }
-    throw std::runtime_error("Invalid bank type");
+    m_activeBank = readBank;
+    m_writeBank = writeBank;
+    m_read = m_banks[readBank].read;
+    m_write = writeBank ? m_banks[*writeBank].write : nullptr;
   }
 
-  void write(Address /*address*/, Address normalizedAddress, Byte value) override
+  //! The bank reads come from.
+  constexpr size_t activeBank() const noexcept
   {
-    // Address has already been validated & normalized by Bus
-    assert(static_cast<size_t>(normalizedAddress) < BankSize);
+    return m_activeBank;
+  }
 
-    auto& activeBank = m_banks[m_activeBank];
-    if (std::holds_alternative<RamBank>(activeBank))
+  constexpr std::optional<size_t> writeBank() const noexcept
+  {
+    return m_writeBank;
+  }
+
+  Byte read(Address /*address*/, Address normalizedAddress) const override
+  {
+    auto offset = static_cast<size_t>(normalizedAddress);
+    if (offset >= m_size)
     {
-      std::get<RamBank>(activeBank)[static_cast<size_t>(normalizedAddress)] = value;
+      throw std::out_of_range("Address outside the bank");
     }
-    else
+    return m_read[offset];
+  }
+
+  void write(Address /*address*/, Address normalizedAddress, Byte value) override
+  {
+    auto offset = static_cast<size_t>(normalizedAddress);
+    if (m_write != nullptr && offset < m_size)
     {
-      throw std::runtime_error("Attempt to write to read-only bank");
+      m_write[offset] = value;
     }
   }
 
+  Bus::DirectMemory directMemory() noexcept override
+  {
+    return {m_read, m_write, m_size, m_write == nullptr};
+  }
+
   constexpr size_t size() const noexcept
   {
-    return BankSize;
+    return m_size;
   }
 
 private:
-  using RamBank = std::span<Common::Byte, BankSize>;
-  using RomBank = std::span<const Common::Byte, BankSize>;
-  using Bank = std::variant<RamBank, RomBank>;
+  struct Bank
+  {
+    constexpr Bank(std::span<Byte, BankSize> ram) noexcept
+      : read(ram.data())
+      , write(ram.data())
+    {
+    }
+
+    constexpr Bank(std::span<const Byte, BankSize> rom) noexcept
+      : read(rom.data())
+    {
+    }
+
+    const Byte* read = nullptr;
+    Byte* write = nullptr;  // nullptr for ROM
+  };
 
   std::array<Bank, BankCount> m_banks;
+  size_t m_size;
   size_t m_activeBank = 0;
+  std::optional<size_t> m_writeBank;
+  const Byte* m_read = nullptr;
+  Byte* m_write = nullptr;
 };
 
 template<typename T, size_t BankSize, typename... Spans>
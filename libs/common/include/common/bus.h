@@ -1,8 +1,13 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <bitset>
 #include <cstdint>
-#include <span>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "common/address.h"
 
@@ -12,6 +17,27 @@ namespace Common
 //! A simple bus that maps address ranges to devices. Each device must implement the
 //! Device interface with read and write methods. The bus will route read and write
 //! requests to the appropriate device based on the address.
+//!
+//! Entries may overlap; the first entry (in array order) that contains an address wins. To avoid
+//! searching the entries on every access, the bus resolves each 256-byte page once at construction.
+//! Pages that are owned entirely by one entry are routed straight through the page table, pages that
+//! are split between entries fall back to the linear search.
+//!
+//! Devices that are plain memory (RAM, ROM) can expose their backing storage. The bus then stores a
+//! raw pointer for each page they own and reads or writes that storage directly, so only I/O pages
+//! pay for the virtual Device call.
+//!
+//! Every page also counts the writes to it and the times it was mapped again, see generation(), so a
+//! cache of decoded code can tell when the bytes it decoded may have changed. Pages can also record
+//! that they were written in a bitmap, see trackWrites(), for anything that only wants to look at the
+//! memory that changed since it last looked.
+//!
+//! For debuggers the bus keeps breakpoints and watchpoints. Neither costs anything while it is not
+//! armed: a breakpoint only sets a bit for its page that the owner asks about at instruction
+//! boundaries, see isBreakpoint(). A watched page is routed through a device of the bus that checks
+//! every access before passing it on, so only accesses to watched pages pay for the check.
+//!
+//! The bus does not record the accesses it routes. Wrap a device in a TracingDevice to capture them.
 class Bus
 {
 public:
@@ -19,7 +45,21 @@ public:
   using Byte = Common::Byte;
 
   static constexpr size_t c_maxDevices{16};
-  static constexpr size_t c_maxCycles{16};
+  static constexpr size_t c_pageSize{0x100};
+  static constexpr size_t c_pageCount{0x100};
+
+  //! One bit per page.
+  using PageBitmap = std::bitset<c_pageCount>;
+
+  //! Backing storage a device exposes for direct access, indexed by normalized address.
+  struct DirectMemory
+  {
+    const Byte* read = nullptr;  // nullptr if reads must go through the device
+    Byte* write = nullptr;  // nullptr if writes must go through the device (or are ignored)
+    size_t size = 0;  // Number of bytes available through the pointers
+    bool readOnly = false;  // Writes are ignored, the device does not need to see them
+    bool remapOnWrite = false;  // A write through the device may change the storage of its page
+  };
 
   class Device
   {
@@ -27,15 +67,71 @@ public:
     virtual ~Device() = default;
     virtual Byte read(Address address, Address normalizedAddress) const = 0;
     virtual void write(Address address, Address normalizedAddress, Byte value) = 0;
+
+    //! Override to let the bus bypass read()/write() for this device. The storage must stay valid
+    //! (and at the same address) for the lifetime of the bus.
+    virtual DirectMemory directMemory() noexcept
+    {
+      return {};
+    }
+
+    //! Storage for the page at normalized address `offset`. Devices whose storage is not contiguous
+    //! override this instead of directMemory(). The bus asks again after every write through the
+    //! device if the page has remapOnWrite set, or when remap() is called.
+    virtual DirectMemory directPage(size_t offset) noexcept
+    {
+      DirectMemory memory = directMemory();
+      if (offset + c_pageSize > memory.size)
+      {
+        return {};
+      }
+      return {memory.read != nullptr ? memory.read + offset : nullptr,
+          memory.write != nullptr ? memory.write + offset : nullptr, c_pageSize, memory.readOnly, memory.remapOnWrite};
+    }
+  };
+
+  //! How the bus accesses pages owned by devices that expose direct memory.
+  enum class MemoryAccess
+  {
+    Device,  // Always call through the Device interface
+    Direct,  // Read and write the exposed storage directly
   };
 
   struct Entry
   {
     Address start;  // inclusive start
-    Address end;  // exclusive end
+    Address end;  // inclusive end
     Device* device;
   };
 
+  //! What a watchpoint looks at.
+  enum class Access : uint8_t
+  {
+    Read = 1,
+    Write = 2,
+    ReadWrite = 3,
+  };
+
+  struct Watchpoint
+  {
+    Address first;  // inclusive
+    Address last;  // inclusive
+    Access access = Access::ReadWrite;
+
+    bool operator==(const Watchpoint&) const noexcept = default;
+  };
+
+  //! An access a watchpoint saw.
+  struct WatchHit
+  {
+    Address address;
+    Byte value;
+    bool isRead;
+
+    bool operator==(const WatchHit&) const noexcept = default;
+  };
+
+  //! One bus access, as recorded by TracingDevice.
   struct Cycle
   {
     Address address;
@@ -45,23 +141,192 @@ public:
     bool operator==(const Cycle& cycle) const noexcept = default;
   };
 
-  explicit Bus(std::array<Entry, c_maxDevices> devices) noexcept;
+  explicit Bus(std::array<Entry, c_maxDevices> devices, MemoryAccess access = MemoryAccess::Direct) noexcept;
 
-  Byte read(Address address) const;
-  void write(Address address, Byte value);
+  Bus(const Bus&) = delete;
+  Bus& operator=(const Bus&) = delete;
 
-  std::span<const Cycle> cycles() const noexcept
+  Byte read(Address address) const
   {
-    size_t count = m_cycleIndex;
-    m_cycleIndex = 0;  // Reset for next instruction
-    return {m_cycles.data(), count};
+    const Page& page = m_pages[HiByte(address)];
+    if (page.read != nullptr)
+    {
+      return page.read[LoByte(address)];
+    }
+    return readDevice(address);
+  }
+
+  void write(Address address, Byte value)
+  {
+    Page& page = m_pages[HiByte(address)];
+    if (page.write != nullptr)
+    {
+      ++page.generation;
+      if (page.trackWrites)
+      {
+        markWritten(HiByte(address));
+      }
+      page.write[LoByte(address)] = value;
+      return;
+    }
+    if (page.readOnly)
+    {
+      return;
+    }
+    ++page.generation;
+    if (page.trackWrites)
+    {
+      markWritten(HiByte(address));
+    }
+    writeDevice(address, value);
+    if (page.remapOnWrite)
+    {
+      mapPage(HiByte(address));
+    }
+  }
+
+  //! Asks the devices for the storage of the pages from `first` to `last` again, after a device
+  //! changed it without a write going through the bus.
+  void remap(Address first, Address last) noexcept;
+
+  //! Reads a byte without any side effects, for debuggers and profilers. Only pages with direct
+  //! memory can be peeked, anything else (I/O, split pages) returns nothing.
+  std::optional<Byte> peek(Address address) const noexcept
+  {
+    const Page& page = m_pages[HiByte(address)];
+    if (page.read == nullptr)
+    {
+      return std::nullopt;
+    }
+    return page.read[LoByte(address)];
+  }
+
+  //! Changes whenever what reads of page `page` return may have changed without the page being read:
+  //! on every write to it that is not dropped and whenever it is mapped again. Starts at 0 and wraps.
+  uint32_t generation(size_t page) const noexcept
+  {
+    return m_pages[page].generation;
+  }
+
+  //! Starts or stops recording writes to the pages from `first` to `last`. A recorded write costs one
+  //! OR into a 256-bit mask, pages that are not tracked only test a flag they already have loaded.
+  //! Writes that are dropped are not recorded.
+  void trackWrites(Address first, Address last, bool enable) noexcept;
+
+  //! The tracked pages written since the last takeWrittenPages().
+  PageBitmap writtenPages() const noexcept;
+
+  //! writtenPages(), clearing them. Can be called from another thread than the one running the bus: a
+  //! write that happens meanwhile is reported by this call or the next one, never lost, although
+  //! it may be reported by both.
+  PageBitmap takeWrittenPages() noexcept;
+
+  //! Adds a breakpoint at `address`. The bus only remembers it; the owner running the CPU asks
+  //! isBreakpoint() at instruction boundaries while hasDebugPoints() is true.
+  void addBreakpoint(Address address);
+  void removeBreakpoint(Address address) noexcept;
+
+  //! True if there is a breakpoint at `address`. Pages without one answer from their page bit.
+  bool isBreakpoint(Address address) const noexcept
+  {
+    return m_pages[HiByte(address)].breakpoint && findBreakpoint(address);
+  }
+
+  //! Starts watching the accesses of `watchpoint.access` from `first` to `last`. The pages in that
+  //! range are routed through the checking device until no watchpoint covers them any more, which
+  //! also means they cannot be peeked.
+  void addWatchpoint(Watchpoint watchpoint);
+  void removeWatchpoint(Watchpoint watchpoint) noexcept;
+
+  //! The first access a watchpoint saw since the last call, which clears it.
+  std::optional<WatchHit> takeWatchHit() noexcept
+  {
+    return std::exchange(m_watchHit, std::nullopt);
+  }
+
+  //! True while a breakpoint or watchpoint is set.
+  bool hasDebugPoints() const noexcept
+  {
+    return !m_breakpoints.empty() || !m_watchpoints.empty();
   }
 
 private:
+  // Takes the place of the devices of watched pages, see addWatchpoint().
+  class WatchDevice : public Device
+  {
+  public:
+    explicit WatchDevice(Bus& bus) noexcept
+      : m_bus(bus)
+    {
+    }
+
+    Byte read(Address address, Address normalizedAddress) const override;
+    void write(Address address, Address normalizedAddress, Byte value) override;
+
+  private:
+    Bus& m_bus;
+  };
+
+  //! Routing information for one 256-byte page.
+  struct Page
+  {
+    const Byte* read = nullptr;  // Direct read pointer for this page, indexed by the low byte
+    Byte* write = nullptr;  // Direct write pointer for this page, indexed by the low byte
+    Device* device = nullptr;  // Device that owns the whole page, nullptr if unmapped
+    Address start{0};  // Start of the owning entry, used to normalize addresses
+    bool readOnly = false;  // Writes are dropped without calling the device
+    bool split = false;  // More than one entry claims part of this page
+    bool remapOnWrite = false;  // Map the page again after a write through the device
+    uint32_t generation = 0;  // See generation()
+    bool trackWrites = false;  // See trackWrites(), kept when the page is mapped again
+    bool breakpoint = false;  // A breakpoint is set in this page, kept when the page is mapped again
+    bool watched = false;  // Routed through m_watchDevice, kept when the page is mapped again
+  };
+
+  static constexpr size_t c_wordBits = 64;
+
+  void markWritten(size_t index) noexcept
+  {
+    // Only the thread running the bus sets bits, so a load and a store do instead of an atomic OR.
+    // takeWrittenPages() clearing the word in between can only bring back bits it already took.
+    std::atomic<uint64_t>& word = m_written[index / c_wordBits];
+    word.store(word.load(std::memory_order_relaxed) | (uint64_t{1} << (index % c_wordBits)), std::memory_order_relaxed);
+  }
+
+  // Slow paths for pages without direct memory.
+  Byte readDevice(Address address) const;
+  void writeDevice(Address address, Byte value);
+
+  // Linear search used to build the page table and to route accesses to split pages.
+  const Entry* findEntry(Address address) const noexcept;
+
+  void buildPageTable() noexcept;
+  void mapPage(size_t index) noexcept;
+
+  // Returns the device and entry start address of `page` that handle the given address.
+  std::pair<Device*, Address> route(const Page& page, Address address) const noexcept;
+
+  bool findBreakpoint(Address address) const noexcept;
+
+  // Accesses to watched pages, passed on to how the page would be routed if it was not watched.
+  Byte readWatched(Address address) const;
+  void writeWatched(Address address, Byte value);
+  void recordWatchHit(Address address, Byte value, Access access) const noexcept;
+  void updateWatchedPages(Address first, Address last) noexcept;
+
   std::array<Entry, c_maxDevices> m_devices;
-  // Longest possible instruction is 7 cycles I think.
-  mutable std::array<Cycle, c_maxCycles> m_cycles;
-  mutable size_t m_cycleIndex = 0;
+  std::array<Page, c_pageCount> m_pages{};
+  std::array<std::atomic<uint64_t>, c_pageCount / c_wordBits> m_written{};  // See markWritten()
+  MemoryAccess m_access;
+
+  std::vector<Address> m_breakpoints;
+  std::vector<Watchpoint> m_watchpoints;
+  std::unique_ptr<std::array<Page, c_pageCount>> m_unwatched;  // How watched pages are really routed
+  WatchDevice m_watchDevice{*this};
+  mutable std::optional<WatchHit> m_watchHit;  // Set by reads too, see takeWatchHit()
 };
 
+//! See Bus::PageBitmap.
+using PageBitmap = Bus::PageBitmap;
+
 }  // namespace Common
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace Common
+{
+
+//! RAM that starts out as a view of an image shared with any number of other devices. The image is
+//! never written: the first write to one of its pages gives this device a private copy of that page,
+//! and only touched pages use memory of their own.
+//!
+//! Reads always go straight through the bus page table. Writes to shared pages go through write(),
+//! which copies the page and lets the bus map the copy for direct writes from then on.
+class CopyOnWriteMemory : public Bus::Device
+{
+public:
+  using Address = Common::Address;
+  using Byte = Common::Byte;
+  using Page = std::array<Byte, Bus::c_pageSize>;
+
+  //! `image` is kept alive for as long as the device uses it. Its size must be a whole number of pages.
+  CopyOnWriteMemory(std::shared_ptr<const Byte> image, size_t size);
+
+  size_t size() const noexcept
+  {
+    return m_pages.size() * Bus::c_pageSize;
+  }
+
+  //! Number of pages this device has its own copy of.
+  size_t privatePages() const noexcept;
+
+  //! Shares `image` again, dropping every private page. Call Bus::remap() for the range afterwards.
+  void share(std::shared_ptr<const Byte> image);
+
+  //! Makes the contents equal to `memory`, copying only the pages that differ. Call Bus::remap() for
+  //! the range afterwards.
+  void assign(std::span<const Byte> memory);
+
+  void copyTo(std::span<Byte> memory) const noexcept;
+
+  Byte read(Address address, Address normalizedAddress) const override;
+  void write(Address address, Address normalizedAddress, Byte value) override;
+  Bus::DirectMemory directPage(size_t offset) noexcept override;
+
+private:
+  struct PageEntry
+  {
+    const Byte* read = nullptr;  // The shared page or the private copy
+    std::unique_ptr<Page> copy;  // nullptr while the page is shared
+  };
+
+  Page& makePrivate(PageEntry& entry);
+
+  std::shared_ptr<const Byte> m_image;
+  std::vector<PageEntry> m_pages;
+};
+
+}  // namespace Common
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+
+namespace Common
+{
+
+//! Deadlines on the CPU's cycle count for the devices of one machine. A device adds its handler once
+//! and then schedules it for the cycle it next needs to act at; the owner runs the CPU uninterrupted up
+//! to nextDeadline() and calls runDue() there, so no device has to be polled in between. Each handler
+//! has at most one deadline, scheduling it again moves it. The deadlines are kept in a binary min-heap
+//! that knows where each handler is, so moving or cancelling one does not leave stale entries behind.
+class EventQueue
+{
+public:
+  //! Called with the cycle count runDue() was given, which can be past the deadline when the CPU
+  //! could not stop exactly on it.
+  using Handler = std::function<void(uint64_t cycle)>;
+  using Id = size_t;
+
+  static constexpr uint64_t c_never{std::numeric_limits<uint64_t>::max()};
+
+  //! Registers `handler`, which is not scheduled yet.
+  Id add(Handler handler);
+
+  //! Has the handler run once the cycle count reaches `cycle`, replacing its previous deadline.
+  //! Handlers due on the same cycle run in the order they were scheduled.
+  void schedule(Id id, uint64_t cycle);
+
+  void cancel(Id id) noexcept;
+
+  [[nodiscard]] bool isScheduled(Id id) const noexcept
+  {
+    return m_events[id].position != c_unscheduled;
+  }
+
+  //! The earliest deadline, c_never if nothing is scheduled.
+  [[nodiscard]] uint64_t nextDeadline() const noexcept
+  {
+    return m_heap.empty() ? c_never : m_events[m_heap.front()].cycle;
+  }
+
+  //! The cycle count as of the last runDue(), for devices that schedule from a bus access.
+  [[nodiscard]] uint64_t now() const noexcept
+  {
+    return m_now;
+  }
+
+  //! Runs the handlers due by `cycle`, earliest deadline first. A handler may schedule itself or
+  //! others again; if it schedules one at or before `cycle`, that one runs in this call as well.
+  void runDue(uint64_t cycle)
+  {
+    m_now = cycle;
+    if (nextDeadline() <= cycle)
+    {
+      runHandlers(cycle);
+    }
+  }
+
+  //! Moves every deadline and now() back by `cycles`, for when the owner's cycle count starts over.
+  void rewind(uint64_t cycles) noexcept;
+
+private:
+  static constexpr size_t c_unscheduled{std::numeric_limits<size_t>::max()};
+
+  struct Event
+  {
+    Handler handler;
+    uint64_t cycle = 0;
+    uint64_t sequence = 0;  // Orders events due on the same cycle
+    size_t position = c_unscheduled;  // Index in m_heap
+  };
+
+  bool earlier(Id lhs, Id rhs) const noexcept
+  {
+    const Event& a = m_events[lhs];
+    const Event& b = m_events[rhs];
+    return a.cycle != b.cycle ? a.cycle < b.cycle : a.sequence < b.sequence;
+  }
+
+  void place(size_t position, Id id) noexcept
+  {
+    m_heap[position] = id;
+    m_events[id].position = position;
+  }
+
+  void runHandlers(uint64_t cycle);
+  void siftUp(size_t position) noexcept;
+  void siftDown(size_t position) noexcept;
+  void remove(size_t position) noexcept;
+
+  std::vector<Event> m_events;
+  std::vector<Id> m_heap;
+  uint64_t m_sequence = 0;
+  uint64_t m_now = 0;
+};
+
+}  // namespace Common
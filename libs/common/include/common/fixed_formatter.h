@@ -34,6 +34,9 @@ public:
   // Write an address as 4 hex digits
   FixedFormatter& operator<<(Common::Address addr) noexcept;
 
+  // Write an integer in decimal
+  FixedFormatter& operator<<(int value) noexcept;
+
   // Null-terminate and return used length
   std::string_view finalize() noexcept;
 };
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "common/address.h"
+
+namespace Common
+{
+
+//! Histogram of cycles spent per instruction address across the 64K address space. It is fed one
+//! instruction boundary at a time: every call to instructionStart() charges the instruction that
+//! started at the previous boundary with the cycles since then.
+class HotSpotProfile
+{
+public:
+  using Histogram = std::array<uint64_t, 0x10000>;
+
+  //! An instruction starts at `pc` when `cycle` cycles have been executed.
+  void instructionStart(Address pc, uint64_t cycle) noexcept
+  {
+    flush(cycle);
+    m_pc = pc;
+    m_active = true;
+  }
+
+  //! Charges the instruction in progress with the cycles up to `cycle`.
+  void flush(uint64_t cycle) noexcept
+  {
+    if (m_active)
+    {
+      m_cycles[static_cast<size_t>(m_pc)] += cycle - m_start;
+    }
+    m_start = cycle;
+  }
+
+  [[nodiscard]] uint64_t cycles(Address pc) const noexcept
+  {
+    return m_cycles[static_cast<size_t>(pc)];
+  }
+
+  [[nodiscard]] const Histogram& histogram() const noexcept
+  {
+    return m_cycles;
+  }
+
+private:
+  Histogram m_cycles{};
+  uint64_t m_start = 0;  // Cycle at which the instruction in progress started
+  Address m_pc{0};
+  bool m_active = false;  // An instruction is in progress
+};
+
+}  // namespace Common
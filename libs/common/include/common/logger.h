@@ -15,8 +15,8 @@ namespace common
 enum class LogLevel
 {
   None,  // No logging output
-  Minimal,  // Instruction disassembly only
-  Verbose  // Instruction disassembly + bus cycles
+  Minimal,  // Instruction disassembly and device events, such as a disk being loaded
+  Verbose  // Also bus cycles and every device register access
 };
 
 #ifdef EMULATE_ENABLE_LOGGING
@@ -31,10 +31,19 @@ public:
   // Function pointer type for log output
   using OutputFunc = void (*)(std::string_view output);
 
+  //! Longest line LOG formats, longer ones are cut off.
+  static constexpr size_t c_maxLineSize{256};
+
   // Runtime level control
   static void setLevel(LogLevel level) noexcept;
   static LogLevel level() noexcept;
 
+  //! True if statements at `level` are output at the current runtime level.
+  static bool isEnabled(LogLevel level) noexcept
+  {
+    return level != LogLevel::None && level <= Logger::level();
+  }
+
   // Override output destination (default is stdout)
   static void setOutputFunc(OutputFunc func) noexcept;
 
@@ -49,13 +58,23 @@ public:
 
 // Convenience macros that compile to nothing if logging disabled
 
-// For normal execution - reads from memory span
-#define LOG(str)                         \
-  if constexpr (common::logging_enabled) \
-  {                                      \
-    common::Logger logger;               \
-    logger.output(str);                  \
-  }                                      \
+//! Outputs one line at `level`, formatted from a chain of FixedFormatter insertions:
+//!
+//!   LOG(LogLevel::Verbose, "read(" << address << ")");
+//!
+//! `message` is only evaluated if logging is compiled in and `level` is enabled at runtime, and it is
+//! formatted into a buffer on the stack, so a log statement never allocates.
+#define LOG(level, message)                                         \
+  if constexpr (common::logging_enabled)                            \
+  {                                                                 \
+    if (common::Logger::isEnabled(level))                           \
+    {                                                               \
+      std::array<char, common::Logger::c_maxLineSize> logBuffer{};  \
+      Common::FixedFormatter logFormatter{logBuffer};               \
+      logFormatter << message;                                      \
+      common::Logger{}.output(logFormatter.finalize());             \
+    }                                                               \
+  }                                                                 \
   ((void) 0)  // Force semicolon
 
 }  // namespace common
@@ -65,6 +65,14 @@ public:
     }
   }
 
+  Bus::DirectMemory directMemory() noexcept override
+  {
+    if constexpr (std::is_const_v<ValueType>)
+      return {m_memory.data(), nullptr, m_memory.size(), true};
+    else
+      return {m_memory.data(), m_memory.data(), m_memory.size(), false};
+  }
+
 private:
   std::span<ValueType> m_memory;
 };
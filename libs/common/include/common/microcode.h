@@ -1,5 +1,8 @@
 #pragma once
 
+#include <cstdint>
+#include <exception>
+
 #include "common/address.h"
 #include "common/bus.h"
 #include "common/microcode_pump.h"
@@ -13,6 +16,8 @@ namespace Common
 //! CPU state, and the Bus object represents the bus interface to read and write memory and I/O. The
 //! microcode can return a Response object that contains a Microcode function to inject into the
 //! stream, or nullptr if none.
+//!
+//! The State is normally the CPU definition itself, so it also carries the trap state declared here.
 
 template<typename AddressType, typename DataType, typename StateType>
 struct ProcessorDefinition
@@ -21,8 +26,8 @@ struct ProcessorDefinition
   using Data = DataType;
   using State = StateType;
 
-  //! Exception thrown when the CPU encounters a trap condition, such as a self-jump
-  //! or self branch.
+  //! Exception for callers that turn a trap into an error, such as Apple2System::run(). The CPU
+  //! itself never throws it, see trap().
   class TrapException : public std::exception
   {
   public:
@@ -45,29 +50,26 @@ struct ProcessorDefinition
     Address m_address;
   };
 
-  //! Trap exception handler. If set, this function will be called when a trap is triggered.
-  //! If not set, a TrapException will be thrown.
-  using TrapHandler = void (*)(Address pc);
-
-  // Default trap handler that throws
-  static void defaultTrapHandler(Address trapAddress)
+  //! What a CPU does when it detects a trap, such as a self-jump or self-branch.
+  enum class TrapPolicy : uint8_t
   {
-    throw TrapException(trapAddress);
-  }
+    Stop,  // Record the trap, MicrocodePump::runFor() ends the batch at the next instruction boundary
+    Ignore,  // Keep running, e.g. to benchmark a program that spins on its trap
+  };
 
-  // Static function pointer with default value
-  static inline TrapHandler trapHandler = defaultTrapHandler;
+  // Trap handling is part of the CPU state, so CPUs on different threads can use different policies.
+  TrapPolicy trapPolicy = TrapPolicy::Stop;
+  bool trapped = false;  // A trap was recorded and has not been reported yet
+  Address trapAddress{};  // Address of the trapping instruction, only valid if trapped
 
-  // Convenience function for microcode to call
-  static void trap(Address address)
+  //! Called by microcode. The trapping instruction still runs to completion.
+  constexpr void trap(Address address) noexcept
   {
-    trapHandler(address);
-  }
-
-  // Function to change the trap handler (for testing)
-  static void setTrapHandler(TrapHandler handler)
-  {
-    trapHandler = handler ? handler : defaultTrapHandler;
+    if (trapPolicy == TrapPolicy::Stop)
+    {
+      trapped = true;
+      trapAddress = address;
+    }
   }
 
   // You must define two static methods to pump microcodes into the MicrocodePump:
@@ -1,27 +1,101 @@
 #pragma once
 
+#include <cassert>
 #include <concepts>
 #include <cstdint>
 #include <tuple>
+#include <utility>
+
+#include "common/profiler.h"
+
+//! Why MicrocodePump::runFor() returned.
+enum class RunStatus
+{
+  Completed,  // The cycle budget was used up
+  Stopped,  // The stop predicate asked to stop at an instruction boundary
+  Trapped,  // The CPU recorded a trap, the run ended after the trapping instruction
+  Breakpoint,  // A breakpoint or watchpoint on the bus hit, only reported by owners that check them
+};
+
+//! Stop predicate for runFor() that never stops early.
+struct NeverStop
+{
+  template<typename State>
+  constexpr bool operator()(const State& /*cpu*/) const noexcept
+  {
+    return false;
+  }
+};
+
+//! A runFor() stop predicate takes the CPU state, and optionally the number of cycles executed
+//! before the instruction boundary it is called at.
+template<typename Predicate, typename State>
+concept StopCondition =
+    std::predicate<Predicate&, const State&> || std::predicate<Predicate&, const State&, uint64_t>;
+
+template<typename State, StopCondition<State> Predicate>
+bool shouldStop(Predicate& stop, const State& cpu, uint64_t cycle)
+{
+  if constexpr (std::predicate<Predicate&, const State&, uint64_t>)
+  {
+    return stop(cpu, cycle);
+  }
+  else
+  {
+    return stop(cpu);
+  }
+}
 
 // MicrocodePump - executes microcode operations in sequence, fetching opcodes as needed.
 // The CpuDefinition template parameter must define the following types and static methods:
+//
+// For snapshot() and restore() it must also number its microcode the same way in every build:
+//   static uint16_t microcodeIndex(Microcode microcode) noexcept;
+//   static Microcode microcode(uint16_t index) noexcept;  // nullptr if no microcode has that number
+//
+// The Profiler policy is told about every opcode fetch, see Common::OpcodeProfiler. The default
+// NullProfiler adds no code and no storage.
 
-template<typename CpuDefinition>
+template<typename CpuDefinition, typename Profiler = Common::NullProfiler>
 class MicrocodePump
 {
 public:
   using State = typename CpuDefinition::State;
   using BusToken = typename CpuDefinition::BusToken;
   using Microcode = typename CpuDefinition::Microcode;
+  using Address = typename CpuDefinition::Address;
+
+  struct RunResult
+  {
+    uint64_t cycles = 0;  // Cycles executed by this call
+    RunStatus status = RunStatus::Completed;
+    Address trapAddress{};  // Only valid if status is Trapped
+  };
+
+  //! Everything the pump needs to carry on where it left off, trivially copyable. The microcode in
+  //! progress is stored as CpuDefinition::microcodeIndex() rather than its address, so another build
+  //! of the same CPU can restore it.
+  struct Snapshot
+  {
+    uint16_t microcode = 0;  // Only valid if inInstruction
+    uint64_t cycles = 0;
+    bool inInstruction = false;
+    bool stopped = false;
+  };
 
   MicrocodePump() = default;
 
   bool tick(State& cpu, BusToken bus)
   {
+    m_stopped = false;
     if (!m_nextMicrocode)
     {
+      m_instructionStart = m_cycles;
       m_nextMicrocode = CpuDefinition::fetchNextOpcode(cpu, bus);  // Fetch next opcode
+      if constexpr (Profiler::enabled)
+      {
+        m_profiler.fetched(cpu.opcode, m_cycles);
+      }
     }
     else
     {
@@ -33,12 +107,123 @@ public:
     return m_nextMicrocode != nullptr;
   }
 
+  //! Runs up to `cycles` cycles in one call. This is the same as calling tick() in a loop, but the
+  //! next microcode and the cycle count stay in locals for the whole batch. The batch may end in the
+  //! middle of an instruction; the next call picks up where this one left off.
+  //!
+  //! `stop` is called with the CPU state at every instruction boundary before the next opcode is
+  //! fetched, and the run ends early if it returns true. If it also takes a cycle count, it gets
+  //! cycles() as of that boundary. After a stop, the next call does not consult it again for the same
+  //! instruction, so a run that stopped at a breakpoint can be resumed.
+  //!
+  //! A trap the CPU recorded (see ProcessorDefinition::trap()) ends the run at the next instruction
+  //! boundary, after the trapping instruction. The trap is reported once; the next call carries on.
+  template<StopCondition<State> StopPredicate = NeverStop>
+  RunResult runFor(State& cpu, BusToken bus, uint64_t cycles, StopPredicate stop = {})
+  {
+    RunResult result;
+    Microcode next = m_nextMicrocode;
+    uint64_t executed = 0;
+    bool resuming = std::exchange(m_stopped, false);
+
+    while (executed < cycles)
+    {
+      if (next == nullptr)
+      {
+        if (cpu.trapped)
+        {
+          cpu.trapped = false;
+          result.status = RunStatus::Trapped;
+          result.trapAddress = cpu.trapAddress;
+          break;
+        }
+        if (!resuming && shouldStop(stop, std::as_const(cpu), m_cycles + executed))
+        {
+          result.status = RunStatus::Stopped;
+          m_stopped = true;
+          break;
+        }
+        resuming = false;
+        m_instructionStart = m_cycles + executed;
+        next = CpuDefinition::fetchNextOpcode(cpu, bus);
+        if constexpr (Profiler::enabled)
+        {
+          m_profiler.fetched(cpu.opcode, m_cycles + executed);
+        }
+      }
+      else
+      {
+        next = next(cpu, bus).injection;
+      }
+      ++executed;
+    }
+
+    m_nextMicrocode = next;
+    m_cycles += executed;
+    result.cycles = executed;
+    return result;
+  }
+
+  //! Counts cycles the owner fast-forwarded without running them through the pump. Only valid on an
+  //! instruction boundary.
+  void skip(uint64_t cycles) noexcept
+  {
+    m_cycles += cycles;
+  }
+
+  //! True if the last tick() or runFor() ended on an instruction boundary.
+  [[nodiscard]] bool atInstructionBoundary() const noexcept
+  {
+    return m_nextMicrocode == nullptr;
+  }
+
   [[nodiscard]] uint64_t cycles() const noexcept
   {
     return m_cycles;
   }
 
+  //! cycles() as of the fetch of the instruction in progress. cycles() itself is only brought up to
+  //! date at the end of runFor(), so this is the time a device sees when the CPU accesses it during a
+  //! batch, at most one instruction early.
+  [[nodiscard]] uint64_t instructionStart() const noexcept
+  {
+    return m_instructionStart;
+  }
+
+  [[nodiscard]] Snapshot snapshot() const noexcept
+  {
+    Snapshot snapshot{0, m_cycles, m_nextMicrocode != nullptr, m_stopped};
+    if (snapshot.inInstruction)
+    {
+      snapshot.microcode = CpuDefinition::microcodeIndex(m_nextMicrocode);
+    }
+    return snapshot;
+  }
+
+  //! Restores a snapshot(). The microcode it names must exist, see CpuDefinition::microcode(). The
+  //! profiler is left alone.
+  void restore(const Snapshot& snapshot) noexcept
+  {
+    m_nextMicrocode = snapshot.inInstruction ? CpuDefinition::microcode(snapshot.microcode) : nullptr;
+    assert(m_nextMicrocode != nullptr || !snapshot.inInstruction);
+    m_cycles = snapshot.cycles;
+    m_stopped = snapshot.stopped;
+  }
+
+  [[nodiscard]] Profiler& profiler() noexcept
+  {
+    return m_profiler;
+  }
+
+  [[nodiscard]] const Profiler& profiler() const noexcept
+  {
+    return m_profiler;
+  }
+
 private:
   Microcode m_nextMicrocode = nullptr;
   uint64_t m_cycles = 0;  // Number of microcode operations executed
+  uint64_t m_instructionStart = 0;  // m_cycles when the current instruction was fetched
+  bool m_stopped = false;  // The last runFor() stopped at the current instruction boundary
+  [[no_unique_address]] Profiler m_profiler;
 };
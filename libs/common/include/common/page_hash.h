@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace Common
+{
+
+//! Change detection for memory in Bus pages, for incremental checkpoints and for finding instances
+//! that hold the same memory. Comparing or hashing 64K takes a few microseconds, so a checkpoint only
+//! has to copy and store the pages that changed.
+//!
+//! The kernels are picked when the library is built: AVX2 with EMULATE_ENABLE_AVX2, NEON where the
+//! target has it, portable code otherwise. All of them compute the same hashes, so hashes can be
+//! compared between machines and builds.
+
+using PageView = std::span<const Byte, Bus::c_pageSize>;
+
+//! The name of the kernels this build uses: "avx2", "neon" or "scalar".
+const char* pageKernel() noexcept;
+
+//! A 64-bit hash of the contents of `page`. Pages with equal hashes are almost certainly equal; use
+//! samePage() where that is not good enough.
+uint64_t hashPage(PageView page) noexcept;
+
+//! True if both pages hold the same bytes.
+bool samePage(PageView a, PageView b) noexcept;
+
+//! Writes hashPage() of every page of `memory`, which is a whole number of pages, to `hashes`.
+void hashPages(std::span<const Byte> memory, std::span<uint64_t> hashes) noexcept;
+
+//! Sets bit `firstPage + i` of `changed` for every page i that differs between `memory` and
+//! `previous`, which have the same size, a whole number of pages, and fit into the bitmap from
+//! `firstPage` on. Other bits are left alone, so several regions can be diffed into one bitmap.
+void changedPages(
+    std::span<const Byte> memory, std::span<const Byte> previous, PageBitmap& changed, size_t firstPage = 0) noexcept;
+
+}  // namespace Common
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+#include "common/address.h"
+
+namespace Common
+{
+
+#ifdef EMULATE_ENABLE_PROFILING
+constexpr bool profiling_enabled = true;
+#else
+constexpr bool profiling_enabled = false;
+#endif
+
+//! Profiling policy for MicrocodePump that records nothing. The pump checks `enabled` with
+//! `if constexpr`, so with this policy there is no profiling code in the execution loop at all.
+struct NullProfiler
+{
+  static constexpr bool enabled = false;
+
+  void fetched(Byte /*opcode*/, uint64_t /*cycle*/) noexcept
+  {
+  }
+
+  void flush(uint64_t /*cycle*/) noexcept
+  {
+  }
+};
+
+//! Profiling policy that counts executions and cycles per opcode. It requires the CPU state to have
+//! an `opcode` member that fetchNextOpcode() sets to the opcode it fetched.
+class OpcodeProfiler
+{
+public:
+  static constexpr bool enabled = true;
+
+  struct Counter
+  {
+    uint64_t executions = 0;
+    uint64_t cycles = 0;  // Including the opcode fetch
+  };
+
+  using Counters = std::array<Counter, 256>;
+
+  //! Called after `opcode` has been fetched in cycle `cycle`. The previous instruction is charged
+  //! with every cycle since its own fetch.
+  void fetched(Byte opcode, uint64_t cycle) noexcept
+  {
+    flush(cycle);
+    ++m_counters[opcode].executions;
+    m_current = opcode;
+    m_active = true;
+  }
+
+  //! Charges the instruction in progress with the cycles up to `cycle`, so counters() is complete.
+  void flush(uint64_t cycle) noexcept
+  {
+    if (m_active)
+    {
+      m_counters[m_current].cycles += cycle - m_start;
+    }
+    m_start = cycle;
+  }
+
+  [[nodiscard]] const Counters& counters() const noexcept
+  {
+    return m_counters;
+  }
+
+  void reset() noexcept
+  {
+    m_counters = {};
+    m_active = false;
+  }
+
+private:
+  Counters m_counters{};
+  uint64_t m_start = 0;  // Cycle in which the instruction in progress was fetched
+  Byte m_current = 0;
+  bool m_active = false;  // An instruction is in progress
+};
+
+//! The profiler selected by EMULATE_ENABLE_PROFILING.
+using DefaultProfiler = std::conditional_t<profiling_enabled, OpcodeProfiler, NullProfiler>;
+
+}  // namespace Common
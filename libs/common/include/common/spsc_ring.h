@@ -0,0 +1,81 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+
+namespace Common
+{
+
+//! A fixed-size queue between exactly one producer thread and one consumer thread. Neither side ever
+//! blocks or allocates: push() fails when the ring is full and pop() returns nothing when it is empty.
+//! The two indices live on cache lines of their own, and each side keeps a copy of the other's index
+//! so it only reads the shared one when the copy says the ring is full or empty.
+template<typename T, size_t Capacity>
+class SpscRing
+{
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+  static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+  static constexpr size_t c_capacity{Capacity};
+
+  //! Producer only. Returns false, leaving the ring alone, if it is full.
+  bool push(const T& value) noexcept
+  {
+    size_t head = m_head.load(std::memory_order_relaxed);
+    if (head - m_cachedTail == Capacity)
+    {
+      m_cachedTail = m_tail.load(std::memory_order_acquire);
+      if (head - m_cachedTail == Capacity)
+      {
+        return false;
+      }
+    }
+    m_slots[head & c_mask] = value;
+    m_head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  //! Consumer only. Moves up to `values.size()` of the oldest values into `values` and returns how many.
+  size_t pop(std::span<T> values) noexcept
+  {
+    size_t tail = m_tail.load(std::memory_order_relaxed);
+    if (m_cachedHead - tail < values.size())
+    {
+      m_cachedHead = m_head.load(std::memory_order_acquire);
+    }
+    size_t count = std::min(m_cachedHead - tail, values.size());
+    for (size_t i = 0; i < count; ++i)
+    {
+      values[i] = m_slots[(tail + i) & c_mask];
+    }
+    m_tail.store(tail + count, std::memory_order_release);
+    return count;
+  }
+
+  //! Either side. Only a snapshot, the other side may have moved on by the time it is looked at.
+  [[nodiscard]] bool empty() const noexcept
+  {
+    return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+  }
+
+private:
+  static constexpr size_t c_mask{Capacity - 1};
+  static constexpr size_t c_cacheLine{64};
+
+  // Written by the producer
+  alignas(c_cacheLine) std::atomic<size_t> m_head{0};
+  size_t m_cachedTail = 0;  // Last m_tail the producer saw
+
+  // Written by the consumer
+  alignas(c_cacheLine) std::atomic<size_t> m_tail{0};
+  size_t m_cachedHead = 0;  // Last m_head the consumer saw
+
+  alignas(c_cacheLine) std::array<T, Capacity> m_slots{};
+};
+
+}  // namespace Common
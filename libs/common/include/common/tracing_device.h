@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+namespace Common
+{
+
+//! Bus device decorator that records every access to the wrapped device. The bus itself keeps no
+//! trace state, so only test harnesses that map a TracingDevice pay for the bookkeeping.
+//!
+//! The decorator never exposes direct memory, so every access to the wrapped device goes through
+//! it, even if the wrapped device could be accessed directly.
+class TracingDevice : public Bus::Device
+{
+public:
+  using Cycle = Bus::Cycle;
+
+  // Longest possible instruction is 7 cycles I think.
+  static constexpr size_t c_maxCycles{16};
+
+  explicit TracingDevice(Bus::Device& device) noexcept
+    : m_device(device)
+  {
+  }
+
+  Byte read(Address address, Address normalizedAddress) const override
+  {
+    Byte value = m_device.read(address, normalizedAddress);
+    record(Cycle{address, value, true});
+    return value;
+  }
+
+  void write(Address address, Address normalizedAddress, Byte value) override
+  {
+    m_device.write(address, normalizedAddress, value);
+    record(Cycle{address, value, false});
+  }
+
+  //! Returns the cycles recorded since the previous call.
+  std::span<const Cycle> cycles() const noexcept
+  {
+    size_t count = m_cycleIndex;
+    m_cycleIndex = 0;  // Reset for next instruction
+    return {m_cycles.data(), count};
+  }
+
+private:
+  void record(Cycle cycle) const noexcept
+  {
+    m_cycles[m_cycleIndex] = cycle;
+    m_cycleIndex = (m_cycleIndex + 1) % c_maxCycles;
+  }
+
+  Bus::Device& m_device;
+  mutable std::array<Cycle, c_maxCycles> m_cycles{};
+  mutable size_t m_cycleIndex = 0;
+};
+
+}  // namespace Common
@@ -1,44 +1,295 @@
 #include "common/bus.h"
 
+#include <algorithm>
+#include <bit>
+#include <utility>
+
 namespace Common
 {
 
-Bus::Bus(std::array<Entry, c_maxDevices> devices) noexcept
-  : m_devices(std::move(devices))
-  , m_cycles{}
-  , m_cycleIndex(0)
+namespace
+{
+
+void setBits(Bus::PageBitmap& pages, size_t first, uint64_t bits) noexcept
 {
+  for (; bits != 0; bits &= bits - 1)
+  {
+    pages.set(first + static_cast<size_t>(std::countr_zero(bits)));
+  }
 }
 
-Byte Bus::read(Address address) const
+}  // namespace
+
+Bus::Bus(std::array<Entry, c_maxDevices> devices, MemoryAccess access) noexcept
+  : m_devices(std::move(devices))
+  , m_access(access)
 {
-  Byte result = 0;
+  buildPageTable();
+}
 
+const Bus::Entry* Bus::findEntry(Address address) const noexcept
+{
   auto it = std::ranges::find_if(
       m_devices, [address](const Entry& entry) { return address >= entry.start && address <= entry.end; });
 
-  if (it != m_devices.end() && it->device != nullptr)
+  return it != m_devices.end() ? &*it : nullptr;
+}
+
+void Bus::buildPageTable() noexcept
+{
+  for (size_t index = 0; index < c_pageCount; ++index)
   {
-    auto normalizedAddress = Address{address - it->start};
-    result = it->device->read(address, normalizedAddress);
-    m_cycles[m_cycleIndex] = Cycle{address, result, true};
-    m_cycleIndex = (m_cycleIndex + 1) % c_maxCycles;
+    mapPage(index);
   }
-  return result;
 }
 
-void Bus::write(Address address, Byte value)
+void Bus::remap(Address first, Address last) noexcept
 {
-  auto it = std::ranges::find_if(
-      m_devices, [address](const Entry& entry) { return address >= entry.start && address <= entry.end; });
+  for (size_t index = HiByte(first); index <= HiByte(last); ++index)
+  {
+    mapPage(index);
+  }
+}
 
-  if (it != m_devices.end() && it->device != nullptr)
+void Bus::mapPage(size_t index) noexcept
+{
+  auto first = static_cast<uint16_t>(index * c_pageSize);
+  auto last = static_cast<uint16_t>(first + c_pageSize - 1);
+
+  // The first entry that touches the page decides how it is routed. If that entry covers the whole
+  // page every address in it resolves to the same entry, no matter what later entries claim. If it
+  // only covers part of the page, the remaining addresses may resolve to another entry (or none), so
+  // the page has to use the linear search.
+  auto it = std::ranges::find_if(m_devices,
+      [first, last](const Entry& entry)
+      { return static_cast<uint16_t>(entry.start) <= last && static_cast<uint16_t>(entry.end) >= first; });
+
+  Page mapped;  // Unmapped if no entry touches the page
+  if (it != m_devices.end() && static_cast<uint16_t>(it->start) <= first && static_cast<uint16_t>(it->end) >= last)
   {
-    auto normalizedAddress = Address{address - it->start};
-    it->device->write(address, normalizedAddress, value);
-    m_cycles[m_cycleIndex] = Cycle{address, value, false};
+    mapped.device = it->device;
+    mapped.start = it->start;
+
+    if (m_access == MemoryAccess::Direct && mapped.device != nullptr)
+    {
+      // Only use the storage if the device can back the whole page.
+      DirectMemory memory = mapped.device->directPage(first - static_cast<uint16_t>(it->start));
+      if (memory.size >= c_pageSize)
+      {
+        mapped.read = memory.read;
+        mapped.write = memory.write;
+        mapped.readOnly = memory.readOnly;
+        mapped.remapOnWrite = memory.remapOnWrite;
+      }
+    }
+  }
+  else if (it != m_devices.end())
+  {
+    mapped.split = true;
+  }
+
+  // A watched page keeps its real routing on the side and sends every access to the watch device.
+  Page& page = m_pages[index];
+  if (page.watched)
+  {
+    (*m_unwatched)[index] = mapped;
+    mapped = Page{};
+    mapped.device = &m_watchDevice;
+  }
+  mapped.generation = page.generation + 1;
+  mapped.trackWrites = page.trackWrites;
+  mapped.breakpoint = page.breakpoint;
+  mapped.watched = page.watched;
+  page = mapped;
+}
 
-    m_cycleIndex = (m_cycleIndex + 1) % c_maxCycles;
+void Bus::trackWrites(Address first, Address last, bool enable) noexcept
+{
+  for (size_t index = HiByte(first); index <= HiByte(last); ++index)
+  {
+    m_pages[index].trackWrites = enable;
+  }
+}
+
+Bus::PageBitmap Bus::writtenPages() const noexcept
+{
+  PageBitmap pages;
+  for (size_t word = 0; word < m_written.size(); ++word)
+  {
+    setBits(pages, word * c_wordBits, m_written[word].load(std::memory_order_relaxed));
+  }
+  return pages;
+}
+
+Bus::PageBitmap Bus::takeWrittenPages() noexcept
+{
+  PageBitmap pages;
+  for (size_t word = 0; word < m_written.size(); ++word)
+  {
+    setBits(pages, word * c_wordBits, m_written[word].exchange(0, std::memory_order_relaxed));
+  }
+  return pages;
+}
+
+void Bus::addBreakpoint(Address address)
+{
+  if (!findBreakpoint(address))
+  {
+    m_breakpoints.push_back(address);
+  }
+  m_pages[HiByte(address)].breakpoint = true;
+}
+
+void Bus::removeBreakpoint(Address address) noexcept
+{
+  std::erase(m_breakpoints, address);
+  m_pages[HiByte(address)].breakpoint = std::ranges::any_of(
+      m_breakpoints, [page = HiByte(address)](Address breakpoint) { return HiByte(breakpoint) == page; });
+}
+
+bool Bus::findBreakpoint(Address address) const noexcept
+{
+  return std::ranges::find(m_breakpoints, address) != m_breakpoints.end();
+}
+
+void Bus::addWatchpoint(Watchpoint watchpoint)
+{
+  if (!m_unwatched)
+  {
+    m_unwatched = std::make_unique<std::array<Page, c_pageCount>>();
+  }
+  m_watchpoints.push_back(watchpoint);
+  updateWatchedPages(watchpoint.first, watchpoint.last);
+}
+
+void Bus::removeWatchpoint(Watchpoint watchpoint) noexcept
+{
+  if (auto it = std::ranges::find(m_watchpoints, watchpoint); it != m_watchpoints.end())
+  {
+    m_watchpoints.erase(it);
+    updateWatchedPages(watchpoint.first, watchpoint.last);
+  }
+}
+
+void Bus::updateWatchedPages(Address first, Address last) noexcept
+{
+  for (size_t index = HiByte(first); index <= HiByte(last); ++index)
+  {
+    bool watched = std::ranges::any_of(m_watchpoints,
+        [index](const Watchpoint& watchpoint)
+        { return HiByte(watchpoint.first) <= index && HiByte(watchpoint.last) >= index; });
+    if (watched != m_pages[index].watched)
+    {
+      m_pages[index].watched = watched;
+      mapPage(index);
+    }
+  }
+}
+
+void Bus::recordWatchHit(Address address, Byte value, Access access) const noexcept
+{
+  if (m_watchHit)
+  {
+    return;
+  }
+  for (const Watchpoint& watchpoint : m_watchpoints)
+  {
+    if (address >= watchpoint.first && address <= watchpoint.last &&
+        (static_cast<uint8_t>(watchpoint.access) & static_cast<uint8_t>(access)) != 0)
+    {
+      m_watchHit = WatchHit{address, value, access == Access::Read};
+      return;
+    }
+  }
+}
+
+Byte Bus::readWatched(Address address) const
+{
+  const Page& page = (*m_unwatched)[HiByte(address)];
+  Byte value = 0;
+  if (page.read != nullptr)
+  {
+    value = page.read[LoByte(address)];
+  }
+  else if (auto [device, start] = route(page, address); device != nullptr)
+  {
+    value = device->read(address, Address{address - start});
+  }
+  recordWatchHit(address, value, Access::Read);
+  return value;
+}
+
+void Bus::writeWatched(Address address, Byte value)
+{
+  // Writes that are then dropped are still seen, as on the real bus. The page's generation has
+  // already changed by the time the write gets here.
+  recordWatchHit(address, value, Access::Write);
+  size_t index = HiByte(address);
+  Page& page = (*m_unwatched)[index];
+  if (page.write != nullptr)
+  {
+    page.write[LoByte(address)] = value;
+    return;
+  }
+  if (page.readOnly)
+  {
+    return;
+  }
+  if (auto [device, start] = route(page, address); device != nullptr)
+  {
+    device->write(address, Address{address - start}, value);
+  }
+  if (page.remapOnWrite)
+  {
+    mapPage(index);
+  }
+}
+
+Byte Bus::WatchDevice::read(Address address, Address /*normalizedAddress*/) const
+{
+  return m_bus.readWatched(address);
+}
+
+void Bus::WatchDevice::write(Address address, Address /*normalizedAddress*/, Byte value)
+{
+  m_bus.writeWatched(address, value);
+}
+
+std::pair<Bus::Device*, Address> Bus::route(const Page& page, Address address) const noexcept
+{
+  if (!page.split)
+  {
+    return {page.device, page.start};
+  }
+
+  const Entry* entry = findEntry(address);
+  if (entry == nullptr)
+  {
+    return {nullptr, Address{0}};
+  }
+  return {entry->device, entry->start};
+}
+
+Byte Bus::readDevice(Address address) const
+{
+  Byte result = 0;
+
+  auto [device, start] = route(m_pages[HiByte(address)], address);
+  if (device != nullptr)
+  {
+    auto normalizedAddress = Address{address - start};
+    result = device->read(address, normalizedAddress);
+  }
+  return result;
+}
+
+void Bus::writeDevice(Address address, Byte value)
+{
+  auto [device, start] = route(m_pages[HiByte(address)], address);
+  if (device != nullptr)
+  {
+    auto normalizedAddress = Address{address - start};
+    device->write(address, normalizedAddress, value);
   }
 }
 
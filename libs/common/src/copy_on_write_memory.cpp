@@ -0,0 +1,103 @@
+#include "common/copy_on_write_memory.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include "common/page_hash.h"
+
+namespace Common
+{
+
+CopyOnWriteMemory::CopyOnWriteMemory(std::shared_ptr<const Byte> image, size_t size)
+  : m_pages(size / Bus::c_pageSize)
+{
+  if (size % Bus::c_pageSize != 0)
+  {
+    throw std::invalid_argument("Copy-on-write memory must be a whole number of pages");
+  }
+  share(std::move(image));
+}
+
+size_t CopyOnWriteMemory::privatePages() const noexcept
+{
+  return static_cast<size_t>(std::ranges::count_if(m_pages, [](const PageEntry& entry) { return entry.copy != nullptr; }));
+}
+
+void CopyOnWriteMemory::share(std::shared_ptr<const Byte> image)
+{
+  m_image = std::move(image);
+  for (size_t index = 0; index < m_pages.size(); ++index)
+  {
+    m_pages[index].read = m_image.get() + index * Bus::c_pageSize;
+    m_pages[index].copy.reset();
+  }
+}
+
+void CopyOnWriteMemory::assign(std::span<const Byte> memory)
+{
+  assert(memory.size() == size());
+  for (size_t index = 0; index < m_pages.size(); ++index)
+  {
+    PageEntry& entry = m_pages[index];
+    auto source = memory.subspan(index * Bus::c_pageSize, Bus::c_pageSize);
+    if (!samePage(PageView(source), PageView(entry.read, Bus::c_pageSize)))
+    {
+      std::ranges::copy(source, makePrivate(entry).begin());
+    }
+  }
+}
+
+void CopyOnWriteMemory::copyTo(std::span<Byte> memory) const noexcept
+{
+  assert(memory.size() == size());
+  for (size_t index = 0; index < m_pages.size(); ++index)
+  {
+    std::memcpy(memory.data() + index * Bus::c_pageSize, m_pages[index].read, Bus::c_pageSize);
+  }
+}
+
+Byte CopyOnWriteMemory::read(Address /*address*/, Address normalizedAddress) const
+{
+  auto offset = static_cast<size_t>(normalizedAddress);
+  assert(offset < size());
+  return m_pages[offset / Bus::c_pageSize].read[offset % Bus::c_pageSize];
+}
+
+void CopyOnWriteMemory::write(Address /*address*/, Address normalizedAddress, Byte value)
+{
+  auto offset = static_cast<size_t>(normalizedAddress);
+  assert(offset < size());
+  makePrivate(m_pages[offset / Bus::c_pageSize])[offset % Bus::c_pageSize] = value;
+}
+
+Bus::DirectMemory CopyOnWriteMemory::directPage(size_t offset) noexcept
+{
+  if (offset % Bus::c_pageSize != 0 || offset >= size())
+  {
+    return {};
+  }
+
+  PageEntry& entry = m_pages[offset / Bus::c_pageSize];
+  if (entry.copy == nullptr)
+  {
+    // Writes have to come through write() so the page can be copied first.
+    return {entry.read, nullptr, Bus::c_pageSize, false, true};
+  }
+  return {entry.copy->data(), entry.copy->data(), Bus::c_pageSize, false, false};
+}
+
+CopyOnWriteMemory::Page& CopyOnWriteMemory::makePrivate(PageEntry& entry)
+{
+  if (entry.copy == nullptr)
+  {
+    entry.copy = std::make_unique<Page>();
+    std::memcpy(entry.copy->data(), entry.read, Bus::c_pageSize);
+    entry.read = entry.copy->data();
+  }
+  return *entry.copy;
+}
+
+}  // namespace Common
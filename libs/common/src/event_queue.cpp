@@ -0,0 +1,111 @@
+#include "common/event_queue.h"
+
+#include <utility>
+
+namespace Common
+{
+
+EventQueue::Id EventQueue::add(Handler handler)
+{
+  m_events.push_back(Event{std::move(handler)});
+  m_heap.reserve(m_events.size());
+  return m_events.size() - 1;
+}
+
+void EventQueue::schedule(Id id, uint64_t cycle)
+{
+  Event& event = m_events[id];
+  event.cycle = cycle;
+  event.sequence = m_sequence++;
+  if (event.position == c_unscheduled)
+  {
+    m_heap.push_back(id);
+    event.position = m_heap.size() - 1;
+  }
+  siftUp(event.position);
+  siftDown(event.position);
+}
+
+void EventQueue::cancel(Id id) noexcept
+{
+  if (isScheduled(id))
+  {
+    remove(m_events[id].position);
+  }
+}
+
+void EventQueue::runHandlers(uint64_t cycle)
+{
+  while (!m_heap.empty() && m_events[m_heap.front()].cycle <= cycle)
+  {
+    Id id = m_heap.front();
+    remove(0);
+    m_events[id].handler(cycle);
+  }
+}
+
+void EventQueue::rewind(uint64_t cycles) noexcept
+{
+  // Taking the same amount off every deadline keeps the heap ordered.
+  for (Id id : m_heap)
+  {
+    Event& event = m_events[id];
+    event.cycle = event.cycle > cycles ? event.cycle - cycles : 0;
+  }
+  m_now = m_now > cycles ? m_now - cycles : 0;
+}
+
+void EventQueue::siftUp(size_t position) noexcept
+{
+  Id id = m_heap[position];
+  while (position > 0)
+  {
+    size_t parent = (position - 1) / 2;
+    if (!earlier(id, m_heap[parent]))
+    {
+      break;
+    }
+    place(position, m_heap[parent]);
+    position = parent;
+  }
+  place(position, id);
+}
+
+void EventQueue::siftDown(size_t position) noexcept
+{
+  Id id = m_heap[position];
+  while (true)
+  {
+    size_t child = 2 * position + 1;
+    if (child >= m_heap.size())
+    {
+      break;
+    }
+    if (child + 1 < m_heap.size() && earlier(m_heap[child + 1], m_heap[child]))
+    {
+      ++child;
+    }
+    if (!earlier(m_heap[child], id))
+    {
+      break;
+    }
+    place(position, m_heap[child]);
+    position = child;
+  }
+  place(position, id);
+}
+
+void EventQueue::remove(size_t position) noexcept
+{
+  m_events[m_heap[position]].position = c_unscheduled;
+  Id last = m_heap.back();
+  m_heap.pop_back();
+  if (position < m_heap.size())
+  {
+    place(position, last);
+    siftUp(position);
+    siftDown(m_events[last].position);
+  }
+}
+
+}  // namespace Common
@@ -47,6 +47,29 @@ FixedFormatter& FixedFormatter::operator<<(Common::Address addr) noexcept
   return *this << static_cast<Common::Byte>((value >> 8) & 0xFF) << static_cast<Common::Byte>(value & 0xFF);
 }
 
+FixedFormatter& FixedFormatter::operator<<(int value) noexcept
+{
+  // Digits come out lowest first, collect them before writing them in order.
+  char digits[11];
+  size_t count = 0;
+  auto magnitude = value < 0 ? 0u - static_cast<unsigned>(value) : static_cast<unsigned>(value);
+  do
+  {
+    digits[count++] = static_cast<char>('0' + magnitude % 10);
+    magnitude /= 10;
+  } while (magnitude != 0);
+
+  if (value < 0)
+  {
+    *this << '-';
+  }
+  while (count > 0)
+  {
+    *this << digits[--count];
+  }
+  return *this;
+}
+
 std::string_view FixedFormatter::finalize() noexcept
 {
   return std::string_view(m_begin, m_current);
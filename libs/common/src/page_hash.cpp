@@ -0,0 +1,218 @@
+#include "common/page_hash.h"
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+namespace Common
+{
+
+namespace
+{
+
+// The hash runs eight 32-bit lanes over the page like xxHash32 does: lane l takes the little-endian
+// words l, l + 8, l + 16, ... so eight of them are one 32-byte load. The lanes are folded into 64
+// bits at the end. Every kernel has to produce the same lanes as hashLanesScalar().
+constexpr size_t c_lanes = 8;
+constexpr size_t c_rounds = Bus::c_pageSize / (c_lanes * sizeof(uint32_t));
+
+constexpr uint32_t c_prime1 = 0x9E3779B1u;
+constexpr uint32_t c_prime2 = 0x85EBCA77u;
+constexpr int c_rotate = 13;
+
+using Lanes = std::array<uint32_t, c_lanes>;
+
+constexpr Lanes c_seeds = []()
+{
+  Lanes seeds{};
+  for (size_t lane = 0; lane < c_lanes; ++lane)
+  {
+    seeds[lane] = static_cast<uint32_t>(c_prime1 * (lane + 1));
+  }
+  return seeds;
+}();
+
+uint64_t fold(const Lanes& lanes) noexcept
+{
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (uint32_t lane : lanes)
+  {
+    hash = (hash ^ lane) * 0x100000001B3ull;
+  }
+
+  // The splitmix64 finalizer, so every input bit reaches every output bit.
+  hash = (hash ^ (hash >> 30)) * 0xBF58476D1CE4E5B9ull;
+  hash = (hash ^ (hash >> 27)) * 0x94D049BB133111EBull;
+  return hash ^ (hash >> 31);
+}
+
+[[maybe_unused]] Lanes hashLanesScalar(PageView page) noexcept
+{
+  Lanes lanes = c_seeds;
+  for (size_t round = 0; round < c_rounds; ++round)
+  {
+    for (size_t lane = 0; lane < c_lanes; ++lane)
+    {
+      const Byte* bytes = page.data() + (round * c_lanes + lane) * sizeof(uint32_t);
+      uint32_t word = uint32_t{bytes[0]} | uint32_t{bytes[1]} << 8 | uint32_t{bytes[2]} << 16 | uint32_t{bytes[3]} << 24;
+      lanes[lane] = std::rotl(lanes[lane] + word * c_prime2, c_rotate) * c_prime1;
+    }
+  }
+  return lanes;
+}
+
+#if defined(__AVX2__)
+
+constexpr const char* c_kernel = "avx2";
+
+// The unaligned load and store take an __m256i pointer but need no alignment.
+__m256i load(const void* data) noexcept
+{
+  return _mm256_loadu_si256(static_cast<const __m256i*>(data));
+}
+
+void store(void* data, __m256i value) noexcept
+{
+  _mm256_storeu_si256(static_cast<__m256i*>(data), value);
+}
+
+Lanes hashLanes(PageView page) noexcept
+{
+  const __m256i prime1 = _mm256_set1_epi32(static_cast<int>(c_prime1));
+  const __m256i prime2 = _mm256_set1_epi32(static_cast<int>(c_prime2));
+  __m256i lanes = load(c_seeds.data());
+  for (size_t round = 0; round < c_rounds; ++round)
+  {
+    __m256i words = load(page.data() + round * 32);
+    lanes = _mm256_add_epi32(lanes, _mm256_mullo_epi32(words, prime2));
+    lanes = _mm256_or_si256(_mm256_slli_epi32(lanes, c_rotate), _mm256_srli_epi32(lanes, 32 - c_rotate));
+    lanes = _mm256_mullo_epi32(lanes, prime1);
+  }
+
+  Lanes result;
+  store(result.data(), lanes);
+  return result;
+}
+
+bool samePageKernel(PageView a, PageView b) noexcept
+{
+  __m256i difference = _mm256_setzero_si256();
+  for (size_t offset = 0; offset < Bus::c_pageSize; offset += 32)
+  {
+    __m256i left = load(a.data() + offset);
+    __m256i right = load(b.data() + offset);
+    difference = _mm256_or_si256(difference, _mm256_xor_si256(left, right));
+  }
+  return _mm256_testz_si256(difference, difference) != 0;
+}
+
+#elif defined(__ARM_NEON)
+
+static_assert(std::endian::native == std::endian::little, "The NEON kernel loads the words in host order");
+
+constexpr const char* c_kernel = "neon";
+
+// One NEON register holds four lanes, so lanes 0-3 and 4-7 are kept in two.
+Lanes hashLanes(PageView page) noexcept
+{
+  const uint32x4_t prime1 = vdupq_n_u32(c_prime1);
+  const uint32x4_t prime2 = vdupq_n_u32(c_prime2);
+  uint32x4_t low = vld1q_u32(c_seeds.data());
+  uint32x4_t high = vld1q_u32(c_seeds.data() + 4);
+  for (size_t round = 0; round < c_rounds; ++round)
+  {
+    const Byte* bytes = page.data() + round * 32;
+    low = vmlaq_u32(low, vreinterpretq_u32_u8(vld1q_u8(bytes)), prime2);
+    high = vmlaq_u32(high, vreinterpretq_u32_u8(vld1q_u8(bytes + 16)), prime2);
+    low = vmulq_u32(vsriq_n_u32(vshlq_n_u32(low, c_rotate), low, 32 - c_rotate), prime1);
+    high = vmulq_u32(vsriq_n_u32(vshlq_n_u32(high, c_rotate), high, 32 - c_rotate), prime1);
+  }
+
+  Lanes result;
+  vst1q_u32(result.data(), low);
+  vst1q_u32(result.data() + 4, high);
+  return result;
+}
+
+bool samePageKernel(PageView a, PageView b) noexcept
+{
+  uint8x16_t difference = vdupq_n_u8(0);
+  for (size_t offset = 0; offset < Bus::c_pageSize; offset += 16)
+  {
+    difference = vorrq_u8(difference, veorq_u8(vld1q_u8(a.data() + offset), vld1q_u8(b.data() + offset)));
+  }
+  uint64x2_t halves = vreinterpretq_u64_u8(difference);
+  return (vgetq_lane_u64(halves, 0) | vgetq_lane_u64(halves, 1)) == 0;
+}
+
+#else
+
+constexpr const char* c_kernel = "scalar";
+
+Lanes hashLanes(PageView page) noexcept
+{
+  return hashLanesScalar(page);
+}
+
+bool samePageKernel(PageView a, PageView b) noexcept
+{
+  return std::memcmp(a.data(), b.data(), Bus::c_pageSize) == 0;
+}
+
+#endif
+
+}  // namespace
+
+const char* pageKernel() noexcept
+{
+  return c_kernel;
+}
+
+uint64_t hashPage(PageView page) noexcept
+{
+  return fold(hashLanes(page));
+}
+
+bool samePage(PageView a, PageView b) noexcept
+{
+  return samePageKernel(a, b);
+}
+
+void hashPages(std::span<const Byte> memory, std::span<uint64_t> hashes) noexcept
+{
+  assert(memory.size() % Bus::c_pageSize == 0);
+  assert(hashes.size() == memory.size() / Bus::c_pageSize);
+  for (size_t index = 0; index < hashes.size(); ++index)
+  {
+    hashes[index] = hashPage(PageView(memory.subspan(index * Bus::c_pageSize, Bus::c_pageSize)));
+  }
+}
+
+void changedPages(
+    std::span<const Byte> memory, std::span<const Byte> previous, PageBitmap& changed, size_t firstPage) noexcept
+{
+  assert(memory.size() == previous.size());
+  assert(memory.size() % Bus::c_pageSize == 0);
+  size_t pages = memory.size() / Bus::c_pageSize;
+  assert(firstPage + pages <= changed.size());
+  for (size_t index = 0; index < pages; ++index)
+  {
+    size_t offset = index * Bus::c_pageSize;
+    if (!samePageKernel(PageView(memory.subspan(offset, Bus::c_pageSize)),
+            PageView(previous.subspan(offset, Bus::c_pageSize))))
+    {
+      changed.set(firstPage + index);
+    }
+  }
+}
+
+}  // namespace Common
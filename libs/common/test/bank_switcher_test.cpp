@@ -47,3 +47,34 @@ TEST_CASE("BankSwitcher basic functionality", "[bank_switcher]")
   REQUIRE_THROWS_AS(switcher.read(Address{0x0000}, Address{0x7FFF}), std::out_of_range);
   REQUIRE_THROWS_AS(switcher.read(Address{0x1FFF}, Address{0xA000}), std::out_of_range);
 }
+
+TEST_CASE("BankSwitcher reads and writes different banks through the bus", "[bank_switcher]")
+{
+  std::array<Byte, 0x1000> rom{};
+  std::array<Byte, 0x1000> ram{};
+  rom.fill(0x11);
+  ram.fill(0x22);
+
+  BankSwitcher switcher{std::span<const Byte, 0x1000>{rom}, std::span<Byte, 0x1000>{ram}};
+  Bus bus{{Bus::Entry{Address{0xD000}, Address{0xDFFF}, &switcher}}};
+
+  // Writes to ROM are ignored.
+  bus.write(Address{0xD000}, 0x33);
+  CHECK(bus.read(Address{0xD000}) == 0x11);
+  CHECK(rom[0] == 0x11);
+
+  // Read ROM, write the RAM behind it. The bus uses the new banks once remapped.
+  switcher.selectBanks(0, 1);
+  bus.remap(Address{0xD000}, Address{0xDFFF});
+  bus.write(Address{0xD010}, 0x44);
+  CHECK(bus.read(Address{0xD010}) == 0x11);
+  CHECK(ram[0x10] == 0x44);
+
+  switcher.selectBanks(1, std::nullopt);
+  bus.remap(Address{0xD000}, Address{0xDFFF});
+  CHECK(switcher.activeBank() == 1);
+  CHECK_FALSE(switcher.writeBank().has_value());
+  bus.write(Address{0xD010}, 0x55);
+  CHECK(bus.read(Address{0xD010}) == 0x44);
+  CHECK(bus.peek(Address{0xDFFF}) == Byte{0x22});
+}
@@ -0,0 +1,371 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+
+using namespace Common;
+
+namespace
+{
+
+//! Device that answers every read with a value derived from its id and the normalized address, so
+//! a test can tell which device handled an access and how the address was normalized.
+class TaggedDevice : public Bus::Device
+{
+public:
+  explicit TaggedDevice(Byte id) noexcept
+    : m_id(id)
+  {
+  }
+
+  Byte read(Address /*address*/, Address normalizedAddress) const override
+  {
+    return static_cast<Byte>(m_id ^ LoByte(normalizedAddress) ^ HiByte(normalizedAddress));
+  }
+
+  void write(Address address, Address normalizedAddress, Byte value) override
+  {
+    lastWrite = {address, normalizedAddress, value};
+  }
+
+  struct Write
+  {
+    Address address{0};
+    Address normalized{0};
+    Byte value = 0;
+
+    bool operator==(const Write&) const noexcept = default;
+  };
+
+  Write lastWrite;
+
+private:
+  Byte m_id;
+};
+
+// The routing rule the page table has to reproduce: the first entry containing the address wins.
+const Bus::Entry* linearLookup(std::span<const Bus::Entry> entries, Address address)
+{
+  auto it = std::ranges::find_if(
+      entries, [address](const Bus::Entry& entry) { return address >= entry.start && address <= entry.end; });
+  return it != entries.end() ? &*it : nullptr;
+}
+
+}  // namespace
+
+TEST_CASE("Bus page table matches first-match routing", "[bus]")
+{
+  TaggedDevice video{0x10};
+  TaggedDevice disk{0x20};
+  TaggedDevice io{0x30};
+  TaggedDevice single{0x40};
+  TaggedDevice ram{0x50};
+  TaggedDevice rom{0x60};
+  TaggedDevice odd{0x70};
+
+  // Mirrors the Apple II layout, including overlapping entries, a one-byte entry and an entry that
+  // starts and ends in the middle of a page.
+  const std::array<Bus::Entry, Bus::c_maxDevices> entries{{
+      Bus::Entry{Address{0x0400}, Address{0x07FF}, &video},
+      Bus::Entry{Address{0xC0E0}, Address{0xC0EF}, &disk},
+      Bus::Entry{Address{0xC600}, Address{0xC6FF}, &disk},
+      Bus::Entry{Address{0xC000}, Address{0xC0FF}, &io},
+      Bus::Entry{Address{0x0000}, Address{0x0000}, &single},
+      Bus::Entry{Address{0x0000}, Address{0xBFFF}, &ram},
+      Bus::Entry{Address{0xD000}, Address{0xFFFF}, &rom},
+      Bus::Entry{Address{0xC710}, Address{0xC8EF}, &odd},
+      Bus::Entry{Address{0xC900}, Address{0xC9FF}, nullptr},  // Explicitly unmapped
+  }};
+
+  Bus bus{entries};
+
+  for (uint32_t value = 0; value <= 0xFFFF; ++value)
+  {
+    Address address{static_cast<uint16_t>(value)};
+    const Bus::Entry* entry = linearLookup(entries, address);
+
+    Byte expected = 0;
+    if (entry != nullptr && entry->device != nullptr)
+    {
+      expected = entry->device->read(address, Address{address - entry->start});
+    }
+
+    if (bus.read(address) != expected)
+    {
+      FAIL("Read routed differently at $" << std::hex << value);
+    }
+  }
+
+  bus.write(Address{0xC0E5}, 0x99);
+  CHECK(disk.lastWrite == TaggedDevice::Write{Address{0xC0E5}, Address{0x05}, 0x99});
+
+  bus.write(Address{0xC0F0}, 0x98);
+  CHECK(io.lastWrite == TaggedDevice::Write{Address{0xC0F0}, Address{0xF0}, 0x98});
+
+  bus.write(Address{0xC800}, 0x97);
+  CHECK(odd.lastWrite == TaggedDevice::Write{Address{0xC800}, Address{0x00F0}, 0x97});
+
+  // Writes to an unmapped page are ignored and reads return 0.
+  bus.write(Address{0xC950}, 0x96);
+  CHECK(bus.read(Address{0xC950}) == 0);
+}
+
+TEST_CASE("Bus direct memory access matches device access", "[bus]")
+{
+  std::array<Byte, 0x1000> ramStorage{};
+  std::array<Byte, 0x1000> romStorage{};
+  for (size_t i = 0; i < romStorage.size(); ++i)
+  {
+    romStorage[i] = static_cast<Byte>(i * 7);
+  }
+
+  MemoryDevice ram{std::span<Byte>(ramStorage)};
+  MemoryDevice rom{std::span<const Byte>(romStorage)};
+  TaggedDevice io{0x30};
+
+  // The RAM entry is larger than its storage at the top, so that page must not use the direct path.
+  const std::array<Bus::Entry, Bus::c_maxDevices> entries{{
+      Bus::Entry{Address{0x1080}, Address{0x108F}, &io},
+      Bus::Entry{Address{0x1000}, Address{0x20FF}, &ram},
+      Bus::Entry{Address{0xF000}, Address{0xFFFF}, &rom},
+  }};
+
+  Bus direct{entries, Bus::MemoryAccess::Direct};
+  Bus virtualOnly{entries, Bus::MemoryAccess::Device};
+
+  SECTION("Reads")
+  {
+    for (uint16_t value : std::array<uint16_t, 8>{0x1000, 0x1050, 0x1085, 0x10FF, 0x1FFF, 0xF000, 0xF123, 0xFFFF})
+    {
+      Address address{value};
+      CHECK(direct.read(address) == virtualOnly.read(address));
+    }
+    CHECK(direct.read(Address{0xF123}) == romStorage[0x123]);
+  }
+
+  SECTION("Writes")
+  {
+    direct.write(Address{0x1234}, 0x42);
+    CHECK(ramStorage[0x234] == 0x42);
+    CHECK(virtualOnly.read(Address{0x1234}) == 0x42);
+
+    direct.write(Address{0x1082}, 0x43);
+    CHECK(io.lastWrite == TaggedDevice::Write{Address{0x1082}, Address{0x02}, 0x43});
+
+    direct.write(Address{0xF010}, 0x44);
+    CHECK(romStorage[0x010] == 0x10 * 7);
+  }
+
+  SECTION("Peek")
+  {
+    CHECK(direct.peek(Address{0xF123}) == romStorage[0x123]);
+    CHECK(direct.peek(Address{0x1234}) == ramStorage[0x234]);
+
+    // Device pages, including the RAM page split with the I/O device, and unmapped pages.
+    CHECK_FALSE(direct.peek(Address{0x1085}).has_value());
+    CHECK_FALSE(direct.peek(Address{0x1050}).has_value());
+    CHECK_FALSE(direct.peek(Address{0x8000}).has_value());
+    CHECK_FALSE(virtualOnly.peek(Address{0xF123}).has_value());
+  }
+
+  SECTION("Generations")
+  {
+    uint32_t ramPage = direct.generation(0x12);
+    uint32_t splitPage = direct.generation(0x10);
+    uint32_t romPage = direct.generation(0xF0);
+    uint32_t untouchedPage = direct.generation(0x13);
+
+    direct.write(Address{0x1234}, 0x42);
+    direct.write(Address{0x1082}, 0x43);
+    direct.write(Address{0xF010}, 0x44);
+    CHECK(direct.generation(0x12) != ramPage);
+    CHECK(direct.generation(0x10) != splitPage);
+    CHECK(direct.generation(0xF0) == romPage);  // The write was dropped
+    CHECK(direct.generation(0x13) == untouchedPage);
+
+    direct.remap(Address{0xF000}, Address{0xF0FF});
+    CHECK(direct.generation(0xF0) != romPage);
+  }
+
+  SECTION("Written pages")
+  {
+    direct.write(Address{0x1234}, 0x41);
+    CHECK(direct.writtenPages().none());  // Not tracked yet
+
+    direct.trackWrites(Address{0x1000}, Address{0x12FF}, true);
+    direct.trackWrites(Address{0x1F00}, Address{0x1FFF}, true);
+    direct.trackWrites(Address{0xF000}, Address{0xFFFF}, true);
+    direct.write(Address{0x1234}, 0x42);
+    direct.write(Address{0x1082}, 0x43);
+    direct.write(Address{0xF010}, 0x44);  // Dropped
+    direct.write(Address{0x1534}, 0x45);  // Not tracked
+    direct.remap(Address{0x1000}, Address{0x1FFF});  // Tracking survives mapping the pages again
+    direct.write(Address{0x1FFF}, 0x46);
+
+    Bus::PageBitmap expected;
+    expected.set(0x10).set(0x12).set(0x1F);
+    CHECK(direct.writtenPages() == expected);
+    CHECK(direct.takeWrittenPages() == expected);
+    CHECK(direct.takeWrittenPages().none());
+
+    direct.trackWrites(Address{0x1000}, Address{0x1FFF}, false);
+    direct.write(Address{0x1234}, 0x47);
+    CHECK(direct.takeWrittenPages().none());
+  }
+}
+
+TEST_CASE("Bus breakpoints and watchpoints", "[bus]")
+{
+  std::array<Byte, 0x1000> ramStorage{};
+  std::array<Byte, 0x1000> romStorage{};
+  for (size_t i = 0; i < romStorage.size(); ++i)
+  {
+    romStorage[i] = static_cast<Byte>(i * 7);
+  }
+
+  MemoryDevice ram{std::span<Byte>(ramStorage)};
+  MemoryDevice rom{std::span<const Byte>(romStorage)};
+  TaggedDevice io{0x30};
+
+  const std::array<Bus::Entry, Bus::c_maxDevices> entries{{
+      Bus::Entry{Address{0x1080}, Address{0x108F}, &io},
+      Bus::Entry{Address{0x1000}, Address{0x1FFF}, &ram},
+      Bus::Entry{Address{0xF000}, Address{0xFFFF}, &rom},
+  }};
+  Bus bus{entries};
+  CHECK_FALSE(bus.hasDebugPoints());
+
+  SECTION("Breakpoints")
+  {
+    bus.addBreakpoint(Address{0x1234});
+    bus.addBreakpoint(Address{0x1250});
+    CHECK(bus.hasDebugPoints());
+    CHECK(bus.isBreakpoint(Address{0x1234}));
+    CHECK(bus.isBreakpoint(Address{0x1250}));
+    CHECK_FALSE(bus.isBreakpoint(Address{0x1235}));
+    CHECK_FALSE(bus.isBreakpoint(Address{0x3434}));
+
+    bus.removeBreakpoint(Address{0x1234});
+    CHECK_FALSE(bus.isBreakpoint(Address{0x1234}));
+    CHECK(bus.isBreakpoint(Address{0x1250}));
+    bus.removeBreakpoint(Address{0x1250});
+    CHECK_FALSE(bus.isBreakpoint(Address{0x1250}));
+    CHECK_FALSE(bus.hasDebugPoints());
+  }
+
+  SECTION("Watchpoints")
+  {
+    const Bus::Watchpoint ramWrites{Address{0x1230}, Address{0x123F}, Bus::Access::Write};
+    const Bus::Watchpoint romReads{Address{0xF100}, Address{0xF100}, Bus::Access::Read};
+    const Bus::Watchpoint ioAccess{Address{0x1080}, Address{0x1080}, Bus::Access::ReadWrite};
+    uint32_t generation = bus.generation(0x12);
+    bus.addWatchpoint(ramWrites);
+    bus.addWatchpoint(romReads);
+    bus.addWatchpoint(ioAccess);
+    CHECK(bus.hasDebugPoints());
+    CHECK(bus.generation(0x12) != generation);  // Cached code has to be decoded again
+    CHECK_FALSE(bus.peek(Address{0x1234}).has_value());
+
+    // Accesses to watched pages that no watchpoint matches.
+    bus.write(Address{0x1200}, 0x41);
+    CHECK(ramStorage[0x200] == 0x41);
+    CHECK(bus.read(Address{0x1234}) == 0);
+    CHECK(bus.read(Address{0xF101}) == romStorage[0x101]);
+    CHECK_FALSE(bus.takeWatchHit().has_value());
+
+    // The first hit is kept until it is taken.
+    bus.write(Address{0x1234}, 0x42);
+    bus.write(Address{0x1235}, 0x43);
+    CHECK(ramStorage[0x234] == 0x42);
+    CHECK(ramStorage[0x235] == 0x43);
+    CHECK(bus.takeWatchHit() == Bus::WatchHit{Address{0x1234}, 0x42, false});
+    CHECK_FALSE(bus.takeWatchHit().has_value());
+
+    const Byte romByte = romStorage[0x100];
+    CHECK(bus.read(Address{0xF100}) == romByte);
+    CHECK(bus.takeWatchHit() == Bus::WatchHit{Address{0xF100}, romByte, true});
+    bus.write(Address{0xF100}, 0x44);  // Dropped, and only reads are watched
+    CHECK(romStorage[0x100] == romByte);
+    CHECK_FALSE(bus.takeWatchHit().has_value());
+
+    // A page split between devices.
+    bus.write(Address{0x1080}, 0x45);
+    CHECK(io.lastWrite == TaggedDevice::Write{Address{0x1080}, Address{0x00}, 0x45});
+    CHECK(bus.takeWatchHit() == Bus::WatchHit{Address{0x1080}, 0x45, false});
+    CHECK(bus.read(Address{0x10C0}) == 0);
+
+    // Remapping keeps the page watched.
+    bus.remap(Address{0x1000}, Address{0x1FFF});
+    bus.write(Address{0x1236}, 0x46);
+    CHECK(bus.takeWatchHit() == Bus::WatchHit{Address{0x1236}, 0x46, false});
+
+    bus.removeWatchpoint(ramWrites);
+    bus.removeWatchpoint(romReads);
+    bus.removeWatchpoint(ioAccess);
+    CHECK_FALSE(bus.hasDebugPoints());
+    CHECK(bus.peek(Address{0x1234}) == 0x42);
+    bus.write(Address{0x1234}, 0x47);
+    CHECK_FALSE(bus.takeWatchHit().has_value());
+  }
+}
+
+TEST_CASE("Bus routing benchmark", "[.][benchmark][bus]")
+{
+  // 48K of RAM behind a text page and I/O, the typical Apple II layout. The baseline is the linear
+  // search the bus used before it had a page table.
+  std::vector<Byte> memory(0x10000);
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  TaggedDevice video{0x10};
+  TaggedDevice io{0x30};
+
+  const std::array<Bus::Entry, Bus::c_maxDevices> entries{{
+      Bus::Entry{Address{0x0400}, Address{0x07FF}, &video},
+      Bus::Entry{Address{0xC0E0}, Address{0xC0EF}, &io},
+      Bus::Entry{Address{0xC600}, Address{0xC6FF}, &io},
+      Bus::Entry{Address{0xC000}, Address{0xC0FF}, &io},
+      Bus::Entry{Address{0x0000}, Address{0xBFFF}, &ram},
+      Bus::Entry{Address{0xD000}, Address{0xFFFF}, &ram},
+  }};
+  Bus bus{entries, Bus::MemoryAccess::Device};
+  Bus direct{entries, Bus::MemoryAccess::Direct};
+
+  static constexpr uint16_t c_cycles = 0x8000;
+
+  BENCHMARK("linear search, 32K cycles")
+  {
+    unsigned sum = 0;
+    for (uint16_t i = 0; i < c_cycles; ++i)
+    {
+      Address address{static_cast<uint16_t>(0x0800 + i)};
+      const Bus::Entry* entry = linearLookup(entries, address);
+      sum += entry->device->read(address, Address{address - entry->start});
+    }
+    return sum;
+  };
+
+  BENCHMARK("page table, 32K cycles")
+  {
+    unsigned sum = 0;
+    for (uint16_t i = 0; i < c_cycles; ++i)
+    {
+      sum += bus.read(Address{static_cast<uint16_t>(0x0800 + i)});
+    }
+    return sum;
+  };
+
+  BENCHMARK("page table with direct memory, 32K cycles")
+  {
+    unsigned sum = 0;
+    for (uint16_t i = 0; i < c_cycles; ++i)
+    {
+      sum += direct.read(Address{static_cast<uint16_t>(0x0800 + i)});
+    }
+    return sum;
+  };
+}
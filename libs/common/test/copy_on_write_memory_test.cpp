@@ -0,0 +1,83 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <memory>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/copy_on_write_memory.h"
+
+using namespace Common;
+
+namespace
+{
+
+using Image = std::array<Byte, 0x400>;
+
+std::shared_ptr<const Byte> makeImage(std::shared_ptr<Image>& image)
+{
+  image = std::make_shared<Image>();
+  for (size_t i = 0; i < image->size(); ++i)
+  {
+    (*image)[i] = static_cast<Byte>(i * 7);
+  }
+  return {image, image->data()};
+}
+
+}  // namespace
+
+TEST_CASE("CopyOnWriteMemory shares pages until they are written", "[cow]")
+{
+  std::shared_ptr<Image> image;
+  auto shared = makeImage(image);
+
+  CopyOnWriteMemory first(shared, image->size());
+  CopyOnWriteMemory second(shared, image->size());
+  Bus firstBus{{Bus::Entry{Address{0x1000}, Address{0x13FF}, &first}}};
+  Bus secondBus{{Bus::Entry{Address{0x1000}, Address{0x13FF}, &second}}};
+
+  CHECK(firstBus.read(Address{0x1105}) == static_cast<Byte>(0x105 * 7));
+  CHECK(firstBus.peek(Address{0x1105}) == static_cast<Byte>(0x105 * 7));
+  CHECK(first.privatePages() == 0);
+
+  firstBus.write(Address{0x1105}, 0xAA);
+  firstBus.write(Address{0x1106}, 0xBB);
+  CHECK(first.privatePages() == 1);
+  CHECK(firstBus.read(Address{0x1105}) == 0xAA);
+  CHECK(firstBus.read(Address{0x1106}) == 0xBB);
+  CHECK(firstBus.read(Address{0x1107}) == static_cast<Byte>(0x107 * 7));
+
+  // Neither the image nor the other device sees the write.
+  CHECK((*image)[0x105] == static_cast<Byte>(0x105 * 7));
+  CHECK(secondBus.read(Address{0x1105}) == static_cast<Byte>(0x105 * 7));
+  CHECK(second.privatePages() == 0);
+}
+
+TEST_CASE("CopyOnWriteMemory assign only copies pages that differ", "[cow]")
+{
+  std::shared_ptr<Image> image;
+  auto shared = makeImage(image);
+
+  CopyOnWriteMemory memory(shared, image->size());
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x03FF}, &memory}}};
+  bus.write(Address{0x0000}, 0x11);
+
+  Image contents = *image;
+  contents[0x0310] = 0x22;
+  memory.assign(contents);
+  bus.remap(Address{0x0000}, Address{0x03FF});
+
+  CHECK(memory.privatePages() == 2);
+  CHECK(bus.read(Address{0x0000}) == 0x00);
+  CHECK(bus.read(Address{0x0310}) == 0x22);
+
+  Image copy{};
+  memory.copyTo(copy);
+  CHECK(copy == contents);
+
+  memory.share(shared);
+  bus.remap(Address{0x0000}, Address{0x03FF});
+  CHECK(memory.privatePages() == 0);
+  CHECK(bus.read(Address{0x0310}) == static_cast<Byte>(0x310 * 7));
+}
@@ -0,0 +1,75 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "common/event_queue.h"
+
+using Common::EventQueue;
+
+TEST_CASE("EventQueue runs handlers in deadline order", "[event_queue]")
+{
+  EventQueue events;
+  std::vector<int> ran;
+  std::vector<EventQueue::Id> ids;
+  for (int index = 0; index < 8; ++index)
+  {
+    ids.push_back(events.add([&ran, index](uint64_t /*cycle*/) { ran.push_back(index); }));
+  }
+  CHECK(events.nextDeadline() == EventQueue::c_never);
+
+  // Out of order, with two on the same cycle.
+  const std::vector<uint64_t> deadlines{50, 10, 70, 30, 30, 90, 20, 60};
+  for (size_t index = 0; index < ids.size(); ++index)
+  {
+    events.schedule(ids[index], deadlines[index]);
+  }
+  CHECK(events.nextDeadline() == 10);
+
+  events.runDue(30);
+  CHECK(ran == std::vector<int>{1, 6, 3, 4});
+  CHECK(events.now() == 30);
+  CHECK(events.nextDeadline() == 50);
+  CHECK_FALSE(events.isScheduled(ids[3]));
+  CHECK(events.isScheduled(ids[0]));
+
+  // Moving and cancelling deadlines keeps the rest in order.
+  events.schedule(ids[5], 55);
+  events.cancel(ids[0]);
+  events.cancel(ids[0]);
+  CHECK(events.nextDeadline() == 55);
+  ran.clear();
+  events.runDue(1000);
+  CHECK(ran == std::vector<int>{5, 7, 2});
+  CHECK(events.nextDeadline() == EventQueue::c_never);
+}
+
+TEST_CASE("EventQueue handlers can schedule themselves again", "[event_queue]")
+{
+  EventQueue events;
+  std::vector<uint64_t> calls;
+  EventQueue::Id tick = 0;
+  tick = events.add(
+      [&](uint64_t cycle)
+      {
+        calls.push_back(cycle);
+        if (calls.size() < 4)
+        {
+          events.schedule(tick, cycle + 100);
+        }
+      });
+  events.schedule(tick, 100);
+
+  // A late call passes the actual cycle count, and anything that becomes due by then runs as well.
+  events.runDue(150);
+  CHECK(calls == std::vector<uint64_t>{150});
+  events.runDue(260);
+  CHECK(calls == std::vector<uint64_t>{150, 260});
+  CHECK(events.nextDeadline() == 360);
+
+  events.rewind(300);
+  CHECK(events.nextDeadline() == 60);
+  CHECK(events.now() == 0);
+  events.runDue(60);
+  CHECK(calls == std::vector<uint64_t>{150, 260, 60});
+}
@@ -0,0 +1,230 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode.h"
+#include "common/microcode_pump.h"
+#include "common/profiler.h"
+
+using namespace Common;
+
+namespace
+{
+
+//! Minimal CPU for exercising the pump: each opcode is the number of cycles the instruction takes
+//! after its fetch, and $FF traps.
+struct ToyCpu : ProcessorDefinition<Address, Byte, ToyCpu>
+{
+  static constexpr Byte c_trap{0xFF};
+
+  Address pc{0};
+  Byte remaining = 0;
+  Byte opcode = 0;
+
+  static Microcode fetchNextOpcode(ToyCpu& cpu, BusToken bus)
+  {
+    Byte opcode = bus.read(cpu.pc++);
+    if (opcode == c_trap)
+    {
+      cpu.trap(cpu.pc - 1);
+      return nullptr;
+    }
+    cpu.opcode = opcode;
+    cpu.remaining = opcode;
+    return opcode != 0 ? step : nullptr;
+  }
+
+  static Response step(ToyCpu& cpu, BusToken bus)
+  {
+    static_cast<void>(bus.read(cpu.pc));
+    return {--cpu.remaining != 0 ? step : nullptr};
+  }
+
+  static uint16_t microcodeIndex(Microcode /*microcode*/) noexcept
+  {
+    return 0;
+  }
+
+  static Microcode microcode(uint16_t index) noexcept
+  {
+    return index == 0 ? step : nullptr;
+  }
+};
+
+}  // namespace
+
+TEST_CASE("MicrocodePump runFor matches tick", "[pump]")
+{
+  std::array<Byte, 0x100> program{0, 1, 2, 3, 4, 5, 6, 0, 2, 1, 0, 3};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu ticked;
+  ToyCpu batched;
+  MicrocodePump<ToyCpu> tickPump;
+  MicrocodePump<ToyCpu> batchPump;
+
+  // Batches of different sizes end in the middle of instructions as well as on boundaries.
+  for (uint64_t batch : std::array<uint64_t, 7>{1, 2, 3, 5, 7, 4, 6})
+  {
+    for (uint64_t i = 0; i < batch; ++i)
+    {
+      tickPump.tick(ticked, ToyCpu::BusToken{&bus});
+    }
+
+    auto result = batchPump.runFor(batched, ToyCpu::BusToken{&bus}, batch);
+    CHECK(result.status == RunStatus::Completed);
+    CHECK(result.cycles == batch);
+    CHECK(batched.pc == ticked.pc);
+    CHECK(batched.remaining == ticked.remaining);
+    CHECK(batchPump.atInstructionBoundary() == tickPump.atInstructionBoundary());
+    CHECK(batchPump.cycles() == tickPump.cycles());
+    CHECK(batchPump.instructionStart() == tickPump.instructionStart());
+    CHECK(batchPump.instructionStart() <= batchPump.cycles());
+  }
+}
+
+TEST_CASE("MicrocodePump runFor stops at instruction boundaries", "[pump]")
+{
+  std::array<Byte, 0x100> program{2, 2, 2, 2, 2, 2};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  MicrocodePump<ToyCpu> pump;
+  auto breakpoint = [](const ToyCpu& state) { return state.pc == Address{0x0003}; };
+
+  auto result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 100, breakpoint);
+  CHECK(result.status == RunStatus::Stopped);
+  CHECK(result.cycles == 9);
+  CHECK(cpu.pc == Address{0x0003});
+  CHECK(pump.atInstructionBoundary());
+
+  // Resuming runs past the breakpoint.
+  result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 3, breakpoint);
+  CHECK(result.status == RunStatus::Completed);
+  CHECK(result.cycles == 3);
+  CHECK(cpu.pc == Address{0x0004});
+}
+
+TEST_CASE("MicrocodePump runFor passes the cycle count to the stop predicate", "[pump]")
+{
+  std::array<Byte, 0x100> program{2, 2, 2, 2, 2, 2};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  MicrocodePump<ToyCpu> pump;
+  static_cast<void>(pump.runFor(cpu, ToyCpu::BusToken{&bus}, 1));
+
+  // Boundaries are at cycles 3, 6, 9, ... counted from the first call.
+  auto atCycle = [](const ToyCpu& /*state*/, uint64_t cycle) { return cycle >= 5; };
+  auto result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 100, atCycle);
+  CHECK(result.status == RunStatus::Stopped);
+  CHECK(result.cycles == 5);
+  CHECK(pump.cycles() == 6);
+}
+
+TEST_CASE("MicrocodePump runFor returns on a trap", "[pump]")
+{
+  std::array<Byte, 0x100> program{1, 3, ToyCpu::c_trap, 1};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  MicrocodePump<ToyCpu> pump;
+
+  // The trapping instruction completes before the run ends.
+  auto result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 100);
+  CHECK(result.status == RunStatus::Trapped);
+  CHECK(result.trapAddress == Address{0x0002});
+  CHECK(result.cycles == 7);
+  CHECK(pump.atInstructionBoundary());
+  CHECK_FALSE(cpu.trapped);
+
+  // The trap is only reported once.
+  result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 2);
+  CHECK(result.status == RunStatus::Completed);
+  CHECK(cpu.pc == Address{0x0004});
+}
+
+TEST_CASE("MicrocodePump runFor keeps going if the CPU ignores traps", "[pump]")
+{
+  std::array<Byte, 0x100> program{1, ToyCpu::c_trap, 1};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  cpu.trapPolicy = ToyCpu::TrapPolicy::Ignore;
+  MicrocodePump<ToyCpu> pump;
+
+  auto result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 5);
+  CHECK(result.status == RunStatus::Completed);
+  CHECK(result.cycles == 5);
+  CHECK(cpu.pc == Address{0x0003});
+  CHECK_FALSE(cpu.trapped);
+}
+
+TEST_CASE("MicrocodePump profiler counts executions and cycles per opcode", "[pump]")
+{
+  std::array<Byte, 0x100> program{2, 0, 2, 1};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  MicrocodePump<ToyCpu, OpcodeProfiler> pump;
+
+  // Stop in the middle of the last instruction, it is only charged up to the flush.
+  auto result = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 8);
+  CHECK(result.cycles == 8);
+  pump.profiler().flush(pump.cycles());
+
+  const auto& counters = pump.profiler().counters();
+  CHECK(counters[2].executions == 2);
+  CHECK(counters[2].cycles == 6);
+  CHECK(counters[0].executions == 1);
+  CHECK(counters[0].cycles == 1);
+  CHECK(counters[1].executions == 1);
+  CHECK(counters[1].cycles == 1);
+
+  // tick() reports to the profiler as well.
+  pump.tick(cpu, ToyCpu::BusToken{&bus});
+  pump.tick(cpu, ToyCpu::BusToken{&bus});
+  pump.profiler().flush(pump.cycles());
+  CHECK(counters[1].cycles == 2);
+  CHECK(counters[0].executions == 2);
+  CHECK(counters[0].cycles == 2);
+}
+
+TEST_CASE("MicrocodePump restores a snapshot taken in the middle of an instruction", "[pump]")
+{
+  std::array<Byte, 0x100> program{3, 4, 2, 5, 1};
+  MemoryDevice memory{std::span<Byte>(program)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0x00FF}, &memory}}};
+
+  ToyCpu cpu;
+  MicrocodePump<ToyCpu> pump;
+  pump.runFor(cpu, ToyCpu::BusToken{&bus}, 6);
+  REQUIRE_FALSE(pump.atInstructionBoundary());
+
+  auto snapshot = pump.snapshot();
+  ToyCpu savedCpu = cpu;
+  auto expected = pump.runFor(cpu, ToyCpu::BusToken{&bus}, 10);
+
+  ToyCpu clonedCpu = savedCpu;
+  MicrocodePump<ToyCpu> clone;
+  clone.restore(snapshot);
+  CHECK(clone.cycles() == 6);
+  CHECK_FALSE(clone.atInstructionBoundary());
+
+  auto result = clone.runFor(clonedCpu, ToyCpu::BusToken{&bus}, 10);
+  CHECK(result.cycles == expected.cycles);
+  CHECK(clonedCpu.pc == cpu.pc);
+  CHECK(clonedCpu.remaining == cpu.remaining);
+  CHECK(clone.cycles() == pump.cycles());
+  CHECK(clone.atInstructionBoundary() == pump.atInstructionBoundary());
+}
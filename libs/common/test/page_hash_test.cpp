@@ -0,0 +1,121 @@
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/page_hash.h"
+
+using namespace Common;
+
+namespace
+{
+
+using PageBytes = std::array<Byte, Bus::c_pageSize>;
+
+PageBytes pattern(unsigned multiplier, unsigned offset)
+{
+  PageBytes page{};
+  for (size_t i = 0; i < page.size(); ++i)
+  {
+    page[i] = static_cast<Byte>(i * multiplier + offset);
+  }
+  return page;
+}
+
+}  // namespace
+
+TEST_CASE("Page hashes are the same with every kernel", "[page_hash]")
+{
+  // Worked out independently of the kernels; a kernel that disagrees would break hashes saved by
+  // another build.
+  INFO("kernel " << pageKernel());
+  CHECK(hashPage(PageView(PageBytes{})) == 0x4F0CA611792A7116ull);
+  CHECK(hashPage(PageView(pattern(1, 0))) == 0x8DABBE8D841E05EFull);
+  CHECK(hashPage(PageView(pattern(7, 3))) == 0x3CFCE24A038636D1ull);
+}
+
+TEST_CASE("Page hashes and comparisons see every byte", "[page_hash]")
+{
+  PageBytes original = pattern(7, 3);
+  uint64_t hash = hashPage(PageView(original));
+  for (size_t i = 0; i < original.size(); ++i)
+  {
+    PageBytes changed = original;
+    changed[i] ^= 0x01;
+    if (hashPage(PageView(changed)) == hash || samePage(PageView(changed), PageView(original)))
+    {
+      FAIL("Byte " << i << " is not seen");
+    }
+  }
+  CHECK(samePage(PageView(original), PageView(pattern(7, 3))));
+}
+
+TEST_CASE("changedPages marks the pages that differ", "[page_hash]")
+{
+  std::vector<Byte> previous(4 * Bus::c_pageSize);
+  for (size_t i = 0; i < previous.size(); ++i)
+  {
+    previous[i] = static_cast<Byte>(i);
+  }
+  std::vector<Byte> memory = previous;
+  memory[0x1FF] = 0xAA;
+  memory[0x300] = 0xBB;
+
+  PageBitmap changed;
+  changed.set(0);  // Left alone
+  changedPages(memory, previous, changed, 10);
+  CHECK(changed.count() == 3);
+  CHECK(changed.test(0));
+  CHECK(changed.test(11));
+  CHECK(changed.test(13));
+
+  std::array<uint64_t, 4> hashes{};
+  std::array<uint64_t, 4> previousHashes{};
+  hashPages(memory, hashes);
+  hashPages(previous, previousHashes);
+  for (size_t page = 0; page < hashes.size(); ++page)
+  {
+    CHECK((hashes[page] != previousHashes[page]) == changed.test(10 + page));
+  }
+}
+
+TEST_CASE("Page hash benchmark", "[.][benchmark][page_hash]")
+{
+  std::vector<Byte> memory(0x10000);
+  for (size_t i = 0; i < memory.size(); ++i)
+  {
+    memory[i] = static_cast<Byte>(i * 13);
+  }
+  std::vector<Byte> previous = memory;
+  previous[0x8000] ^= 1;
+
+  BENCHMARK("memcmp per page, 64K")
+  {
+    unsigned changed = 0;
+    for (size_t offset = 0; offset < memory.size(); offset += Bus::c_pageSize)
+    {
+      changed += std::memcmp(memory.data() + offset, previous.data() + offset, Bus::c_pageSize) != 0 ? 1u : 0u;
+    }
+    return changed;
+  };
+
+  BENCHMARK("changedPages, 64K")
+  {
+    PageBitmap changed;
+    changedPages(memory, previous, changed);
+    return changed.count();
+  };
+
+  BENCHMARK("hashPages, 64K")
+  {
+    std::array<uint64_t, Bus::c_pageCount> hashes{};
+    hashPages(memory, hashes);
+    return hashes[0x80];
+  };
+}
@@ -0,0 +1,73 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+#include "common/spsc_ring.h"
+
+using Common::SpscRing;
+
+TEST_CASE("SpscRing fills, empties and wraps around", "[spsc_ring]")
+{
+  SpscRing<uint32_t, 4> ring;
+  std::array<uint32_t, 8> values{};
+  CHECK(ring.empty());
+  CHECK(ring.pop(values) == 0);
+
+  for (uint32_t value = 1; value <= 4; ++value)
+  {
+    CHECK(ring.push(value));
+  }
+  CHECK_FALSE(ring.push(5));
+
+  // Pop part of it, then refill past the end of the slots.
+  REQUIRE(ring.pop(std::span(values).first(3)) == 3);
+  CHECK(values[0] == 1);
+  CHECK(values[2] == 3);
+  CHECK(ring.push(5));
+  CHECK(ring.push(6));
+  CHECK(ring.push(7));
+  CHECK_FALSE(ring.push(8));
+
+  REQUIRE(ring.pop(values) == 4);
+  CHECK(values[0] == 4);
+  CHECK(values[3] == 7);
+  CHECK(ring.empty());
+}
+
+TEST_CASE("SpscRing hands values from one thread to another in order", "[spsc_ring]")
+{
+  constexpr uint32_t c_count = 200'000;
+  auto ring = std::make_unique<SpscRing<uint32_t, 256>>();
+
+  std::thread producer(
+      [&ring]
+      {
+        for (uint32_t value = 0; value < c_count;)
+        {
+          if (ring->push(value))
+          {
+            ++value;
+          }
+        }
+      });
+
+  uint32_t expected = 0;
+  bool ordered = true;
+  std::array<uint32_t, 64> values{};
+  while (expected < c_count)
+  {
+    size_t count = ring->pop(values);
+    for (size_t i = 0; i < count; ++i)
+    {
+      ordered = ordered && values[i] == expected;
+      ++expected;
+    }
+  }
+  producer.join();
+
+  CHECK(ordered);
+  CHECK(ring->empty());
+}
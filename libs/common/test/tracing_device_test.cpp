@@ -0,0 +1,69 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <array>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/tracing_device.h"
+
+using namespace Common;
+
+TEST_CASE("TracingDevice records bus cycles", "[bus]")
+{
+  std::array<Byte, 0x1000> ramStorage{};
+  std::array<Byte, 0x1000> romStorage{};
+  romStorage[0x001] = 0x77;
+
+  MemoryDevice ram{std::span<Byte>(ramStorage)};
+  MemoryDevice rom{std::span<const Byte>(romStorage)};
+  TracingDevice tracedRam{ram};
+  TracingDevice tracedRom{rom};
+
+  Bus bus{{
+      Bus::Entry{Address{0x1000}, Address{0x1FFF}, &tracedRam},
+      Bus::Entry{Address{0xF000}, Address{0xFFFF}, &tracedRom},
+  }};
+
+  SECTION("Accesses reach the wrapped device")
+  {
+    bus.write(Address{0x1234}, 0x42);
+    CHECK(ramStorage[0x234] == 0x42);
+    CHECK(bus.read(Address{0x1234}) == 0x42);
+    CHECK(bus.read(Address{0xF001}) == 0x77);
+
+    bus.write(Address{0xF001}, 0x66);
+    CHECK(romStorage[0x001] == 0x77);
+  }
+
+  SECTION("Cycles are recorded in order, including writes to ROM")
+  {
+    bus.write(Address{0x1001}, 0x55);
+    static_cast<void>(bus.read(Address{0x1001}));
+
+    const std::vector<Bus::Cycle> expectedRam{
+        {Address{0x1001}, 0x55, false},
+        {Address{0x1001}, 0x55, true},
+    };
+    auto ramCycles = tracedRam.cycles();
+    CHECK(std::vector<Bus::Cycle>(ramCycles.begin(), ramCycles.end()) == expectedRam);
+
+    static_cast<void>(bus.read(Address{0xF001}));
+    bus.write(Address{0xF001}, 0x66);
+
+    const std::vector<Bus::Cycle> expectedRom{
+        {Address{0xF001}, 0x77, true},
+        {Address{0xF001}, 0x66, false},
+    };
+    auto romCycles = tracedRom.cycles();
+    CHECK(std::vector<Bus::Cycle>(romCycles.begin(), romCycles.end()) == expectedRom);
+  }
+
+  SECTION("Reading the cycles resets the trace")
+  {
+    static_cast<void>(bus.read(Address{0x1000}));
+    CHECK(tracedRam.cycles().size() == 1);
+    CHECK(tracedRam.cycles().empty());
+  }
+}
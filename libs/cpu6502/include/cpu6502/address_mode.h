@@ -24,6 +24,32 @@ concept IsWriteOperation = requires {
   requires T::isWrite == true;
 };
 
+//! Instructions that may continue somewhere other than the next instruction declare `changesFlow`;
+//! a basic block ends with them.
+template<typename T>
+concept ChangesFlow = requires { requires T::changesFlow; };
+
+//! Runs the microcode an operation returned back to back, without going through MicrocodePump. The
+//! instruction-level engine uses this for the part of an instruction that is only known at run time
+//! (e.g. a taken branch or the writes of a read-modify-write). Returns `cycles` plus one cycle for each
+//! microcode step.
+inline uint32_t finishInstruction(
+    Generic6502Definition& cpu, Common::Bus& bus, uint32_t cycles, Generic6502Definition::Response response)
+{
+  for (auto next = response.injection; next != nullptr; ++cycles)
+  {
+    next = next(cpu, Generic6502Definition::BusToken{&bus}).injection;
+  }
+  return cycles;
+}
+
+//! Every addressing mode provides two entry points for the same instruction:
+//! - execute() is the first microcode step, MicrocodePump runs the rest one cycle at a time.
+//! - run() executes the whole instruction (after the opcode fetch) by calling the same steps
+//!   directly and returns its cycle count, including the opcode fetch.
+//! Modes with operand bytes also provide runDecoded(), which is run() for operand bytes the block
+//! cache has already read: it steps the PC over them and makes all the other accesses. run() reads
+//! the operand bytes and calls it.
 struct AddressMode
 {
   using MicrocodeResponse = Generic6502Definition::Response;
@@ -32,15 +58,24 @@ struct AddressMode
   using Byte = Common::Byte;
   using State = Generic6502Definition;
   using Format = Generic6502Definition::DisassemblyFormat;
+  using Bus = Common::Bus;
 };
 
 template<typename Derived>
 struct Implied : AddressMode
 {
+  static constexpr bool changesFlow = ChangesFlow<Derived>;
+
   static MicrocodeResponse execute(State& cpu, BusToken bus)
   {
     return Derived::step0(cpu, bus.read(cpu.registers.pc));
   }
+
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return finishInstruction(cpu, bus, 2, execute(cpu, BusToken{&bus}));
+  }
+
   static constexpr Format format;
 };
 
@@ -51,6 +86,12 @@ struct Accumulator : AddressMode
   {
     return Derived::step0(cpu, bus.read(cpu.registers.pc));
   }
+
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return finishInstruction(cpu, bus, 2, execute(cpu, BusToken{&bus}));
+  }
+
   static constexpr Format format;
 };
 
@@ -62,18 +103,44 @@ struct Immediate : AddressMode
     // Read the immediate operand from the instruction
     return Derived::step0(cpu, bus.read(cpu.registers.pc++));
   }
+
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    return finishInstruction(cpu, bus, 2, Derived::step0(cpu, lo));
+  }
+
   static constexpr Format format{"#$", "", 1 /* e.g. "#$44" */};
 };
 
 template<typename Derived>
 struct Relative : AddressMode
 {
+  static constexpr bool changesFlow = true;
+
   static MicrocodeResponse execute(State& cpu, BusToken bus)
   {
     // Read the signed 8-bit offset from the instruction
     return Derived::step0(cpu, bus.read(cpu.registers.pc++));
   }
-  static constexpr Format format{"$", "", 1 /* e.g. "$44" */};
+
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    return finishInstruction(cpu, bus, 2, Derived::step0(cpu, lo));
+  }
+
+  static constexpr Format format{"$", "", 1, true /* e.g. "$4410" */};
 };
 
 template<typename Derived, Common::Byte Registers::* reg>
@@ -91,6 +158,27 @@ struct ZeroPageBase : AddressMode
     return {finalize};
   }
 
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    cpu.lo = lo;
+    cpu.hi = 0;
+    if constexpr (reg != nullptr)
+    {
+      addZeroPageIndex(cpu, BusToken{&bus});
+      return finishInstruction(cpu, bus, 4, finalize(cpu, BusToken{&bus}));
+    }
+    else
+    {
+      return finishInstruction(cpu, bus, 3, finalize(cpu, BusToken{&bus}));
+    }
+  }
+
   static MicrocodeResponse addZeroPageIndex(State& cpu, BusToken bus)
   {
     // Adds the given register to the lo register of the effective address. Overflow is ignored for
@@ -117,8 +205,9 @@ struct ZeroPageBase : AddressMode
   }
 
   static constexpr Format format =  //
-      (reg == &Registers::x ? Format{"$", ",X", 1} :  //
-                              Format{"$", ",Y", 1});  // e.g. "$44,X"
+      (reg == nullptr         ? Format{"$", "", 1} :  //
+          reg == &Registers::x ? Format{"$", ",X", 1} :  //
+                                 Format{"$", ",Y", 1});  // e.g. "$44,X"
 };
 
 template<typename Derived>
@@ -133,12 +222,28 @@ using ZeroPageY = ZeroPageBase<Derived, &Registers::y>;
 template<typename Derived>
 struct Absolute : AddressMode
 {
+  static constexpr bool changesFlow = ChangesFlow<Derived>;
+
   static MicrocodeResponse execute(State& cpu, BusToken bus)
   {
     cpu.lo = bus.read(cpu.registers.pc++);
     return {readHighByte};
   }
 
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    Byte lo = bus.read(cpu.registers.pc);
+    return runDecoded(cpu, bus, lo, bus.read(cpu.registers.pc + 1));
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte hi)
+  {
+    cpu.registers.pc += 2;
+    cpu.lo = lo;
+    cpu.hi = hi;
+    return finishInstruction(cpu, bus, 4, finalize(cpu, BusToken{&bus}));
+  }
+
   static constexpr Format format{"$", "", 2};
 
 protected:
@@ -169,6 +274,26 @@ struct AbsoluteIndex : AddressMode
     return {readHighByte};
   }
 
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    Byte lo = bus.read(cpu.registers.pc);
+    return runDecoded(cpu, bus, lo, bus.read(cpu.registers.pc + 1));
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte hi)
+  {
+    cpu.registers.pc += 2;
+    cpu.lo = lo;
+    cpu.hi = hi;
+    MicrocodeResponse response = addIndex(cpu, BusToken{&bus});
+    if (response.injection == finalize)
+    {
+      // Page crossing or write: one more cycle to access the corrected address.
+      return finishInstruction(cpu, bus, 5, finalize(cpu, BusToken{&bus}));
+    }
+    return finishInstruction(cpu, bus, 4, response);
+  }
+
   static constexpr Format format =  //
       (reg == &Registers::x ? Format{"$", ",X", 2} :  //
                               Format{"$", ",Y", 2});
@@ -204,13 +329,13 @@ private:
       ++cpu.hi;
 
       // Schedule an extra read cycle to get the correct address
-      return {pageCrossingPenalty};
+      return {finalize};
     }
 
     if constexpr (IsWriteOperation<Derived>)
     {
-      // For write operations, we need to write the original value back first
-      return {pageCrossingPenalty};
+      // Write operations always take the extra cycle, even without a page crossing
+      return {finalize};
     }
 
     if constexpr (NeedsOperand<decltype(Derived::step0)>)
@@ -224,11 +349,6 @@ private:
     }
   }
 
-  static MicrocodeResponse pageCrossingPenalty(State& /*cpu*/, BusToken /*bus*/)
-  {
-    return {finalize};
-  }
-
   static MicrocodeResponse finalize(State& cpu, BusToken bus)
   {
     auto effectiveAddr = Common::MakeAddress(cpu.lo, cpu.hi);
@@ -285,6 +405,22 @@ struct IndirectZeroPageX : AddressMode
     return {spuriousRead};
   }
 
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    cpu.lo = lo;
+    cpu.hi = 0;
+    spuriousRead(cpu, BusToken{&bus});
+    addZeroPageIndex(cpu, BusToken{&bus});
+    readHiByteFromZeroPage(cpu, BusToken{&bus});
+    return finishInstruction(cpu, bus, 6, readEffectiveAddress(cpu, BusToken{&bus}));
+  }
+
   static constexpr Format format{"($", ",X)", 1};
 
 private:
@@ -342,6 +478,27 @@ struct IndirectZeroPageY : AddressMode
     return {readLoByteFromZeroPage};
   }
 
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    cpu.lo = lo;
+    cpu.hi = 0;
+    readLoByteFromZeroPage(cpu, BusToken{&bus});
+    readHiByteFromZeroPage(cpu, BusToken{&bus});
+    MicrocodeResponse response = add16BitIndex(cpu, BusToken{&bus});
+    if (response.injection == fixupHighByte)
+    {
+      // Page crossing or write: one more cycle to access the corrected address.
+      return finishInstruction(cpu, bus, 6, fixupHighByte(cpu, BusToken{&bus}));
+    }
+    return finishInstruction(cpu, bus, 5, response);
+  }
+
   static constexpr Format format{"($", "),Y", 1};
 
 private:
@@ -410,4 +567,63 @@ private:
   }
 };
 
+
+//! (zp), only on the 65C02: like (zp),Y without the index, so it always takes 5 cycles.
+template<typename Derived>
+struct IndirectZeroPage : AddressMode
+{
+  static MicrocodeResponse execute(State& cpu, BusToken bus)
+  {
+    // Read the zero page address from the instruction
+    cpu.lo = bus.read(cpu.registers.pc++);
+    cpu.hi = 0;
+    return {readLoByteFromZeroPage};
+  }
+
+  static uint32_t run(State& cpu, Bus& bus)
+  {
+    return runDecoded(cpu, bus, bus.read(cpu.registers.pc), 0);
+  }
+
+  static uint32_t runDecoded(State& cpu, Bus& bus, Byte lo, Byte /*hi*/)
+  {
+    ++cpu.registers.pc;
+    cpu.lo = lo;
+    cpu.hi = 0;
+    readLoByteFromZeroPage(cpu, BusToken{&bus});
+    readHiByteFromZeroPage(cpu, BusToken{&bus});
+    return finishInstruction(cpu, bus, 5, readEffectiveAddress(cpu, BusToken{&bus}));
+  }
+
+  static constexpr Format format{"($", ")", 1};
+
+private:
+  static MicrocodeResponse readLoByteFromZeroPage(State& cpu, BusToken bus)
+  {
+    // we can't replace cpu.lo yet.
+    cpu.operand = bus.read(Common::MakeAddress(cpu.lo, 0x00));
+    return {readHiByteFromZeroPage};
+  }
+
+  static MicrocodeResponse readHiByteFromZeroPage(State& cpu, BusToken bus)
+  {
+    // The pointer wraps around within zero page
+    auto effectiveAddr = Common::MakeAddress(static_cast<Common::Byte>(cpu.lo + 1), 0x00);
+    cpu.lo = cpu.operand;
+    cpu.hi = bus.read(effectiveAddr);
+
+    return {readEffectiveAddress};
+  }
+
+  static MicrocodeResponse readEffectiveAddress(State& cpu, BusToken bus)
+  {
+    auto effectiveAddr = Common::MakeAddress(cpu.lo, cpu.hi);
+
+    if constexpr (NeedsOperand<decltype(Derived::step0)>)
+      return Derived::step0(cpu, bus.read(effectiveAddr));
+    else
+      return Derived::step0(cpu, bus, effectiveAddr);
+  }
+};
+
 }  // namespace cpu6502
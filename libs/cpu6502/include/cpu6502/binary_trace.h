@@ -0,0 +1,137 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "common/bus.h"
+#include "common/tracing_device.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+//! One instruction boundary in a binary trace: the registers and cycle count as the instruction is
+//! about to run, and, if the trace has them, the bus cycles of the instruction before it.
+struct TraceStep
+{
+  uint64_t cycle = 0;
+  Registers registers;
+  std::span<const Common::Bus::Cycle> busCycles{};  // Valid until the next step is written or read
+
+  bool operator==(const TraceStep& other) const noexcept;
+};
+
+//! Writes a compact trace, one step per instruction. Each step stores which registers changed, the
+//! cycles since the previous step and the PC as a small delta, so a typical instruction takes three
+//! or four bytes; bus cycles add two or three bytes each. Output is buffered and written in large
+//! blocks, nothing is kept beyond the buffer, so traces can be as long as the stream allows.
+class BinaryTraceWriter
+{
+public:
+  //! Writes the header. `busCycles` says if steps carry bus cycles.
+  BinaryTraceWriter(std::ostream& out, bool busCycles);
+
+  BinaryTraceWriter(const BinaryTraceWriter&) = delete;
+  BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+  //! Flushes.
+  ~BinaryTraceWriter();
+
+  //! `busCycles` is ignored if the trace has no bus cycles. At most TracingDevice::c_maxCycles.
+  void write(const TraceStep& step);
+
+  //! Writes out the buffer.
+  void flush();
+
+  uint64_t steps() const noexcept
+  {
+    return m_steps;
+  }
+
+private:
+  void put(Common::Byte byte);
+  void putNumber(uint64_t value);
+
+  std::ostream& m_out;
+  bool m_busCycles;
+  std::vector<char> m_buffer;
+  TraceStep m_previous;
+  Common::Address m_previousBusAddress{0};
+  uint64_t m_steps = 0;
+};
+
+//! Reads a trace written by BinaryTraceWriter, one step at a time.
+class BinaryTraceReader
+{
+public:
+  //! Reads the header. Throws std::runtime_error if `in` does not hold a trace.
+  explicit BinaryTraceReader(std::istream& in);
+
+  bool hasBusCycles() const noexcept
+  {
+    return m_busCycles;
+  }
+
+  //! The next step, or nullopt at the end of the trace. Throws std::runtime_error if the trace is
+  //! cut off or corrupt.
+  std::optional<TraceStep> next();
+
+private:
+  // nullopt at the end of the stream.
+  std::optional<Common::Byte> get();
+  Common::Byte require();
+  uint64_t getNumber();
+
+  std::istream& m_in;
+  bool m_busCycles = false;
+  std::vector<char> m_buffer;
+  size_t m_position = 0;
+  size_t m_size = 0;
+  TraceStep m_previous;
+  Common::Address m_previousBusAddress{0};
+  std::array<Common::Bus::Cycle, Common::TracingDevice::c_maxCycles> m_busCycleStorage{};
+};
+
+//! runFor() stop predicate that writes a step at every instruction boundary and never stops. With a
+//! TracingDevice, each step gets the bus cycles the device saw since the previous boundary.
+struct BinaryTraceRecorder
+{
+  BinaryTraceWriter* writer;
+  const Common::TracingDevice* device = nullptr;
+
+  bool operator()(const Generic6502Definition& cpu, uint64_t cycle) const
+  {
+    TraceStep step{cycle, cpu.registers};
+    if (device != nullptr)
+    {
+      step.busCycles = device->cycles();
+    }
+    writer->write(step);
+    return false;
+  }
+};
+
+//! Where two traces first differ.
+struct TraceDivergence
+{
+  uint64_t step = 0;  // Index of the first step that differs
+  std::optional<TraceStep> expected;  // nullopt if that trace ended first
+  std::optional<TraceStep> actual;
+  std::optional<TraceStep> lastMatch;  // The step before, if any
+
+  // The steps above have no busCycles, the readers have moved on. These are copies.
+  std::vector<Common::Bus::Cycle> expectedBusCycles{};
+  std::vector<Common::Bus::Cycle> actualBusCycles{};
+};
+
+//! Reads both traces in lockstep and returns the first step at which they differ, or nullopt if they
+//! are the same. Bus cycles are only compared if both traces have them.
+std::optional<TraceDivergence> findDivergence(BinaryTraceReader& expected, BinaryTraceReader& actual);
+
+}  // namespace cpu6502
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "cpu6502/cpu6502_types.h"
+
+namespace cpu6502
+{
+
+//! Basic blocks decoded ahead of time, keyed by the address of their first instruction. A block is the
+//! straight run of instructions from that address up to the first one that changes the flow (a branch,
+//! jump, call, return or BRK), to the end of the 256-byte page or to c_maxInstructions, whichever comes
+//! first. Each instruction is decoded once into its runner and operand bytes, so running a block is one
+//! indirect call per instruction without the opcode and operand fetches or the table lookup.
+//!
+//! Only code on pages the bus can peek is cached, which are RAM and ROM and never I/O, so skipping
+//! those reads has no side effects. The blocks of a page are thrown away as soon as the page's
+//! generation on the bus changes, by a write to it or by mapping other memory there; this keeps
+//! self-modifying code and bank switching correct. Memory changed behind the bus's back needs clear().
+//!
+//! The cache is made for one processor, whose instruction() decodes it and whose executeDecoded()
+//! runs its blocks.
+class BlockCache
+{
+public:
+  using Address = Common::Address;
+  using Decoded = Generic6502Definition::DecodedInstruction;
+  using Decoder = const Generic6502Definition::Instruction& (*)(Common::Byte opcode) noexcept;
+
+  static constexpr size_t c_maxInstructions{32};
+
+  //! A block found by find(), valid until the next find() or clear().
+  struct Block
+  {
+    std::span<const Decoded> instructions;  // Empty if the code at the address cannot be cached
+    size_t page = 0;
+    uint32_t generation = 0;  // The page's generation the block was decoded from
+  };
+
+  //! `decoder` is Processor::instruction.
+  explicit BlockCache(Decoder decoder) noexcept
+    : m_decoder(decoder)
+  {
+  }
+
+  //! The block starting at `address`, decoded now if it was not cached yet or its page has changed.
+  Block find(const Common::Bus& bus, Address address);
+
+  //! True while the page `block` was decoded from has not changed. Check after every instruction of
+  //! the block, as an instruction can overwrite the ones after it.
+  static bool isCurrent(const Common::Bus& bus, const Block& block) noexcept
+  {
+    return bus.generation(block.page) == block.generation;
+  }
+
+  //! Throws every block away.
+  void clear() noexcept;
+
+  //! Blocks decoded since construction, including those decoded again after a change.
+  uint64_t decodedBlocks() const noexcept
+  {
+    return m_decodedBlocks;
+  }
+
+  struct Executed
+  {
+    uint32_t cycles = 0;
+    uint32_t instructions = 0;
+  };
+
+  //! Runs the block at the PC with `Processor`, or one instruction with executeInstruction() if the code
+  //! there cannot be cached. The block is left early if the CPU does not continue with the next
+  //! instruction, because a branch was taken or an interrupt came, if the CPU traps, or if the block's
+  //! page changes.
+  template<typename Processor>
+  Executed execute(Generic6502Definition& cpu, Common::Bus& bus)
+  {
+    Block block = find(bus, cpu.registers.pc);
+    if (block.instructions.empty())
+    {
+      return {Processor::executeInstruction(cpu, bus), 1};
+    }
+
+    Executed executed;
+    for (const Decoded& instruction : block.instructions)
+    {
+      executed.cycles += Processor::executeDecoded(cpu, bus, instruction);
+      ++executed.instructions;
+      if (cpu.registers.pc != instruction.next || cpu.trapped || !isCurrent(bus, block))
+      {
+        break;
+      }
+    }
+    return executed;
+  }
+
+private:
+  // Where the instructions of the block starting at one offset are.
+  struct Range
+  {
+    uint16_t first = 0;  // Index in PageBlocks::instructions
+    uint8_t count = 0;  // 0 if not decoded yet
+  };
+
+  struct PageBlocks
+  {
+    uint32_t generation = 0;
+    std::array<Range, Common::Bus::c_pageSize> ranges{};
+    std::vector<Decoded> instructions;
+  };
+
+  // Appends the block at `address` to `blocks` and returns its range, which is empty if not even its
+  // first instruction can be cached.
+  Range decode(const Common::Bus& bus, Address address, PageBlocks& blocks);
+
+  Decoder m_decoder;
+  std::array<std::unique_ptr<PageBlocks>, Common::Bus::c_pageCount> m_pages;  // Allocated on first use
+  uint64_t m_decodedBlocks = 0;
+};
+
+}  // namespace cpu6502
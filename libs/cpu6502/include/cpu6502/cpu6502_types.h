@@ -1,5 +1,7 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
 #include <cstdint>
 
 #include "common/address.h"
@@ -13,6 +15,9 @@ struct Generic6502Definition : public Common::ProcessorDefinition<Common::Addres
 {
   using Flag = Registers::Flag;
 
+  //! What microcodeIndex() returns for a function that is not one of the processor's steps.
+  static constexpr uint16_t c_unknownMicrocode{0xFFFF};
+
   Generic6502Definition() = default;
   explicit Generic6502Definition(const Registers& state)
     : registers(state)
@@ -33,12 +38,36 @@ struct Generic6502Definition : public Common::ProcessorDefinition<Common::Addres
   Common::Byte hi = 0;
   // Storage for operand during instruction execution
   Common::Byte operand = 0;
+  // Opcode of the instruction being executed, for profiling
+  Common::Byte opcode = 0;
+
+  // Interrupt inputs, sampled at every instruction boundary by pollInterrupts().
+  bool irq = false;  // IRQ line, level triggered: stays set while any device asserts it
+  bool nmi = false;  // NMI edge latch: set by triggerNmi(), cleared when the CPU takes the NMI vector
+
+  // CLI, SEI and PLP change I after the CPU has already polled for interrupts, so the poll at the end of
+  // those instructions still sees the old value.
+  bool interruptMaskDelayed = false;
+  bool delayedInterruptMask = false;
+
+  constexpr void triggerNmi() noexcept
+  {
+    nmi = true;
+  }
+
+  //! Called by instructions that change I, before they change it.
+  constexpr void delayInterruptMask() noexcept;
+
+  //! True if the CPU takes an interrupt instead of fetching the next opcode. Called once per
+  //! instruction boundary.
+  [[nodiscard]] constexpr bool pollInterrupts() noexcept;
 
   struct DisassemblyFormat
   {
-    const char prefix[3] = "";  // e.g. "#$" or "($" -- 2 characters + null terminator
-    const char suffix[4] = "";  // e.g. ",X)" or ",Y" -- 3 characters + null terminator
+    char prefix[3] = "";  // e.g. "#$" or "($" -- 2 characters + null terminator
+    char suffix[4] = "";  // e.g. ",X)" or ",Y" -- 3 characters + null terminator
     Common::Byte numberOfOperands = 0;
+    bool relative = false;  // The operand is a branch offset, shown as the target address
   };
 
   struct Instruction
@@ -49,6 +78,32 @@ struct Generic6502Definition : public Common::ProcessorDefinition<Common::Addres
     char mnemonic[4] = "???";
     DisassemblyFormat format;
     Microcode op = {};  // first microcode operation
+
+    // Runs the whole instruction once its opcode has been fetched and returns the number of cycles it
+    // took, including the fetch. Used by the instruction-level engine.
+    using Runner = uint32_t (*)(Generic6502Definition&, Common::Bus&);
+    Runner run = nullptr;
+
+    // Like run(), but with the operand bytes already read and the PC still on them. Used by the block
+    // cache; nullptr for instructions that gain nothing from it, which it runs with run().
+    using DecodedRunner = uint32_t (*)(Generic6502Definition&, Common::Bus&, Common::Byte lo, Common::Byte hi);
+    DecodedRunner runDecoded = nullptr;
+
+    // Branches, jumps, calls, returns and BRK: the next instruction is not necessarily the one that
+    // follows, so a basic block ends here.
+    bool changesFlow = false;
+  };
+
+  //! One instruction of a basic block, decoded ahead of time from the Instruction for its opcode and the
+  //! bytes that follow it, see BlockCache.
+  struct DecodedInstruction
+  {
+    Instruction::Runner run = nullptr;
+    Instruction::DecodedRunner runDecoded = nullptr;  // Used instead of run if set
+    Common::Address next{0};  // Address of the instruction that follows
+    Common::Byte opcode = 0;
+    Common::Byte lo = 0;  // First operand byte, 0 if none
+    Common::Byte hi = 0;  // Second operand byte, 0 if none
   };
 };
 
@@ -62,10 +117,42 @@ constexpr void Generic6502Definition::set(Flag f, bool v) noexcept
   registers.p = v ? (registers.p | static_cast<uint8_t>(f)) : (registers.p & ~static_cast<uint8_t>(f));
 }
 
+constexpr void Generic6502Definition::delayInterruptMask() noexcept
+{
+  delayedInterruptMask = has(Flag::Interrupt);
+  interruptMaskDelayed = true;
+}
+
+constexpr bool Generic6502Definition::pollInterrupts() noexcept
+{
+  bool masked = interruptMaskDelayed ? delayedInterruptMask : has(Flag::Interrupt);
+  interruptMaskDelayed = false;
+  return nmi || (irq && !masked);
+}
+
+namespace detail
+{
+
+constexpr auto c_zeroNegativeMask = static_cast<Common::Byte>(
+    static_cast<Common::Byte>(Registers::Flag::Zero) | static_cast<Common::Byte>(Registers::Flag::Negative));
+
+//! The Z and N bits of P for every result, so setZN() is a single merge instead of two read-modify-writes.
+constexpr std::array<Common::Byte, 256> c_zeroNegative = []()
+{
+  std::array<Common::Byte, 256> table{};
+  for (size_t v = 0; v < table.size(); ++v)
+  {
+    table[v] = static_cast<Common::Byte>((v == 0 ? static_cast<Common::Byte>(Registers::Flag::Zero) : 0) |
+                                         (v & static_cast<Common::Byte>(Registers::Flag::Negative)));
+  }
+  return table;
+}();
+
+}  // namespace detail
+
 constexpr void Generic6502Definition::setZN(Common::Byte v) noexcept
 {
-  set(Flag::Zero, v == 0);
-  set(Flag::Negative, (v & 0x80) != 0);
+  registers.p = static_cast<Common::Byte>((registers.p & ~detail::c_zeroNegativeMask) | detail::c_zeroNegative[v]);
 }
 
 // If you ever assign p wholesale, re-assert U:
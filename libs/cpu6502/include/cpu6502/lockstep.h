@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+//! Experimental: many 6502s that run the same code from different initial states, such as fuzzing
+//! inputs or test vectors. Each lane has its own registers and 64K of RAM and nothing else: no I/O
+//! and no interrupt inputs.
+//!
+//! The registers of all lanes are kept as structure of arrays. In every step the lanes that are at the
+//! same opcode run it together if it is one of the register-only instructions that have a kernel:
+//! transfers, increments and decrements, flag changes, shifts of A, immediate loads, logic, compares,
+//! binary ADC and SBC, branches and JMP. A kernel is one branch-free loop over the lanes, which the
+//! compiler turns into vector code. The other lanes run one at a time with the processor's
+//! instruction-level engine, so the result is always the same as running every lane on its own.
+class Lockstep
+{
+public:
+  using Address = Common::Address;
+  using Byte = Common::Byte;
+  using Executor = uint32_t (*)(Generic6502Definition& cpu, Common::Bus& bus);
+
+  static constexpr size_t c_memorySize{0x10000};
+
+  //! The registers of every lane, one array per register.
+  struct RegisterFile
+  {
+    std::vector<uint16_t> pc;
+    std::vector<Byte> a;
+    std::vector<Byte> x;
+    std::vector<Byte> y;
+    std::vector<Byte> sp;
+    std::vector<Byte> p;
+  };
+
+  //! Lane instructions run since construction, by the kernels and one lane at a time.
+  struct Stats
+  {
+    uint64_t lockstep = 0;
+    uint64_t scalar = 0;
+  };
+
+  //! `lanes` CPUs with default registers and cleared RAM. `executor` is Processor::executeInstruction;
+  //! the kernels only cover instructions that mos6502 and wdc65c02 run alike.
+  Lockstep(size_t lanes, Executor executor);
+  ~Lockstep();
+
+  size_t lanes() const noexcept
+  {
+    return m_lanes;
+  }
+
+  Registers registers(size_t lane) const noexcept;
+  void setRegisters(size_t lane, const Registers& registers) noexcept;
+
+  const RegisterFile& registerFile() const noexcept
+  {
+    return m_registers;
+  }
+
+  std::span<Byte, c_memorySize> memory(size_t lane) noexcept;
+  std::span<const Byte, c_memorySize> memory(size_t lane) const noexcept;
+
+  //! Cycles the lane has run.
+  uint64_t cycles(size_t lane) const noexcept
+  {
+    return m_cycles[lane];
+  }
+
+  //! A lane stops once its CPU traps, see Generic6502Definition::trap().
+  bool trapped(size_t lane) const noexcept
+  {
+    return m_trapped[lane] != 0;
+  }
+
+  Address trapAddress(size_t lane) const noexcept
+  {
+    return Address{m_trapAddress[lane]};
+  }
+
+  //! Runs one instruction on every lane that has not trapped. Returns the number of lanes that did.
+  size_t step();
+
+  //! Calls step() up to `steps` times, fewer if every lane traps. Returns the number of steps.
+  uint64_t run(uint64_t steps);
+
+  Stats stats() const noexcept
+  {
+    return m_stats;
+  }
+
+private:
+  // The RAM of one lane, as the instruction-level engine sees it.
+  struct LaneBus;
+
+  // The lanes' RAM is not a multiple of 4K apart, so the same address in every lane does not map to
+  // the same cache set.
+  static constexpr size_t c_laneStride{c_memorySize + 64};
+
+  // Runs one instruction on `lane` with the executor.
+  void stepScalar(size_t lane);
+
+  size_t m_lanes;
+  Executor m_executor;
+  RegisterFile m_registers;
+  std::vector<uint64_t> m_cycles;
+  std::vector<Byte> m_trapped;
+  std::vector<uint16_t> m_trapAddress;
+  std::vector<Byte> m_memory;  // c_laneStride bytes per lane
+  std::vector<std::unique_ptr<LaneBus>> m_buses;
+
+  // Per-lane scratch for step(): the opcode and operand bytes at the PC, 0xFF for the lanes a kernel
+  // runs, and whether the lane has run yet.
+  std::vector<Byte> m_opcode;
+  std::vector<Byte> m_lo;
+  std::vector<Byte> m_hi;
+  std::vector<Byte> m_mask;
+  std::vector<Byte> m_pending;
+
+  Stats m_stats;
+};
+
+}  // namespace cpu6502
@@ -21,8 +21,34 @@ struct mos6502 : public Generic6502Definition
 {
   static Microcode fetchNextOpcode(State& cpu, BusToken bus) noexcept;
 
+  //! A number for `microcode` that any build restores to the same code with microcode(), for
+  //! MicrocodePump snapshots. c_unknownMicrocode if it is none of this processor's steps.
+  static uint16_t microcodeIndex(Microcode microcode) noexcept;
+
+  //! The step microcodeIndex() numbers `index`, nullptr if there is none.
+  static Microcode microcode(uint16_t index) noexcept;
+
+  //! Instruction-level engine: fetches and runs one complete instruction without MicrocodePump, so
+  //! there is no indirect call per cycle. The bus sees the same accesses in the same order as with
+  //! the microcode engine. Returns the number of cycles the instruction took.
+  static uint32_t executeInstruction(State& cpu, Common::Bus& bus);
+
+  //! executeInstruction() for an instruction of a cached block at the PC, see BlockCache. Its bytes
+  //! are not read again.
+  static uint32_t executeDecoded(State& cpu, Common::Bus& bus, const DecodedInstruction& instruction);
+
+  //! The instruction table entry for `opcode`.
+  static const Instruction& instruction(Common::Byte opcode) noexcept;
+
   static void disassemble(
       const Registers& cpu, std::span<const Common::Byte, 3> bytes, Common::FixedFormatter& formatter) noexcept;
+
+  //! Disassembles the instruction at `address` without the register dump.
+  static void disassemble(
+      Common::Address address, std::span<const Common::Byte, 3> bytes, Common::FixedFormatter& formatter) noexcept;
+
+  //! Writes the mnemonic and addressing mode of `opcode` with placeholder operands, e.g. "LDA ($nn),Y".
+  static void describe(Common::Byte opcode, Common::FixedFormatter& formatter) noexcept;
 };
 
 }  // namespace cpu6502
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+#include <iosfwd>
+
+#include "common/profiler.h"
+
+namespace cpu6502
+{
+
+//! Writes the `limit` opcodes that used the most cycles, most expensive first, with their mnemonic
+//! and addressing mode, execution count, cycle count and share of all profiled cycles.
+void writeProfileReport(std::ostream& out, const Common::OpcodeProfiler& profiler, size_t limit = 32);
+
+}  // namespace cpu6502
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <span>
+#include <stop_token>
+#include <thread>
+
+#include "common/address.h"
+#include "common/fixed_formatter.h"
+#include "common/spsc_ring.h"
+#include "cpu6502/mos6502.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+//! One instruction as it is about to run: the registers with the PC on the opcode, the instruction's
+//! bytes and the number of bus cycles executed before it.
+struct TraceRecord
+{
+  uint64_t cycle = 0;
+  Registers registers;
+  std::array<Common::Byte, 3> bytes{};
+  bool bytesKnown = false;  // The bytes could be read without side effects
+};
+
+//! Instruction trace that costs the emulation thread one fixed-size copy per instruction. Records are
+//! queued in a lock-free ring, and a writer thread of its own disassembles them and writes them to the
+//! stream in batches, so tracing can stay on while the machine runs at full speed. If the writer falls
+//! behind, records that do not fit are dropped and counted rather than making the emulation wait.
+//!
+//! record() must only be called from one thread at a time. The stream is the writer's until the sink
+//! is destroyed, which writes out everything recorded before returning.
+class TraceSink
+{
+public:
+  using Disassembler = void (*)(
+      const Registers& cpu, std::span<const Common::Byte, 3> bytes, Common::FixedFormatter& formatter) noexcept;
+
+  static constexpr size_t c_capacity{1 << 16};
+
+  //! Records waiting in the ring that are formatted together and written with one call.
+  static constexpr size_t c_batchSize{1024};
+
+  //! `disassemble` must match the processor being traced.
+  explicit TraceSink(std::ostream& out, Disassembler disassemble = &mos6502::disassemble);
+
+  TraceSink(const TraceSink&) = delete;
+  TraceSink& operator=(const TraceSink&) = delete;
+  ~TraceSink();
+
+  //! Queues `record` for the writer. Never blocks; returns false if the ring was full and the record
+  //! was dropped.
+  bool record(const TraceRecord& record) noexcept
+  {
+    if (m_ring.push(record))
+    {
+      return true;
+    }
+    m_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+
+  //! Records dropped because the writer was behind.
+  uint64_t dropped() const noexcept
+  {
+    return m_dropped.load(std::memory_order_relaxed);
+  }
+
+  //! Formats `record` the way the writer does, e.g.
+  //! "0300 : A9 01      LDA #$01      A:00 X:00 Y:00 SP:FD P:24 --U--I-- @1234".
+  static void format(const TraceRecord& record, Disassembler disassemble, Common::FixedFormatter& formatter) noexcept;
+
+private:
+  void write(std::stop_token stop);
+
+  // Formats and writes what is in the ring. Returns the number of records written.
+  size_t drain();
+
+  std::ostream& m_out;
+  Disassembler m_disassemble;
+  Common::SpscRing<TraceRecord, c_capacity> m_ring;
+  std::atomic<uint64_t> m_dropped{0};
+  std::jthread m_writer;  // Last, so it starts after everything it uses and stops before it goes
+};
+
+}  // namespace cpu6502
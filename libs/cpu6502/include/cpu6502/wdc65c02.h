@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace Common
+{
+class FixedFormatter;
+}
+
+namespace cpu6502
+{
+
+//! The CMOS 65C02 of the enhanced Apple IIe: the 6502 instruction set plus BRA, PHX/PHY/PLX/PLY, STZ,
+//! TRB/TSB, INC A/DEC A, BIT #/zp,X/abs,X, JMP (abs,X) and (zp) addressing. JMP ($xxFF) reads its high
+//! byte from the next page, read-modify-write instructions re-read their operand instead of writing it
+//! twice, shifts and rotates on abs,X only take the extra cycle when the index crosses a page, and
+//! decimal ADC/SBC take one more cycle and set N and Z from the decimal result.
+//!
+//! The Rockwell bit instructions (RMB/SMB/BBR/BBS) and WAI/STP are not included; like the other opcodes
+//! the 65C02 does not define, they are one cycle NOPs.
+struct wdc65c02 : public Generic6502Definition
+{
+  static Microcode fetchNextOpcode(State& cpu, BusToken bus) noexcept;
+
+  //! See mos6502::microcodeIndex().
+  static uint16_t microcodeIndex(Microcode microcode) noexcept;
+  static Microcode microcode(uint16_t index) noexcept;
+
+  //! Instruction-level engine, see mos6502::executeInstruction().
+  static uint32_t executeInstruction(State& cpu, Common::Bus& bus);
+
+  //! See mos6502::executeDecoded().
+  static uint32_t executeDecoded(State& cpu, Common::Bus& bus, const DecodedInstruction& instruction);
+
+  static const Instruction& instruction(Common::Byte opcode) noexcept;
+
+  static void disassemble(
+      const Registers& cpu, std::span<const Common::Byte, 3> bytes, Common::FixedFormatter& formatter) noexcept;
+
+  static void disassemble(
+      Common::Address address, std::span<const Common::Byte, 3> bytes, Common::FixedFormatter& formatter) noexcept;
+
+  static void describe(Common::Byte opcode, Common::FixedFormatter& formatter) noexcept;
+};
+
+}  // namespace cpu6502
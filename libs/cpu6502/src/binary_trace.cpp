@@ -0,0 +1,291 @@
+#include "cpu6502/binary_trace.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+namespace cpu6502
+{
+
+namespace
+{
+
+using Common::Address;
+using Common::Byte;
+
+constexpr std::array<char, 4> c_magic{'E', '6', 'T', 'R'};
+constexpr Byte c_version{1};
+constexpr Byte c_hasBusCycles{0x01};
+
+constexpr size_t c_bufferSize{1 << 16};
+
+// Bits of a step's first byte: which registers are stored after the cycle delta, in this order.
+enum Changed : Byte
+{
+  c_pc = 0x01,
+  c_a = 0x02,
+  c_x = 0x04,
+  c_y = 0x08,
+  c_sp = 0x10,
+  c_p = 0x20,
+};
+
+// Small signed deltas as small unsigned numbers: 0, -1, 1, -2, 2...
+uint64_t zigzag(int16_t value) noexcept
+{
+  return value < 0 ? (static_cast<uint64_t>(-(value + 1)) << 1) | 1 : static_cast<uint64_t>(value) << 1;
+}
+
+int16_t unzigzag(uint64_t value) noexcept
+{
+  auto magnitude = static_cast<int32_t>(value >> 1);
+  return static_cast<int16_t>((value & 1) != 0 ? -magnitude - 1 : magnitude);
+}
+
+// The wrapped distance from `from` to `to`.
+int16_t delta(Address from, Address to) noexcept
+{
+  return static_cast<int16_t>(static_cast<uint16_t>(static_cast<uint16_t>(to) - static_cast<uint16_t>(from)));
+}
+
+Address offset(Address from, int16_t delta) noexcept
+{
+  return Address{static_cast<uint16_t>(static_cast<uint16_t>(from) + static_cast<uint16_t>(delta))};
+}
+
+std::vector<Common::Bus::Cycle> copy(std::optional<TraceStep>& step)
+{
+  if (!step)
+  {
+    return {};
+  }
+  std::vector<Common::Bus::Cycle> cycles(step->busCycles.begin(), step->busCycles.end());
+  step->busCycles = {};
+  return cycles;
+}
+
+}  // namespace
+
+bool TraceStep::operator==(const TraceStep& other) const noexcept
+{
+  return cycle == other.cycle && registers == other.registers && std::ranges::equal(busCycles, other.busCycles);
+}
+
+BinaryTraceWriter::BinaryTraceWriter(std::ostream& out, bool busCycles)
+  : m_out(out)
+  , m_busCycles(busCycles)
+{
+  m_buffer.reserve(c_bufferSize);
+  m_buffer.insert(m_buffer.end(), c_magic.begin(), c_magic.end());
+  put(c_version);
+  put(busCycles ? c_hasBusCycles : Byte{0});
+}
+
+BinaryTraceWriter::~BinaryTraceWriter()
+{
+  flush();
+}
+
+void BinaryTraceWriter::write(const TraceStep& step)
+{
+  const Registers& now = step.registers;
+  const Registers& before = m_previous.registers;
+  Byte changed = static_cast<Byte>((now.pc != before.pc ? c_pc : 0) | (now.a != before.a ? c_a : 0) |
+                                   (now.x != before.x ? c_x : 0) | (now.y != before.y ? c_y : 0) |
+                                   (now.sp != before.sp ? c_sp : 0) | (now.p != before.p ? c_p : 0));
+  put(changed);
+  putNumber(step.cycle - m_previous.cycle);
+  if ((changed & c_pc) != 0)
+  {
+    putNumber(zigzag(delta(before.pc, now.pc)));
+  }
+  for (auto [bit, value] : {std::pair{c_a, now.a}, {c_x, now.x}, {c_y, now.y}, {c_sp, now.sp}, {c_p, now.p}})
+  {
+    if ((changed & bit) != 0)
+    {
+      put(value);
+    }
+  }
+
+  if (m_busCycles)
+  {
+    auto cycles = step.busCycles.first(std::min(step.busCycles.size(), Common::TracingDevice::c_maxCycles));
+    putNumber(cycles.size());
+    for (const auto& cycle : cycles)
+    {
+      putNumber((zigzag(delta(m_previousBusAddress, cycle.address)) << 1) | (cycle.isRead ? 1 : 0));
+      put(cycle.data);
+      m_previousBusAddress = cycle.address;
+    }
+  }
+
+  m_previous = TraceStep{step.cycle, now};
+  ++m_steps;
+  if (m_buffer.size() >= c_bufferSize - 64)
+  {
+    flush();
+  }
+}
+
+void BinaryTraceWriter::flush()
+{
+  m_out.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+  m_out.flush();
+  m_buffer.clear();
+}
+
+void BinaryTraceWriter::put(Byte byte)
+{
+  m_buffer.push_back(static_cast<char>(byte));
+}
+
+void BinaryTraceWriter::putNumber(uint64_t value)
+{
+  // Seven bits at a time, low bits first, the top bit set on all but the last byte.
+  while (value >= 0x80)
+  {
+    put(static_cast<Byte>(value | 0x80));
+    value >>= 7;
+  }
+  put(static_cast<Byte>(value));
+}
+
+BinaryTraceReader::BinaryTraceReader(std::istream& in)
+  : m_in(in)
+  , m_buffer(c_bufferSize)
+{
+  for (char expected : c_magic)
+  {
+    if (get() != static_cast<Byte>(expected))
+    {
+      throw std::runtime_error("Not a binary trace");
+    }
+  }
+  if (get() != c_version)
+  {
+    throw std::runtime_error("Unsupported binary trace version");
+  }
+  m_busCycles = (require() & c_hasBusCycles) != 0;
+}
+
+std::optional<TraceStep> BinaryTraceReader::next()
+{
+  auto first = get();
+  if (!first)
+  {
+    return std::nullopt;
+  }
+  Byte changed = *first;
+  if ((changed & ~(c_pc | c_a | c_x | c_y | c_sp | c_p)) != 0)
+  {
+    throw std::runtime_error("Corrupt binary trace");
+  }
+
+  TraceStep step{m_previous.cycle + getNumber(), m_previous.registers};
+  Registers& now = step.registers;
+  if ((changed & c_pc) != 0)
+  {
+    now.pc = offset(now.pc, unzigzag(getNumber()));
+  }
+  for (auto [bit, value] : {std::pair{c_a, &now.a}, {c_x, &now.x}, {c_y, &now.y}, {c_sp, &now.sp}, {c_p, &now.p}})
+  {
+    if ((changed & bit) != 0)
+    {
+      *value = require();
+    }
+  }
+
+  if (m_busCycles)
+  {
+    uint64_t count = getNumber();
+    if (count > m_busCycleStorage.size())
+    {
+      throw std::runtime_error("Corrupt binary trace");
+    }
+    for (size_t i = 0; i < count; ++i)
+    {
+      uint64_t encoded = getNumber();
+      Address address = offset(m_previousBusAddress, unzigzag(encoded >> 1));
+      m_busCycleStorage[i] = Common::Bus::Cycle{address, require(), (encoded & 1) != 0};
+      m_previousBusAddress = address;
+    }
+    step.busCycles = std::span(m_busCycleStorage).first(count);
+  }
+
+  m_previous = TraceStep{step.cycle, now};
+  return step;
+}
+
+std::optional<Byte> BinaryTraceReader::get()
+{
+  if (m_position == m_size)
+  {
+    m_in.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    m_size = static_cast<size_t>(m_in.gcount());
+    m_position = 0;
+    if (m_size == 0)
+    {
+      return std::nullopt;
+    }
+  }
+  return static_cast<Byte>(m_buffer[m_position++]);
+}
+
+Byte BinaryTraceReader::require()
+{
+  auto byte = get();
+  if (!byte)
+  {
+    throw std::runtime_error("Binary trace is cut off");
+  }
+  return *byte;
+}
+
+uint64_t BinaryTraceReader::getNumber()
+{
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7)
+  {
+    Byte byte = require();
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0)
+    {
+      return value;
+    }
+  }
+  throw std::runtime_error("Corrupt binary trace");
+}
+
+std::optional<TraceDivergence> findDivergence(BinaryTraceReader& expected, BinaryTraceReader& actual)
+{
+  bool compareBusCycles = expected.hasBusCycles() && actual.hasBusCycles();
+  std::optional<TraceStep> lastMatch;
+  for (uint64_t index = 0;; ++index)
+  {
+    auto left = expected.next();
+    auto right = actual.next();
+    if (!left && !right)
+    {
+      return std::nullopt;
+    }
+
+    bool same = left && right &&
+                (compareBusCycles ? *left == *right
+                                  : left->cycle == right->cycle && left->registers == right->registers);
+    if (!same)
+    {
+      TraceDivergence divergence{index, left, right, lastMatch};
+      divergence.expectedBusCycles = copy(divergence.expected);
+      divergence.actualBusCycles = copy(divergence.actual);
+      return divergence;
+    }
+
+    lastMatch = TraceStep{left->cycle, left->registers};
+  }
+}
+
+}  // namespace cpu6502
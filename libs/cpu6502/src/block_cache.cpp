@@ -0,0 +1,102 @@
+#include "cpu6502/block_cache.h"
+
+#include <memory>
+#include <optional>
+
+#include "common/address.h"
+#include "common/bus.h"
+
+using namespace Common;
+
+namespace cpu6502
+{
+
+BlockCache::Block BlockCache::find(const Bus& bus, Address address)
+{
+  size_t page = HiByte(address);
+  uint32_t generation = bus.generation(page);
+  Block block{{}, page, generation};
+
+  std::unique_ptr<PageBlocks>& blocks = m_pages[page];
+  if (blocks == nullptr)
+  {
+    // Pages that cannot be peeked, I/O and split pages, are never cached.
+    if (!bus.peek(address))
+    {
+      return block;
+    }
+    blocks = std::make_unique<PageBlocks>();
+    blocks->generation = generation;
+  }
+  else if (blocks->generation != generation)
+  {
+    blocks->ranges.fill({});
+    blocks->instructions.clear();
+    blocks->generation = generation;
+  }
+
+  Range& range = blocks->ranges[LoByte(address)];
+  if (range.count == 0)
+  {
+    range = decode(bus, address, *blocks);
+  }
+  block.instructions = std::span<const Decoded>(blocks->instructions).subspan(range.first, range.count);
+  return block;
+}
+
+void BlockCache::clear() noexcept
+{
+  for (auto& blocks : m_pages)
+  {
+    blocks.reset();
+  }
+}
+
+BlockCache::Range BlockCache::decode(const Bus& bus, Address address, PageBlocks& blocks)
+{
+  Range range{static_cast<uint16_t>(blocks.instructions.size()), 0};
+  Address pc = address;
+  while (range.count < c_maxInstructions)
+  {
+    std::optional<Byte> opcode = bus.peek(pc);
+    if (!opcode)
+    {
+      break;
+    }
+
+    // Opcodes without a runner are left to executeInstruction(), as are instructions that run off
+    // the page, whose operands might be somewhere that cannot be peeked or that changes separately.
+    const Generic6502Definition::Instruction& instruction = m_decoder(*opcode);
+    size_t length = 1 + size_t{instruction.format.numberOfOperands};
+    if (instruction.run == nullptr || LoByte(pc) + length > Bus::c_pageSize)
+    {
+      break;
+    }
+
+    Decoded decoded{instruction.run, instruction.runDecoded, pc + static_cast<uint16_t>(length), *opcode};
+    if (length > 1)
+    {
+      decoded.lo = *bus.peek(pc + 1);
+    }
+    if (length > 2)
+    {
+      decoded.hi = *bus.peek(pc + 2);
+    }
+    blocks.instructions.push_back(decoded);
+    ++range.count;
+    pc = decoded.next;
+
+    if (instruction.changesFlow || LoByte(pc) == 0)
+    {
+      break;
+    }
+  }
+
+  if (range.count != 0)
+  {
+    ++m_decodedBlocks;
+  }
+  return range;
+}
+
+}  // namespace cpu6502
@@ -0,0 +1,102 @@
+#include "instruction_table.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+#include "common/address.h"
+#include "common/fixed_formatter.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+using Common::Address;
+using Common::Byte;
+using Common::FixedFormatter;
+
+void disassemble(
+    const InstructionTable& table, Address address, std::span<const Byte, 3> bytes, FixedFormatter& formatter) noexcept
+{
+  formatter << address << " : ";
+
+  const Byte opcode = bytes[0];
+  const auto& instr = table[opcode];
+
+  assert(instr.format.numberOfOperands < std::size(bytes));
+
+  // Add operand bytes
+  formatter << opcode << ' ';
+  (instr.format.numberOfOperands > 0 ? (formatter << bytes[1]) : (formatter << "  ")) << ' ';
+  (instr.format.numberOfOperands > 1 ? (formatter << bytes[2]) : (formatter << "  ")) << ' ';
+
+  // Mnemonic
+  formatter << "  " << instr.mnemonic << ' ';
+
+  // Operand formatting based on addressing mode
+  // The maximum length of the operand field is 7 characters (e.g. "$xxxx,X")
+  // We will pad with spaces if the operand is shorter
+  size_t currentLength = formatter.finalize().length();
+
+  formatter << instr.format.prefix;
+
+  // Special case for branch instructions to show target address
+
+  if (instr.format.numberOfOperands == 2)
+  {
+    // Need to output an address
+    formatter << bytes[2] << bytes[1];
+  }
+  else if (instr.format.relative)
+  {
+    // Calculate target address for branch
+    int32_t offset = static_cast<int8_t>(bytes[1]);
+    int32_t target = static_cast<int32_t>(address) + 2 + offset;  // Address + instruction length + offset
+    formatter << Address{static_cast<uint16_t>(target)};
+  }
+  else if (instr.format.numberOfOperands == 1)
+  {
+    formatter << bytes[1];
+  }
+
+  formatter << instr.format.suffix;
+
+  // Pad to 9 characters
+  size_t neededSpaces = formatter.finalize().length() - currentLength;
+  static constexpr std::string_view padding = "         ";  // 9 spaces
+
+  formatter << padding.substr(0, 9 - neededSpaces);
+}
+
+void disassemble(const InstructionTable& table, const Registers& cpu, std::span<const Byte, 3> bytes,
+    FixedFormatter& formatter) noexcept
+{
+  // The opcode has been fetched, so the PC points one past it.
+  disassemble(table, cpu.pc - 1, bytes, formatter);
+
+  // Add registers: A, X, Y, SP, P
+  formatter << " A:" << cpu.a;
+  formatter << " X:" << cpu.x;
+  formatter << " Y:" << cpu.y;
+  formatter << " SP:" << cpu.sp;
+  formatter << " P:" << cpu.p;
+  formatter << ' ';
+  cpu6502::flagsToStr(formatter, cpu.p);
+}
+
+void describe(const InstructionTable& table, Byte opcode, FixedFormatter& formatter) noexcept
+{
+  const auto& instr = table[opcode];
+  formatter << std::string_view(instr.mnemonic);
+
+  const auto& format = instr.format;
+  if (format.numberOfOperands > 0)
+  {
+    formatter << ' ' << std::string_view(format.prefix) << (format.numberOfOperands == 2 ? "nnnn" : "nn")
+              << std::string_view(format.suffix);
+  }
+}
+
+}  // namespace cpu6502
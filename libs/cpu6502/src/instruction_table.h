@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <iterator>
+#include <span>
+#include <string_view>
+
+#include "common/address.h"
+#include "common/fixed_formatter.h"
+#include "cpu6502/address_mode.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+//! One entry per opcode. Opcodes that are never added keep the default entry, which ends the
+//! instruction with the opcode fetch.
+using InstructionTable = std::array<Generic6502Definition::Instruction, 256>;
+
+struct Builder
+{
+  InstructionTable& table;
+
+  template<typename Cmd>
+  constexpr Builder& add(Common::Byte opcode, std::string_view mnemonic)
+  {
+    Generic6502Definition::Instruction& instr = table[opcode];
+    instr.opcode = opcode;
+    std::ranges::copy(mnemonic, std::begin(instr.mnemonic));
+    instr.format = Cmd::format;
+    instr.op = Cmd::execute;
+    instr.run = Cmd::run;
+    if constexpr (requires { Cmd::runDecoded; })
+    {
+      instr.runDecoded = Cmd::runDecoded;
+    }
+    instr.changesFlow = ChangesFlow<Cmd>;
+    return *this;
+  }
+};
+
+//! The disassembler shared by every processor, see mos6502::disassemble().
+void disassemble(const InstructionTable& table, Common::Address address, std::span<const Common::Byte, 3> bytes,
+    Common::FixedFormatter& formatter) noexcept;
+void disassemble(const InstructionTable& table, const Registers& cpu, std::span<const Common::Byte, 3> bytes,
+    Common::FixedFormatter& formatter) noexcept;
+void describe(const InstructionTable& table, Common::Byte opcode, Common::FixedFormatter& formatter) noexcept;
+
+}  // namespace cpu6502
@@ -0,0 +1,533 @@
+#include "cpu6502/lockstep.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+namespace
+{
+
+using Byte = Common::Byte;
+using Flag = Registers::Flag;
+using RegisterFile = Lockstep::RegisterFile;
+
+constexpr Byte bit(Flag flag) noexcept
+{
+  return static_cast<Byte>(flag);
+}
+
+constexpr Byte c_carry = bit(Flag::Carry);
+constexpr Byte c_zeroNegative = bit(Flag::Zero) | bit(Flag::Negative);
+constexpr Byte c_arithmetic = c_carry | bit(Flag::Overflow) | c_zeroNegative;
+
+// One lane's registers while a kernel runs. The kernels are written for one lane like the operations
+// in operations.h, but without branches: registerKernel() runs them for every lane and keeps the
+// results of the lanes in the mask, so the loop can be vectorized.
+struct Lane
+{
+  Byte a;
+  Byte x;
+  Byte y;
+  Byte sp;
+  Byte p;
+};
+
+constexpr Byte clear(Byte p, unsigned flags) noexcept
+{
+  return static_cast<Byte>(p & ~flags);
+}
+
+constexpr Byte zeroNegative(Byte value) noexcept
+{
+  return static_cast<Byte>((value == 0 ? bit(Flag::Zero) : 0) | (value & bit(Flag::Negative)));
+}
+
+constexpr void setZN(Lane& lane, Byte value) noexcept
+{
+  lane.p = static_cast<Byte>(clear(lane.p, c_zeroNegative) | zeroNegative(value));
+}
+
+// `carry` is 0 or 1.
+constexpr void setCarryZN(Lane& lane, unsigned carry, Byte value) noexcept
+{
+  lane.p = static_cast<Byte>(clear(lane.p, c_carry | c_zeroNegative) | carry | zeroNegative(value));
+}
+
+// A shift or rotate of A: `carry` is the bit shifted out.
+constexpr void shift(Lane& lane, unsigned carry, Byte result) noexcept
+{
+  lane.a = result;
+  setCarryZN(lane, carry, result);
+}
+
+template<Flag flag, bool set>
+constexpr void setFlag(Lane& lane, Byte /*operand*/) noexcept
+{
+  lane.p = set ? static_cast<Byte>(lane.p | bit(flag)) : clear(lane.p, bit(flag));
+}
+
+// Binary ADC; SBC adds the complement of the operand.
+constexpr void addWithCarry(Lane& lane, Byte operand) noexcept
+{
+  const unsigned sum = unsigned{lane.a} + operand + (lane.p & c_carry);
+  const auto result = static_cast<Byte>(sum);
+  const auto overflow = static_cast<Byte>((~(lane.a ^ operand) & (lane.a ^ result) & 0x80) >> 1);
+  lane.p = static_cast<Byte>(clear(lane.p, c_arithmetic) | (sum >> 8) | overflow | zeroNegative(result));
+  lane.a = result;
+}
+
+template<Byte Lane::* reg>
+constexpr void compare(Lane& lane, Byte operand) noexcept
+{
+  const Byte value = lane.*reg;
+  setCarryZN(lane, value >= operand ? 1u : 0u, static_cast<Byte>(value - operand));
+}
+
+template<Byte Lane::* reg>
+constexpr void load(Lane& lane, Byte operand) noexcept
+{
+  lane.*reg = operand;
+  setZN(lane, operand);
+}
+
+template<Byte Lane::* source, Byte Lane::* target>
+constexpr void transfer(Lane& lane, Byte /*operand*/) noexcept
+{
+  lane.*target = lane.*source;
+  if constexpr (target != &Lane::sp)
+  {
+    setZN(lane, lane.*target);
+  }
+}
+
+template<Byte Lane::* reg, int delta>
+constexpr void increment(Lane& lane, Byte /*operand*/) noexcept
+{
+  lane.*reg = static_cast<Byte>(lane.*reg + delta);
+  setZN(lane, lane.*reg);
+}
+
+constexpr Byte select(Byte mask, Byte value, Byte old) noexcept
+{
+  return static_cast<Byte>((value & mask) | (old & ~mask));
+}
+
+//! The lanes a kernel runs for and their operand bytes.
+struct Batch
+{
+  RegisterFile& registers;
+  size_t first;  // No lane before this one runs
+  std::span<uint64_t> cycles;
+  std::span<const Byte> lo;
+  std::span<const Byte> hi;
+  std::span<const Byte> mask;  // 0xFF for the lanes that run
+};
+
+using Kernel = void (*)(const Batch& batch) noexcept;
+
+constexpr size_t c_chunkLanes = 32;
+
+// Kernels work on a batch in chunks that are copied to local arrays. The compiler then knows that the
+// registers do not alias each other and how many lanes there are, which it needs to vectorize.
+struct Chunk
+{
+  std::array<uint16_t, c_chunkLanes> pc;
+  std::array<Byte, c_chunkLanes> a;
+  std::array<Byte, c_chunkLanes> x;
+  std::array<Byte, c_chunkLanes> y;
+  std::array<Byte, c_chunkLanes> sp;
+  std::array<Byte, c_chunkLanes> p;
+  std::array<uint64_t, c_chunkLanes> cycles;
+  std::array<Byte, c_chunkLanes> lo;
+  std::array<Byte, c_chunkLanes> hi;
+  std::array<Byte, c_chunkLanes> mask;
+};
+
+template<typename Run>
+void forEachChunk(const Batch& batch, Run run) noexcept
+{
+  RegisterFile& r = batch.registers;
+  const size_t lanes = batch.mask.size();
+  for (size_t first = batch.first; first < lanes; first += c_chunkLanes)
+  {
+    // Copies of a whole chunk have a constant size and are inlined.
+    const size_t count = std::min(c_chunkLanes, lanes - first);
+    const bool whole = count == c_chunkLanes;
+    auto copy = [whole, count](const auto* from, auto* to)
+    {
+      whole ? std::copy_n(from, c_chunkLanes, to) : std::copy_n(from, count, to);
+    };
+    auto in = [first, &copy](const auto& values, auto& local) { copy(values.data() + first, local.data()); };
+    auto out = [first, &copy](const auto& local, auto& values) { copy(local.data(), values.data() + first); };
+
+    Chunk chunk;
+    if (!whole)
+    {
+      chunk = Chunk{};  // The lanes past the end stay masked
+    }
+    in(r.pc, chunk.pc);
+    in(r.a, chunk.a);
+    in(r.x, chunk.x);
+    in(r.y, chunk.y);
+    in(r.sp, chunk.sp);
+    in(r.p, chunk.p);
+    in(batch.cycles, chunk.cycles);
+    in(batch.lo, chunk.lo);
+    in(batch.hi, chunk.hi);
+    in(batch.mask, chunk.mask);
+
+    run(chunk);
+
+    out(chunk.pc, r.pc);
+    out(chunk.a, r.a);
+    out(chunk.x, r.x);
+    out(chunk.y, r.y);
+    out(chunk.sp, r.sp);
+    out(chunk.p, r.p);
+    out(chunk.cycles, batch.cycles);
+  }
+}
+
+// Implied, accumulator and immediate instructions: 2 cycles, `length` bytes.
+template<auto operation, uint16_t length>
+void registerKernel(const Batch& batch) noexcept
+{
+  forEachChunk(batch,
+      [](Chunk& c)
+      {
+        for (size_t i = 0; i < c_chunkLanes; ++i)
+        {
+          Lane lane{c.a[i], c.x[i], c.y[i], c.sp[i], c.p[i]};
+          operation(lane, c.lo[i]);
+
+          const Byte keep = c.mask[i];
+          c.a[i] = select(keep, lane.a, c.a[i]);
+          c.x[i] = select(keep, lane.x, c.x[i]);
+          c.y[i] = select(keep, lane.y, c.y[i]);
+          c.sp[i] = select(keep, lane.sp, c.sp[i]);
+          c.p[i] = select(keep, lane.p, c.p[i]);
+          c.pc[i] = static_cast<uint16_t>(c.pc[i] + (keep & length));
+          c.cycles[i] += keep & 2u;
+        }
+      });
+}
+
+// Relative branches: 2 cycles, one more if taken and another one if the target is on another page.
+template<Flag flag, bool set>
+void branchKernel(const Batch& batch) noexcept
+{
+  forEachChunk(batch,
+      [](Chunk& c)
+      {
+        for (size_t i = 0; i < c_chunkLanes; ++i)
+        {
+          const unsigned taken = ((c.p[i] & bit(flag)) != 0) == set ? 1u : 0u;
+          const auto next = static_cast<uint16_t>(c.pc[i] + 2);
+          const auto target = static_cast<uint16_t>(next + static_cast<int8_t>(c.lo[i]));
+          const unsigned crossed = ((next ^ target) & 0xFF00) != 0 ? 1u : 0u;
+
+          const Byte keep = c.mask[i];
+          const uint16_t pc = taken != 0 ? target : next;
+          c.pc[i] = keep != 0 ? pc : c.pc[i];
+          c.cycles[i] += keep & (2u + taken + (taken & crossed));
+        }
+      });
+}
+
+// JMP absolute: 3 cycles.
+void jumpKernel(const Batch& batch) noexcept
+{
+  forEachChunk(batch,
+      [](Chunk& c)
+      {
+        for (size_t i = 0; i < c_chunkLanes; ++i)
+        {
+          const Byte keep = c.mask[i];
+          const auto target = static_cast<uint16_t>(c.lo[i] | c.hi[i] << 8);
+          c.pc[i] = keep != 0 ? target : c.pc[i];
+          c.cycles[i] += keep & 3u;
+        }
+      });
+}
+
+// Lanes a kernel cannot run, which run one at a time instead.
+enum class Exclude : uint8_t
+{
+  None,
+  Decimal,  // ADC and SBC in decimal mode, which mos6502 and wdc65c02 do differently
+  SelfBranch,  // A branch to itself, which traps
+};
+
+struct KernelEntry
+{
+  Kernel run = nullptr;
+  uint8_t length = 1;  // Instruction bytes, including the opcode
+  Exclude exclude = Exclude::None;
+};
+
+template<auto operation>
+constexpr KernelEntry c_implied{&registerKernel<operation, 1>, 1};
+
+template<auto operation>
+constexpr KernelEntry c_immediate{&registerKernel<operation, 2>, 2};
+
+template<Flag flag, bool set>
+constexpr KernelEntry c_branch{&branchKernel<flag, set>, 2, Exclude::SelfBranch};
+
+// Only documented instructions that take the same cycles and give the same results on every
+// processor, so any executor can be used.
+constexpr auto c_kernels = []()
+{
+  std::array<KernelEntry, 256> kernels{};
+
+  kernels[0xEA] = c_implied<[](Lane& /*lane*/, Byte /*operand*/) {}>;  // NOP
+  kernels[0x18] = c_implied<&setFlag<Flag::Carry, false>>;  // CLC
+  kernels[0x38] = c_implied<&setFlag<Flag::Carry, true>>;  // SEC
+  kernels[0xB8] = c_implied<&setFlag<Flag::Overflow, false>>;  // CLV
+  kernels[0xD8] = c_implied<&setFlag<Flag::Decimal, false>>;  // CLD
+  kernels[0xF8] = c_implied<&setFlag<Flag::Decimal, true>>;  // SED
+
+  kernels[0xAA] = c_implied<&transfer<&Lane::a, &Lane::x>>;  // TAX
+  kernels[0xA8] = c_implied<&transfer<&Lane::a, &Lane::y>>;  // TAY
+  kernels[0x8A] = c_implied<&transfer<&Lane::x, &Lane::a>>;  // TXA
+  kernels[0x98] = c_implied<&transfer<&Lane::y, &Lane::a>>;  // TYA
+  kernels[0xBA] = c_implied<&transfer<&Lane::sp, &Lane::x>>;  // TSX
+  kernels[0x9A] = c_implied<&transfer<&Lane::x, &Lane::sp>>;  // TXS
+
+  kernels[0xE8] = c_implied<&increment<&Lane::x, 1>>;  // INX
+  kernels[0xC8] = c_implied<&increment<&Lane::y, 1>>;  // INY
+  kernels[0xCA] = c_implied<&increment<&Lane::x, -1>>;  // DEX
+  kernels[0x88] = c_implied<&increment<&Lane::y, -1>>;  // DEY
+
+  kernels[0x0A] = c_implied<[](Lane& lane, Byte /*operand*/)  // ASL A
+      { shift(lane, lane.a >> 7u, static_cast<Byte>(lane.a << 1)); }>;
+  kernels[0x4A] = c_implied<[](Lane& lane, Byte /*operand*/)  // LSR A
+      { shift(lane, lane.a & 1u, static_cast<Byte>(lane.a >> 1)); }>;
+  kernels[0x2A] = c_implied<[](Lane& lane, Byte /*operand*/)  // ROL A
+      { shift(lane, lane.a >> 7u, static_cast<Byte>(lane.a << 1 | (lane.p & c_carry))); }>;
+  kernels[0x6A] = c_implied<[](Lane& lane, Byte /*operand*/)  // ROR A
+      { shift(lane, lane.a & 1u, static_cast<Byte>(lane.a >> 1 | (lane.p & c_carry) << 7)); }>;
+
+  kernels[0xA9] = c_immediate<&load<&Lane::a>>;  // LDA #
+  kernels[0xA2] = c_immediate<&load<&Lane::x>>;  // LDX #
+  kernels[0xA0] = c_immediate<&load<&Lane::y>>;  // LDY #
+  kernels[0x29] = c_immediate<[](Lane& lane, Byte operand)  // AND #
+      { setZN(lane, lane.a &= operand); }>;
+  kernels[0x09] = c_immediate<[](Lane& lane, Byte operand)  // ORA #
+      { setZN(lane, lane.a |= operand); }>;
+  kernels[0x49] = c_immediate<[](Lane& lane, Byte operand)  // EOR #
+      { setZN(lane, lane.a ^= operand); }>;
+  kernels[0xC9] = c_immediate<&compare<&Lane::a>>;  // CMP #
+  kernels[0xE0] = c_immediate<&compare<&Lane::x>>;  // CPX #
+  kernels[0xC0] = c_immediate<&compare<&Lane::y>>;  // CPY #
+  kernels[0x69] = c_immediate<&addWithCarry>;  // ADC #
+  kernels[0xE9] = c_immediate<[](Lane& lane, Byte operand)  // SBC #
+      { addWithCarry(lane, static_cast<Byte>(~operand)); }>;
+  kernels[0x69].exclude = Exclude::Decimal;
+  kernels[0xE9].exclude = Exclude::Decimal;
+
+  kernels[0x10] = c_branch<Flag::Negative, false>;  // BPL
+  kernels[0x30] = c_branch<Flag::Negative, true>;  // BMI
+  kernels[0x50] = c_branch<Flag::Overflow, false>;  // BVC
+  kernels[0x70] = c_branch<Flag::Overflow, true>;  // BVS
+  kernels[0x90] = c_branch<Flag::Carry, false>;  // BCC
+  kernels[0xB0] = c_branch<Flag::Carry, true>;  // BCS
+  kernels[0xD0] = c_branch<Flag::Zero, false>;  // BNE
+  kernels[0xF0] = c_branch<Flag::Zero, true>;  // BEQ
+
+  kernels[0x4C] = KernelEntry{&jumpKernel, 3};  // JMP $nnnn
+  return kernels;
+}();
+
+// What a lane does in the current step.
+constexpr Byte c_pending = 0;  // Not decided yet
+constexpr Byte c_scalar = 1;  // Runs one at a time
+constexpr Byte c_done = 2;  // Has run, or has trapped
+
+}  // namespace
+
+struct Lockstep::LaneBus
+{
+  explicit LaneBus(std::span<Byte> memory)
+    : ram(memory)
+    , bus{{Common::Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}}
+  {
+  }
+
+  Common::MemoryDevice<Byte> ram;
+  Common::Bus bus;
+};
+
+Lockstep::Lockstep(size_t lanes, Executor executor)
+  : m_lanes(lanes)
+  , m_executor(executor)
+  , m_cycles(lanes)
+  , m_trapped(lanes)
+  , m_trapAddress(lanes)
+  , m_memory(lanes * c_laneStride)
+  , m_opcode(lanes)
+  , m_lo(lanes)
+  , m_hi(lanes)
+  , m_mask(lanes)
+  , m_pending(lanes)
+{
+  assert(executor != nullptr);
+  Registers initial;
+  m_registers.pc.assign(lanes, static_cast<uint16_t>(initial.pc));
+  m_registers.a.assign(lanes, initial.a);
+  m_registers.x.assign(lanes, initial.x);
+  m_registers.y.assign(lanes, initial.y);
+  m_registers.sp.assign(lanes, initial.sp);
+  m_registers.p.assign(lanes, initial.p);
+
+  m_buses.reserve(lanes);
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    m_buses.push_back(std::make_unique<LaneBus>(memory(lane)));
+  }
+}
+
+Lockstep::~Lockstep() = default;
+
+Registers Lockstep::registers(size_t lane) const noexcept
+{
+  Registers registers;
+  registers.pc = Address{m_registers.pc[lane]};
+  registers.a = m_registers.a[lane];
+  registers.x = m_registers.x[lane];
+  registers.y = m_registers.y[lane];
+  registers.sp = m_registers.sp[lane];
+  registers.p = m_registers.p[lane];
+  return registers;
+}
+
+void Lockstep::setRegisters(size_t lane, const Registers& registers) noexcept
+{
+  m_registers.pc[lane] = static_cast<uint16_t>(registers.pc);
+  m_registers.a[lane] = registers.a;
+  m_registers.x[lane] = registers.x;
+  m_registers.y[lane] = registers.y;
+  m_registers.sp[lane] = registers.sp;
+  m_registers.p[lane] = registers.p;
+}
+
+std::span<Common::Byte, Lockstep::c_memorySize> Lockstep::memory(size_t lane) noexcept
+{
+  return std::span<Byte, c_memorySize>(m_memory.data() + lane * c_laneStride, c_memorySize);
+}
+
+std::span<const Common::Byte, Lockstep::c_memorySize> Lockstep::memory(size_t lane) const noexcept
+{
+  return std::span<const Byte, c_memorySize>(m_memory.data() + lane * c_laneStride, c_memorySize);
+}
+
+size_t Lockstep::step()
+{
+  // Local copies of the array pointers: the compiler has to assume that a store to a Byte array
+  // changes the members, so it would load them again after every store.
+  const size_t lanes = m_lanes;
+  const Byte* memory = m_memory.data();
+  const uint16_t* pcs = m_registers.pc.data();
+  const Byte* flags = m_registers.p.data();
+  const Byte* trapped = m_trapped.data();
+  Byte* opcodes = m_opcode.data();
+  Byte* lo = m_lo.data();
+  Byte* hi = m_hi.data();
+  Byte* mask = m_mask.data();
+  Byte* state = m_pending.data();
+
+  // The opcode and the two bytes after it, which are the operands for the instructions with kernels.
+  size_t running = 0;
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    const Byte* code = memory + lane * c_laneStride;
+    const uint16_t pc = pcs[lane];
+    opcodes[lane] = code[pc];
+    lo[lane] = code[static_cast<uint16_t>(pc + 1)];
+    hi[lane] = code[static_cast<uint16_t>(pc + 2)];
+    state[lane] = trapped[lane] == 0 ? c_pending : c_done;
+    running += trapped[lane] == 0 ? 1u : 0u;
+  }
+
+  // Every instruction with a kernel runs once for all the lanes that are at it. The lanes before the
+  // leader have run already or run one at a time below.
+  for (size_t leader = 0; leader < lanes; ++leader)
+  {
+    if (state[leader] != c_pending)
+    {
+      continue;
+    }
+    const Byte opcode = opcodes[leader];
+    const KernelEntry& kernel = c_kernels[opcode];
+    if (kernel.run == nullptr)
+    {
+      state[leader] = c_scalar;
+      continue;
+    }
+
+    const Byte decimal = kernel.exclude == Exclude::Decimal ? bit(Flag::Decimal) : 0;
+    const bool selfBranch = kernel.exclude == Exclude::SelfBranch;
+    size_t selected = 0;
+    for (size_t lane = leader; lane < lanes; ++lane)
+    {
+      const bool candidate = state[lane] == c_pending && opcodes[lane] == opcode;
+      const bool excluded = (flags[lane] & decimal) != 0 || (selfBranch && lo[lane] == 0xFE);
+      mask[lane] = candidate && !excluded ? 0xFF : 0x00;
+      state[lane] = candidate ? (excluded ? c_scalar : c_done) : state[lane];
+      selected += candidate && !excluded ? 1u : 0u;
+    }
+    if (selected != 0)
+    {
+      kernel.run(Batch{m_registers, leader, m_cycles, m_lo, m_hi, m_mask});
+      m_stats.lockstep += selected;
+    }
+  }
+
+  for (size_t lane = 0; lane < lanes; ++lane)
+  {
+    if (state[lane] == c_scalar)
+    {
+      stepScalar(lane);
+    }
+  }
+  return running;
+}
+
+uint64_t Lockstep::run(uint64_t steps)
+{
+  uint64_t done = 0;
+  while (done < steps && step() != 0)
+  {
+    ++done;
+  }
+  return done;
+}
+
+void Lockstep::stepScalar(size_t lane)
+{
+  Generic6502Definition cpu{registers(lane)};
+  m_cycles[lane] += m_executor(cpu, m_buses[lane]->bus);
+  setRegisters(lane, cpu.registers);
+  if (cpu.trapped)
+  {
+    m_trapped[lane] = 1;
+    m_trapAddress[lane] = static_cast<uint16_t>(cpu.trapAddress);
+  }
+  ++m_stats.scalar;
+}
+
+}  // namespace cpu6502
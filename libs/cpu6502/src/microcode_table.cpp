@@ -0,0 +1,118 @@
+#include "microcode_table.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <functional>
+#include <span>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "cpu6502/registers.h"
+
+namespace cpu6502
+{
+
+using Common::Address;
+using Common::Byte;
+
+namespace
+{
+
+auto byAddress = [](const auto& lhs, const auto& rhs) { return std::less<>{}(lhs.first, rhs.first); };
+
+}  // namespace
+
+MicrocodeTable::MicrocodeTable(FetchNextOpcode fetchNextOpcode)
+{
+  // A branch back by $80 from here crosses a page.
+  constexpr Address c_pc{0x0400};
+  // Longer than any instruction, in case one does not end.
+  constexpr size_t c_maxSteps{16};
+  constexpr auto c_unused = static_cast<Byte>(Registers::Flag::Unused);
+
+  std::vector<Byte> memory(0x10000);
+  Common::MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Common::Bus bus{{Common::Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+  bus.trackWrites(Address{0x0000}, Address{0xFFFF}, true);
+
+  auto run = [&](Generic6502Definition cpu, Byte fill)
+  {
+    cpu.trapPolicy = Generic6502Definition::TrapPolicy::Ignore;
+    Microcode next = fetchNextOpcode(cpu, Generic6502Definition::BusToken{&bus});
+    for (size_t step = 0; next != nullptr && step < c_maxSteps; ++step)
+    {
+      add(next);
+      next = next(cpu, Generic6502Definition::BusToken{&bus}).injection;
+    }
+
+    // Only the pages the instruction wrote have to be filled again.
+    Common::Bus::PageBitmap written = bus.takeWrittenPages();
+    for (size_t page = 0; page < Common::Bus::c_pageCount; ++page)
+    {
+      if (written[page])
+      {
+        std::fill_n(memory.begin() + static_cast<std::ptrdiff_t>(page * Common::Bus::c_pageSize),
+            Common::Bus::c_pageSize, fill);
+      }
+    }
+  };
+
+  for (Byte fill : std::array<Byte, 3>{0x00, 0x80, 0xFF})
+  {
+    std::ranges::fill(memory, fill);
+    for (Byte index : std::array<Byte, 2>{0x00, 0xFF})
+    {
+      for (Byte p : std::array<Byte, 2>{0x00, 0xFF})
+      {
+        for (size_t opcode = 0; opcode < 0x100; ++opcode)
+        {
+          memory[static_cast<uint16_t>(c_pc)] = static_cast<Byte>(opcode);
+          Generic6502Definition cpu;
+          cpu.registers.pc = c_pc;
+          cpu.registers.a = cpu.registers.x = cpu.registers.y = index;
+          cpu.registers.p = static_cast<Byte>(p | c_unused);
+          run(cpu, fill);
+        }
+      }
+    }
+
+    // Interrupts are taken instead of the opcode fetch.
+    for (bool nmi : {false, true})
+    {
+      Generic6502Definition cpu;
+      cpu.registers.pc = c_pc;
+      cpu.registers.p = c_unused;
+      cpu.irq = !nmi;
+      cpu.nmi = nmi;
+      run(cpu, fill);
+    }
+  }
+
+  m_sorted.reserve(m_steps.size());
+  for (size_t index = 0; index < m_steps.size(); ++index)
+  {
+    m_sorted.emplace_back(m_steps[index], static_cast<uint16_t>(index));
+  }
+  // Stable, so of the entries for one step the first is the lowest index, the one unique() keeps.
+  std::ranges::stable_sort(m_sorted, byAddress);
+  auto duplicates =
+      std::ranges::unique(m_sorted, [](const auto& lhs, const auto& rhs) { return lhs.first == rhs.first; });
+  m_sorted.erase(duplicates.begin(), duplicates.end());
+}
+
+uint16_t MicrocodeTable::indexOf(Microcode microcode) const noexcept
+{
+  auto found = std::ranges::lower_bound(m_sorted, std::pair{microcode, uint16_t{0}}, byAddress);
+  return found != m_sorted.end() && found->first == microcode ? found->second : c_unknown;
+}
+
+void MicrocodeTable::add(Microcode microcode)
+{
+  // Steps are not merged by address, or folding identical functions would shift the numbers.
+  assert(m_steps.size() < c_unknown);
+  m_steps.push_back(microcode);
+}
+
+}  // namespace cpu6502
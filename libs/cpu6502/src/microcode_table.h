@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "cpu6502/cpu6502_types.h"
+
+namespace cpu6502
+{
+
+//! Every microcode step of a processor, numbered by where it is reached when each opcode and each
+//! interrupt is run from a fixed set of states: the n-th step taken in that walk is number n. The
+//! walk and its numbers only depend on what the instructions do, not on where the code ended up, so
+//! a number means the same step in every build and can be kept in a snapshot instead of an address.
+//! That includes links that fold identical functions into one (/OPT:ICF, --icf=all): a folded step
+//! sits at each number the walk reaches either original at, so indexOf() may give a lower number
+//! than an unfolded build would, but at() of any of them is the same code in every build.
+//!
+//! The states take every data-dependent path through the microcode: index registers of 0 and $FF
+//! with operands of 0, $80 and $FF cross pages or not, P of 0 and $FF takes every branch both ways and
+//! turns decimal mode on and off, and a pending IRQ or NMI runs the interrupt sequence.
+class MicrocodeTable
+{
+public:
+  using Microcode = Generic6502Definition::Microcode;
+  using FetchNextOpcode = Microcode (*)(Generic6502Definition& cpu, Generic6502Definition::BusToken bus);
+
+  //! What indexOf() returns for microcode the table does not know.
+  static constexpr uint16_t c_unknown{Generic6502Definition::c_unknownMicrocode};
+
+  explicit MicrocodeTable(FetchNextOpcode fetchNextOpcode);
+
+  uint16_t indexOf(Microcode microcode) const noexcept;
+
+  //! nullptr if `index` is not in the table.
+  Microcode at(uint16_t index) const noexcept
+  {
+    return index < m_steps.size() ? m_steps[index] : nullptr;
+  }
+
+  size_t size() const noexcept
+  {
+    return m_steps.size();
+  }
+
+private:
+  void add(Microcode microcode);
+
+  std::vector<Microcode> m_steps;  // Every step of the walk, in order, so by index
+  std::vector<std::pair<Microcode, uint16_t>> m_sorted;  // By address, first index only, for indexOf()
+};
+
+}  // namespace cpu6502
@@ -1,832 +1,139 @@
 #include "cpu6502/mos6502.h"
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
 #include "common/address.h"
 #include "common/bus.h"
 #include "common/fixed_formatter.h"
 #include "cpu6502/address_mode.h"
 #include "cpu6502/registers.h"
 
+#include "instruction_table.h"
+#include "microcode_table.h"
+#include "operations.h"
+
 using namespace Common;
 
 namespace cpu6502
 {
 
-using MicrocodeResponse = Generic6502Definition::Response;
-using BusToken = Generic6502Definition::BusToken;
-using Address = Generic6502Definition::Address;
-using State = Generic6502Definition;
-using Flag = Registers::Flag;
-
 ////////////////////////////////////////////////////////////////////////////////
-// ReadModifyWrite Operation
+// Undocumented NMOS instructions
+//
+// Only the stable ones: their results do not depend on the chip, the temperature or what was last on
+// the data bus. Each one is the combination of documented operations that the decoder happens to
+// enable together, so they are built from those and take the cycles of their addressing mode.
 ////////////////////////////////////////////////////////////////////////////////
-template<auto Operation>
-struct ReadModifyWrite
-{
-  static constexpr bool isWrite = true;
 
-  // Step 1: Read from memory, write unmodified value back (6502 quirk)
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    cpu.operand = operand;  // Store original value for step1
-    return {spuriousWrite};
-  }
-
-  static MicrocodeResponse spuriousWrite(State& cpu, BusToken bus)
-  {
-    bus.write(Common::MakeAddress(cpu.lo, cpu.hi), cpu.operand);
-    return {step1};
-  }
-
-  static MicrocodeResponse step1(State& cpu, BusToken bus)
-  {
-    cpu.operand = Operation(cpu, cpu.operand);
-
-    // Reconstruct effective address and write modified value
-    // Note: This assumes addressing mode left address info in reconstructible form
-    bus.write(Common::MakeAddress(cpu.lo, cpu.hi), cpu.operand);
-
-    return {};
-  }
-};
-
-////////////////////////////////////////////////////////////////////////////////
-// Simple Readonly Operation
-template<auto lambda>
-struct SimpleOperation
+//! The read-modify-write combinations (DCP, ISC, SLO, RLA, SRE, RRA): `Modify` changes the memory
+//! operand, then `Read` uses the modified value as its operand.
+template<typename Modify, typename Read>
+Common::Byte modifyThenRead(State& cpu, Common::Byte value)
 {
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    lambda(cpu, operand);
-    return {};
-  }
-};
-
-using NOP = SimpleOperation<[](State& /*cpu*/, Common::Byte /*operand*/)
-    {
-      // No operation; used to consume a cycle
-    }>;
-
-////////////////////////////////////////////////////////////////////////////////
-// Shift/Rotate Instructions - Accumulator Mode (2 cycles)
-////////////////////////////////////////////////////////////////////////////////
-
-// ASL A - Arithmetic Shift Left Accumulator
-using ShiftLeftAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
-    {
-      // C ← [7][6][5][4][3][2][1][0] ← 0
-      bool bit7 = (cpu.registers.a & 0x80) != 0;
-      cpu.registers.a <<= 1;  // Shift left, bit 0 becomes 0
-
-      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
-      cpu.setZN(cpu.registers.a);  // Set N and Z flags
-    }>;
-
-// LSR A - Logical Shift Right Accumulator
-using ShiftRightAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
-    {
-      // 0 → [7][6][5][4][3][2][1][0] → C
-      bool bit0 = (cpu.registers.a & 0x01) != 0;
-      cpu.registers.a >>= 1;  // Shift right, bit 7 becomes 0
-
-      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
-      cpu.setZN(cpu.registers.a);  // Set N and Z flags (N will always be 0)
-    }>;
-
-// ROL A - Rotate Left Accumulator
-using RotateLeftAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
-    {
-      // C ← [7][6][5][4][3][2][1][0] ← C
-      bool bit7 = (cpu.registers.a & 0x80) != 0;
-      bool old_carry = cpu.has(Flag::Carry);
-
-      cpu.registers.a <<= 1;  // Shift left
-      if (old_carry)
-      {
-        cpu.registers.a |= 0x01;  // Carry → Bit 0
-      }
-
-      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
-      cpu.setZN(cpu.registers.a);  // Set N and Z flags
-    }>;
-
-// ROR A - Rotate Right Accumulator
-using RotateRightAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
-    {
-      // C → [7][6][5][4][3][2][1][0] → C
-      bool bit0 = (cpu.registers.a & 0x01) != 0;
-      bool old_carry = cpu.has(Flag::Carry);
-
-      cpu.registers.a >>= 1;  // Shift right
-      if (old_carry)
-      {
-        cpu.registers.a |= 0x80;  // Carry → Bit 7
-      }
-
-      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
-      cpu.setZN(cpu.registers.a);  // Set N and Z flags
-    }>;
-
-using And = SimpleOperation<[](State& cpu, Common::Byte operand)
-    {
-      cpu.registers.a &= operand;  // A ← A ∧ M
-      cpu.setZN(cpu.registers.a);  // Set N and Z flags based on result
-    }>;
+  value = Modify::operation(cpu, value);
+  Read::step0(cpu, value);
+  return value;
+}
 
-using Eor = SimpleOperation<[](State& cpu, Common::Byte operand)
-    {
-      cpu.registers.a ^= operand;  // A ← A ⊕ M
-      cpu.setZN(cpu.registers.a);
-    }>;
+using DCP = ReadModifyWrite<&modifyThenRead<DecrementMemory, CMP>>;
+using ISC = ReadModifyWrite<&modifyThenRead<IncrementMemory, Subtract>>;
+using SLO = ReadModifyWrite<&modifyThenRead<ShiftLeft, Ora>>;
+using RLA = ReadModifyWrite<&modifyThenRead<RotateLeft, And>>;
+using SRE = ReadModifyWrite<&modifyThenRead<ShiftRight, Eor>>;
+using RRA = ReadModifyWrite<&modifyThenRead<RotateRight, Add>>;
 
-using Ora = SimpleOperation<[](State& cpu, Common::Byte operand)
+// LAX - LDA and LDX at once
+using LAX = SimpleOperation<[](State& cpu, Common::Byte operand)
     {
-      // Perform OR with accumulator
-      cpu.registers.a |= operand;
-      cpu.set(Flag::Zero, cpu.registers.a == 0);  // Set zero flag
-      cpu.set(Flag::Negative, cpu.registers.a & 0x80);  // Set negative flag
+      cpu.registers.a = cpu.registers.x = operand;
+      cpu.setZN(operand);
     }>;
 
-using Bit = SimpleOperation<[](State& cpu, Common::Byte operand)
+// LAS - A, X and SP ← M ∧ SP
+using LAS = SimpleOperation<[](State& cpu, Common::Byte operand)
     {
-      // BIT instruction: Test bits in memory with accumulator
-      // - Z flag: Set if (A & M) == 0
-      // - N flag: Copy bit 7 of memory operand
-      // - V flag: Copy bit 6 of memory operand
-      // - Accumulator is NOT modified
-      // - C, I, D flags are not affected
-
-      Byte memory_value = operand;
-      Byte test_result = cpu.registers.a & memory_value;
-
-      // Set Zero flag based on AND result
-      cpu.set(Flag::Zero, test_result == 0);
-
-      // Copy bit 7 of memory to Negative flag
-      cpu.set(Flag::Negative, (memory_value & 0x80) != 0);
-
-      // Copy bit 6 of memory to Overflow flag
-      cpu.set(Flag::Overflow, (memory_value & 0x40) != 0);
-
-      // Note: Accumulator is unchanged!
+      auto value = static_cast<Byte>(operand & cpu.registers.sp);
+      cpu.registers.a = cpu.registers.x = cpu.registers.sp = value;
+      cpu.setZN(value);
     }>;
 
-////////////////////////////////////////////////////////////////////////////////
-// BRK - Software Interrupt (7 cycles)
-////////////////////////////////////////////////////////////////////////////////
-
-struct brk
-{
-  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
-  {
-    return {pushHighPC};
-  }
-
-  // Step 1: Push return address high byte (PC)
-  static MicrocodeResponse pushHighPC(State& cpu, BusToken bus)
-  {
-    // BRK pushes PC (current instruction + 2), unlike JSR which pushes PC-1
-    Byte return_addr_high = Common::HiByte(++cpu.registers.pc);
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), return_addr_high);
-    return {pushLowPC};
-  }
-
-  // Step 2: Push return address low byte
-  static MicrocodeResponse pushLowPC(State& cpu, BusToken bus)
-  {
-    Byte return_addr_low = Common::LoByte(static_cast<uint16_t>(cpu.registers.pc));
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), return_addr_low);
-    return {pushProcessorStatus};
-  }
-
-  // Step 3: Push processor status with Break flag set
-  static MicrocodeResponse pushProcessorStatus(State& cpu, BusToken bus)
-  {
-    // Push P with Break flag set (like PHP)
-    Byte status = cpu.registers.p | static_cast<Byte>(Flag::Break);
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), status);
-    return {readIRQVectorLow};
-  }
-
-  // Step 4: Read IRQ vector low byte, set Interrupt flag
-  static MicrocodeResponse readIRQVectorLow(State& cpu, BusToken bus)
-  {
-    // Set Interrupt flag to disable further interrupts
-    cpu.set(Flag::Interrupt, true);
-
-    // Read IRQ vector low byte from $FFFE
-    cpu.lo = bus.read(0xFFFE_addr);
-
-    return {readIRQVectorHigh};
-  }
-
-  // Step 5: Read IRQ vector high byte and jump
-  static MicrocodeResponse readIRQVectorHigh(State& cpu, BusToken bus)
-  {
-    // Read IRQ vector high byte from $FFFF
-    cpu.hi = bus.read(0xFFFF_addr);
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
-    return {};
-  }
-};
-
-////////////////////////////////////////////////////////////////////////////////
-// Flag operations (CLC, SEC, CLI, SEI, CLD, SED, CLV)
-////////////////////////////////////////////////////////////////////////////////
-template<Registers::Flag Flag, bool Set>
-struct FlagOp
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
-  {
-    cpu.set(Flag, Set);
-    return {};
-  }
-};
-
-using CLC = FlagOp<Flag::Carry, false>;
-using SEC = FlagOp<Flag::Carry, true>;
-using CLI = FlagOp<Flag::Interrupt, false>;
-using SEI = FlagOp<Flag::Interrupt, true>;
-using CLV = FlagOp<Flag::Overflow, false>;
-using CLD = FlagOp<Flag::Decimal, false>;
-using SED = FlagOp<Flag::Decimal, true>;
-
-////////////////////////////////////////////////////////////////////////////////
-// Increment operations (INX, INY)
-
-template<Common::Byte Registers::* reg>
-  requires(reg != &Registers::a)
-struct Increment
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
-  {
-    // Handle increment operation for X or Y registers
-    auto& r = (cpu.registers.*reg);
-    ++r;
-    cpu.setZN(r);
-    return {};
-  }
-};
-
-using INX = Increment<&Registers::x>;
-using INY = Increment<&Registers::y>;
-
-template<Common::Byte Registers::* reg>
-  requires(reg != &Registers::a)
-struct Decrement
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
-  {
-    // Handle decrement operation for X or Y registers
-    auto& r = ((cpu.registers.*reg));
-    --r;
-    cpu.setZN(r);
-    return {};
-  }
-};
-
-using DEX = Decrement<&Registers::x>;
-using DEY = Decrement<&Registers::y>;
-
-////////////////////////////////////////////////////////////////////////////////
-// Push/Pull operations, PLA, PLA, PHP, PLP
-////////////////////////////////////////////////////////////////////////////////
-
-template<Common::Byte Registers::* SourceReg, bool SetBreakFlag = false>
-struct PushOp
-{
-  // Step 0: Dummy read to consume cycle
-  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
-  {
-    return {step1};
-  }
-
-  // Step 2: Write register value to stack
-  static MicrocodeResponse step1(State& cpu, BusToken bus)
-  {
-    Byte data = (cpu.registers.*SourceReg);
-
-    // Apply Break flag modification for PHP
-    if constexpr (SetBreakFlag)
-    {
-      data |= static_cast<Byte>(Flag::Break);
-    }
-
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), data);
-    return {};
-  }
-};
-
-template<Common::Byte Registers::* TargetReg>
-struct PullOp
-{
-  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
-  {
-    return {step2};
-  }
-
-  static MicrocodeResponse step2(State& cpu, BusToken bus)
-  {
-    cpu.operand = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
-    return {step3};
-  }
-
-  // Step 3: Store data and set flags if needed
-  static MicrocodeResponse step3(State& cpu, BusToken bus)
-  {
-    Common::Byte data = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
-
-    // Apply Break flag clearing for PLP
-    if constexpr (TargetReg == &Registers::p)
-    {
-      data &= ~static_cast<Byte>(Flag::Break);
-      cpu.assignP(data);  // Use assignP to ensure U flag is set
-    }
-    else
-    {
-      // Update N/Z flags for PLA
-      // Store in target register
-      (cpu.registers.*TargetReg) = data;
-      cpu.setZN(data);
-    }
-
-    return {};
-  }
-};
-
-using PLA = PullOp<&Registers::a>;
-using PLP = PullOp<&Registers::p>;
-using PHA = PushOp<&Registers::a, false>;
-using PHP = PushOp<&Registers::p, true>;
-
-////////////////////////////////////////////////////////////////////////////////
-// RTI - Return from Interrupt (6 cycles)
-////////////////////////////////////////////////////////////////////////////////
-
-struct Rti
-{
-  // Step 0: Dummy read from current PC
-  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
-  {
-    return {step2};
-  }
-
-  static MicrocodeResponse step2(State& cpu, BusToken bus)
-  {
-    [[maybe_unused]] auto byte = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
-    return {popProcessorStatus};
-  }
-
-  static MicrocodeResponse popProcessorStatus(State& cpu, BusToken bus)
-  {
-    // Restore processor status (clear Break flag like PLP)
-    Byte status = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01)) & ~static_cast<Byte>(Flag::Break);
-    cpu.assignP(status);  // Use assignP to preserve Unused flag
-
-    return {popReturnAddressLow};
-  }
-
-  static MicrocodeResponse popReturnAddressLow(State& cpu, BusToken bus)
-  {
-    cpu.lo = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
-    return {popReturnAddressHigh};
-  }
-
-  static MicrocodeResponse popReturnAddressHigh(State& cpu, BusToken bus)
-  {
-    cpu.hi = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
-
-    // Note: Unlike RTS, RTI does NOT increment PC
-    return {};
-  }
-};
-
-////////////////////////////////////////////////////////////////////////////////
-// RTS - Return from Subroutine (6 cycles)
-////////////////////////////////////////////////////////////////////////////////
-
-struct Rts
+// SAX - M ← A ∧ X, no flags change
+struct SAX
 {
-  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
-  {
-    return {step2};
-  }
-
-  static MicrocodeResponse step2(State& cpu, BusToken bus)
-  {
-    [[maybe_unused]] auto byte = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
-    return {popReturnAddressLow};
-  }
-
-  static MicrocodeResponse popReturnAddressLow(State& cpu, BusToken bus)
-  {
-    cpu.lo = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
-
-    return {popReturnAddressHigh};
-  }
-
-  static MicrocodeResponse popReturnAddressHigh(State& cpu, BusToken bus)
-  {
-    cpu.hi = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
-    return {jumpToReturnAddress};
-  }
+  static constexpr bool isWrite = true;
 
-  static MicrocodeResponse jumpToReturnAddress(State& cpu, BusToken bus)
+  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
   {
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
-
-    bus.read(cpu.registers.pc++);
-
-    // Note: Unlike RTS, RTI does NOT increment PC
+    bus.write(effectiveAddress, static_cast<Byte>(cpu.registers.a & cpu.registers.x));
     return {};
   }
 };
 
-////////////////////////////////////////////////////////////////////////////////
-// Transfer operations (TAX, TAY, TXA, TYA, TSX, TXS)
-////////////////////////////////////////////////////////////////////////////////
-template<Common::Byte Registers::* src, Common::Byte Registers::* dst>
-  requires(src != dst)
-struct Transfer
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
-  {
-    (cpu.registers.*dst) = (cpu.registers.*src);
-
-    if constexpr (dst != &Registers::sp)
+// ANC - AND, then C ← N
+using ANC = SimpleOperation<[](State& cpu, Common::Byte operand)
     {
-      // Only affect flags if not transferring to stack pointer
-      cpu.setZN((cpu.registers.*dst));
-    }
-    return {};
-  }
-};
-
-using TYA = Transfer<&Registers::y, &Registers::a>;
-using TAY = Transfer<&Registers::a, &Registers::y>;
-using TXA = Transfer<&Registers::x, &Registers::a>;
-using TAX = Transfer<&Registers::a, &Registers::x>;
-using TXS = Transfer<&Registers::x, &Registers::sp>;
-using TSX = Transfer<&Registers::sp, &Registers::x>;
-
-////////////////////////////////////////////////////////////////////////////////
-// Shift/Rotate Instructions - Memory Mode (Read-Modify-Write)
-////////////////////////////////////////////////////////////////////////////////
-
-using ShiftLeft = ReadModifyWrite<[](State& cpu, Common::Byte value)
-    {
-      // C ← [7][6][5][4][3][2][1][0] ← 0
-      bool bit7 = (value & 0x80) != 0;
-      value <<= 1;  // Shift left, bit 0 becomes 0
-
-      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
-      cpu.setZN(value);  // Set N and Z flags
-
-      return value;
+      And::step0(cpu, operand);
+      cpu.set(Flag::Carry, cpu.has(Flag::Negative));
     }>;
 
-using ShiftRight = ReadModifyWrite<[](State& cpu, Common::Byte value)
+// ALR - AND, then LSR A
+using ALR = SimpleOperation<[](State& cpu, Common::Byte operand)
     {
-      // 0 → [7][6][5][4][3][2][1][0] → C
-      bool bit0 = (value & 0x01) != 0;
-      value >>= 1;  // Shift right, bit 7 becomes 0
-
-      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
-      cpu.setZN(value);  // Set N and Z flags (N will always be 0)
-
-      return value;
-    }>;
-
-using RotateLeft = ReadModifyWrite<[](State& cpu, Common::Byte value)
-    {
-      // C ← [7][6][5][4][3][2][1][0] ← C
-      bool bit7 = (value & 0x80) != 0;
-      bool old_carry = cpu.has(Flag::Carry);
-
-      value <<= 1;  // Shift left
-      if (old_carry)
-      {
-        value |= 0x01;  // Carry → Bit 0
-      }
-
-      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
-      cpu.setZN(value);  // Set N and Z flags
-
-      return value;
+      And::step0(cpu, operand);
+      ShiftRightAccumulator::step0(cpu, operand);
     }>;
 
-using RotateRight = ReadModifyWrite<[](State& cpu, Common::Byte value)
-    {
-      // C → [7][6][5][4][3][2][1][0] → C
-      bool bit0 = (value & 0x01) != 0;
-      bool old_carry = cpu.has(Flag::Carry);
-
-      value >>= 1;  // Shift right
-      if (old_carry)
-      {
-        value |= 0x80;  // Carry → Bit 7
-      }
-
-      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
-      cpu.setZN(value);  // Set N and Z flags
-
-      return value;
-    }>;
-
-////////////////////////////////////////////////////////////////////////////////
-// Arithmetic and Logic Instructions
-////////////////////////////////////////////////////////////////////////////////
-struct Add
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    //    assert(cpu.has(Flag::Decimal) == false);  // BCD mode not supported
-
-    const Byte a = cpu.registers.a;
-    const Byte m = operand;
-    const Byte c = cpu.has(Flag::Carry) ? 1 : 0;
-
-    const uint16_t sum = uint16_t(a) + uint16_t(m) + uint16_t(c);
-    const Byte result = Byte(sum & 0xFF);
-
-    cpu.set(Flag::Carry, (sum & 0x100) != 0);
-    cpu.set(Flag::Overflow, ((~(a ^ m) & (a ^ result)) & 0x80) != 0);
-    cpu.setZN(result);
-
-    cpu.registers.a = result;
-    return {};
-  }
-};
-
-struct Subtract
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    // SBC: A = A - M - (1 - C) = A + (~M) + C
-    operand = ~operand;  // Invert the operand for two's complement
-    Common::Byte carry = cpu.has(Flag::Carry) ? 1 : 0;
-
-    uint16_t temp = static_cast<uint16_t>(cpu.registers.a) + operand + carry;
-
-    // Set carry flag (no borrow occurred if bit 8 is set)
-    cpu.set(Flag::Carry, (temp & 0x100) != 0);
-
-    // Check for signed overflow
-    auto result = static_cast<Common::Byte>(temp & 0xFF);
-    bool overflow = ((cpu.registers.a ^ result) & (operand ^ result) & 0x80) != 0;
-    cpu.set(Flag::Overflow, overflow);
-
-    // Store result and set N,Z flags
-    cpu.registers.a = result;
-    cpu.setZN(cpu.registers.a);
-
-    return {};
-  }
-};
-
-template<Common::Byte Registers::* reg>
-struct Compare
-{
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    auto r = ((cpu.registers.*reg));
-    uint16_t diff = uint16_t(r) - uint16_t(operand);  // Unsigned arithmetic
-    bool borrow = (diff & 0x100) != 0;
-
-    cpu.set(Flag::Carry, !borrow);
-    cpu.setZN(static_cast<Common::Byte>(diff & 0xFF));
-    return {};
-  }
-};
-
-using CMP = Compare<&Registers::a>;
-using CPX = Compare<&Registers::x>;
-using CPY = Compare<&Registers::y>;
-
-template<Common::Byte Registers::* reg>
-struct Load
+// ARR - AND, then ROR A with C and V taken from the adder. In decimal mode the adder also applies the
+// BCD correction to each digit (see "6502 undocumented opcodes" by Adam Vardy / 64doc).
+struct ARR
 {
   static MicrocodeResponse step0(State& cpu, Common::Byte operand)
   {
-    // This is a generic load operation for A, X, or Y registers.
+    auto value = static_cast<Byte>(cpu.registers.a & operand);
+    bool carry = cpu.has(Flag::Carry);
+    auto result = static_cast<Byte>((value >> 1) | (carry ? 0x80 : 0x00));
 
-    auto data = (cpu.registers.*reg) = operand;
-    cpu.setZN(data);
-    return {};
-  }
-};
-
-using LDA = Load<&Registers::a>;
-using LDX = Load<&Registers::x>;
-using LDY = Load<&Registers::y>;
-
-template<Common::Byte Registers::* reg>
-struct Store
-{
-  static constexpr bool isWrite = true;
-
-  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
-  {
-    // This is a generic store operation for A, X, or Y registers.
-    bus.write(effectiveAddress, (cpu.registers.*reg));
-
-    return {};
-  }
-};
-
-using STA = Store<&Registers::a>;
-using STX = Store<&Registers::x>;
-using STY = Store<&Registers::y>;
-
-template<Registers::Flag flag, bool condition>
-struct Branch
-{
-
-  // Evaluate condition and decide whether to branch
-  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
-  {
-    // The incoming operand is the relative branch offset.
-    cpu.operand = operand;
-
-    // Check if the flag matches the desired condition
-    bool flagSet = cpu.has(flag);
-    bool shouldBranch = (flagSet == condition);
-
-    if (shouldBranch)
-    {
-      // Branch taken - continue to step 1
-      return {branchTaken};
-    }
-
-    return {};
-  }
-
-  static MicrocodeResponse branchTaken(State& cpu, BusToken bus)
-  {
-    int8_t offset = static_cast<int8_t>(cpu.operand);
-
-    if (offset == -2)
-    {  // Self-branch detected
-      Generic6502Definition::trap(cpu.registers.pc - 2);
-    }
-
-    // Add offset to PC low byte
-    auto tmp = static_cast<uint16_t>(cpu.registers.pc) + offset;
-
-    // We have three pieces of information:
-    // - The low byte of the new PC (LoByte(tmp))
-    // - The high byte of the new PC (HiByte(tmp))
-    // - The high byte of the current PC (HiByte(cpu.registers.pc))
-
-    cpu.lo = static_cast<Common::Byte>(tmp & 0xFF);
-    cpu.hi = HiByte(cpu.registers.pc);
-    cpu.operand = HiByte(static_cast<uint16_t>(tmp));
-
-    // Read from the old PC address again
-    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
-
-    // Detect if page boundary is crossed
-    if (cpu.operand == cpu.hi)
+    if (!cpu.has(Flag::Decimal))
     {
-      // No page boundary crossed - branch complete
-      cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+      cpu.setZN(result);
+      cpu.set(Flag::Carry, (result & 0x40) != 0);
+      cpu.set(Flag::Overflow, (((result >> 6) ^ (result >> 5)) & 0x01) != 0);
+      cpu.registers.a = result;
       return {};
     }
 
-    // Page boundary crossed - need step 2 for fixup
-    return {branchPageFixup};
-  }
-
-  static MicrocodeResponse branchPageFixup(State& cpu, BusToken bus)
-  {
-    // Read from the incorrect address
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+    cpu.set(Flag::Negative, carry);
+    cpu.set(Flag::Zero, result == 0);
+    cpu.set(Flag::Overflow, ((value ^ result) & 0x40) != 0);
 
-    [[maybe_unused]] auto byte = bus.read(cpu.registers.pc);
-
-    cpu.hi = cpu.operand;
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, static_cast<Common::Byte>(cpu.hi));
-
-    // 4 cycles total, we're done
-    return {};
-  }
-};
-
-using BNE = Branch<Flag::Zero, false>;
-using BEQ = Branch<Flag::Zero, true>;
-using BPL = Branch<Flag::Negative, false>;
-using BMI = Branch<Flag::Negative, true>;
-using BCC = Branch<Flag::Carry, false>;
-using BCS = Branch<Flag::Carry, true>;
-using BVC = Branch<Flag::Overflow, false>;
-using BVS = Branch<Flag::Overflow, true>;
-
-using IncrementMemory = ReadModifyWrite<[](State& cpu, Common::Byte val)
+    int low = value & 0x0F;
+    int high = value >> 4;
+    if (low + (low & 0x01) > 5)
     {
-      ++val;
-      cpu.setZN(val);
-      return val;
-    }>;
-
-using DecrementMemory = ReadModifyWrite<[](State& cpu, Common::Byte val)
+      result = static_cast<Byte>((result & 0xF0) | ((result + 6) & 0x0F));
+    }
+    bool decimalCarry = high + (high & 0x01) > 5;
+    if (decimalCarry)
     {
-      --val;
-      cpu.setZN(val);
-      return val;
-    }>;
-
-// JSR - Jump to Subroutine (6 cycles)
-struct JumpSubroutine
-{
-  static MicrocodeResponse execute(State& cpu, BusToken bus)
-  {
-    cpu.lo = bus.read(cpu.registers.pc++);
-    return {internal};
-  }
-
-  static MicrocodeResponse internal(State& cpu, BusToken bus)
-  {
-    cpu.operand = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
-    return {pushHighPC};
-  }
-
-  static MicrocodeResponse pushHighPC(State& cpu, BusToken bus)
-  {
-    // Push return address high byte (PC-1)
-    // JSR pushes PC-1 where PC currently points past the JSR instruction
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), Common::HiByte(cpu.registers.pc));
-
-    return {pushLowPC};
-  }
-
-  static MicrocodeResponse pushLowPC(State& cpu, BusToken bus)
-  {
-    // Push return address low byte and jump
-    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), Common::LoByte(cpu.registers.pc));
-
-    return {jump};
-  }
-
-  static MicrocodeResponse jump(State& cpu, BusToken bus)
-  {
-    cpu.hi = bus.read(cpu.registers.pc++);
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
-    return {};
-  }
-};
-
-struct JumpAbsolute
-{
-  static MicrocodeResponse execute(State& cpu, BusToken bus)
-  {
-    cpu.lo = bus.read(cpu.registers.pc++);
-    return {readHighPC};
-  }
-  static MicrocodeResponse readHighPC(State& cpu, BusToken bus)
-  {
-    cpu.hi = bus.read(cpu.registers.pc++);
-    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+      result = static_cast<Byte>(result + 0x60);
+    }
+    cpu.set(Flag::Carry, decimalCarry);
+    cpu.registers.a = result;
     return {};
   }
 };
 
-struct JumpIndirect
+// SBX - X ← (A ∧ X) - M, flags as CMP. Never decimal.
+struct SBX
 {
-  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
-  {
-    // cpu.lo and cpu.hi already hold the two bytes that followed the opcode, the
-    // pointer address. We now need to load the byte at that address, then the byte at
-    // the next address (with the 6502 page wrap bug).
-    cpu.operand = bus.read(effectiveAddress);
-    return {readDestinationHigh};
-  }
-
-  static MicrocodeResponse readDestinationHigh(State& cpu, BusToken bus)
-  {
-    // We read the low byte at the effective address, now we need to increment that address and read
-    // the high byte, with the 6502 page wrap bug. The bug is that we only increment the low byte of
-    // the address. If it wraps, we stay on the same page. I.e. if the pointer address is $xxFF, we read
-    // the high byte from $xx00, not $xy00.
-    Address ptr = Common::MakeAddress(++cpu.lo, cpu.hi);
-
-    cpu.lo = cpu.operand;
-    cpu.hi = bus.read(ptr);
-
-    return {jump};
-  }
-
-  static MicrocodeResponse jump(State& cpu, BusToken /*bus*/)
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
   {
-    Address target = Common::MakeAddress(cpu.lo, cpu.hi);
-    // JMP (indirect) requires 3 bytes, so if we are jumping to the current instruction,
-    // it is a self-jump.
-    if (target == cpu.registers.pc - 3)
-    {  // Self-jump detected
-      Generic6502Definition::trap(target);
-    }
-    cpu.registers.pc = target;
-
+    auto value = static_cast<Byte>(cpu.registers.a & cpu.registers.x);
+    cpu.set(Flag::Carry, value >= operand);
+    cpu.registers.x = static_cast<Byte>(value - operand);
+    cpu.setZN(cpu.registers.x);
     return {};
   }
 };
@@ -835,28 +142,6 @@ struct JumpIndirect
 // CPU implementation
 ////////////////////////////////////////////////////////////////////////////////
 
-namespace
-{
-
-using InstructionTable = std::array<Generic6502Definition::Instruction, 256>;
-
-struct Builder
-{
-  InstructionTable& table;
-
-  template<typename Cmd>
-  constexpr Builder& add(Common::Byte opcode, std::string_view mnemonic)
-  {
-    Generic6502Definition::Instruction& instr = table[opcode];
-    instr.opcode = opcode;
-    std::ranges::copy(mnemonic, std::begin(instr.mnemonic));
-    instr.op = Cmd::execute;
-    return *this;
-  }
-};
-
-}  // namespace
-
 static constexpr auto c_instructions = []()
 {
   InstructionTable table{};
@@ -864,7 +149,7 @@ static constexpr auto c_instructions = []()
   Builder builder{table};
   builder  //
       .add<Implied<NOP>>(0xEA, "NOP")
-      .add<Implied<brk>>(0x00, "BRK")
+      .add<Implied<Break<false>>>(0x00, "BRK")
 
       // Flag operations
       .add<Implied<CLC>>(0x18, "CLC")
@@ -1061,6 +346,100 @@ static constexpr auto c_instructions = []()
       .add<ZeroPage<Bit>>(0x24, "BIT")
       .add<Absolute<Bit>>(0x2C, "BIT")
 
+      // Undocumented: NOPs that read an operand, and the SBC alias
+      .add<Implied<NOP>>(0x1A, "NOP")
+      .add<Implied<NOP>>(0x3A, "NOP")
+      .add<Implied<NOP>>(0x5A, "NOP")
+      .add<Implied<NOP>>(0x7A, "NOP")
+      .add<Implied<NOP>>(0xDA, "NOP")
+      .add<Implied<NOP>>(0xFA, "NOP")
+      .add<Immediate<NOP>>(0x80, "NOP")
+      .add<Immediate<NOP>>(0x82, "NOP")
+      .add<Immediate<NOP>>(0x89, "NOP")
+      .add<Immediate<NOP>>(0xC2, "NOP")
+      .add<Immediate<NOP>>(0xE2, "NOP")
+      .add<ZeroPage<NOP>>(0x04, "NOP")
+      .add<ZeroPage<NOP>>(0x44, "NOP")
+      .add<ZeroPage<NOP>>(0x64, "NOP")
+      .add<ZeroPageX<NOP>>(0x14, "NOP")
+      .add<ZeroPageX<NOP>>(0x34, "NOP")
+      .add<ZeroPageX<NOP>>(0x54, "NOP")
+      .add<ZeroPageX<NOP>>(0x74, "NOP")
+      .add<ZeroPageX<NOP>>(0xD4, "NOP")
+      .add<ZeroPageX<NOP>>(0xF4, "NOP")
+      .add<Absolute<NOP>>(0x0C, "NOP")
+      .add<AbsoluteX<NOP>>(0x1C, "NOP")
+      .add<AbsoluteX<NOP>>(0x3C, "NOP")
+      .add<AbsoluteX<NOP>>(0x5C, "NOP")
+      .add<AbsoluteX<NOP>>(0x7C, "NOP")
+      .add<AbsoluteX<NOP>>(0xDC, "NOP")
+      .add<AbsoluteX<NOP>>(0xFC, "NOP")
+      .add<Immediate<Subtract>>(0xEB, "SBC")
+
+      // Undocumented: LAX, SAX and LAS
+      .add<ZeroPage<LAX>>(0xA7, "LAX")
+      .add<ZeroPageY<LAX>>(0xB7, "LAX")
+      .add<Absolute<LAX>>(0xAF, "LAX")
+      .add<AbsoluteY<LAX>>(0xBF, "LAX")
+      .add<IndirectZeroPageX<LAX>>(0xA3, "LAX")
+      .add<IndirectZeroPageY<LAX>>(0xB3, "LAX")
+      .add<ZeroPage<SAX>>(0x87, "SAX")
+      .add<ZeroPageY<SAX>>(0x97, "SAX")
+      .add<Absolute<SAX>>(0x8F, "SAX")
+      .add<IndirectZeroPageX<SAX>>(0x83, "SAX")
+      .add<AbsoluteY<LAS>>(0xBB, "LAS")
+
+      // Undocumented: immediate combinations
+      .add<Immediate<ANC>>(0x0B, "ANC")
+      .add<Immediate<ANC>>(0x2B, "ANC")
+      .add<Immediate<ALR>>(0x4B, "ALR")
+      .add<Immediate<ARR>>(0x6B, "ARR")
+      .add<Immediate<SBX>>(0xCB, "SBX")
+
+      // Undocumented: read-modify-write combinations
+      .add<ZeroPage<SLO>>(0x07, "SLO")
+      .add<ZeroPageX<SLO>>(0x17, "SLO")
+      .add<Absolute<SLO>>(0x0F, "SLO")
+      .add<AbsoluteX<SLO>>(0x1F, "SLO")
+      .add<AbsoluteY<SLO>>(0x1B, "SLO")
+      .add<IndirectZeroPageX<SLO>>(0x03, "SLO")
+      .add<IndirectZeroPageY<SLO>>(0x13, "SLO")
+      .add<ZeroPage<RLA>>(0x27, "RLA")
+      .add<ZeroPageX<RLA>>(0x37, "RLA")
+      .add<Absolute<RLA>>(0x2F, "RLA")
+      .add<AbsoluteX<RLA>>(0x3F, "RLA")
+      .add<AbsoluteY<RLA>>(0x3B, "RLA")
+      .add<IndirectZeroPageX<RLA>>(0x23, "RLA")
+      .add<IndirectZeroPageY<RLA>>(0x33, "RLA")
+      .add<ZeroPage<SRE>>(0x47, "SRE")
+      .add<ZeroPageX<SRE>>(0x57, "SRE")
+      .add<Absolute<SRE>>(0x4F, "SRE")
+      .add<AbsoluteX<SRE>>(0x5F, "SRE")
+      .add<AbsoluteY<SRE>>(0x5B, "SRE")
+      .add<IndirectZeroPageX<SRE>>(0x43, "SRE")
+      .add<IndirectZeroPageY<SRE>>(0x53, "SRE")
+      .add<ZeroPage<RRA>>(0x67, "RRA")
+      .add<ZeroPageX<RRA>>(0x77, "RRA")
+      .add<Absolute<RRA>>(0x6F, "RRA")
+      .add<AbsoluteX<RRA>>(0x7F, "RRA")
+      .add<AbsoluteY<RRA>>(0x7B, "RRA")
+      .add<IndirectZeroPageX<RRA>>(0x63, "RRA")
+      .add<IndirectZeroPageY<RRA>>(0x73, "RRA")
+      .add<ZeroPage<DCP>>(0xC7, "DCP")
+      .add<ZeroPageX<DCP>>(0xD7, "DCP")
+      .add<Absolute<DCP>>(0xCF, "DCP")
+      .add<AbsoluteX<DCP>>(0xDF, "DCP")
+      .add<AbsoluteY<DCP>>(0xDB, "DCP")
+      .add<IndirectZeroPageX<DCP>>(0xC3, "DCP")
+      .add<IndirectZeroPageY<DCP>>(0xD3, "DCP")
+      .add<ZeroPage<ISC>>(0xE7, "ISC")
+      .add<ZeroPageX<ISC>>(0xF7, "ISC")
+      .add<Absolute<ISC>>(0xEF, "ISC")
+      .add<AbsoluteX<ISC>>(0xFF, "ISC")
+      .add<AbsoluteY<ISC>>(0xFB, "ISC")
+      .add<IndirectZeroPageX<ISC>>(0xE3, "ISC")
+      .add<IndirectZeroPageY<ISC>>(0xF3, "ISC")
+
       // JMP Absolute and JMP Indirect
       .add<JumpAbsolute>(0x4C, "JMP")
       .add<Absolute<JumpIndirect>>(0x6C, "JMP")
@@ -1073,72 +452,98 @@ static constexpr auto c_instructions = []()
 
 mos6502::Microcode mos6502::fetchNextOpcode(State& cpu, BusToken bus) noexcept
 {
+  if (cpu.pollInterrupts()) [[unlikely]]
+  {
+    // The opcode is read but not executed, and PC stays on it.
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<false>::interrupt;
+  }
+
   auto opcode = bus.read(cpu.registers.pc++);
-  const Instruction& instr = c_instructions[opcode];
-  auto microcode = instr.op;
-  return microcode;
+  cpu.opcode = opcode;
+  return c_instructions[opcode].op;
 }
 
-void mos6502::disassemble(const Registers& cpu, std::span<const Common::Byte, 3> bytes, FixedFormatter& formatter) noexcept
+namespace
 {
-  formatter << (cpu.pc - 1) << " : ";
 
-  const Byte opcode = bytes[0];
-  const auto& instr = c_instructions[opcode];
-
-  assert(instr.format.numberOfOperands < std::size(bytes));
-
-  // Add operand bytes
-  formatter << opcode << ' ';
-  (instr.format.numberOfOperands > 0 ? (formatter << bytes[1]) : (formatter << "  ")) << ' ';
-  (instr.format.numberOfOperands > 1 ? (formatter << bytes[2]) : (formatter << "  ")) << ' ';
+// Built on first use, by the first snapshot.
+const MicrocodeTable& microcodeTable()
+{
+  static const MicrocodeTable table{&mos6502::fetchNextOpcode};
+  return table;
+}
 
-  // Mnemonic
-  formatter << "  " << instr.mnemonic << ' ';
+}  // namespace
 
-  // Operand formatting based on addressing mode
-  // The maximum length of the operand field is 7 characters (e.g. "$xxxx,X")
-  // We will pad with spaces if the operand is shorter
-  size_t currentLength = formatter.finalize().length();
+uint16_t mos6502::microcodeIndex(Microcode microcode) noexcept
+{
+  return microcodeTable().indexOf(microcode);
+}
 
-  formatter << instr.format.prefix;
+mos6502::Microcode mos6502::microcode(uint16_t index) noexcept
+{
+  return microcodeTable().at(index);
+}
 
-  // Special case for branch instructions to show target address
-  // Branch instructions have opcodes 0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0
+uint32_t mos6502::executeInstruction(State& cpu, Common::Bus& bus)
+{
+  if (cpu.pollInterrupts()) [[unlikely]]
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<false>::runInterrupt(cpu, bus);
+  }
 
-  if (instr.format.numberOfOperands == 2)
+  auto opcode = bus.read(cpu.registers.pc++);
+  cpu.opcode = opcode;
+  const Instruction& instr = c_instructions[opcode];
+  if (instr.run == nullptr)
   {
-    // Need to output an address
-    formatter << bytes[2] << bytes[1];
+    // Unimplemented opcode; like the microcode engine, the fetch is the whole instruction.
+    return 1;
   }
-  else if ((opcode & 0x1F) == 0x10)
+  return instr.run(cpu, bus);
+}
+
+uint32_t mos6502::executeDecoded(State& cpu, Common::Bus& bus, const DecodedInstruction& instruction)
+{
+  if (cpu.pollInterrupts()) [[unlikely]]
   {
-    // Calculate target address for branch
-    int32_t offset = static_cast<int8_t>(bytes[1]);
-    int32_t target = static_cast<int32_t>(cpu.pc) + 1 + offset;  // PC + instruction length + offset
-    formatter << Address{static_cast<uint16_t>(target)};
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<false>::runInterrupt(cpu, bus);
   }
-  else if (instr.format.numberOfOperands == 1)
+
+  // The opcode fetch; the block cache has read the opcode and the operands already.
+  ++cpu.registers.pc;
+  cpu.opcode = instruction.opcode;
+  if (instruction.runDecoded != nullptr)
   {
-    formatter << bytes[1];
+    return instruction.runDecoded(cpu, bus, instruction.lo, instruction.hi);
   }
+  return instruction.run(cpu, bus);
+}
 
-  formatter << instr.format.suffix;
+const mos6502::Instruction& mos6502::instruction(Common::Byte opcode) noexcept
+{
+  return c_instructions[opcode];
+}
 
-  // Pad to 9 characters
-  size_t neededSpaces = formatter.finalize().length() - currentLength;
-  static constexpr std::string_view padding = "         ";  // 9 spaces
+void mos6502::disassemble(Address address, std::span<const Common::Byte, 3> bytes, FixedFormatter& formatter) noexcept
+{
+  cpu6502::disassemble(c_instructions, address, bytes, formatter);
+}
 
-  formatter << padding.substr(0, 9 - neededSpaces);
+void mos6502::disassemble(const Registers& cpu, std::span<const Common::Byte, 3> bytes, FixedFormatter& formatter) noexcept
+{
+  cpu6502::disassemble(c_instructions, cpu, bytes, formatter);
+}
 
-  // Add registers: A, X, Y, SP, P
-  formatter << " A:" << cpu.a;
-  formatter << " X:" << cpu.x;
-  formatter << " Y:" << cpu.y;
-  formatter << " SP:" << cpu.sp;
-  formatter << " P:" << cpu.p;
-  formatter << ' ';
-  cpu6502::flagsToStr(formatter, cpu.p);
+void mos6502::describe(Common::Byte opcode, FixedFormatter& formatter) noexcept
+{
+  cpu6502::describe(c_instructions, opcode, formatter);
 }
 
 }  // namespace cpu6502
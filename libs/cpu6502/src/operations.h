@@ -0,0 +1,1040 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "cpu6502/address_mode.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+// The operations that the instruction tables of mos6502 and wdc65c02 are composed of. Each one is the
+// part of an instruction that comes after its addressing mode, see address_mode.h.
+
+namespace cpu6502
+{
+
+using Common::Byte;
+using Common::HiByte;
+
+using MicrocodeResponse = Generic6502Definition::Response;
+using BusToken = Generic6502Definition::BusToken;
+using Address = Generic6502Definition::Address;
+using State = Generic6502Definition;
+using Flag = Registers::Flag;
+
+////////////////////////////////////////////////////////////////////////////////
+// ReadModifyWrite Operation
+////////////////////////////////////////////////////////////////////////////////
+template<auto Operation>
+struct ReadModifyWrite
+{
+  static constexpr bool isWrite = true;
+  static constexpr auto operation = Operation;
+
+  // Step 1: Read from memory, write unmodified value back (6502 quirk)
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    cpu.operand = operand;  // Store original value for step1
+    return {spuriousWrite};
+  }
+
+  static MicrocodeResponse spuriousWrite(State& cpu, BusToken bus)
+  {
+    bus.write(Common::MakeAddress(cpu.lo, cpu.hi), cpu.operand);
+    return {step1};
+  }
+
+  static MicrocodeResponse step1(State& cpu, BusToken bus)
+  {
+    cpu.operand = Operation(cpu, cpu.operand);
+
+    // Reconstruct effective address and write modified value
+    // Note: This assumes addressing mode left address info in reconstructible form
+    bus.write(Common::MakeAddress(cpu.lo, cpu.hi), cpu.operand);
+
+    return {};
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Simple Readonly Operation
+template<auto lambda>
+struct SimpleOperation
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    lambda(cpu, operand);
+    return {};
+  }
+};
+
+using NOP = SimpleOperation<[](State& /*cpu*/, Common::Byte /*operand*/)
+    {
+      // No operation; used to consume a cycle
+    }>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shift/Rotate Instructions - Accumulator Mode (2 cycles)
+////////////////////////////////////////////////////////////////////////////////
+
+// ASL A - Arithmetic Shift Left Accumulator
+using ShiftLeftAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      // C ← [7][6][5][4][3][2][1][0] ← 0
+      bool bit7 = (cpu.registers.a & 0x80) != 0;
+      cpu.registers.a <<= 1;  // Shift left, bit 0 becomes 0
+
+      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
+      cpu.setZN(cpu.registers.a);  // Set N and Z flags
+    }>;
+
+// LSR A - Logical Shift Right Accumulator
+using ShiftRightAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      // 0 → [7][6][5][4][3][2][1][0] → C
+      bool bit0 = (cpu.registers.a & 0x01) != 0;
+      cpu.registers.a >>= 1;  // Shift right, bit 7 becomes 0
+
+      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
+      cpu.setZN(cpu.registers.a);  // Set N and Z flags (N will always be 0)
+    }>;
+
+// ROL A - Rotate Left Accumulator
+using RotateLeftAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      // C ← [7][6][5][4][3][2][1][0] ← C
+      bool bit7 = (cpu.registers.a & 0x80) != 0;
+      bool old_carry = cpu.has(Flag::Carry);
+
+      cpu.registers.a <<= 1;  // Shift left
+      if (old_carry)
+      {
+        cpu.registers.a |= 0x01;  // Carry → Bit 0
+      }
+
+      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
+      cpu.setZN(cpu.registers.a);  // Set N and Z flags
+    }>;
+
+// ROR A - Rotate Right Accumulator
+using RotateRightAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      // C → [7][6][5][4][3][2][1][0] → C
+      bool bit0 = (cpu.registers.a & 0x01) != 0;
+      bool old_carry = cpu.has(Flag::Carry);
+
+      cpu.registers.a >>= 1;  // Shift right
+      if (old_carry)
+      {
+        cpu.registers.a |= 0x80;  // Carry → Bit 7
+      }
+
+      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
+      cpu.setZN(cpu.registers.a);  // Set N and Z flags
+    }>;
+
+using And = SimpleOperation<[](State& cpu, Common::Byte operand)
+    {
+      cpu.registers.a &= operand;  // A ← A ∧ M
+      cpu.setZN(cpu.registers.a);  // Set N and Z flags based on result
+    }>;
+
+using Eor = SimpleOperation<[](State& cpu, Common::Byte operand)
+    {
+      cpu.registers.a ^= operand;  // A ← A ⊕ M
+      cpu.setZN(cpu.registers.a);
+    }>;
+
+using Ora = SimpleOperation<[](State& cpu, Common::Byte operand)
+    {
+      // Perform OR with accumulator
+      cpu.registers.a |= operand;
+      cpu.set(Flag::Zero, cpu.registers.a == 0);  // Set zero flag
+      cpu.set(Flag::Negative, cpu.registers.a & 0x80);  // Set negative flag
+    }>;
+
+using Bit = SimpleOperation<[](State& cpu, Common::Byte operand)
+    {
+      // BIT instruction: Test bits in memory with accumulator
+      // - Z flag: Set if (A & M) == 0
+      // - N flag: Copy bit 7 of memory operand
+      // - V flag: Copy bit 6 of memory operand
+      // - Accumulator is NOT modified
+      // - C, I, D flags are not affected
+
+      Byte memory_value = operand;
+      Byte test_result = cpu.registers.a & memory_value;
+
+      // Set Zero flag based on AND result
+      cpu.set(Flag::Zero, test_result == 0);
+
+      // Copy bit 7 of memory to Negative flag
+      cpu.set(Flag::Negative, (memory_value & 0x80) != 0);
+
+      // Copy bit 6 of memory to Overflow flag
+      cpu.set(Flag::Overflow, (memory_value & 0x40) != 0);
+
+      // Note: Accumulator is unchanged!
+    }>;
+
+////////////////////////////////////////////////////////////////////////////////
+// BRK and hardware interrupts (7 cycles)
+////////////////////////////////////////////////////////////////////////////////
+
+// IRQ and NMI run the same steps as BRK after fetchNextOpcode() has read and discarded the opcode, but
+// push the address of the instruction they interrupted and P with B clear. The vector is only chosen
+// when it is read, so an NMI that arrives while BRK or an IRQ is pushing hijacks it.
+//
+// The 65C02 also clears the Decimal flag when it takes the vector; the NMOS 6502 leaves it alone.
+template<bool ClearDecimal>
+struct Break
+{
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
+  {
+    // BRK pushes PC (current instruction + 2), unlike JSR which pushes PC-1
+    ++cpu.registers.pc;
+    cpu.operand = static_cast<Byte>(Flag::Break);
+    return {pushHighPC};
+  }
+
+  // Step 0 of an IRQ or NMI
+  static MicrocodeResponse interrupt(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.operand = 0;
+    return {pushHighPC};
+  }
+
+  //! The whole IRQ or NMI sequence for the instruction-level engine, the opcode read included.
+  static uint32_t runInterrupt(State& cpu, Common::Bus& bus)
+  {
+    return finishInstruction(cpu, bus, 2, interrupt(cpu, BusToken{&bus}));
+  }
+
+  // Step 1: Push return address high byte (PC)
+  static MicrocodeResponse pushHighPC(State& cpu, BusToken bus)
+  {
+    Byte return_addr_high = Common::HiByte(cpu.registers.pc);
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), return_addr_high);
+    return {pushLowPC};
+  }
+
+  // Step 2: Push return address low byte
+  static MicrocodeResponse pushLowPC(State& cpu, BusToken bus)
+  {
+    Byte return_addr_low = Common::LoByte(static_cast<uint16_t>(cpu.registers.pc));
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), return_addr_low);
+    return {pushProcessorStatus};
+  }
+
+  // Step 3: Push processor status, with the Break flag set for BRK (like PHP)
+  static MicrocodeResponse pushProcessorStatus(State& cpu, BusToken bus)
+  {
+    Byte status = cpu.registers.p | cpu.operand;
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), status);
+    return {readVectorLow};
+  }
+
+  // Step 4: Read vector low byte, set Interrupt flag
+  static MicrocodeResponse readVectorLow(State& cpu, BusToken bus)
+  {
+    // Set Interrupt flag to disable further interrupts
+    cpu.set(Flag::Interrupt, true);
+    if constexpr (ClearDecimal)
+    {
+      cpu.set(Flag::Decimal, false);
+    }
+
+    // NMI at $FFFA, IRQ and BRK at $FFFE
+    cpu.operand = cpu.nmi ? 0xFA : 0xFE;
+    cpu.nmi = false;
+    cpu.lo = bus.read(Common::MakeAddress(cpu.operand, 0xFF));
+
+    return {readVectorHigh};
+  }
+
+  // Step 5: Read vector high byte and jump
+  static MicrocodeResponse readVectorHigh(State& cpu, BusToken bus)
+  {
+    cpu.hi = bus.read(Common::MakeAddress(static_cast<Byte>(cpu.operand + 1), 0xFF));
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+    return {};
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Flag operations (CLC, SEC, CLI, SEI, CLD, SED, CLV)
+////////////////////////////////////////////////////////////////////////////////
+template<Registers::Flag Flag, bool Set>
+struct FlagOp
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
+  {
+    if constexpr (Flag == Registers::Flag::Interrupt)
+    {
+      cpu.delayInterruptMask();
+    }
+    cpu.set(Flag, Set);
+    return {};
+  }
+};
+
+using CLC = FlagOp<Flag::Carry, false>;
+using SEC = FlagOp<Flag::Carry, true>;
+using CLI = FlagOp<Flag::Interrupt, false>;
+using SEI = FlagOp<Flag::Interrupt, true>;
+using CLV = FlagOp<Flag::Overflow, false>;
+using CLD = FlagOp<Flag::Decimal, false>;
+using SED = FlagOp<Flag::Decimal, true>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Increment operations (INX, INY)
+
+template<Common::Byte Registers::* reg>
+  requires(reg != &Registers::a)
+struct Increment
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
+  {
+    // Handle increment operation for X or Y registers
+    auto& r = (cpu.registers.*reg);
+    ++r;
+    cpu.setZN(r);
+    return {};
+  }
+};
+
+using INX = Increment<&Registers::x>;
+using INY = Increment<&Registers::y>;
+
+template<Common::Byte Registers::* reg>
+  requires(reg != &Registers::a)
+struct Decrement
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
+  {
+    // Handle decrement operation for X or Y registers
+    auto& r = ((cpu.registers.*reg));
+    --r;
+    cpu.setZN(r);
+    return {};
+  }
+};
+
+using DEX = Decrement<&Registers::x>;
+using DEY = Decrement<&Registers::y>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Push/Pull operations, PLA, PLA, PHP, PLP
+////////////////////////////////////////////////////////////////////////////////
+
+template<Common::Byte Registers::* SourceReg, bool SetBreakFlag = false>
+struct PushOp
+{
+  // Step 0: Dummy read to consume cycle
+  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
+  {
+    return {step1};
+  }
+
+  // Step 2: Write register value to stack
+  static MicrocodeResponse step1(State& cpu, BusToken bus)
+  {
+    Byte data = (cpu.registers.*SourceReg);
+
+    // Apply Break flag modification for PHP
+    if constexpr (SetBreakFlag)
+    {
+      data |= static_cast<Byte>(Flag::Break);
+    }
+
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), data);
+    return {};
+  }
+};
+
+template<Common::Byte Registers::* TargetReg>
+struct PullOp
+{
+  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
+  {
+    return {step2};
+  }
+
+  static MicrocodeResponse step2(State& cpu, BusToken bus)
+  {
+    cpu.operand = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
+    return {step3};
+  }
+
+  // Step 3: Store data and set flags if needed
+  static MicrocodeResponse step3(State& cpu, BusToken bus)
+  {
+    Common::Byte data = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
+
+    // Apply Break flag clearing for PLP
+    if constexpr (TargetReg == &Registers::p)
+    {
+      data &= ~static_cast<Byte>(Flag::Break);
+      cpu.delayInterruptMask();
+      cpu.assignP(data);  // Use assignP to ensure U flag is set
+    }
+    else
+    {
+      // Update N/Z flags for PLA
+      // Store in target register
+      (cpu.registers.*TargetReg) = data;
+      cpu.setZN(data);
+    }
+
+    return {};
+  }
+};
+
+using PLA = PullOp<&Registers::a>;
+using PLP = PullOp<&Registers::p>;
+using PHA = PushOp<&Registers::a, false>;
+using PHP = PushOp<&Registers::p, true>;
+
+////////////////////////////////////////////////////////////////////////////////
+// RTI - Return from Interrupt (6 cycles)
+////////////////////////////////////////////////////////////////////////////////
+
+struct Rti
+{
+  static constexpr bool changesFlow = true;
+
+  // Step 0: Dummy read from current PC
+  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
+  {
+    return {step2};
+  }
+
+  static MicrocodeResponse step2(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto byte = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
+    return {popProcessorStatus};
+  }
+
+  static MicrocodeResponse popProcessorStatus(State& cpu, BusToken bus)
+  {
+    // Restore processor status (clear Break flag like PLP)
+    Byte status = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01)) & ~static_cast<Byte>(Flag::Break);
+    cpu.assignP(status);  // Use assignP to preserve Unused flag
+
+    return {popReturnAddressLow};
+  }
+
+  static MicrocodeResponse popReturnAddressLow(State& cpu, BusToken bus)
+  {
+    cpu.lo = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
+    return {popReturnAddressHigh};
+  }
+
+  static MicrocodeResponse popReturnAddressHigh(State& cpu, BusToken bus)
+  {
+    cpu.hi = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+
+    // Note: Unlike RTS, RTI does NOT increment PC
+    return {};
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// RTS - Return from Subroutine (6 cycles)
+////////////////////////////////////////////////////////////////////////////////
+
+struct Rts
+{
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
+  {
+    return {step2};
+  }
+
+  static MicrocodeResponse step2(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto byte = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
+    return {popReturnAddressLow};
+  }
+
+  static MicrocodeResponse popReturnAddressLow(State& cpu, BusToken bus)
+  {
+    cpu.lo = bus.read(Common::MakeAddress(cpu.registers.sp++, 0x01));
+
+    return {popReturnAddressHigh};
+  }
+
+  static MicrocodeResponse popReturnAddressHigh(State& cpu, BusToken bus)
+  {
+    cpu.hi = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
+    return {jumpToReturnAddress};
+  }
+
+  static MicrocodeResponse jumpToReturnAddress(State& cpu, BusToken bus)
+  {
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+
+    bus.read(cpu.registers.pc++);
+
+    // Note: Unlike RTS, RTI does NOT increment PC
+    return {};
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Transfer operations (TAX, TAY, TXA, TYA, TSX, TXS)
+////////////////////////////////////////////////////////////////////////////////
+template<Common::Byte Registers::* src, Common::Byte Registers::* dst>
+  requires(src != dst)
+struct Transfer
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte /*operand*/)
+  {
+    (cpu.registers.*dst) = (cpu.registers.*src);
+
+    if constexpr (dst != &Registers::sp)
+    {
+      // Only affect flags if not transferring to stack pointer
+      cpu.setZN((cpu.registers.*dst));
+    }
+    return {};
+  }
+};
+
+using TYA = Transfer<&Registers::y, &Registers::a>;
+using TAY = Transfer<&Registers::a, &Registers::y>;
+using TXA = Transfer<&Registers::x, &Registers::a>;
+using TAX = Transfer<&Registers::a, &Registers::x>;
+using TXS = Transfer<&Registers::x, &Registers::sp>;
+using TSX = Transfer<&Registers::sp, &Registers::x>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Shift/Rotate Instructions - Memory Mode (Read-Modify-Write)
+////////////////////////////////////////////////////////////////////////////////
+
+using ShiftLeft = ReadModifyWrite<[](State& cpu, Common::Byte value)
+    {
+      // C ← [7][6][5][4][3][2][1][0] ← 0
+      bool bit7 = (value & 0x80) != 0;
+      value <<= 1;  // Shift left, bit 0 becomes 0
+
+      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
+      cpu.setZN(value);  // Set N and Z flags
+
+      return value;
+    }>;
+
+using ShiftRight = ReadModifyWrite<[](State& cpu, Common::Byte value)
+    {
+      // 0 → [7][6][5][4][3][2][1][0] → C
+      bool bit0 = (value & 0x01) != 0;
+      value >>= 1;  // Shift right, bit 7 becomes 0
+
+      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
+      cpu.setZN(value);  // Set N and Z flags (N will always be 0)
+
+      return value;
+    }>;
+
+using RotateLeft = ReadModifyWrite<[](State& cpu, Common::Byte value)
+    {
+      // C ← [7][6][5][4][3][2][1][0] ← C
+      bool bit7 = (value & 0x80) != 0;
+      bool old_carry = cpu.has(Flag::Carry);
+
+      value <<= 1;  // Shift left
+      if (old_carry)
+      {
+        value |= 0x01;  // Carry → Bit 0
+      }
+
+      cpu.set(Flag::Carry, bit7);  // Bit 7 → Carry
+      cpu.setZN(value);  // Set N and Z flags
+
+      return value;
+    }>;
+
+using RotateRight = ReadModifyWrite<[](State& cpu, Common::Byte value)
+    {
+      // C → [7][6][5][4][3][2][1][0] → C
+      bool bit0 = (value & 0x01) != 0;
+      bool old_carry = cpu.has(Flag::Carry);
+
+      value >>= 1;  // Shift right
+      if (old_carry)
+      {
+        value |= 0x80;  // Carry → Bit 7
+      }
+
+      cpu.set(Flag::Carry, bit0);  // Bit 0 → Carry
+      cpu.setZN(value);  // Set N and Z flags
+
+      return value;
+    }>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Arithmetic and Logic Instructions
+////////////////////////////////////////////////////////////////////////////////
+
+namespace detail
+{
+
+//! Result of a decimal mode ADC or SBC as the NMOS 6502 computes it.
+struct DecimalResult
+{
+  Byte value = 0;
+  Byte flags = 0;  // N, V, Z and C in their positions in P
+};
+
+// Indexed by decimalIndex(), which is (carry, A, operand).
+using DecimalTable = std::array<DecimalResult, 2 * 256 * 256>;
+
+inline constexpr Byte c_arithmeticFlags = static_cast<Byte>(
+    static_cast<Byte>(Flag::Negative) | static_cast<Byte>(Flag::Overflow) | static_cast<Byte>(Flag::Zero) |
+    static_cast<Byte>(Flag::Carry));
+
+constexpr size_t decimalIndex(bool carry, Byte a, Byte operand) noexcept
+{
+  return (static_cast<size_t>(carry) << 16) | (static_cast<size_t>(a) << 8) | operand;
+}
+
+constexpr Byte arithmeticFlags(bool negative, bool overflow, bool zero, bool carry) noexcept
+{
+  return static_cast<Byte>((negative ? static_cast<Byte>(Flag::Negative) : 0) |
+                           (overflow ? static_cast<Byte>(Flag::Overflow) : 0) | (zero ? static_cast<Byte>(Flag::Zero) : 0) |
+                           (carry ? static_cast<Byte>(Flag::Carry) : 0));
+}
+
+// Decimal ADC, see "Decimal Mode" by Bruce Clark (6502.org, appendix A). Z comes from the binary sum,
+// N and V from the sum before the high digit is adjusted.
+inline DecimalResult decimalAdd(int carry, int a, int operand) noexcept
+{
+  int low = (a & 0x0F) + (operand & 0x0F) + carry;
+  if (low >= 0x0A)
+  {
+    low = ((low + 0x06) & 0x0F) + 0x10;
+  }
+  int sum = (a & 0xF0) + (operand & 0xF0) + low;
+  int signedSum = static_cast<int8_t>(a & 0xF0) + static_cast<int8_t>(operand & 0xF0) + low;
+
+  bool negative = (sum & 0x80) != 0;
+  bool overflow = signedSum < -128 || signedSum > 127;
+  bool zero = ((a + operand + carry) & 0xFF) == 0;
+  if (sum >= 0xA0)
+  {
+    sum += 0x60;
+  }
+  return {static_cast<Byte>(sum & 0xFF), arithmeticFlags(negative, overflow, zero, sum >= 0x100)};
+}
+
+// Decimal SBC. Only the result is decimal, the NMOS 6502 sets all flags as in binary mode.
+inline DecimalResult decimalSubtract(int carry, int a, int operand) noexcept
+{
+  int low = (a & 0x0F) - (operand & 0x0F) + carry - 1;
+  if (low < 0)
+  {
+    low = ((low - 0x06) & 0x0F) - 0x10;
+  }
+  int difference = (a & 0xF0) - (operand & 0xF0) + low;
+  if (difference < 0)
+  {
+    difference -= 0x60;
+  }
+
+  int binary = a + (~operand & 0xFF) + carry;
+  auto result = static_cast<Byte>(binary & 0xFF);
+  bool overflow = ((a ^ result) & (~operand ^ result) & 0x80) != 0;
+  return {static_cast<Byte>(difference & 0xFF),
+      arithmeticFlags((result & 0x80) != 0, overflow, result == 0, binary > 0xFF)};
+}
+
+template<DecimalResult (*Operation)(int, int, int) noexcept>
+DecimalTable makeDecimalTable() noexcept
+{
+  DecimalTable table{};
+  for (int carry = 0; carry < 2; ++carry)
+  {
+    for (int a = 0; a < 256; ++a)
+    {
+      for (int operand = 0; operand < 256; ++operand)
+      {
+        table[decimalIndex(carry != 0, static_cast<Byte>(a), static_cast<Byte>(operand))] = Operation(carry, a, operand);
+      }
+    }
+  }
+  return table;
+}
+
+// Built once at startup. As constexpr tables they would take more evaluation steps than compilers
+// allow by default.
+inline const DecimalTable c_decimalAdd = makeDecimalTable<decimalAdd>();
+inline const DecimalTable c_decimalSubtract = makeDecimalTable<decimalSubtract>();
+
+inline void applyDecimal(State& cpu, const DecimalTable& table, Byte operand) noexcept
+{
+  const DecimalResult& entry = table[decimalIndex(cpu.has(Flag::Carry), cpu.registers.a, operand)];
+  cpu.registers.a = entry.value;
+  cpu.registers.p = static_cast<Byte>((cpu.registers.p & ~c_arithmeticFlags) | entry.flags);
+}
+
+}  // namespace detail
+
+struct Add
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    if (cpu.has(Flag::Decimal))
+    {
+      detail::applyDecimal(cpu, detail::c_decimalAdd, operand);
+      return {};
+    }
+
+    const Byte a = cpu.registers.a;
+    const Byte m = operand;
+    const Byte c = cpu.has(Flag::Carry) ? 1 : 0;
+
+    const uint16_t sum = uint16_t(a) + uint16_t(m) + uint16_t(c);
+    const Byte result = Byte(sum & 0xFF);
+
+    cpu.set(Flag::Carry, (sum & 0x100) != 0);
+    cpu.set(Flag::Overflow, ((~(a ^ m) & (a ^ result)) & 0x80) != 0);
+    cpu.setZN(result);
+
+    cpu.registers.a = result;
+    return {};
+  }
+};
+
+struct Subtract
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    if (cpu.has(Flag::Decimal))
+    {
+      detail::applyDecimal(cpu, detail::c_decimalSubtract, operand);
+      return {};
+    }
+
+    // SBC: A = A - M - (1 - C) = A + (~M) + C
+    operand = ~operand;  // Invert the operand for two's complement
+    Common::Byte carry = cpu.has(Flag::Carry) ? 1 : 0;
+
+    uint16_t temp = static_cast<uint16_t>(cpu.registers.a) + operand + carry;
+
+    // Set carry flag (no borrow occurred if bit 8 is set)
+    cpu.set(Flag::Carry, (temp & 0x100) != 0);
+
+    // Check for signed overflow
+    auto result = static_cast<Common::Byte>(temp & 0xFF);
+    bool overflow = ((cpu.registers.a ^ result) & (operand ^ result) & 0x80) != 0;
+    cpu.set(Flag::Overflow, overflow);
+
+    // Store result and set N,Z flags
+    cpu.registers.a = result;
+    cpu.setZN(cpu.registers.a);
+
+    return {};
+  }
+};
+
+template<Common::Byte Registers::* reg>
+struct Compare
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    auto r = ((cpu.registers.*reg));
+    uint16_t diff = uint16_t(r) - uint16_t(operand);  // Unsigned arithmetic
+    bool borrow = (diff & 0x100) != 0;
+
+    cpu.set(Flag::Carry, !borrow);
+    cpu.setZN(static_cast<Common::Byte>(diff & 0xFF));
+    return {};
+  }
+};
+
+using CMP = Compare<&Registers::a>;
+using CPX = Compare<&Registers::x>;
+using CPY = Compare<&Registers::y>;
+
+template<Common::Byte Registers::* reg>
+struct Load
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    // This is a generic load operation for A, X, or Y registers.
+
+    auto data = (cpu.registers.*reg) = operand;
+    cpu.setZN(data);
+    return {};
+  }
+};
+
+using LDA = Load<&Registers::a>;
+using LDX = Load<&Registers::x>;
+using LDY = Load<&Registers::y>;
+
+template<Common::Byte Registers::* reg>
+struct Store
+{
+  static constexpr bool isWrite = true;
+
+  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
+  {
+    // This is a generic store operation for A, X, or Y registers.
+    bus.write(effectiveAddress, (cpu.registers.*reg));
+
+    return {};
+  }
+};
+
+using STA = Store<&Registers::a>;
+using STX = Store<&Registers::x>;
+using STY = Store<&Registers::y>;
+
+template<Registers::Flag flag, bool condition>
+struct Branch
+{
+
+  // Evaluate condition and decide whether to branch
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    // The incoming operand is the relative branch offset.
+    cpu.operand = operand;
+
+    // Check if the flag matches the desired condition
+    bool flagSet = cpu.has(flag);
+    bool shouldBranch = (flagSet == condition);
+
+    if (shouldBranch)
+    {
+      // Branch taken - continue to step 1
+      return {branchTaken};
+    }
+
+    return {};
+  }
+
+  static MicrocodeResponse branchTaken(State& cpu, BusToken bus)
+  {
+    int8_t offset = static_cast<int8_t>(cpu.operand);
+
+    if (offset == -2)
+    {  // Self-branch detected
+      cpu.trap(cpu.registers.pc - 2);
+    }
+
+    // Add offset to PC low byte
+    auto tmp = static_cast<uint16_t>(cpu.registers.pc) + offset;
+
+    // We have three pieces of information:
+    // - The low byte of the new PC (LoByte(tmp))
+    // - The high byte of the new PC (HiByte(tmp))
+    // - The high byte of the current PC (HiByte(cpu.registers.pc))
+
+    cpu.lo = static_cast<Common::Byte>(tmp & 0xFF);
+    cpu.hi = HiByte(cpu.registers.pc);
+    cpu.operand = HiByte(static_cast<uint16_t>(tmp));
+
+    // Read from the old PC address again
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+
+    // Detect if page boundary is crossed
+    if (cpu.operand == cpu.hi)
+    {
+      // No page boundary crossed - branch complete
+      cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+      return {};
+    }
+
+    // Page boundary crossed - need step 2 for fixup
+    return {branchPageFixup};
+  }
+
+  static MicrocodeResponse branchPageFixup(State& cpu, BusToken bus)
+  {
+    // Read from the incorrect address
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+
+    [[maybe_unused]] auto byte = bus.read(cpu.registers.pc);
+
+    cpu.hi = cpu.operand;
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, static_cast<Common::Byte>(cpu.hi));
+
+    // 4 cycles total, we're done
+    return {};
+  }
+};
+
+using BNE = Branch<Flag::Zero, false>;
+using BEQ = Branch<Flag::Zero, true>;
+using BPL = Branch<Flag::Negative, false>;
+using BMI = Branch<Flag::Negative, true>;
+using BCC = Branch<Flag::Carry, false>;
+using BCS = Branch<Flag::Carry, true>;
+using BVC = Branch<Flag::Overflow, false>;
+using BVS = Branch<Flag::Overflow, true>;
+
+using IncrementMemory = ReadModifyWrite<[](State& cpu, Common::Byte val)
+    {
+      ++val;
+      cpu.setZN(val);
+      return val;
+    }>;
+
+using DecrementMemory = ReadModifyWrite<[](State& cpu, Common::Byte val)
+    {
+      --val;
+      cpu.setZN(val);
+      return val;
+    }>;
+
+// JSR - Jump to Subroutine (6 cycles)
+struct JumpSubroutine
+{
+  static constexpr Generic6502Definition::DisassemblyFormat format{"$", "", 2 /* e.g. "$4400" */};
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse execute(State& cpu, BusToken bus)
+  {
+    cpu.lo = bus.read(cpu.registers.pc++);
+    return {internal};
+  }
+
+  static MicrocodeResponse internal(State& cpu, BusToken bus)
+  {
+    cpu.operand = bus.read(Common::MakeAddress(cpu.registers.sp, 0x01));
+    return {pushHighPC};
+  }
+
+  static MicrocodeResponse pushHighPC(State& cpu, BusToken bus)
+  {
+    // Push return address high byte (PC-1)
+    // JSR pushes PC-1 where PC currently points past the JSR instruction
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), Common::HiByte(cpu.registers.pc));
+
+    return {pushLowPC};
+  }
+
+  static MicrocodeResponse pushLowPC(State& cpu, BusToken bus)
+  {
+    // Push return address low byte and jump
+    bus.write(Common::MakeAddress(cpu.registers.sp--, 0x01), Common::LoByte(cpu.registers.pc));
+
+    return {jump};
+  }
+
+  static MicrocodeResponse jump(State& cpu, BusToken bus)
+  {
+    cpu.hi = bus.read(cpu.registers.pc++);
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+    return {};
+  }
+
+  static uint32_t run(State& cpu, Common::Bus& bus)
+  {
+    execute(cpu, BusToken{&bus});
+    internal(cpu, BusToken{&bus});
+    pushHighPC(cpu, BusToken{&bus});
+    pushLowPC(cpu, BusToken{&bus});
+    jump(cpu, BusToken{&bus});
+    return 6;
+  }
+
+  static uint32_t runDecoded(State& cpu, Common::Bus& bus, Common::Byte lo, Common::Byte hi)
+  {
+    // The return address pushed is the one of the high byte, which is only read at the end.
+    ++cpu.registers.pc;
+    cpu.lo = lo;
+    internal(cpu, BusToken{&bus});
+    pushHighPC(cpu, BusToken{&bus});
+    pushLowPC(cpu, BusToken{&bus});
+    cpu.hi = hi;
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+    return 6;
+  }
+};
+
+struct JumpAbsolute
+{
+  static constexpr Generic6502Definition::DisassemblyFormat format{"$", "", 2 /* e.g. "$4400" */};
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse execute(State& cpu, BusToken bus)
+  {
+    cpu.lo = bus.read(cpu.registers.pc++);
+    return {readHighPC};
+  }
+  static MicrocodeResponse readHighPC(State& cpu, BusToken bus)
+  {
+    cpu.hi = bus.read(cpu.registers.pc++);
+    cpu.registers.pc = Common::MakeAddress(cpu.lo, cpu.hi);
+    return {};
+  }
+
+  static uint32_t run(State& cpu, Common::Bus& bus)
+  {
+    execute(cpu, BusToken{&bus});
+    readHighPC(cpu, BusToken{&bus});
+    return 3;
+  }
+
+  static uint32_t runDecoded(State& cpu, Common::Bus& /*bus*/, Common::Byte lo, Common::Byte hi)
+  {
+    cpu.lo = lo;
+    cpu.hi = hi;
+    cpu.registers.pc = Common::MakeAddress(lo, hi);
+    return 3;
+  }
+};
+
+struct JumpIndirect
+{
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
+  {
+    // cpu.lo and cpu.hi already hold the two bytes that followed the opcode, the
+    // pointer address. We now need to load the byte at that address, then the byte at
+    // the next address (with the 6502 page wrap bug).
+    cpu.operand = bus.read(effectiveAddress);
+    return {readDestinationHigh};
+  }
+
+  static MicrocodeResponse readDestinationHigh(State& cpu, BusToken bus)
+  {
+    // We read the low byte at the effective address, now we need to increment that address and read
+    // the high byte, with the 6502 page wrap bug. The bug is that we only increment the low byte of
+    // the address. If it wraps, we stay on the same page. I.e. if the pointer address is $xxFF, we read
+    // the high byte from $xx00, not $xy00.
+    Address ptr = Common::MakeAddress(++cpu.lo, cpu.hi);
+
+    cpu.lo = cpu.operand;
+    cpu.hi = bus.read(ptr);
+
+    // The jump happens in the same cycle as the last read.
+    jump(cpu);
+    return {};
+  }
+
+  static void jump(State& cpu)
+  {
+    Address target = Common::MakeAddress(cpu.lo, cpu.hi);
+    // JMP (indirect) requires 3 bytes, so if we are jumping to the current instruction,
+    // it is a self-jump.
+    if (target == cpu.registers.pc - 3)
+    {  // Self-jump detected
+      cpu.trap(target);
+    }
+    cpu.registers.pc = target;
+  }
+};
+
+}  // namespace cpu6502
@@ -0,0 +1,56 @@
+#include "cpu6502/profile_report.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iomanip>
+#include <numeric>
+#include <ostream>
+#include <string_view>
+
+#include "common/fixed_formatter.h"
+#include "common/profiler.h"
+#include "cpu6502/mos6502.h"
+
+namespace cpu6502
+{
+
+void writeProfileReport(std::ostream& out, const Common::OpcodeProfiler& profiler, size_t limit)
+{
+  const auto& counters = profiler.counters();
+
+  std::array<Common::Byte, 256> opcodes{};
+  std::iota(opcodes.begin(), opcodes.end(), Common::Byte{0});
+  std::ranges::stable_sort(opcodes, std::greater{}, [&](Common::Byte opcode) { return counters[opcode].cycles; });
+
+  uint64_t total = 0;
+  for (const auto& counter : counters)
+  {
+    total += counter.cycles;
+  }
+
+  auto flags = out.flags();
+  out << "op  instruction     executions        cycles   share\n";
+  for (size_t i = 0; i < std::min(limit, opcodes.size()); ++i)
+  {
+    Common::Byte opcode = opcodes[i];
+    const auto& counter = counters[opcode];
+    if (counter.executions == 0)
+    {
+      break;
+    }
+
+    std::array<char, 32> buffer{};
+    Common::FixedFormatter formatter{buffer};
+    formatter << opcode << "  ";
+    mos6502::describe(opcode, formatter);
+    std::string_view text = formatter.finalize();
+
+    double share = total != 0 ? 100.0 * static_cast<double>(counter.cycles) / static_cast<double>(total) : 0.0;
+    out << std::left << std::setw(16) << text << std::right << std::setw(14) << counter.executions << std::setw(14)
+        << counter.cycles << std::setw(7) << std::fixed << std::setprecision(1) << share << "%\n";
+  }
+  out.flags(flags);
+}
+
+}  // namespace cpu6502
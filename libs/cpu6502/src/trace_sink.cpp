@@ -0,0 +1,98 @@
+#include "cpu6502/trace_sink.h"
+
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "common/fixed_formatter.h"
+
+namespace cpu6502
+{
+
+namespace
+{
+
+// Longest formatted record, with room to spare.
+constexpr size_t c_lineSize{128};
+
+// How long the writer sleeps when the ring is empty.
+constexpr std::chrono::milliseconds c_idleWait{1};
+
+}  // namespace
+
+TraceSink::TraceSink(std::ostream& out, Disassembler disassemble)
+  : m_out(out)
+  , m_disassemble(disassemble)
+  , m_writer([this](std::stop_token stop) { write(stop); })
+{
+}
+
+TraceSink::~TraceSink()
+{
+  m_writer.request_stop();
+  m_writer.join();
+}
+
+void TraceSink::format(const TraceRecord& record, Disassembler disassemble, Common::FixedFormatter& formatter) noexcept
+{
+  if (record.bytesKnown)
+  {
+    // The disassembler expects the PC one past the opcode, as it is once the opcode has been fetched.
+    Registers fetched = record.registers;
+    fetched.pc = fetched.pc + 1;
+    disassemble(fetched, record.bytes, formatter);
+  }
+  else
+  {
+    formatter << record.registers.pc << " : ??";
+  }
+
+  std::array<char, 24> cycle{};
+  auto [end, error] = std::to_chars(cycle.data(), cycle.data() + cycle.size(), record.cycle);
+  formatter << " @" << std::string_view(cycle.data(), end);
+}
+
+void TraceSink::write(std::stop_token stop)
+{
+  while (!stop.stop_requested())
+  {
+    if (drain() == 0)
+    {
+      std::this_thread::sleep_for(c_idleWait);
+    }
+  }
+
+  // The producer is done by the time the sink is destroyed, write out what it left.
+  while (drain() != 0)
+  {
+  }
+  m_out.flush();
+}
+
+size_t TraceSink::drain()
+{
+  std::array<TraceRecord, c_batchSize> records;
+  size_t count = m_ring.pop(records);
+  if (count == 0)
+  {
+    return 0;
+  }
+
+  std::string batch;
+  batch.reserve(count * c_lineSize);
+  for (size_t i = 0; i < count; ++i)
+  {
+    std::array<char, c_lineSize> line{};
+    Common::FixedFormatter formatter{line};
+    format(records[i], m_disassemble, formatter);
+    batch += formatter.finalize();
+    batch += '\n';
+  }
+  m_out.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+  return count;
+}
+
+}  // namespace cpu6502
@@ -0,0 +1,614 @@
+#include "cpu6502/wdc65c02.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/fixed_formatter.h"
+#include "cpu6502/address_mode.h"
+#include "cpu6502/registers.h"
+
+#include "instruction_table.h"
+#include "microcode_table.h"
+#include "operations.h"
+
+using namespace Common;
+
+namespace cpu6502
+{
+
+////////////////////////////////////////////////////////////////////////////////
+// ReadModifyWrite Operation
+////////////////////////////////////////////////////////////////////////////////
+
+//! The 65C02 reads the operand a second time where the NMOS 6502 writes it back unmodified. INC and
+//! DEC abs,X always take the extra index cycle (`AlwaysIndexCycle`), the shifts and rotates only
+//! when the index crosses a page.
+template<auto Operation, bool AlwaysIndexCycle = false>
+struct CmosReadModifyWrite
+{
+  static constexpr bool isWrite = AlwaysIndexCycle;
+
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    cpu.operand = operand;  // Store original value for step1
+    return {spuriousRead};
+  }
+
+  static MicrocodeResponse spuriousRead(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto data = bus.read(Common::MakeAddress(cpu.lo, cpu.hi));
+    return {step1};
+  }
+
+  static MicrocodeResponse step1(State& cpu, BusToken bus)
+  {
+    cpu.operand = Operation(cpu, cpu.operand);
+    bus.write(Common::MakeAddress(cpu.lo, cpu.hi), cpu.operand);
+    return {};
+  }
+};
+
+using CmosShiftLeft = CmosReadModifyWrite<ShiftLeft::operation>;
+using CmosShiftRight = CmosReadModifyWrite<ShiftRight::operation>;
+using CmosRotateLeft = CmosReadModifyWrite<RotateLeft::operation>;
+using CmosRotateRight = CmosReadModifyWrite<RotateRight::operation>;
+using CmosIncrementMemory = CmosReadModifyWrite<IncrementMemory::operation, true>;
+using CmosDecrementMemory = CmosReadModifyWrite<DecrementMemory::operation, true>;
+
+namespace
+{
+
+// TSB - Z ← (A ∧ M) = 0, M ← M ∨ A
+Common::Byte testAndSetBits(State& cpu, Common::Byte value)
+{
+  cpu.set(Flag::Zero, (cpu.registers.a & value) == 0);
+  return static_cast<Byte>(value | cpu.registers.a);
+}
+
+// TRB - Z ← (A ∧ M) = 0, M ← M ∧ ¬A
+Common::Byte testAndResetBits(State& cpu, Common::Byte value)
+{
+  cpu.set(Flag::Zero, (cpu.registers.a & value) == 0);
+  return static_cast<Byte>(value & ~cpu.registers.a);
+}
+
+}  // namespace
+
+using TSB = CmosReadModifyWrite<&testAndSetBits>;
+using TRB = CmosReadModifyWrite<&testAndResetBits>;
+
+////////////////////////////////////////////////////////////////////////////////
+// Instructions the NMOS 6502 does not have
+////////////////////////////////////////////////////////////////////////////////
+
+using IncrementAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      ++cpu.registers.a;
+      cpu.setZN(cpu.registers.a);
+    }>;
+
+using DecrementAccumulator = SimpleOperation<[](State& cpu, Common::Byte /*operand*/)
+    {
+      --cpu.registers.a;
+      cpu.setZN(cpu.registers.a);
+    }>;
+
+// BIT #imm only sets Z, there is no memory operand to copy N and V from.
+using BitImmediate = SimpleOperation<[](State& cpu, Common::Byte operand)
+    {
+      cpu.set(Flag::Zero, (cpu.registers.a & operand) == 0);
+    }>;
+
+// STZ - M ← 0
+struct StoreZero
+{
+  static constexpr bool isWrite = true;
+
+  static MicrocodeResponse step0(State& /*cpu*/, BusToken bus, Common::Address effectiveAddress)
+  {
+    bus.write(effectiveAddress, 0x00);
+    return {};
+  }
+};
+
+using PHX = PushOp<&Registers::x>;
+using PHY = PushOp<&Registers::y>;
+using PLX = PullOp<&Registers::x>;
+using PLY = PullOp<&Registers::y>;
+
+// BRA - the taken half of a conditional branch, including the page crossing cycle.
+struct BranchAlways
+{
+  using Taken = Branch<Flag::Zero, true>;  // Any condition, only its taken steps are used
+
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    cpu.operand = operand;
+    return {Taken::branchTaken};
+  }
+};
+
+//! JMP (abs) and JMP (abs,X), 6 cycles. The 65C02 spends a cycle re-reading the last operand byte
+//! (adding X for the indexed form) and then reads the target from two consecutive addresses, so a
+//! pointer at $xxFF takes its high byte from the next page.
+template<bool Indexed>
+struct CmosJumpIndirect
+{
+  static constexpr bool changesFlow = true;
+
+  static MicrocodeResponse step0(State& cpu, BusToken bus, Common::Address effectiveAddress)
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc - 1);
+    if constexpr (Indexed)
+    {
+      effectiveAddress = effectiveAddress + cpu.registers.x;
+      cpu.lo = Common::LoByte(effectiveAddress);
+      cpu.hi = Common::HiByte(effectiveAddress);
+    }
+    return {readDestinationLow};
+  }
+
+  static MicrocodeResponse readDestinationLow(State& cpu, BusToken bus)
+  {
+    cpu.operand = bus.read(Common::MakeAddress(cpu.lo, cpu.hi));
+    return {readDestinationHigh};
+  }
+
+  static MicrocodeResponse readDestinationHigh(State& cpu, BusToken bus)
+  {
+    Address ptr = Common::MakeAddress(cpu.lo, cpu.hi) + 1;
+
+    cpu.lo = cpu.operand;
+    cpu.hi = bus.read(ptr);
+
+    JumpIndirect::jump(cpu);
+    return {};
+  }
+};
+
+// $5C: reads its absolute operand, then idles for four more cycles (8 in total).
+struct WideNop
+{
+  static MicrocodeResponse step0(State& /*cpu*/, Common::Byte /*operand*/)
+  {
+    return {idle<3>};
+  }
+
+  template<int Remaining>
+  static MicrocodeResponse idle(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto data = bus.read(Common::MakeAddress(cpu.lo, cpu.hi));
+    if constexpr (Remaining > 0)
+    {
+      return {idle<Remaining - 1>};
+    }
+    return {};
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Decimal mode ADC and SBC
+////////////////////////////////////////////////////////////////////////////////
+
+namespace
+{
+
+// Decimal ADC: the NMOS result, carry and V (see "Decimal Mode" by Bruce Clark, appendix A), with N
+// and Z from the result.
+void decimalAdd(State& cpu, Common::Byte operand) noexcept
+{
+  detail::applyDecimal(cpu, detail::c_decimalAdd, operand);
+  cpu.setZN(cpu.registers.a);
+}
+
+// Decimal SBC: the 65C02 adjusts the whole difference rather than each digit. C and V are as in
+// binary mode, which the NMOS table has already; N and Z come from the result.
+void decimalSubtract(State& cpu, Common::Byte operand) noexcept
+{
+  int carry = cpu.has(Flag::Carry) ? 1 : 0;
+  int a = cpu.registers.a;
+  int low = (a & 0x0F) - (operand & 0x0F) + carry - 1;
+  int difference = a - operand + carry - 1;
+  if (difference < 0)
+  {
+    difference -= 0x60;
+  }
+  if (low < 0)
+  {
+    difference -= 0x06;
+  }
+
+  detail::applyDecimal(cpu, detail::c_decimalSubtract, operand);
+  cpu.registers.a = static_cast<Byte>(difference & 0xFF);
+  cpu.setZN(cpu.registers.a);
+}
+
+}  // namespace
+
+//! ADC and SBC: binary mode is the NMOS operation, decimal mode takes one more cycle, in which the
+//! 65C02 reads the byte at the program counter again.
+template<typename BinaryOperation, void (*Decimal)(State&, Common::Byte) noexcept>
+struct CmosArithmetic
+{
+  static MicrocodeResponse step0(State& cpu, Common::Byte operand)
+  {
+    if (cpu.has(Flag::Decimal))
+    {
+      Decimal(cpu, operand);
+      return {decimalCycle};
+    }
+    return BinaryOperation::step0(cpu, operand);
+  }
+
+  static MicrocodeResponse decimalCycle(State& cpu, BusToken bus)
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    return {};
+  }
+};
+
+using CmosAdd = CmosArithmetic<Add, &decimalAdd>;
+using CmosSubtract = CmosArithmetic<Subtract, &decimalSubtract>;
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU implementation
+////////////////////////////////////////////////////////////////////////////////
+
+static constexpr auto c_instructions = []()
+{
+  InstructionTable table{};
+
+  Builder builder{table};
+  builder  //
+      .add<Implied<NOP>>(0xEA, "NOP")
+      .add<Implied<Break<true>>>(0x00, "BRK")
+
+      // Flag operations
+      .add<Implied<CLC>>(0x18, "CLC")
+      .add<Implied<SEC>>(0x38, "SEC")
+      .add<Implied<CLI>>(0x58, "CLI")
+      .add<Implied<SEI>>(0x78, "SEI")
+      .add<Implied<CLV>>(0xB8, "CLV")
+      .add<Implied<CLD>>(0xD8, "CLD")
+      .add<Implied<SED>>(0xF8, "SED")
+
+      // Increment and Decrement instructions
+      .add<Implied<INX>>(0xE8, "INX")
+      .add<Implied<INY>>(0xC8, "INY")
+      .add<Implied<DEX>>(0xCA, "DEX")
+      .add<Implied<DEY>>(0x88, "DEY")
+      .add<Accumulator<IncrementAccumulator>>(0x1A, "INC")
+      .add<Accumulator<DecrementAccumulator>>(0x3A, "DEC")
+
+      // Stack operations
+      .add<Implied<PLA>>(0x68, "PLA")
+      .add<Implied<PHA>>(0x48, "PHA")
+      .add<Implied<PLP>>(0x28, "PLP")
+      .add<Implied<PHP>>(0x08, "PHP")
+      .add<Implied<PLX>>(0xFA, "PLX")
+      .add<Implied<PHX>>(0xDA, "PHX")
+      .add<Implied<PLY>>(0x7A, "PLY")
+      .add<Implied<PHY>>(0x5A, "PHY")
+
+      // RTI/RTS
+      .add<Implied<Rti>>(0x40, "RTI")
+      .add<Implied<Rts>>(0x60, "RTS")
+
+      // Transfer instructions
+      .add<Implied<TYA>>(0x98, "TYA")
+      .add<Implied<TAY>>(0xA8, "TAY")
+      .add<Implied<TXA>>(0x8A, "TXA")
+      .add<Implied<TAX>>(0xAA, "TAX")
+      .add<Implied<TXS>>(0x9A, "TXS")
+      .add<Implied<TSX>>(0xBA, "TSX")
+
+      // Accumulator mode (2 cycles):
+      .add<Accumulator<ShiftLeftAccumulator>>(0x0A, "ASL")
+      .add<Accumulator<ShiftRightAccumulator>>(0x4A, "LSR")
+      .add<Accumulator<RotateLeftAccumulator>>(0x2A, "ROL")
+      .add<Accumulator<RotateRightAccumulator>>(0x6A, "ROR")
+
+      // Memory modes (5-7 cycles):
+      .add<ZeroPage<CmosShiftLeft>>(0x06, "ASL")  // ASL $nn
+      .add<ZeroPageX<CmosShiftLeft>>(0x16, "ASL")  // ASL $nn,X
+      .add<Absolute<CmosShiftLeft>>(0x0E, "ASL")  // ASL $nnnn
+      .add<AbsoluteX<CmosShiftLeft>>(0x1E, "ASL")  // ASL $nnnn,X
+      .add<ZeroPage<CmosShiftRight>>(0x46, "LSR")  // LSR $nn
+      .add<ZeroPageX<CmosShiftRight>>(0x56, "LSR")  // LSR $nn,X
+      .add<Absolute<CmosShiftRight>>(0x4E, "LSR")  // LSR $nnnn
+      .add<AbsoluteX<CmosShiftRight>>(0x5E, "LSR")  // LSR $nnnn,X
+      .add<ZeroPage<CmosRotateLeft>>(0x26, "ROL")  // ROL $nn
+      .add<ZeroPageX<CmosRotateLeft>>(0x36, "ROL")  // ROL $nn,X
+      .add<Absolute<CmosRotateLeft>>(0x2E, "ROL")  // ROL $nnnn
+      .add<AbsoluteX<CmosRotateLeft>>(0x3E, "ROL")  // ROL $nnnn,X
+      .add<ZeroPage<CmosRotateRight>>(0x66, "ROR")  // ROR $nn
+      .add<ZeroPageX<CmosRotateRight>>(0x76, "ROR")  // ROR $nn,X
+      .add<Absolute<CmosRotateRight>>(0x6E, "ROR")  // ROR $nnnn
+      .add<AbsoluteX<CmosRotateRight>>(0x7E, "ROR")  // ROR $nnnn,X
+
+      // AND instructions - all addressing modes
+      .add<Immediate<And>>(0x29, "AND")  // AND #$nn
+      .add<ZeroPage<And>>(0x25, "AND")  // AND $nn
+      .add<ZeroPageX<And>>(0x35, "AND")  // AND $nn,X
+      .add<Absolute<And>>(0x2D, "AND")  // AND $nnnn
+      .add<AbsoluteX<And>>(0x3D, "AND")  // AND $nnnn,X
+      .add<AbsoluteY<And>>(0x39, "AND")  // AND $nnnn,Y
+      .add<IndirectZeroPageX<And>>(0x21, "AND")  // AND ($nn,X)
+      .add<IndirectZeroPageY<And>>(0x31, "AND")  // AND ($nn),Y
+      .add<IndirectZeroPage<And>>(0x32, "AND")  // AND ($nn)
+
+      // CMP — Compare Accumulator
+      .add<Immediate<CMP>>(0xC9, "CMP")
+      .add<ZeroPage<CMP>>(0xC5, "CMP")
+      .add<ZeroPageX<CMP>>(0xD5, "CMP")
+      .add<Absolute<CMP>>(0xCD, "CMP")
+      .add<AbsoluteX<CMP>>(0xDD, "CMP")
+      .add<AbsoluteY<CMP>>(0xD9, "CMP")
+      .add<IndirectZeroPageX<CMP>>(0xC1, "CMP")
+      .add<IndirectZeroPageY<CMP>>(0xD1, "CMP")
+      .add<IndirectZeroPage<CMP>>(0xD2, "CMP")
+
+      // CPX — Compare X Register
+      .add<Immediate<CPX>>(0xE0, "CPX")
+      .add<ZeroPage<CPX>>(0xE4, "CPX")
+      .add<Absolute<CPX>>(0xEC, "CPX")
+
+      // CPY — Compare Y Register
+      .add<Immediate<CPY>>(0xC0, "CPY")
+      .add<ZeroPage<CPY>>(0xC4, "CPY")
+      .add<Absolute<CPY>>(0xCC, "CPY")
+
+      // EOR instructions - all addressing modes (exclusive OR)
+      .add<Immediate<Eor>>(0x49, "EOR")
+      .add<ZeroPage<Eor>>(0x45, "EOR")
+      .add<ZeroPageX<Eor>>(0x55, "EOR")
+      .add<Absolute<Eor>>(0x4D, "EOR")
+      .add<AbsoluteX<Eor>>(0x5D, "EOR")
+      .add<AbsoluteY<Eor>>(0x59, "EOR")
+      .add<IndirectZeroPageX<Eor>>(0x41, "EOR")
+      .add<IndirectZeroPageY<Eor>>(0x51, "EOR")
+      .add<IndirectZeroPage<Eor>>(0x52, "EOR")
+
+      // LDA instructions
+      .add<Immediate<LDA>>(0xA9, "LDA")
+      .add<ZeroPage<LDA>>(0xA5, "LDA")
+      .add<ZeroPageX<LDA>>(0xB5, "LDA")
+      .add<Absolute<LDA>>(0xAD, "LDA")
+      .add<AbsoluteX<LDA>>(0xBD, "LDA")
+      .add<AbsoluteY<LDA>>(0xB9, "LDA")
+      .add<IndirectZeroPageX<LDA>>(0xA1, "LDA")
+      .add<IndirectZeroPageY<LDA>>(0xB1, "LDA")
+      .add<IndirectZeroPage<LDA>>(0xB2, "LDA")
+
+      // LDX instructions
+      .add<Immediate<LDX>>(0xA2, "LDX")
+      .add<ZeroPage<LDX>>(0xA6, "LDX")
+      .add<ZeroPageY<LDX>>(0xB6, "LDX")
+      .add<Absolute<LDX>>(0xAE, "LDX")
+      .add<AbsoluteY<LDX>>(0xBE, "LDX")
+
+      // LDY instructions
+      .add<Immediate<LDY>>(0xA0, "LDY")
+      .add<ZeroPage<LDY>>(0xA4, "LDY")
+      .add<ZeroPageX<LDY>>(0xB4, "LDY")
+      .add<Absolute<LDY>>(0xAC, "LDY")
+      .add<AbsoluteX<LDY>>(0xBC, "LDY")
+
+      // STA variations
+      .add<ZeroPage<STA>>(0x85, "STA")
+      .add<ZeroPageX<STA>>(0x95, "STA")
+      .add<Absolute<STA>>(0x8D, "STA")
+      .add<AbsoluteX<STA>>(0x9D, "STA")
+      .add<AbsoluteY<STA>>(0x99, "STA")
+      .add<IndirectZeroPageX<STA>>(0x81, "STA")
+      .add<IndirectZeroPageY<STA>>(0x91, "STA")
+      .add<IndirectZeroPage<STA>>(0x92, "STA")
+
+      // STX variations
+      .add<ZeroPage<STX>>(0x86, "STX")
+      .add<ZeroPageY<STX>>(0x96, "STX")
+      .add<Absolute<STX>>(0x8E, "STX")
+
+      // STY variations
+      .add<ZeroPage<STY>>(0x84, "STY")
+      .add<ZeroPageX<STY>>(0x94, "STY")
+      .add<Absolute<STY>>(0x8C, "STY")
+
+      // STZ variations
+      .add<ZeroPage<StoreZero>>(0x64, "STZ")
+      .add<ZeroPageX<StoreZero>>(0x74, "STZ")
+      .add<Absolute<StoreZero>>(0x9C, "STZ")
+      .add<AbsoluteX<StoreZero>>(0x9E, "STZ")
+
+      // ORA variations
+      .add<Immediate<Ora>>(0x09, "ORA")
+      .add<Absolute<Ora>>(0x0D, "ORA")
+      .add<IndirectZeroPageX<Ora>>(0x01, "ORA")
+      .add<IndirectZeroPageY<Ora>>(0x11, "ORA")
+      .add<IndirectZeroPage<Ora>>(0x12, "ORA")
+      .add<ZeroPage<Ora>>(0x05, "ORA")
+      .add<ZeroPageX<Ora>>(0x15, "ORA")
+      .add<AbsoluteY<Ora>>(0x19, "ORA")
+      .add<AbsoluteX<Ora>>(0x1D, "ORA")
+
+      // ADC instructions
+      .add<Immediate<CmosAdd>>(0x69, "ADC")
+      .add<ZeroPage<CmosAdd>>(0x65, "ADC")
+      .add<ZeroPageX<CmosAdd>>(0x75, "ADC")
+      .add<Absolute<CmosAdd>>(0x6D, "ADC")
+      .add<AbsoluteX<CmosAdd>>(0x7D, "ADC")
+      .add<AbsoluteY<CmosAdd>>(0x79, "ADC")
+      .add<IndirectZeroPageX<CmosAdd>>(0x61, "ADC")
+      .add<IndirectZeroPageY<CmosAdd>>(0x71, "ADC")
+      .add<IndirectZeroPage<CmosAdd>>(0x72, "ADC")
+
+      // SBC instructions - all addressing modes
+      .add<Immediate<CmosSubtract>>(0xE9, "SBC")
+      .add<ZeroPage<CmosSubtract>>(0xE5, "SBC")
+      .add<ZeroPageX<CmosSubtract>>(0xF5, "SBC")
+      .add<Absolute<CmosSubtract>>(0xED, "SBC")
+      .add<AbsoluteX<CmosSubtract>>(0xFD, "SBC")
+      .add<AbsoluteY<CmosSubtract>>(0xF9, "SBC")
+      .add<IndirectZeroPageX<CmosSubtract>>(0xE1, "SBC")
+      .add<IndirectZeroPageY<CmosSubtract>>(0xF1, "SBC")
+      .add<IndirectZeroPage<CmosSubtract>>(0xF2, "SBC")
+
+      // Branch instructions
+      .add<Relative<BNE>>(0xD0, "BNE")
+      .add<Relative<BEQ>>(0xF0, "BEQ")
+      .add<Relative<BPL>>(0x10, "BPL")
+      .add<Relative<BMI>>(0x30, "BMI")
+      .add<Relative<BCC>>(0x90, "BCC")
+      .add<Relative<BCS>>(0xB0, "BCS")
+      .add<Relative<BVC>>(0x50, "BVC")
+      .add<Relative<BVS>>(0x70, "BVS")
+      .add<Relative<BranchAlways>>(0x80, "BRA")
+
+      .add<ZeroPage<CmosIncrementMemory>>(0xE6, "INC")  // INC $nn
+      .add<ZeroPageX<CmosIncrementMemory>>(0xF6, "INC")  // INC $nn,X
+      .add<Absolute<CmosIncrementMemory>>(0xEE, "INC")  // INC $nnnn
+      .add<AbsoluteX<CmosIncrementMemory>>(0xFE, "INC")  // INC $nnnn,X
+      .add<ZeroPage<CmosDecrementMemory>>(0xC6, "DEC")  // DEC $nn
+      .add<ZeroPageX<CmosDecrementMemory>>(0xD6, "DEC")  // DEC $nn,X
+      .add<Absolute<CmosDecrementMemory>>(0xCE, "DEC")  // DEC $nnnn
+      .add<AbsoluteX<CmosDecrementMemory>>(0xDE, "DEC")  // DEC $nnnn,X
+
+      .add<Immediate<BitImmediate>>(0x89, "BIT")
+      .add<ZeroPage<Bit>>(0x24, "BIT")
+      .add<ZeroPageX<Bit>>(0x34, "BIT")
+      .add<Absolute<Bit>>(0x2C, "BIT")
+      .add<AbsoluteX<Bit>>(0x3C, "BIT")
+
+      .add<ZeroPage<TSB>>(0x04, "TSB")
+      .add<Absolute<TSB>>(0x0C, "TSB")
+      .add<ZeroPage<TRB>>(0x14, "TRB")
+      .add<Absolute<TRB>>(0x1C, "TRB")
+
+      // JMP Absolute and JMP Indirect
+      .add<JumpAbsolute>(0x4C, "JMP")
+      .add<Absolute<CmosJumpIndirect<false>>>(0x6C, "JMP")
+      .add<Absolute<CmosJumpIndirect<true>>>(0x7C, "JMP")
+      .add<JumpSubroutine>(0x20, "JSR")  // Note: JSR uses absolute addressing for the target
+
+      // Opcodes the 65C02 does not define are NOPs. The ones listed here read operands; everything
+      // else is a one byte, one cycle NOP and keeps the default entry.
+      .add<Immediate<NOP>>(0x02, "NOP")
+      .add<Immediate<NOP>>(0x22, "NOP")
+      .add<Immediate<NOP>>(0x42, "NOP")
+      .add<Immediate<NOP>>(0x62, "NOP")
+      .add<Immediate<NOP>>(0x82, "NOP")
+      .add<Immediate<NOP>>(0xC2, "NOP")
+      .add<Immediate<NOP>>(0xE2, "NOP")
+      .add<ZeroPage<NOP>>(0x44, "NOP")
+      .add<ZeroPageX<NOP>>(0x54, "NOP")
+      .add<ZeroPageX<NOP>>(0xD4, "NOP")
+      .add<ZeroPageX<NOP>>(0xF4, "NOP")
+      .add<Absolute<WideNop>>(0x5C, "NOP")
+      .add<Absolute<NOP>>(0xDC, "NOP")
+      .add<Absolute<NOP>>(0xFC, "NOP")
+
+      //
+      ;
+  return table;
+}(/* immediate execution */);
+
+wdc65c02::Microcode wdc65c02::fetchNextOpcode(State& cpu, BusToken bus) noexcept
+{
+  if (cpu.pollInterrupts()) [[unlikely]]
+  {
+    // The opcode is read but not executed, and PC stays on it.
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<true>::interrupt;
+  }
+
+  auto opcode = bus.read(cpu.registers.pc++);
+  cpu.opcode = opcode;
+  return c_instructions[opcode].op;
+}
+
+namespace
+{
+
+// Built on first use, by the first snapshot.
+const MicrocodeTable& microcodeTable()
+{
+  static const MicrocodeTable table{&wdc65c02::fetchNextOpcode};
+  return table;
+}
+
+}  // namespace
+
+uint16_t wdc65c02::microcodeIndex(Microcode microcode) noexcept
+{
+  return microcodeTable().indexOf(microcode);
+}
+
+wdc65c02::Microcode wdc65c02::microcode(uint16_t index) noexcept
+{
+  return microcodeTable().at(index);
+}
+
+uint32_t wdc65c02::executeInstruction(State& cpu, Common::Bus& bus)
+{
+  if (cpu.pollInterrupts()) [[unlikely]]
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<true>::runInterrupt(cpu, bus);
+  }
+
+  auto opcode = bus.read(cpu.registers.pc++);
+  cpu.opcode = opcode;
+  const Instruction& instr = c_instructions[opcode];
+  if (instr.run == nullptr)
+  {
+    // Undefined opcode: a one cycle NOP.
+    return 1;
+  }
+  return instr.run(cpu, bus);
+}
+
+uint32_t wdc65c02::executeDecoded(State& cpu, Common::Bus& bus, const DecodedInstruction& instruction)
+{
+  if (cpu.pollInterrupts()) [[unlikely]]
+  {
+    [[maybe_unused]] auto data = bus.read(cpu.registers.pc);
+    cpu.opcode = 0x00;
+    return Break<true>::runInterrupt(cpu, bus);
+  }
+
+  // The opcode fetch; the block cache has read the opcode and the operands already.
+  ++cpu.registers.pc;
+  cpu.opcode = instruction.opcode;
+  if (instruction.runDecoded != nullptr)
+  {
+    return instruction.runDecoded(cpu, bus, instruction.lo, instruction.hi);
+  }
+  return instruction.run(cpu, bus);
+}
+
+const wdc65c02::Instruction& wdc65c02::instruction(Common::Byte opcode) noexcept
+{
+  return c_instructions[opcode];
+}
+
+void wdc65c02::disassemble(Address address, std::span<const Common::Byte, 3> bytes, FixedFormatter& formatter) noexcept
+{
+  cpu6502::disassemble(c_instructions, address, bytes, formatter);
+}
+
+void wdc65c02::disassemble(const Registers& cpu, std::span<const Common::Byte, 3> bytes, FixedFormatter& formatter) noexcept
+{
+  cpu6502::disassemble(c_instructions, cpu, bytes, formatter);
+}
+
+void wdc65c02::describe(Common::Byte opcode, FixedFormatter& formatter) noexcept
+{
+  cpu6502::describe(c_instructions, opcode, formatter);
+}
+
+}  // namespace cpu6502
@@ -0,0 +1,74 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/mos6502.h"
+#include "cpu6502/wdc65c02.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+//! Runs random bytes as a program, with interrupts now and then, and counts the microcode steps that
+//! have no index or do not come back from it.
+template<typename Processor>
+size_t unnumberedSteps()
+{
+  std::mt19937 random{6502};
+  std::vector<Byte> memory(0x10000);
+  std::ranges::generate(memory, [&random] { return static_cast<Byte>(random()); });
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+
+  Generic6502Definition cpu;
+  cpu.trapPolicy = Generic6502Definition::TrapPolicy::Ignore;
+  cpu.registers.pc = Address{0x0400};
+
+  size_t unnumbered = 0;
+  for (size_t instruction = 0; instruction < 200'000; ++instruction)
+  {
+    if (instruction % 997 == 0)
+    {
+      cpu.irq = (random() & 1) != 0;
+      cpu.nmi = (random() & 3) == 0;
+    }
+
+    auto next = Processor::fetchNextOpcode(cpu, Generic6502Definition::BusToken{&bus});
+    // A jammed processor never finishes its instruction.
+    for (size_t step = 0; next != nullptr && step < 16; ++step)
+    {
+      uint16_t index = Processor::microcodeIndex(next);
+      if (index == Generic6502Definition::c_unknownMicrocode || Processor::microcode(index) != next)
+      {
+        ++unnumbered;
+      }
+      next = next(cpu, Generic6502Definition::BusToken{&bus}).injection;
+    }
+  }
+  return unnumbered;
+}
+
+}  // namespace
+
+TEST_CASE("Every NMOS 6502 microcode step has an index", "[cpu6502][snapshot]")
+{
+  CHECK(unnumberedSteps<mos6502>() == 0);
+  CHECK(mos6502::microcode(Generic6502Definition::c_unknownMicrocode) == nullptr);
+}
+
+TEST_CASE("Every 65C02 microcode step has an index", "[cpu6502][snapshot]")
+{
+  CHECK(unnumberedSteps<wdc65c02>() == 0);
+  CHECK(wdc65c02::microcode(Generic6502Definition::c_unknownMicrocode) == nullptr);
+}
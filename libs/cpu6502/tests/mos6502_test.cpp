@@ -0,0 +1,245 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "cpu6502/mos6502.h"
+#include "run_instruction.h"
+
+using namespace InstructionTest;
+using cpu6502::mos6502;
+
+TEST_CASE("Undocumented NMOS opcodes take the cycles of their addressing mode", "[cpu6502][undocumented]")
+{
+  struct Timing
+  {
+    Byte opcode;
+    size_t cycles;
+  };
+
+  // Without page crossings. The pointers and addresses are all $0000.
+  const std::vector<Timing> timings{
+      // SLO, RLA, SRE, RRA, DCP, ISC: zp, zp,X, abs, abs,X, abs,Y, (zp,X), (zp),Y
+      {0x07, 5}, {0x17, 6}, {0x0F, 6}, {0x1F, 7}, {0x1B, 7}, {0x03, 8}, {0x13, 8},  //
+      {0x27, 5}, {0x37, 6}, {0x2F, 6}, {0x3F, 7}, {0x3B, 7}, {0x23, 8}, {0x33, 8},  //
+      {0x47, 5}, {0x57, 6}, {0x4F, 6}, {0x5F, 7}, {0x5B, 7}, {0x43, 8}, {0x53, 8},  //
+      {0x67, 5}, {0x77, 6}, {0x6F, 6}, {0x7F, 7}, {0x7B, 7}, {0x63, 8}, {0x73, 8},  //
+      {0xC7, 5}, {0xD7, 6}, {0xCF, 6}, {0xDF, 7}, {0xDB, 7}, {0xC3, 8}, {0xD3, 8},  //
+      {0xE7, 5}, {0xF7, 6}, {0xEF, 6}, {0xFF, 7}, {0xFB, 7}, {0xE3, 8}, {0xF3, 8},  //
+      // LAX: zp, zp,Y, abs, abs,Y, (zp,X), (zp),Y
+      {0xA7, 3}, {0xB7, 4}, {0xAF, 4}, {0xBF, 4}, {0xA3, 6}, {0xB3, 5},  //
+      // SAX: zp, zp,Y, abs, (zp,X)
+      {0x87, 3}, {0x97, 4}, {0x8F, 4}, {0x83, 6},  //
+      // LAS abs,Y
+      {0xBB, 4},  //
+      // ANC, ALR, ARR, SBX and SBC #
+      {0x0B, 2}, {0x2B, 2}, {0x4B, 2}, {0x6B, 2}, {0xCB, 2}, {0xEB, 2},  //
+      // NOP: implied, #, zp, zp,X, abs, abs,X
+      {0x1A, 2}, {0x3A, 2}, {0x5A, 2}, {0x7A, 2}, {0xDA, 2}, {0xFA, 2},  //
+      {0x80, 2}, {0x82, 2}, {0x89, 2}, {0xC2, 2}, {0xE2, 2},  //
+      {0x04, 3}, {0x44, 3}, {0x64, 3},  //
+      {0x14, 4}, {0x34, 4}, {0x54, 4}, {0x74, 4}, {0xD4, 4}, {0xF4, 4},  //
+      {0x0C, 4},  //
+      {0x1C, 4}, {0x3C, 4}, {0x5C, 4}, {0x7C, 4}, {0xDC, 4}, {0xFC, 4},
+  };
+
+  for (const Timing& timing : timings)
+  {
+    INFO("Opcode " << static_cast<int>(timing.opcode));
+    Result result = runInstruction<mos6502>(registers(0x00, 0x00, 0x00), {timing.opcode, 0x00, 0x00});
+    CHECK(result.cycles.size() == timing.cycles);
+  }
+}
+
+TEST_CASE("LAX (zp),Y loads A and X and takes a cycle for a page crossing", "[cpu6502][undocumented]")
+{
+  SECTION("In the page")
+  {
+    Result result = runInstruction<mos6502>(
+        registers(0x00, 0x00, 0x05), {0xB3, 0x10}, {{0x0010, 0x00}, {0x0011, 0x20}, {0x2005, 0x80}});
+    CHECK(result.registers.a == 0x80);
+    CHECK(result.registers.x == 0x80);
+    CHECK(result.registers.pc == Address{0x0402});
+    CHECK(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK(result.cycles == std::vector{read(0x0400, 0xB3), read(0x0401, 0x10), read(0x0010, 0x00),
+                               read(0x0011, 0x20), read(0x2005, 0x80)});
+  }
+
+  SECTION("Across a page")
+  {
+    Result result = runInstruction<mos6502>(
+        registers(0x55, 0x55, 0x20), {0xB3, 0x10}, {{0x0010, 0xF0}, {0x0011, 0x20}, {0x2110, 0x00}});
+    CHECK(result.registers.a == 0x00);
+    CHECK(result.registers.x == 0x00);
+    CHECK(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Negative));
+    // The first read is from the base page, before the carry reaches the high byte.
+    CHECK(result.cycles == std::vector{read(0x0400, 0xB3), read(0x0401, 0x10), read(0x0010, 0xF0),
+                               read(0x0011, 0x20), read(0x2010, 0x00), read(0x2110, 0x00)});
+  }
+}
+
+TEST_CASE("SBX subtracts from A AND X like CMP, never in decimal", "[cpu6502][undocumented]")
+{
+  SECTION("No borrow")
+  {
+    Result result = runInstruction<mos6502>(registers(0xF0, 0x3C, 0x00), {0xCB, 0x10});
+    CHECK(result.registers.x == 0x20);
+    CHECK(result.registers.a == 0xF0);
+    CHECK(result.has(Flag::Carry));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Negative));
+    CHECK(result.cycles.size() == 2);
+  }
+
+  SECTION("Equal")
+  {
+    Result result = runInstruction<mos6502>(registers(0xF0, 0x3C, 0x00), {0xCB, 0x30});
+    CHECK(result.registers.x == 0x00);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Zero));
+  }
+
+  SECTION("Borrow, whatever the carry was")
+  {
+    Result result = runInstruction<mos6502>(registers(0xF0, 0x3C, 0x00, flags(Flag::Carry)), {0xCB, 0x31});
+    CHECK(result.registers.x == 0xFF);
+    CHECK_FALSE(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Negative));
+  }
+
+  SECTION("Decimal mode")
+  {
+    Result result = runInstruction<mos6502>(registers(0xF0, 0x3C, 0x00, flags(Flag::Decimal)), {0xCB, 0x05});
+    CHECK(result.registers.x == 0x2B);
+    CHECK(result.has(Flag::Carry));
+  }
+}
+
+TEST_CASE("ARR takes C and V from the adder", "[cpu6502][undocumented]")
+{
+  SECTION("Binary, C from bit 6")
+  {
+    Result result = runInstruction<mos6502>(registers(0xFF, 0x00, 0x00, flags(Flag::Carry)), {0x6B, 0xFF});
+    CHECK(result.registers.a == 0xFF);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Overflow));
+  }
+
+  SECTION("Binary, V from bit 6 XOR bit 5")
+  {
+    Result result = runInstruction<mos6502>(registers(0xFF, 0x00, 0x00), {0x6B, 0x40});
+    CHECK(result.registers.a == 0x20);
+    CHECK_FALSE(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Overflow));
+  }
+
+  SECTION("Decimal, both digits corrected")
+  {
+    Result result = runInstruction<mos6502>(registers(0xFF, 0x00, 0x00, flags(Flag::Decimal)), {0x6B, 0xFF});
+    CHECK(result.registers.a == 0xD5);
+    CHECK(result.has(Flag::Carry));
+    CHECK_FALSE(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Overflow));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK(result.cycles.size() == 2);
+  }
+
+  SECTION("Decimal, N is the carry rotated in")
+  {
+    Result result =
+        runInstruction<mos6502>(registers(0xFF, 0x00, 0x00, flags(Flag::Decimal, Flag::Carry)), {0x6B, 0xFF});
+    CHECK(result.registers.a == 0x55);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Negative));
+  }
+
+  SECTION("Decimal, no correction")
+  {
+    Result result = runInstruction<mos6502>(registers(0xFF, 0x00, 0x00, flags(Flag::Decimal)), {0x6B, 0x40});
+    CHECK(result.registers.a == 0x20);
+    CHECK_FALSE(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Overflow));
+  }
+}
+
+TEST_CASE("RRA and ISC add and subtract in decimal mode", "[cpu6502][undocumented]")
+{
+  SECTION("RRA adds with the carry rotated out")
+  {
+    // ROR $03 with C set gives $81 and C set; 18 + 81 + 1 = 100.
+    Result result = runInstruction<mos6502>(
+        registers(0x18, 0x00, 0x00, flags(Flag::Decimal, Flag::Carry)), {0x67, 0x10}, {{0x0010, 0x03}});
+    CHECK(result.memory[0x0010] == 0x81);
+    CHECK(result.registers.a == 0x00);
+    CHECK(result.has(Flag::Carry));
+    // The NMOS 6502 takes N from the sum before the high digit is corrected, and Z from the binary sum.
+    CHECK(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Overflow));
+    CHECK(result.cycles == std::vector{read(0x0400, 0x67), read(0x0401, 0x10), read(0x0010, 0x03),
+                               write(0x0010, 0x03), write(0x0010, 0x81)});
+  }
+
+  SECTION("ISC subtracts the incremented value")
+  {
+    // INC $00 gives $01; 00 - 01 = 99 with a borrow.
+    Result result = runInstruction<mos6502>(
+        registers(0x00, 0x00, 0x00, flags(Flag::Decimal, Flag::Carry)), {0xE7, 0x10}, {{0x0010, 0x00}});
+    CHECK(result.memory[0x0010] == 0x01);
+    CHECK(result.registers.a == 0x99);
+    CHECK_FALSE(result.has(Flag::Carry));
+    // Flags as in binary, $00 - $01 = $FF.
+    CHECK(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Overflow));
+    CHECK(result.cycles == std::vector{read(0x0400, 0xE7), read(0x0401, 0x10), read(0x0010, 0x00),
+                               write(0x0010, 0x00), write(0x0010, 0x01)});
+  }
+}
+
+TEST_CASE("Undocumented read-modify-write opcodes write the old value back first", "[cpu6502][undocumented]")
+{
+  SECTION("DCP abs,X across a page")
+  {
+    Result result = runInstruction<mos6502>(registers(0x42, 0x02, 0x00), {0xDF, 0xFF, 0x20}, {{0x2101, 0x43}});
+    CHECK(result.memory[0x2101] == 0x42);
+    CHECK(result.has(Flag::Zero));
+    CHECK(result.has(Flag::Carry));
+    CHECK_FALSE(result.has(Flag::Negative));
+    CHECK(result.cycles == std::vector{read(0x0400, 0xDF), read(0x0401, 0xFF), read(0x0402, 0x20),
+                               read(0x2001, 0x00), read(0x2101, 0x43), write(0x2101, 0x43), write(0x2101, 0x42)});
+  }
+
+  SECTION("SLO (zp),Y in the page still takes 8 cycles")
+  {
+    Result result = runInstruction<mos6502>(
+        registers(0x10, 0x00, 0x05), {0x13, 0x10}, {{0x0010, 0x00}, {0x0011, 0x20}, {0x2005, 0x81}});
+    CHECK(result.memory[0x2005] == 0x02);
+    CHECK(result.registers.a == 0x12);
+    CHECK(result.has(Flag::Carry));
+    CHECK_FALSE(result.has(Flag::Negative));
+    CHECK(result.cycles == std::vector{read(0x0400, 0x13), read(0x0401, 0x10), read(0x0010, 0x00),
+                               read(0x0011, 0x20), read(0x2005, 0x81), read(0x2005, 0x81), write(0x2005, 0x81),
+                               write(0x2005, 0x02)});
+  }
+}
+
+TEST_CASE("SAX stores A AND X without changing the flags", "[cpu6502][undocumented]")
+{
+  Result result = runInstruction<mos6502>(registers(0xF0, 0x3C, 0x01, flags(Flag::Negative)), {0x97, 0x10});
+  CHECK(result.memory[0x0011] == 0x30);
+  CHECK(result.registers.p == flags(Flag::Negative));
+  CHECK(result.cycles ==
+        std::vector{read(0x0400, 0x97), read(0x0401, 0x10), read(0x0010, 0x00), write(0x0011, 0x30)});
+}
+
+TEST_CASE("NOP abs,X reads its operand and takes a cycle for a page crossing", "[cpu6502][undocumented]")
+{
+  Result result = runInstruction<mos6502>(registers(0x00, 0x01, 0x00), {0x1C, 0xFF, 0x20});
+  CHECK(result.registers.pc == Address{0x0403});
+  CHECK(result.cycles == std::vector{read(0x0400, 0x1C), read(0x0401, 0xFF), read(0x0402, 0x20),
+                             read(0x2000, 0x00), read(0x2100, 0x00)});
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <initializer_list>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "common/tracing_device.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/registers.h"
+
+namespace InstructionTest
+{
+
+using Common::Address;
+using Common::Byte;
+using Flag = cpu6502::Registers::Flag;
+
+//! Where runInstruction() puts the program.
+inline constexpr Address c_origin{0x0400};
+
+//! P with the unused bit and `flags` set.
+template<typename... Flags>
+constexpr Byte flags(Flags... flag) noexcept
+{
+  return static_cast<Byte>((static_cast<Byte>(Flag::Unused) | ... | static_cast<Byte>(flag)));
+}
+
+//! The registers at c_origin.
+inline cpu6502::Registers registers(Byte a, Byte x, Byte y, Byte p = flags()) noexcept
+{
+  return cpu6502::Registers{c_origin, a, x, y, 0xFD, p};
+}
+
+struct Result
+{
+  cpu6502::Registers registers;
+  std::vector<Byte> memory;
+  std::vector<Common::Bus::Cycle> cycles;  // Every bus access, one per cycle
+
+  bool has(Flag flag) const noexcept
+  {
+    return (registers.p & static_cast<Byte>(flag)) != 0;
+  }
+};
+
+//! Runs one instruction from `program` at c_origin, with `data` stored in otherwise empty memory.
+//! Both the microcode pump and executeInstruction() run it and have to agree about the registers,
+//! the memory and every bus cycle; the result is the pump's.
+template<typename Processor>
+Result runInstruction(const cpu6502::Registers& initial, std::initializer_list<Byte> program,
+    std::initializer_list<std::pair<uint16_t, Byte>> data = {})
+{
+  auto run = [&](bool microcode)
+  {
+    Result result{initial, std::vector<Byte>(0x10000), {}};
+    std::ranges::copy(program, result.memory.begin() + static_cast<uint16_t>(c_origin));
+    for (auto [address, value] : data)
+    {
+      result.memory[address] = value;
+    }
+
+    Common::MemoryDevice<Byte> ram{std::span<Byte>(result.memory)};
+    Common::TracingDevice tracer{ram};
+    Common::Bus bus{{Common::Bus::Entry{Address{0x0000}, Address{0xFFFF}, &tracer}}};
+
+    cpu6502::Generic6502Definition cpu{initial};
+    cpu.trapPolicy = cpu6502::Generic6502Definition::TrapPolicy::Ignore;
+    uint64_t cycles = 0;
+    if (microcode)
+    {
+      MicrocodePump<Processor> pump;
+      while (pump.tick(cpu, cpu6502::Generic6502Definition::BusToken{&bus}))
+      {
+        // Keep executing until the instruction is finished.
+      }
+      cycles = pump.cycles();
+    }
+    else
+    {
+      cycles = Processor::executeInstruction(cpu, bus);
+    }
+
+    result.registers = cpu.registers;
+    std::span<const Common::Bus::Cycle> traced = tracer.cycles();
+    result.cycles.assign(traced.begin(), traced.end());
+    CHECK(cycles == result.cycles.size());
+    return result;
+  };
+
+  Result pumped = run(true);
+  Result executed = run(false);
+  CHECK(executed.registers.pc == pumped.registers.pc);
+  CHECK(executed.registers.a == pumped.registers.a);
+  CHECK(executed.registers.x == pumped.registers.x);
+  CHECK(executed.registers.y == pumped.registers.y);
+  CHECK(executed.registers.sp == pumped.registers.sp);
+  CHECK(executed.registers.p == pumped.registers.p);
+  CHECK(executed.memory == pumped.memory);
+  CHECK(executed.cycles == pumped.cycles);
+  return pumped;
+}
+
+//! A read cycle, to compare with Result::cycles.
+inline Common::Bus::Cycle read(uint16_t address, Byte data) noexcept
+{
+  return {Address{address}, data, true};
+}
+
+//! A write cycle, to compare with Result::cycles.
+inline Common::Bus::Cycle write(uint16_t address, Byte data) noexcept
+{
+  return {Address{address}, data, false};
+}
+
+}  // namespace InstructionTest
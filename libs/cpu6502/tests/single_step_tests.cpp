@@ -1,14 +1,28 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <exception>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 
 #include "common/address.h"
 #include "common/bus.h"
 #include "common/logger.h"
 #include "common/memory.h"
 #include "common/microcode_pump.h"
+#include "common/tracing_device.h"
 #include "cpu6502/mos6502.h"
 #include "cpu6502/registers.h"
+#include "cpu6502/wdc65c02.h"
 #include "simdjson.h"
 #include "test_reporter.h"
 #include "test_run.h"
@@ -25,32 +39,150 @@ std::vector<Bus::Cycle> Copy(std::span<const Bus::Cycle> cycles)
   return std::vector<Bus::Cycle>(cycles.begin(), cycles.end());
 }
 
-int main(int argc, char* argv[])
+namespace
+{
+
+enum class Engine
+{
+  Microcode,
+  Instruction,
+};
+
+struct EngineResult
+{
+  Snapshot snapshot;
+  uint64_t cycles = 0;  // Cycle count reported by the engine
+};
+
+// Runs one instruction from the initial snapshot with the given engine.
+template<typename Processor>
+EngineResult runInstruction(Engine engine, const Snapshot& initial, FlatMemory& memory)
 {
-  if (argc < 2)
+  Generic6502Definition cpu_state(initial.regs);
+  // Self-branches are ordinary instructions in these tests.
+  cpu_state.trapPolicy = Generic6502Definition::TrapPolicy::Ignore;
+  memory.load(initial.memory);
+  TracingDevice tracer(memory);
+
+  Bus bus{{
+      Bus::Entry{Address{0x0000}, Address{0xFFFF}, &tracer},
+  }};
+
+  uint64_t cycles = 0;
+  if (engine == Engine::Microcode)
   {
-    std::cout << "Usage: " << argv[0] << " <testfile.json>" << std::endl;
-    return -1;
+    using BusToken = Generic6502Definition::BusToken;
+
+    MicrocodePump<Processor> pump;
+    while (pump.tick(cpu_state, BusToken{&bus}))
+    {
+      // Keep executing until the instruction is finished.
+    }
+    cycles = pump.cycles();
+  }
+  else
+  {
+    cycles = Processor::executeInstruction(cpu_state, bus);
   }
 
-  std::cout << "Using test file: " << argv[1] << std::endl;
+  return {Snapshot{cpu_state.registers, memory.locations(), Copy(tracer.cycles())}, cycles};
+}
 
-  // Logger::setLevel(LogLevel::Minimal);
+// Reports every difference between what the engine did and what the test expects.
+void reportFailure(TestReporting::TestReporter* reporter, Engine engine, const Snapshot& final,
+    const Snapshot& actual, uint64_t cycles)
+{
+  TestReporting::SectionScope engineScope(
+      reporter, engine == Engine::Microcode ? "Microcode engine" : "Instruction engine");
+  {
+    TestReporting::SectionScope registers(reporter, "Registers");
+    reporter->report("PC", final.regs.pc, actual.regs.pc);
+    reporter->report("A", final.regs.a, actual.regs.a);
+    reporter->report("X", final.regs.x, actual.regs.x);
+    reporter->report("Y", final.regs.y, actual.regs.y);
+    reporter->report("S", final.regs.sp, actual.regs.sp);
+  }
+  {
+    using OptionalByte = std::optional<Common::Byte>;
+    struct CombinedMemory
+    {
+      Common::Address address;
+      OptionalByte expected;
+      OptionalByte actual;
+    };
+    std::vector<CombinedMemory> unified;
+    unified.reserve(actual.memory.size() + final.memory.size());
+
+    std::ranges::transform(final.memory, std::back_inserter(unified),
+        [](const MemoryLocation& loc) { return CombinedMemory{loc.address, loc.value, std::nullopt}; });
+    for (const auto& loc : actual.memory)
+    {
+      auto it = std::ranges::find_if(unified, [addr = loc.address](const auto& m) { return m.address == addr; });
+      if (it == unified.end())
+      {
+        unified.emplace_back(loc.address, std::nullopt, loc.value);
+      }
+      else
+      {
+        it->actual = loc.value;
+      }
+    }
+    std::ranges::sort(unified, {}, &CombinedMemory::address);
 
-  // Disable trap handling for tests
-  cpu6502::mos6502::trapHandler = [](Address /*pc*/) { /* ignore traps */ };
+    TestReporting::SectionScope registers(reporter, "Memory");
+    for (const auto& mem : unified)
+    {
+      if (mem.expected != mem.actual)
+      {
+        std::string field = std::format("{:04X}", static_cast<uint16_t>(mem.address));
+        reporter->report(field, mem.expected.value_or(0), mem.actual.value_or(0));
+      }
+    }
+  }
+  {
+    TestReporting::SectionScope registers(reporter, "Cycles");
+    size_t minSize = std::min(actual.cycles.size(), final.cycles.size());
+    for (size_t i = 0; i < minSize; ++i)
+    {
+      const auto& expected = final.cycles[i];
+      if (expected != actual.cycles[i])
+      {
+        std::string field = std::format("Cycle {}", i);
+        if (expected.address != actual.cycles[i].address)
+          reporter->report(field + " Address", expected.address, actual.cycles[i].address);
+        reporter->report(field + " Data", expected.data, actual.cycles[i].data);
+        reporter->report(field + " Type", expected.isRead, actual.cycles[i].isRead);
+      }
+    }
+    if (actual.cycles.size() != final.cycles.size())
+    {
+      reporter->report("Cycle count", final.cycles.size(), actual.cycles.size());
+    }
+  }
+  if (cycles != final.cycles.size())
+  {
+    reporter->report("Engine cycle count", static_cast<uint64_t>(final.cycles.size()), cycles);
+  }
+}
 
-  auto reporter = TestReporting::createReporter(TestReporting::ReporterType::Minimal);
+struct SuiteResult
+{
+  int32_t tests = 0;
+  int32_t failures = 0;
+};
 
-  reporter->testSuiteStarted(argv[1]);
+// Runs every test in one JSON file. Each worker thread brings its own parser and memory, both are
+// reused from one test and one file to the next.
+SuiteResult runSuite(const std::filesystem::path& file, bool cmos, ondemand::parser& parser, FlatMemory& memory,
+    TestReporting::TestReporter* reporter)
+{
+  SuiteResult result;
+  reporter->testSuiteStarted(file.string());
 
-  ondemand::parser parser;
-  auto json = padded_string::load(argv[1]);
+  auto json = padded_string::load(file.string());
   // position a pointer at the beginning of the JSON data
   ondemand::document doc = parser.iterate(json);
 
-  [[maybe_unused]] int32_t testCount = 0;
-  int32_t failCount = 0;
   for (auto test : doc.get_array())
   {
     std::string_view name = test["name"].get_string().value();
@@ -60,111 +192,143 @@ int main(int argc, char* argv[])
     Snapshot initial = test["initial"].get<Snapshot>();
     Snapshot final = test["final"].get<Snapshot>();
 
-    MicrocodePump<mos6502> pump;
-    Generic6502Definition cpu_state(initial.regs);
-    SparseMemory memory(std::move(initial.memory));
-
-    Bus bus{{
-        Bus::Entry{Address{0x0000}, Address{0xFFFF}, &memory},
-    }};
-
     test["cycles"].get(final.cycles);
+    std::ranges::sort(final.memory, {}, &MemoryLocation::address);
 
-    using BusToken = Generic6502Definition::BusToken;
+    bool failed = false;
+    for (Engine engine : {Engine::Microcode, Engine::Instruction})
+    {
+      try
+      {
+        auto [actual, cycles] = cmos ? runInstruction<wdc65c02>(engine, initial, memory)
+                                     : runInstruction<mos6502>(engine, initial, memory);
+        if (actual == final && cycles == final.cycles.size())
+        {
+          continue;
+        }
+        reportFailure(reporter, engine, final, actual, cycles);
+      }
+      catch (const std::exception& e)
+      {
+        reporter->reportMismatch(engine == Engine::Microcode ? "Microcode engine" : "Instruction engine",
+            "no exception", e.what());
+      }
+      failed = true;
+    }
+
+    if (failed)
+    {
+      ++result.failures;
+    }
+    ++result.tests;
+    reporter->testCaseFinished();
+  }
 
-    // Set a breakpoint if necessary
-    // if (name != "01 a4 8f")
-    // {
-    //   std::cout << "Skipping " << name << "\n";
-    //   continue;
-    // }
+  reporter->testSuiteFinished();
+  return result;
+}
 
-    // LOG_INSTRUCTION_BYTES(cpu_state.registers, name);
+// The JSON files to run: `path` itself, or every .json file in the directory, in name order.
+std::vector<std::filesystem::path> findSuites(const std::filesystem::path& path)
+{
+  if (!std::filesystem::is_directory(path))
+  {
+    return {path};
+  }
 
-    while (pump.tick(cpu_state, BusToken{&bus}))
+  std::vector<std::filesystem::path> files;
+  for (const auto& entry : std::filesystem::directory_iterator(path))
+  {
+    if (entry.is_regular_file() && entry.path().extension() == ".json")
     {
-      // Keep executing until the instruction is finished.
+      files.push_back(entry.path());
     }
+  }
+  std::ranges::sort(files);
+  return files;
+}
 
-    std::ranges::sort(memory.mem, {}, &MemoryLocation::address);
-    std::ranges::sort(final.memory, {}, &MemoryLocation::address);
+}  // namespace
 
-    Snapshot actual{cpu_state.registers, memory.mem, Copy(bus.cycles())};
+int main(int argc, char* argv[])
+{
+  bool validProcessor =
+      argc < 3 || std::string_view(argv[2]) == "6502" || std::string_view(argv[2]) == "65c02";
+  if (argc < 2 || argc > 4 || !validProcessor)
+  {
+    std::cout << "Usage: " << argv[0] << " <testfile.json|directory> [6502|65c02] [threads]" << std::endl;
+    return -1;
+  }
 
-    if (actual != final)
-    {
-      {
-        TestReporting::SectionScope registers(reporter.get(), "Registers");
-        reporter->report("PC", final.regs.pc, actual.regs.pc);
-        reporter->report("A", final.regs.a, actual.regs.a);
-        reporter->report("X", final.regs.x, actual.regs.x);
-        reporter->report("Y", final.regs.y, actual.regs.y);
-        reporter->report("S", final.regs.sp, actual.regs.sp);
-      }
-      {
-        using OptionalByte = std::optional<Common::Byte>;
-        struct CombinedMemory
-        {
-          Common::Address address;
-          OptionalByte expected;
-          OptionalByte actual;
-        };
-        std::vector<CombinedMemory> unified;
-        unified.reserve(actual.memory.size() + final.memory.size());
-
-        std::ranges::transform(final.memory, std::back_inserter(unified),
-            [](const MemoryLocation& loc) { return CombinedMemory{loc.address, loc.value, std::nullopt}; });
-        for (const auto& loc : actual.memory)
-        {
-          auto it = std::ranges::find_if(unified, [addr = loc.address](const auto& m) { return m.address == addr; });
-          if (it == unified.end())
-          {
-            unified.emplace_back(loc.address, std::nullopt, loc.value);
-          }
-          else
-          {
-            it->actual = loc.value;
-          }
-        }
-        std::ranges::sort(unified, {}, &CombinedMemory::address);
+  // The 6502 and 65C02 vectors are separate suites, the second argument picks the processor.
+  bool cmos = argc > 2 && std::string_view(argv[2]) == "65c02";
 
-        TestReporting::SectionScope registers(reporter.get(), "Memory");
-        for (const auto& mem : unified)
-        {
-          if (mem.expected != mem.actual)
-          {
-            std::string field = std::format("{:04X}", static_cast<uint16_t>(mem.address));
-            reporter->report(field, mem.expected.value_or(0), mem.actual.value_or(0));
-          }
-        }
-      }
-      {
-        TestReporting::SectionScope registers(reporter.get(), "Cycles");
-        size_t minSize = std::min(actual.cycles.size(), final.cycles.size());
-        for (size_t i = 0; i < minSize; ++i)
+  std::vector<std::filesystem::path> files = findSuites(argv[1]);
+  size_t threads = argc > 3 ? std::stoul(argv[3]) : std::max(1u, std::thread::hardware_concurrency());
+  threads = std::clamp<size_t>(threads, 1, std::max<size_t>(files.size(), 1));
+
+  std::cout << "Running " << files.size() << " test files from " << argv[1] << " on " << threads << " threads"
+            << std::endl;
+
+  // Logger::setLevel(LogLevel::Minimal);
+
+  auto reporter = TestReporting::createReporter(TestReporting::ReporterType::Minimal);
+
+  // Workers take the next file and record what they report. The results are replayed into the
+  // reporter in file order as soon as each one is done, so the output is the same for any thread count.
+  struct Pending
+  {
+    TestReporting::RecordingReporter recording;
+    SuiteResult result;
+    bool done = false;
+  };
+  std::vector<Pending> pending(files.size());
+  std::mutex mutex;
+  std::condition_variable finished;
+  std::atomic<size_t> nextFile{0};
+
+  std::vector<std::jthread> workers;
+  for (size_t worker = 0; worker < threads; ++worker)
+  {
+    workers.emplace_back(
+        [&]
         {
-          const auto& expected = final.cycles[i];
-          if (expected != actual.cycles[i])
+          ondemand::parser parser;
+          auto memory = std::make_unique<FlatMemory>();
+          for (size_t index = nextFile++; index < files.size(); index = nextFile++)
           {
-            std::string field = std::format("Cycle {}", i);
-            if (expected.address != actual.cycles[i].address)
-              reporter->report(field + " Address", expected.address, actual.cycles[i].address);
-            reporter->report(field + " Data", expected.data, actual.cycles[i].data);
-            reporter->report(field + " Type", expected.isRead, actual.cycles[i].isRead);
+            Pending& suite = pending[index];
+            try
+            {
+              suite.result = runSuite(files[index], cmos, parser, *memory, &suite.recording);
+            }
+            catch (const std::exception& e)
+            {
+              suite.recording.reportMismatch(files[index].string(), "a readable test file", e.what());
+              ++suite.result.failures;
+            }
+
+            std::lock_guard lock{mutex};
+            suite.done = true;
+            finished.notify_all();
           }
-        }
-        if (actual.cycles.size() != final.cycles.size())
-        {
-          reporter->report("Cycle count", final.cycles.size(), actual.cycles.size());
-        }
-      }
-      ++failCount;
+        });
+  }
+
+  int32_t testCount = 0;
+  int32_t failCount = 0;
+  for (auto& suite : pending)
+  {
+    {
+      std::unique_lock lock{mutex};
+      finished.wait(lock, [&suite] { return suite.done; });
     }
-    ++testCount;
-    reporter->testCaseFinished();
+    suite.recording.replay(*reporter);
+    suite.recording = {};
+    testCount += suite.result.tests;
+    failCount += suite.result.failures;
   }
 
-  reporter->testSuiteFinished();
   std::cout << "Completed " << testCount << " tests with " << failCount << " failures.\n";
 
   return failCount;
@@ -419,6 +419,74 @@ void JsonReporter::ensureSectionStarted()
 // Factory Function
 //////////////////////////////////////////////////////////////////////////////
 
+//////////////////////////////////////////////////////////////////////////////
+// RecordingReporter Implementation
+//////////////////////////////////////////////////////////////////////////////
+
+void RecordingReporter::testSuiteStarted(const std::string& suite_name)
+{
+  events.push_back({Call::SuiteStarted, suite_name, {}, {}});
+}
+
+void RecordingReporter::testSuiteFinished()
+{
+  events.push_back({Call::SuiteFinished, {}, {}, {}});
+}
+
+void RecordingReporter::testCaseStarted(const std::string& test_name)
+{
+  events.push_back({Call::CaseStarted, test_name, {}, {}});
+}
+
+void RecordingReporter::testCaseFinished()
+{
+  events.push_back({Call::CaseFinished, {}, {}, {}});
+}
+
+void RecordingReporter::sectionStarted(const std::string& section_name)
+{
+  events.push_back({Call::SectionStarted, section_name, {}, {}});
+}
+
+void RecordingReporter::sectionFinished()
+{
+  events.push_back({Call::SectionFinished, {}, {}, {}});
+}
+
+void RecordingReporter::reportMatch(const std::string& field, const std::string& value)
+{
+  events.push_back({Call::Match, field, value, {}});
+}
+
+void RecordingReporter::reportMismatch(const std::string& field, const std::string& expected, const std::string& actual)
+{
+  events.push_back({Call::Mismatch, field, expected, actual});
+}
+
+void RecordingReporter::reportSummary(int total_tests, int passed_tests, int failed_tests)
+{
+  events.push_back({Call::Summary, {}, {}, {}, {total_tests, passed_tests, failed_tests}});
+}
+
+void RecordingReporter::replay(TestReporter& reporter) const
+{
+  for (const auto& event : events)
+  {
+    switch (event.call)
+    {
+      case Call::SuiteStarted: reporter.testSuiteStarted(event.field); break;
+      case Call::SuiteFinished: reporter.testSuiteFinished(); break;
+      case Call::CaseStarted: reporter.testCaseStarted(event.field); break;
+      case Call::CaseFinished: reporter.testCaseFinished(); break;
+      case Call::SectionStarted: reporter.sectionStarted(event.field); break;
+      case Call::SectionFinished: reporter.sectionFinished(); break;
+      case Call::Match: reporter.reportMatch(event.field, event.expected); break;
+      case Call::Mismatch: reporter.reportMismatch(event.field, event.expected, event.actual); break;
+      case Call::Summary: reporter.reportSummary(event.counts[0], event.counts[1], event.counts[2]); break;
+    }
+  }
+}
+
 std::unique_ptr<TestReporter> createReporter(ReporterType type, bool enable_colors, const std::string& output_file)
 {
   switch (type)
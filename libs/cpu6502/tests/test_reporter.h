@@ -1,8 +1,10 @@
 #pragma once
 
+#include <array>
 #include <fstream>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "common/address.h"
 #include "test_run.h"
@@ -166,6 +168,52 @@ private:
   void ensureSectionStarted();
 };
 
+// Recording reporter - keeps the calls so another reporter can be given them later. Workers running
+// suites on their own threads each record into one, and the results are replayed in suite order.
+class RecordingReporter : public TestReporter
+{
+private:
+  enum class Call
+  {
+    SuiteStarted,
+    SuiteFinished,
+    CaseStarted,
+    CaseFinished,
+    SectionStarted,
+    SectionFinished,
+    Match,
+    Mismatch,
+    Summary,
+  };
+
+  struct Event
+  {
+    Call call;
+    std::string field;
+    std::string expected;
+    std::string actual;
+    std::array<int, 3> counts{};
+  };
+
+  std::vector<Event> events;
+
+public:
+  void testSuiteStarted(const std::string& suite_name) override;
+  void testSuiteFinished() override;
+  void testCaseStarted(const std::string& test_name) override;
+  void testCaseFinished() override;
+
+  void sectionStarted(const std::string& section_name) override;
+  void sectionFinished() override;
+
+  void reportMatch(const std::string& field, const std::string& value) override;
+  void reportMismatch(const std::string& field, const std::string& expected, const std::string& actual) override;
+  void reportSummary(int total_tests, int passed_tests, int failed_tests) override;
+
+  // Makes the recorded calls on `reporter`, in order
+  void replay(TestReporter& reporter) const;
+};
+
 // Factory function to create reporters
 enum class ReporterType
 {
@@ -1,28 +1,61 @@
 #include "test_run.h"
 
+#include <algorithm>
 #include <ranges>
+#include <stdexcept>
+#include <string>
 
 #include "simdjson.h"
 
-Common::Byte SparseMemory::read(Common::Address address, Common::Address /*normalizedAddress*/) const
+void FlatMemory::load(std::span<const MemoryLocation> locations)
 {
-  auto it = std::ranges::find_if(mem, [=](const auto& pair) { return pair.address == address; });
-  if (it == mem.end())
+  for (auto address : m_addresses)
+  {
+    m_touched[static_cast<uint16_t>(address)] = false;
+  }
+  m_addresses.clear();
+
+  for (const auto& location : locations)
+  {
+    touch(location.address);
+    m_bytes[static_cast<uint16_t>(location.address)] = location.value;
+  }
+}
+
+std::vector<MemoryLocation> FlatMemory::locations() const
+{
+  std::vector<MemoryLocation> locations;
+  locations.reserve(m_addresses.size());
+  for (auto address : m_addresses)
+  {
+    locations.push_back(MemoryLocation{address, m_bytes[static_cast<uint16_t>(address)]});
+  }
+  std::ranges::sort(locations, {}, &MemoryLocation::address);
+  return locations;
+}
+
+Common::Byte FlatMemory::read(Common::Address address, Common::Address /*normalizedAddress*/) const
+{
+  if (!m_touched[static_cast<uint16_t>(address)])
   {
     throw std::runtime_error("Memory read of uninitialized address " + std::to_string(static_cast<uint16_t>(address)));
   }
-  return it->value;
+  return m_bytes[static_cast<uint16_t>(address)];
+}
+
+void FlatMemory::write(Common::Address address, Common::Address /*normalizedAddress*/, Common::Byte data)
+{
+  touch(address);
+  m_bytes[static_cast<uint16_t>(address)] = data;
 }
 
-void SparseMemory::write(Common::Address address, Common::Address /*normalizedAddress*/, Common::Byte data)
+void FlatMemory::touch(Common::Address address)
 {
-  // Write
-  auto it = std::ranges::find_if(mem, [=](const auto& pair) { return pair.address == address; });
-  if (it == mem.end())
+  if (!m_touched[static_cast<uint16_t>(address)])
   {
-    mem.emplace_back(address, data);
+    m_touched[static_cast<uint16_t>(address)] = true;
+    m_addresses.push_back(address);
   }
-  it->value = data;
 }
 
 void reportError(std::string_view name, const Snapshot& expected, const Snapshot& actual)
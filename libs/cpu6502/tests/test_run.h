@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
+#include <span>
 #include <vector>
 
 #include "common/address.h"
@@ -37,18 +39,27 @@ struct Snapshot
   }
 };
 
-//! Wrapper around a vector of MemoryLocations to provide tick() method for memory operations
-struct SparseMemory : public Common::Bus::Device
+//! Flat 64K memory for running one test after another. Only the addresses a test loads or writes are
+//! remembered, so moving on to the next test costs as much as the test's own locations, not 64K.
+class FlatMemory : public Common::Bus::Device
 {
-  std::vector<MemoryLocation> mem;
+public:
+  //! Forgets the previous test and loads `locations`.
+  void load(std::span<const MemoryLocation> locations);
 
-  SparseMemory(std::vector<MemoryLocation>&& incoming)
-    : mem(std::move(incoming))
-  {
-  }
+  //! Every address loaded or written since load(), in ascending order, with its value.
+  std::vector<MemoryLocation> locations() const;
 
+  //! Throws std::runtime_error for addresses the test did not load or write.
   Common::Byte read(Common::Address address, Common::Address normalizedAddress) const override;
   void write(Common::Address address, Common::Address normalizedAddress, Common::Byte data) override;
+
+private:
+  void touch(Common::Address address);
+
+  std::array<Common::Byte, 0x10000> m_bytes{};
+  std::array<bool, 0x10000> m_touched{};
+  std::vector<Common::Address> m_addresses;  // The touched addresses, in the order they were touched
 };
 
 void reportError(std::string_view name, const Snapshot& expected, const Snapshot& actual);
@@ -0,0 +1,197 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu6502/mos6502.h"
+#include "cpu6502/wdc65c02.h"
+#include "run_instruction.h"
+
+using namespace InstructionTest;
+using cpu6502::mos6502;
+using cpu6502::wdc65c02;
+
+TEST_CASE("BRA takes a cycle for the branch and one for a page crossing", "[cpu6502][65c02]")
+{
+  SECTION("In the page")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x00, 0x00, 0x00), {0x80, 0x05});
+    CHECK(result.registers.pc == Address{0x0407});
+    CHECK(result.cycles.size() == 3);
+  }
+
+  SECTION("Across a page")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x00, 0x00, 0x00, flags(Flag::Zero)), {0x80, 0x80});
+    CHECK(result.registers.pc == Address{0x0382});
+    CHECK(result.registers.p == flags(Flag::Zero));
+    CHECK(result.cycles.size() == 4);
+  }
+}
+
+TEST_CASE("JMP ($xxFF) takes the high byte from the next page", "[cpu6502][65c02]")
+{
+  Result result = runInstruction<wdc65c02>(
+      registers(0x00, 0x00, 0x00), {0x6C, 0xFF, 0x10}, {{0x10FF, 0x34}, {0x1100, 0x12}, {0x1000, 0x56}});
+  CHECK(result.registers.pc == Address{0x1234});
+  CHECK(result.cycles.size() == 6);
+
+  // The NMOS 6502 wraps within the page, a cycle sooner.
+  Result nmos = runInstruction<mos6502>(
+      registers(0x00, 0x00, 0x00), {0x6C, 0xFF, 0x10}, {{0x10FF, 0x34}, {0x1100, 0x12}, {0x1000, 0x56}});
+  CHECK(nmos.registers.pc == Address{0x5634});
+  CHECK(nmos.cycles.size() == 5);
+}
+
+TEST_CASE("TSB and TRB set Z from A AND M and leave N and V alone", "[cpu6502][65c02]")
+{
+  SECTION("TSB zp, no bits in common")
+  {
+    Result result = runInstruction<wdc65c02>(
+        registers(0x0F, 0x00, 0x00, flags(Flag::Negative, Flag::Overflow)), {0x04, 0x10}, {{0x0010, 0xF0}});
+    CHECK(result.memory[0x0010] == 0xFF);
+    CHECK(result.registers.p == flags(Flag::Negative, Flag::Overflow, Flag::Zero));
+    // The 65C02 reads the operand again where the NMOS 6502 writes it back.
+    CHECK(result.cycles == std::vector{read(0x0400, 0x04), read(0x0401, 0x10), read(0x0010, 0xF0),
+                               read(0x0010, 0xF0), write(0x0010, 0xFF)});
+  }
+
+  SECTION("TSB abs, bits in common")
+  {
+    Result result =
+        runInstruction<wdc65c02>(registers(0x0F, 0x00, 0x00, flags(Flag::Zero)), {0x0C, 0x00, 0x20}, {{0x2000, 0x01}});
+    CHECK(result.memory[0x2000] == 0x0F);
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK(result.cycles.size() == 6);
+  }
+
+  SECTION("TRB zp, bits in common")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x0F, 0x00, 0x00), {0x14, 0x10}, {{0x0010, 0xFF}});
+    CHECK(result.memory[0x0010] == 0xF0);
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK(result.cycles.size() == 5);
+  }
+
+  SECTION("TRB abs, no bits in common")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x0F, 0x00, 0x00), {0x1C, 0x00, 0x20}, {{0x2000, 0xF0}});
+    CHECK(result.memory[0x2000] == 0xF0);
+    CHECK(result.has(Flag::Zero));
+    CHECK(result.cycles.size() == 6);
+  }
+}
+
+TEST_CASE("STZ stores zero in every addressing mode", "[cpu6502][65c02]")
+{
+  struct Case
+  {
+    const char* mode;
+    std::vector<Byte> program;
+    uint16_t address;
+    size_t cycles;
+  };
+
+  const std::vector<Case> cases{
+      {"zp", {0x64, 0x10}, 0x0010, 3},
+      {"zp,X", {0x74, 0x10}, 0x0012, 4},
+      {"abs", {0x9C, 0x00, 0x20}, 0x2000, 4},
+      {"abs,X", {0x9E, 0x00, 0x20}, 0x2002, 5},
+      {"abs,X across a page", {0x9E, 0xFF, 0x20}, 0x2101, 5},
+  };
+
+  for (const Case& stz : cases)
+  {
+    INFO("STZ " << stz.mode);
+    Byte third = stz.program.size() > 2 ? stz.program[2] : 0x00;
+    Result result = runInstruction<wdc65c02>(registers(0xFF, 0x02, 0x00, flags(Flag::Negative)),
+        {stz.program[0], stz.program[1], third}, {{stz.address, 0xFF}});
+    CHECK(result.memory[stz.address] == 0x00);
+    CHECK(result.registers.p == flags(Flag::Negative));
+    CHECK(result.cycles.size() == stz.cycles);
+    CHECK(result.cycles.back() == write(stz.address, 0x00));
+  }
+}
+
+TEST_CASE("Decimal ADC and SBC set N and Z from the result and take a cycle more", "[cpu6502][65c02]")
+{
+  SECTION("ADC carries into a zero")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x99, 0x00, 0x00, flags(Flag::Decimal)), {0x69, 0x01});
+    CHECK(result.registers.a == 0x00);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Negative));
+    CHECK(result.cycles == std::vector{read(0x0400, 0x69), read(0x0401, 0x01), read(0x0402, 0x00)});
+  }
+
+  SECTION("ADC into the high digits")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x79, 0x00, 0x00, flags(Flag::Decimal)), {0x69, 0x01});
+    CHECK(result.registers.a == 0x80);
+    CHECK(result.has(Flag::Negative));
+    CHECK(result.has(Flag::Overflow));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Carry));
+  }
+
+  SECTION("SBC borrows")
+  {
+    Result result =
+        runInstruction<wdc65c02>(registers(0x00, 0x00, 0x00, flags(Flag::Decimal, Flag::Carry)), {0xE9, 0x01});
+    CHECK(result.registers.a == 0x99);
+    CHECK_FALSE(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Negative));
+    CHECK_FALSE(result.has(Flag::Zero));
+    CHECK(result.cycles.size() == 3);
+  }
+
+  SECTION("SBC to zero")
+  {
+    Result result =
+        runInstruction<wdc65c02>(registers(0x42, 0x00, 0x00, flags(Flag::Decimal, Flag::Carry)), {0xE9, 0x42});
+    CHECK(result.registers.a == 0x00);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.has(Flag::Zero));
+    CHECK_FALSE(result.has(Flag::Negative));
+  }
+
+  SECTION("Binary mode takes no extra cycle")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x99, 0x00, 0x00), {0x69, 0x01});
+    CHECK(result.registers.a == 0x9A);
+    CHECK(result.cycles.size() == 2);
+  }
+}
+
+TEST_CASE("Shifts abs,X only take the index cycle across a page", "[cpu6502][65c02]")
+{
+  SECTION("ASL abs,X in the page")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x00, 0x01, 0x00), {0x1E, 0x00, 0x20}, {{0x2001, 0x81}});
+    CHECK(result.memory[0x2001] == 0x02);
+    CHECK(result.has(Flag::Carry));
+    CHECK(result.cycles.size() == 6);
+
+    // The NMOS 6502 always takes it.
+    Result nmos = runInstruction<mos6502>(registers(0x00, 0x01, 0x00), {0x1E, 0x00, 0x20}, {{0x2001, 0x81}});
+    CHECK(nmos.memory[0x2001] == 0x02);
+    CHECK(nmos.cycles.size() == 7);
+  }
+
+  SECTION("ASL abs,X across a page")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x00, 0x02, 0x00), {0x1E, 0xFF, 0x20}, {{0x2101, 0x81}});
+    CHECK(result.memory[0x2101] == 0x02);
+    CHECK(result.cycles.size() == 7);
+  }
+
+  SECTION("INC abs,X in the page still takes it")
+  {
+    Result result = runInstruction<wdc65c02>(registers(0x00, 0x01, 0x00), {0xFE, 0x00, 0x20}, {{0x2001, 0x7F}});
+    CHECK(result.memory[0x2001] == 0x80);
+    CHECK(result.has(Flag::Negative));
+    CHECK(result.cycles.size() == 7);
+  }
+}
@@ -0,0 +1,94 @@
+// Compares two binary traces written by cpu6502::BinaryTraceWriter and reports the first step at which
+// they differ. Both traces are streamed, so they can be any length.
+//
+//   traceDiff expected.trace actual.trace
+//
+// Exits with 0 if the traces are the same, 1 if they differ and 2 if either cannot be read.
+
+#include <array>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string_view>
+
+#include "common/bus.h"
+#include "common/fixed_formatter.h"
+#include "cpu6502/binary_trace.h"
+#include "cpu6502/registers.h"
+
+namespace
+{
+
+void printStep(std::string_view label, const std::optional<cpu6502::TraceStep>& step,
+    std::span<const Common::Bus::Cycle> busCycles = {})
+{
+  std::cout << label;
+  if (!step)
+  {
+    std::cout << "end of trace\n";
+    return;
+  }
+
+  std::array<char, 128> buffer{};
+  Common::FixedFormatter formatter{buffer};
+  const auto& cpu = step->registers;
+  formatter << "PC:" << cpu.pc << " A:" << cpu.a << " X:" << cpu.x << " Y:" << cpu.y << " SP:" << cpu.sp
+            << " P:" << cpu.p << ' ';
+  cpu6502::flagsToStr(formatter, cpu.p);
+  std::cout << formatter.finalize() << " @" << step->cycle << '\n';
+
+  for (const auto& cycle : busCycles)
+  {
+    std::array<char, 16> text{};
+    Common::FixedFormatter cycleFormatter{text};
+    cycleFormatter << (cycle.isRead ? "  R " : "  W ") << cycle.address << '=' << cycle.data;
+    std::cout << "           " << cycleFormatter.finalize() << '\n';
+  }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[])
+{
+  if (argc != 3)
+  {
+    std::cerr << "Usage: " << argv[0] << " expected.trace actual.trace\n";
+    return 2;
+  }
+
+  try
+  {
+    std::ifstream expectedFile(argv[1], std::ios::binary);
+    std::ifstream actualFile(argv[2], std::ios::binary);
+    if (!expectedFile || !actualFile)
+    {
+      std::cerr << "Cannot open " << (expectedFile ? argv[2] : argv[1]) << '\n';
+      return 2;
+    }
+
+    cpu6502::BinaryTraceReader expected{expectedFile};
+    cpu6502::BinaryTraceReader actual{actualFile};
+    auto divergence = cpu6502::findDivergence(expected, actual);
+    if (!divergence)
+    {
+      std::cout << "Traces are the same\n";
+      return 0;
+    }
+
+    std::cout << "Traces differ at step " << divergence->step << '\n';
+    if (divergence->lastMatch)
+    {
+      printStep("  last match: ", divergence->lastMatch);
+    }
+    printStep("  expected:   ", divergence->expected, divergence->expectedBusCycles);
+    printStep("  actual:     ", divergence->actual, divergence->actualBusCycles);
+    return 1;
+  }
+  catch (const std::exception& e)
+  {
+    std::cerr << "Error: " << e.what() << '\n';
+    return 2;
+  }
+}
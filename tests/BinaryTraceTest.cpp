@@ -0,0 +1,156 @@
+// Records binary traces of a small program with MicrocodePump and compares them.
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "common/tracing_device.h"
+#include "cpu6502/binary_trace.h"
+#include "cpu6502/mos6502.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+constexpr Address c_start{0x0400};
+
+// Counts X down from 5, storing each value into $10,X, then counts up on $20 forever.
+constexpr std::array<Byte, 13> c_program{
+    0xA2, 0x05,  // 0400 LDX #$05
+    0x8A,  // 0402 TXA
+    0x95, 0x10,  // 0403 STA $10,X
+    0xCA,  // 0405 DEX
+    0xD0, 0xFA,  // 0406 BNE $0402
+    0xE6, 0x20,  // 0408 INC $20
+    0x4C, 0x08, 0x04,  // 040A JMP $0408
+};
+
+//! Runs `program` for `cycles` with a recorder attached and returns the trace.
+std::string record(const std::array<Byte, 13>& program, uint64_t cycles, bool busCycles)
+{
+  std::vector<Byte> memory(0x10000);
+  std::ranges::copy(program, memory.begin() + static_cast<uint16_t>(c_start));
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  TracingDevice tracer{ram};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &tracer}}};
+
+  std::ostringstream out;
+  {
+    BinaryTraceWriter writer{out, busCycles};
+    MicrocodePump<mos6502> pump;
+    Generic6502Definition cpu;
+    cpu.registers.pc = c_start;
+    pump.runFor(cpu, Generic6502Definition::BusToken{&bus}, cycles,
+        BinaryTraceRecorder{&writer, busCycles ? &tracer : nullptr});
+  }
+  return out.str();
+}
+
+}  // namespace
+
+TEST_CASE("Binary trace reads back what was recorded", "[binary_trace]")
+{
+  std::string trace = record(c_program, 200, true);
+  std::istringstream in{trace};
+  BinaryTraceReader reader{in};
+  CHECK(reader.hasBusCycles());
+
+  auto first = reader.next();
+  REQUIRE(first.has_value());
+  CHECK(first->cycle == 0);
+  CHECK(first->registers.pc == c_start);
+
+  // TXA after LDX #$05: the LDX's two reads come with it.
+  auto second = reader.next();
+  REQUIRE(second.has_value());
+  CHECK(second->cycle == 2);
+  CHECK(second->registers.pc == Address{0x0402});
+  CHECK(second->registers.x == 5);
+  REQUIRE(second->busCycles.size() == 2);
+  CHECK(second->busCycles[1] == Bus::Cycle{Address{0x0401}, 0x05, true});
+
+  size_t steps = 2;
+  while (auto step = reader.next())
+  {
+    ++steps;
+  }
+  CHECK(steps > 30);
+
+  // Two to four bytes per step, most of it bus cycles.
+  CHECK(trace.size() < steps * 16);
+  CHECK(record(c_program, 200, false).size() < steps * 4);
+}
+
+TEST_CASE("Binary trace diff finds the first divergence", "[binary_trace]")
+{
+  std::string expectedTrace = record(c_program, 200, true);
+  {
+    std::istringstream expectedIn{expectedTrace};
+    std::istringstream actualIn{expectedTrace};
+    BinaryTraceReader expected{expectedIn};
+    BinaryTraceReader actual{actualIn};
+    CHECK_FALSE(findDivergence(expected, actual).has_value());
+  }
+
+  // Start the count at 4: the LDX is the last step that matches.
+  auto changed = c_program;
+  changed[1] = 0x04;
+  std::string actualTrace = record(changed, 200, true);
+  {
+    std::istringstream expectedIn{expectedTrace};
+    std::istringstream actualIn{actualTrace};
+    BinaryTraceReader expected{expectedIn};
+    BinaryTraceReader actual{actualIn};
+    auto divergence = findDivergence(expected, actual);
+    REQUIRE(divergence.has_value());
+    CHECK(divergence->step == 1);
+    REQUIRE(divergence->lastMatch.has_value());
+    CHECK(divergence->lastMatch->registers.pc == c_start);
+    CHECK(divergence->expected->registers.x == 5);
+    CHECK(divergence->actual->registers.x == 4);
+    CHECK(divergence->actualBusCycles.size() == 2);
+  }
+
+  // A trace that stops early diverges where it ends.
+  std::string shortTrace = record(c_program, 100, false);
+  {
+    std::istringstream expectedIn{expectedTrace};
+    std::istringstream actualIn{shortTrace};
+    BinaryTraceReader expected{expectedIn};
+    BinaryTraceReader actual{actualIn};
+    auto divergence = findDivergence(expected, actual);
+    REQUIRE(divergence.has_value());
+    CHECK(divergence->expected.has_value());
+    CHECK_FALSE(divergence->actual.has_value());
+  }
+}
+
+TEST_CASE("Binary trace reader rejects other files", "[binary_trace]")
+{
+  std::istringstream text{"not a trace"};
+  CHECK_THROWS_AS(BinaryTraceReader{text}, std::runtime_error);
+
+  std::string trace = record(c_program, 200, true);
+  std::istringstream cut{trace.substr(0, trace.size() - 1)};
+  BinaryTraceReader reader{cut};
+  CHECK_THROWS_AS(
+      [&reader]
+      {
+        while (reader.next())
+        {
+        }
+      }(),
+      std::runtime_error);
+}
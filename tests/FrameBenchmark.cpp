@@ -0,0 +1,96 @@
+// Compares per-cycle ticking with batched execution in 17,030-cycle frames (one NTSC Apple II video
+// frame) on the Klaus Dormann functional test image.
+// Credit: Klaus Dormann — https://github.com/Klaus2m5/6502_65C02_functional_tests
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "cpu6502/mos6502.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+constexpr Address c_start{0x0400};
+constexpr uint64_t c_frameCycles = 17'030;
+constexpr int c_frames = 60;
+
+}  // namespace
+
+TEST_CASE("Frame batching benchmark", "[.][benchmark][klaus]")
+{
+  const std::vector<Byte> image = LoadFile(KLAUS_FUNCTIONAL_TEST_BIN);
+  if (image.empty())
+  {
+    SKIP("Klaus functional test image not found: " KLAUS_FUNCTIONAL_TEST_BIN);
+  }
+
+  std::vector<Byte> memory(0x10000);
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+
+  using BusToken = Generic6502Definition::BusToken;
+
+  auto reset = [&]()
+  {
+    auto count = static_cast<std::ptrdiff_t>(std::min(image.size(), memory.size()));
+    std::copy_n(image.begin(), count, memory.begin());
+    Generic6502Definition cpu;
+    cpu.registers.pc = c_start;
+    // The benchmark only measures throughput, a failing test just spins on its trap.
+    cpu.trapPolicy = Generic6502Definition::TrapPolicy::Ignore;
+    return cpu;
+  };
+
+  BENCHMARK("tick() per cycle, 60 frames")
+  {
+    auto cpu = reset();
+    MicrocodePump<mos6502> pump;
+    for (int frame = 0; frame < c_frames; ++frame)
+    {
+      for (uint64_t cycle = 0; cycle < c_frameCycles; ++cycle)
+      {
+        pump.tick(cpu, BusToken{&bus});
+      }
+    }
+    return pump.cycles();
+  };
+
+  BENCHMARK("runFor() per frame, 60 frames")
+  {
+    auto cpu = reset();
+    MicrocodePump<mos6502> pump;
+    for (int frame = 0; frame < c_frames; ++frame)
+    {
+      pump.runFor(cpu, BusToken{&bus}, c_frameCycles);
+    }
+    return pump.cycles();
+  };
+
+  BENCHMARK("instruction engine per frame, 60 frames")
+  {
+    auto cpu = reset();
+    uint64_t cycles = 0;
+    for (int frame = 0; frame < c_frames; ++frame)
+    {
+      uint64_t end = cycles + c_frameCycles;
+      while (cycles < end)
+      {
+        cycles += mos6502::executeInstruction(cpu, bus);
+      }
+    }
+    return cycles;
+  };
+}
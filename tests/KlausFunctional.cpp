@@ -1,4 +1,3 @@
-// Source: /home/jason/projects/emulate/build/clang/debug/_deps/master-src/bin_files/6502_functional_test.lst
 // Credit: Klaus Dormann — https://github.com/Klaus2m5/6502_65C02_functional_tests
 
 #include "KlausFunctional.h"
@@ -6,19 +5,12 @@
 #include <span>
 
 #include "common/address.h"
-
-#if 0
-
 #include "incbin.h"
 
-extern "C" {
-INCBIN(Common::Byte, _Klaus__6502_functional_testBin,
-    "../build/clang/debug/_deps/master-src/bin_files/6502_functional_test.bin");
-}
+// KLAUS_FUNCTIONAL_TEST_BIN is the image CPM fetched, see tests/CMakeLists.txt.
+INCBIN(KlausFunctionalTest, KLAUS_FUNCTIONAL_TEST_BIN);
 
 std::span<const Common::Byte> Klaus__6502_functional_test::data() noexcept
 {
-  return std::span<const Common::Byte>(g_Klaus__6502_functional_testBinData, g_Klaus__6502_functional_testBinSize);
+  return std::span<const Common::Byte>(gKlausFunctionalTestData, gKlausFunctionalTestSize);
 }
-
-#endif
@@ -0,0 +1,165 @@
+// Runs the Klaus Dormann functional test image with every CPU engine.
+// Credit: Klaus Dormann — https://github.com/Klaus2m5/6502_65C02_functional_tests
+
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <span>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "KlausFunctional.h"
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "cpu6502/block_cache.h"
+#include "cpu6502/mos6502.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+constexpr Address c_start{0x0400};
+
+// The test keeps the number of the test in progress here.
+constexpr Address c_testCase{0x0200};
+
+// Enough for the whole test (about 30 million instructions), so a runaway test still terminates.
+constexpr uint64_t c_maxInstructions = 100'000'000;
+
+enum class Engine
+{
+  Microcode,
+  Instruction,
+  Block,
+};
+
+struct RunResult
+{
+  Address trap{0};
+  uint64_t cycles = 0;
+};
+
+// Runs until the program traps (branches or jumps to itself) and returns the trap address. The
+// test signals both success and failure with a trap.
+RunResult runUntilTrap(Engine engine, Bus& bus)
+{
+  MicrocodePump<mos6502> pump;
+  BlockCache blocks{&mos6502::instruction};
+  Generic6502Definition cpu;
+  cpu.registers.pc = c_start;
+
+  using BusToken = Generic6502Definition::BusToken;
+  uint64_t cycles = 0;
+  for (uint64_t count = 0; count < c_maxInstructions; ++count)
+  {
+    Address pc = cpu.registers.pc;
+    uint32_t instructions = 1;
+    if (engine == Engine::Microcode)
+    {
+      while (pump.tick(cpu, BusToken{&bus}))
+      {
+      }
+      cycles = pump.cycles();
+    }
+    else if (engine == Engine::Instruction)
+    {
+      cycles += mos6502::executeInstruction(cpu, bus);
+    }
+    else
+    {
+      auto executed = blocks.execute<mos6502>(cpu, bus);
+      cycles += executed.cycles;
+      instructions = executed.instructions;
+    }
+    if (cpu.trapped)
+    {
+      return {cpu.trapAddress, cycles};
+    }
+
+    // JMP absolute does not raise a trap itself. A longer block can loop back to its start without
+    // being a trap.
+    if (instructions == 1 && cpu.registers.pc == pc)
+    {
+      return {pc, cycles};
+    }
+  }
+  return {cpu.registers.pc, cycles};
+}
+
+// Names the trap: success, the failed check among the test's error traps and the test it is part
+// of, or a trap the test does not have.
+std::string describeTrap(Address trap, const Bus& bus)
+{
+  std::ostringstream out;
+  out << std::hex << std::uppercase << std::setfill('0') << "trap at $" << std::setw(4)
+      << static_cast<uint16_t>(trap);
+  if (trap == Klaus__6502_functional_test::success)
+  {
+    out << ": success";
+    return out.str();
+  }
+
+  const auto& errors = Klaus__6502_functional_test::errors;
+  auto error = std::ranges::find(errors, trap);
+  if (error == std::end(errors))
+  {
+    out << ": not one of the test's traps";
+    return out.str();
+  }
+  out << std::dec << ": error trap " << (error - std::begin(errors)) << " of " << std::size(errors)
+      << ", failed in test $" << std::hex << std::setw(2) << static_cast<int>(bus.read(c_testCase));
+  return out.str();
+}
+
+void runEngine(Engine engine, const char* name)
+{
+  std::span<const Byte> image = Klaus__6502_functional_test::data();
+  REQUIRE(!image.empty());
+
+  std::vector<Byte> memory(0x10000);
+  std::ranges::copy(image.first(std::min(image.size(), memory.size())), memory.begin());
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+
+  auto start = std::chrono::steady_clock::now();
+  RunResult result = runUntilTrap(engine, bus);
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+  INFO(describeTrap(result.trap, bus));
+  CHECK(result.trap == Klaus__6502_functional_test::success);
+
+  std::cout << "Klaus functional test, " << name << ": " << result.cycles << " cycles in " << std::fixed
+            << std::setprecision(3) << elapsed.count() << " s, "
+            << static_cast<double>(result.cycles) / elapsed.count() / 1e6 << " MHz\n";
+}
+
+}  // namespace
+
+TEST_CASE("Klaus functional test", "[klaus][slow]")
+{
+  SECTION("Microcode engine")
+  {
+    runEngine(Engine::Microcode, "microcode engine");
+  }
+
+  SECTION("Instruction engine")
+  {
+    runEngine(Engine::Instruction, "instruction engine");
+  }
+
+  SECTION("Block engine")
+  {
+    runEngine(Engine::Block, "block engine");
+  }
+}
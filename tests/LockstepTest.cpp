@@ -0,0 +1,246 @@
+// Runs many CPUs in lockstep and checks every lane against the instruction-level engine running it on
+// its own.
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "cpu6502/cpu6502_types.h"
+#include "cpu6502/lockstep.h"
+#include "cpu6502/mos6502.h"
+#include "cpu6502/registers.h"
+#include "cpu6502/wdc65c02.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+constexpr Address c_start{0x0400};
+
+//! One lane copied out of a Lockstep, run on its own.
+struct Reference
+{
+  Reference(std::span<const Byte> image, const Registers& registers)
+    : memory(image.begin(), image.end())
+    , cpu(registers)
+  {
+  }
+
+  std::vector<Byte> memory;
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  Bus bus{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+  Generic6502Definition cpu;
+  uint64_t cycles = 0;
+};
+
+//! Registers that differ in every lane. Every 256 lanes all values of A meet all operand bytes that
+//! setOperands() writes, with one of four flag combinations.
+Registers laneRegisters(size_t lane)
+{
+  using Flag = Registers::Flag;
+  constexpr std::array<Byte, 4> c_flags{0x00, static_cast<Byte>(Flag::Carry), static_cast<Byte>(Flag::Decimal),
+      static_cast<Byte>(Flag::Carry) | static_cast<Byte>(Flag::Overflow) | static_cast<Byte>(Flag::Zero) |
+          static_cast<Byte>(Flag::Negative)};
+
+  Registers registers;
+  registers.pc = c_start;
+  registers.a = static_cast<Byte>(lane);
+  registers.x = static_cast<Byte>(lane * 11 + 5);
+  registers.y = static_cast<Byte>(lane * 59 + 3);
+  registers.sp = static_cast<Byte>(0xFF - lane % 16);
+  registers.p = static_cast<Byte>(c_flags[(lane + lane / 256) % c_flags.size()] | static_cast<Byte>(Flag::Unused));
+  return registers;
+}
+
+void setOperands(std::span<Byte, Lockstep::c_memorySize> memory, size_t lane)
+{
+  memory[static_cast<uint16_t>(c_start) + 1] = static_cast<Byte>(lane * 7 + lane / 256);
+  memory[static_cast<uint16_t>(c_start) + 2] = static_cast<Byte>(lane * 3);
+}
+
+//! Runs `steps` steps of `lockstep` and the same number of instructions of each lane on its own, and
+//! compares them.
+template<typename Processor>
+void checkAgainstReference(Lockstep& lockstep, uint64_t steps, bool compareMemory)
+{
+  std::vector<std::unique_ptr<Reference>> references;
+  for (size_t lane = 0; lane < lockstep.lanes(); ++lane)
+  {
+    references.push_back(std::make_unique<Reference>(lockstep.memory(lane), lockstep.registers(lane)));
+  }
+
+  lockstep.run(steps);
+  for (auto& reference : references)
+  {
+    for (uint64_t step = 0; step < steps && !reference->cpu.trapped; ++step)
+    {
+      reference->cycles += Processor::executeInstruction(reference->cpu, reference->bus);
+    }
+  }
+
+  for (size_t lane = 0; lane < lockstep.lanes(); ++lane)
+  {
+    const Reference& reference = *references[lane];
+    INFO("lane " << lane);
+    CHECK(lockstep.registers(lane) == reference.cpu.registers);
+    CHECK(lockstep.cycles(lane) == reference.cycles);
+    REQUIRE(lockstep.trapped(lane) == reference.cpu.trapped);
+    if (reference.cpu.trapped)
+    {
+      CHECK(lockstep.trapAddress(lane) == reference.cpu.trapAddress);
+    }
+    if (compareMemory)
+    {
+      CHECK(std::ranges::equal(lockstep.memory(lane), reference.memory));
+    }
+  }
+}
+
+// The instructions the kernels run. Decimal ADC and SBC and self-branches run one lane at a time.
+constexpr std::array<Byte, 40> c_kernelOpcodes{0xEA, 0x18, 0x38, 0xB8, 0xD8, 0xF8, 0xAA, 0xA8, 0x8A, 0x98, 0xBA,
+    0x9A, 0xE8, 0xC8, 0xCA, 0x88, 0x0A, 0x4A, 0x2A, 0x6A, 0xA9, 0xA2, 0xA0, 0x29, 0x09, 0x49, 0xC9, 0xE0, 0xC0, 0x69,
+    0xE9, 0x10, 0x30, 0x50, 0x70, 0x90, 0xB0, 0xD0, 0xF0, 0x4C};
+
+template<typename Processor>
+void checkOpcodes()
+{
+  constexpr size_t c_lanes = 512;
+  for (Byte opcode : c_kernelOpcodes)
+  {
+    INFO("opcode $" << std::hex << unsigned{opcode});
+    Lockstep lockstep{c_lanes, &Processor::executeInstruction};
+    for (size_t lane = 0; lane < c_lanes; ++lane)
+    {
+      lockstep.setRegisters(lane, laneRegisters(lane));
+      lockstep.memory(lane)[static_cast<uint16_t>(c_start)] = opcode;
+      setOperands(lockstep.memory(lane), lane);
+    }
+    checkAgainstReference<Processor>(lockstep, 1, false);
+    CHECK(lockstep.stats().lockstep > 0);
+    CHECK(lockstep.stats().lockstep + lockstep.stats().scalar == c_lanes);
+  }
+}
+
+// CLC; ADC #$1D; BCC +2; INC $10; STA $0200,Y; PHA; PLA; LSR A; INY; BNE loop; SED; ADC #$01; CLD;
+// JMP loop. The lanes take the branches at different times and drift apart.
+constexpr std::array<Byte, 25> c_divergingLoop{0xA0, 0x00, 0x18, 0x69, 0x1D, 0x90, 0x02, 0xE6, 0x10, 0x99, 0x00,
+    0x02, 0x48, 0x68, 0x4A, 0xC8, 0xD0, 0xF0, 0xF8, 0x69, 0x01, 0xD8, 0x4C, 0x02, 0x04};
+
+// CLC; ADC #$37; EOR #$A5; AND #$7F; ORA #$01; ASL A; LSR A; CMP #$40; INX; BNE loop; JMP loop, the
+// ALU loop of emulateBench without its initial loads, so the lanes keep their own A and X.
+constexpr std::array<Byte, 19> c_aluLoop{0x18, 0x69, 0x37, 0x49, 0xA5, 0x29, 0x7F, 0x09, 0x01, 0x0A, 0x4A, 0xC9,
+    0x40, 0xE8, 0xD0, 0xF0, 0x4C, 0x00, 0x04};
+
+template<size_t N>
+void loadProgram(Lockstep& lockstep, const std::array<Byte, N>& program, bool decimal)
+{
+  for (size_t lane = 0; lane < lockstep.lanes(); ++lane)
+  {
+    Registers registers = laneRegisters(lane);
+    registers.p = static_cast<Byte>(registers.p & ~static_cast<Byte>(Registers::Flag::Decimal));
+    if (decimal && lane % 3 == 0)
+    {
+      registers.p = static_cast<Byte>(registers.p | static_cast<Byte>(Registers::Flag::Decimal));
+    }
+    lockstep.setRegisters(lane, registers);
+    std::ranges::copy(program, lockstep.memory(lane).begin() + static_cast<uint16_t>(c_start));
+  }
+}
+
+}  // namespace
+
+TEST_CASE("Lockstep kernels run like the NMOS 6502", "[lockstep]")
+{
+  checkOpcodes<mos6502>();
+}
+
+TEST_CASE("Lockstep kernels run like the 65C02", "[lockstep]")
+{
+  checkOpcodes<wdc65c02>();
+}
+
+TEST_CASE("Lockstep runs diverging lanes one at a time", "[lockstep]")
+{
+  Lockstep lockstep{37, &mos6502::executeInstruction};
+  loadProgram(lockstep, c_divergingLoop, true);
+  checkAgainstReference<mos6502>(lockstep, 3000, true);
+
+  Lockstep::Stats stats = lockstep.stats();
+  CHECK(stats.lockstep + stats.scalar == 37 * 3000);
+  CHECK(stats.lockstep > 0);
+  CHECK(stats.scalar > 0);
+  CHECK(lockstep.registerFile().pc.size() == 37);
+}
+
+TEST_CASE("Lockstep stops lanes that trap", "[lockstep]")
+{
+  // Lane 1 branches to itself, lane 0 runs on into NOPs.
+  Lockstep lockstep{2, &mos6502::executeInstruction};
+  for (size_t lane = 0; lane < 2; ++lane)
+  {
+    auto memory = lockstep.memory(lane);
+    std::fill_n(memory.begin() + static_cast<uint16_t>(c_start), 16, Byte{0xEA});
+    memory[static_cast<uint16_t>(c_start)] = 0xB0;  // BCS *
+    memory[static_cast<uint16_t>(c_start) + 1] = 0xFE;
+    Registers registers;
+    registers.pc = c_start;
+    registers.p = static_cast<Byte>(registers.p | (lane == 1 ? static_cast<Byte>(Registers::Flag::Carry) : 0));
+    lockstep.setRegisters(lane, registers);
+  }
+
+  CHECK(lockstep.run(4) == 4);
+  CHECK(lockstep.trapped(1));
+  CHECK(lockstep.trapAddress(1) == c_start);
+  CHECK(lockstep.registers(1).pc == c_start);
+  CHECK(!lockstep.trapped(0));
+  CHECK(lockstep.registers(0).pc == Address{0x0405});
+  CHECK(lockstep.cycles(0) == 8);
+}
+
+TEST_CASE("Lockstep benchmark", "[.][benchmark][lockstep]")
+{
+  constexpr size_t c_lanes = 256;
+  constexpr uint64_t c_steps = 1'000;
+
+  // The same X in every lane keeps them in step; only A differs.
+  Lockstep lockstep{c_lanes, &mos6502::executeInstruction};
+  loadProgram(lockstep, c_aluLoop, false);
+  std::vector<std::unique_ptr<Reference>> lanes;
+  for (size_t lane = 0; lane < c_lanes; ++lane)
+  {
+    Registers registers = lockstep.registers(lane);
+    registers.x = 0;
+    lockstep.setRegisters(lane, registers);
+    lanes.push_back(std::make_unique<Reference>(lockstep.memory(lane), registers));
+  }
+
+  BENCHMARK("256 lanes one at a time, 1000 instructions each")
+  {
+    uint64_t cycles = 0;
+    for (auto& lane : lanes)
+    {
+      for (uint64_t step = 0; step < c_steps; ++step)
+      {
+        cycles += mos6502::executeInstruction(lane->cpu, lane->bus);
+      }
+    }
+    return cycles;
+  };
+
+  BENCHMARK("256 lanes in lockstep, 1000 instructions each")
+  {
+    return lockstep.run(c_steps);
+  };
+}
@@ -0,0 +1,87 @@
+// Compares the cost of capturing bus cycles on the Klaus Dormann functional test image.
+// Credit: Klaus Dormann — https://github.com/Klaus2m5/6502_65C02_functional_tests
+
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <catch2/catch_test_macros.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "common/address.h"
+#include "common/bus.h"
+#include "common/memory.h"
+#include "common/microcode_pump.h"
+#include "common/tracing_device.h"
+#include "cpu6502/mos6502.h"
+
+using namespace Common;
+using namespace cpu6502;
+
+namespace
+{
+
+// The image is a 64K memory dump, execution starts at $0400.
+constexpr Address c_start{0x0400};
+constexpr uint64_t c_ticks = 1'000'000;
+
+uint64_t run(Bus& bus)
+{
+  MicrocodePump<mos6502> pump;
+  Generic6502Definition cpu;
+  cpu.registers.pc = c_start;
+  // The benchmark only measures throughput, a failing test just spins on its trap.
+  cpu.trapPolicy = Generic6502Definition::TrapPolicy::Ignore;
+
+  using BusToken = Generic6502Definition::BusToken;
+  for (uint64_t i = 0; i < c_ticks; ++i)
+  {
+    pump.tick(cpu, BusToken{&bus});
+  }
+  return pump.cycles() + static_cast<uint16_t>(cpu.registers.pc);
+}
+
+}  // namespace
+
+TEST_CASE("Bus tracing benchmark", "[.][benchmark][klaus]")
+{
+  const std::vector<Byte> image = LoadFile(KLAUS_FUNCTIONAL_TEST_BIN);
+  if (image.empty())
+  {
+    SKIP("Klaus functional test image not found: " KLAUS_FUNCTIONAL_TEST_BIN);
+  }
+
+  std::vector<Byte> memory(0x10000);
+  MemoryDevice<Byte> ram{std::span<Byte>(memory)};
+  TracingDevice tracer{ram};
+
+  Bus untraced{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}};
+  Bus untracedDevice{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &ram}}, Bus::MemoryAccess::Device};
+  Bus traced{{Bus::Entry{Address{0x0000}, Address{0xFFFF}, &tracer}}};
+
+  auto reset = [&]()
+  {
+    auto count = static_cast<std::ptrdiff_t>(std::min(image.size(), memory.size()));
+    std::copy_n(image.begin(), count, memory.begin());
+  };
+
+  BENCHMARK("untraced, 1M ticks")
+  {
+    reset();
+    return run(untraced);
+  };
+
+  BENCHMARK("untraced through Device interface, 1M ticks")
+  {
+    reset();
+    return run(untracedDevice);
+  };
+
+  BENCHMARK("traced, 1M ticks")
+  {
+    reset();
+    return run(traced);
+  };
+}